@@ -0,0 +1,130 @@
+/*
+  RadioLib LoRaWAN Non-blocking Example
+
+  This example joins a LoRaWAN network and sends uplinks
+  without blocking the main loop. Instead of waiting in
+  sendReceive() for several seconds, the uplink is started
+  using startSendReceive() and advanced by calling tick().
+  In the meantime, the loop is free to do other work.
+
+  Running this examples REQUIRES you to check "Resets DevNonces"
+  on your LoRaWAN dashboard. Refer to the network's
+  documentation on how to do this.
+
+  For default module settings, see the wiki page
+  https://github.com/jgromes/RadioLib/wiki/Default-configuration
+
+  For full API reference, see the GitHub Pages
+  https://jgromes.github.io/RadioLib/
+
+  For LoRaWAN details, see the wiki page
+  https://github.com/jgromes/RadioLib/wiki/LoRaWAN
+
+*/
+
+#include "config.h"
+
+// buffers must remain valid until the sequence finishes
+uint8_t uplinkPayload[3];
+uint8_t downlinkPayload[255];
+size_t downlinkLen = 0;
+
+// flag to indicate that the uplink/downlink sequence finished
+volatile bool sequenceDone = false;
+volatile int16_t sequenceState = RADIOLIB_ERR_NONE;
+
+// this function is called from node.tick() when the sequence finishes
+void sequenceFinished(int16_t state) {
+  sequenceState = state;
+  sequenceDone = true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while(!Serial);
+  delay(5000);  // Give time to switch to the serial monitor
+  Serial.println(F("\nSetup ... "));
+
+  Serial.println(F("Initialise the radio"));
+  ConfigLoRa_t config;
+  config.frequency = 868; // The frequency here does not matter, as it will get changed by LoRaWAN anyway
+  //radio.tcxoVoltage = 1.6; // Some radio modules like SX126x often come with TCXO
+  int state = radio.begin(config);
+  debug(state != RADIOLIB_ERR_NONE, F("Initialise radio failed"), state, true);
+
+  // Setup the OTAA session information
+  state = node.beginOTAA(joinEUI, devEUI, nwkKey, appKey);
+  debug(state != RADIOLIB_ERR_NONE, F("Initialise node failed"), state, true);
+
+  Serial.println(F("Join ('login') the LoRaWAN Network"));
+  state = node.activateOTAA();
+  debug(state != RADIOLIB_LORAWAN_NEW_SESSION, F("Join failed"), state, true);
+
+  // set the function that will be called when a sequence finishes
+  node.setSendReceiveCallback(sequenceFinished);
+
+  Serial.println(F("Ready!\n"));
+}
+
+uint32_t lastUplink = 0;
+bool busy = false;
+
+void loop() {
+  // advance the uplink/downlink sequence
+  // tip: node.timeUntilTick() returns the number of milliseconds
+  //      until the next call is needed, so you could sleep until then
+  if(busy) {
+    node.tick();
+  }
+
+  // check if the sequence finished
+  if(sequenceDone) {
+    sequenceDone = false;
+    busy = false;
+    debug(sequenceState < RADIOLIB_ERR_NONE, F("Error in sequence"), sequenceState, false);
+
+    // Check if a downlink was received
+    // (state 0 = no downlink, state 1/2 = downlink in window Rx1/Rx2)
+    if(sequenceState > 0) {
+      Serial.println(F("Received a downlink"));
+      if(downlinkLen > 0) {
+        Serial.println(F("Downlink data: "));
+        arrayDump(downlinkPayload, downlinkLen);
+      }
+    } else {
+      Serial.println(F("No downlink received"));
+    }
+
+    Serial.print(F("Next uplink in "));
+    Serial.print(uplinkIntervalSeconds);
+    Serial.println(F(" seconds\n"));
+  }
+
+  // this is the place to do other work while the radio is busy
+
+  // if less than uplinkIntervalSeconds have elapsed since previous uplink,
+  // stop and go back to the top of the loop()
+  if(busy || (millis() - lastUplink < uplinkIntervalSeconds * 1000)) {
+    return;
+  }
+
+  Serial.println(F("Sending uplink"));
+
+  // This is the place to gather the sensor inputs
+  // Instead of reading any real sensor, we just generate some random numbers as example
+  uint8_t value1 = radio.random(100);
+  uint16_t value2 = radio.random(2000);
+
+  // Build payload byte array
+  uplinkPayload[0] = value1;
+  uplinkPayload[1] = highByte(value2);   // See notes for high/lowByte functions
+  uplinkPayload[2] = lowByte(value2);
+
+  // Start the uplink, this returns immediately
+  int16_t state = node.startSendReceive(uplinkPayload, sizeof(uplinkPayload), 1, downlinkPayload, &downlinkLen);
+  debug(state != RADIOLIB_ERR_NONE, F("Error in startSendReceive"), state, false);
+  busy = (state == RADIOLIB_ERR_NONE);
+
+  // set timestamp of last uplink
+  lastUplink = millis();
+}
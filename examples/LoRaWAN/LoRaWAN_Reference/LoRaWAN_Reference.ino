@@ -197,8 +197,9 @@ void loop() {
 
   // wait before sending another packet
   uint32_t minimumDelay = uplinkIntervalSeconds * 1000UL;
-  uint32_t interval = node.timeUntilUplink();     // calculate minimum duty cycle delay (per FUP & law!)
-  uint32_t delayMs = max(interval, minimumDelay); // cannot send faster than duty cycle allows
+  RadioLibTime_t interval = node.timeUntilUplink(sizeof(uplinkPayload)); // calculate minimum duty cycle delay (per FUP & law!)
+  debug(interval == RADIOLIB_LORAWAN_UPLINK_NEVER, F("Uplink too long for the duty cycle"), 0, true);
+  uint32_t delayMs = max((uint32_t)interval, minimumDelay); // cannot send faster than duty cycle allows
 
   Serial.print(F("[LoRaWAN] Next uplink in "));
   Serial.print(delayMs/1000);
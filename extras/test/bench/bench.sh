@@ -0,0 +1,19 @@
+#!/bin/bash
+
+set -e
+
+args=$1
+
+# build the benchmark binary
+rm -rf build
+mkdir build
+cd build
+cmake -DCMAKE_CXX_FLAGS="${CMAKE_CXX_FLAGS} ${args}" ..
+make -j4
+
+# run it, pass the minimum acceptable throughput (cycles/s) as the third argument to catch regressions
+cd ..
+./build/radiolib-bench 16 256 ${MIN_CYCLES_PER_SECOND:-0}
+
+# simulate a fleet of 1000 nodes for one hour
+./build/radiolib-fleet 1000 1
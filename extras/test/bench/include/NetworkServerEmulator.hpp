@@ -0,0 +1,709 @@
+#ifndef NETWORK_SERVER_EMULATOR_HPP
+#define NETWORK_SERVER_EMULATOR_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <RadioLib.h>
+
+#include "VirtualRadio.hpp"
+
+// maximum number of channels tracked per device (dynamic bands only)
+#define NS_EMULATOR_MAX_CHANNELS      (16)
+
+// NetID and DevAddr prefix handed out by the emulator
+#define NS_EMULATOR_NET_ID            (0x000013)
+#define NS_EMULATOR_DEV_ADDR_BASE     (0x26000000UL)
+
+// counters kept by the network server
+struct NsStats {
+  uint32_t joinRequests = 0;
+  uint32_t joinAccepts = 0;
+  uint32_t uplinks = 0;
+  uint32_t retransmissions = 0;
+  uint32_t downlinks = 0;
+  uint32_t acks = 0;
+  uint32_t micFailures = 0;
+  uint32_t unknownDevices = 0;
+  uint32_t replays = 0;
+  uint32_t malformed = 0;
+
+  // answers to network-initiated MAC commands
+  uint32_t linkAdrAns = 0;
+  uint32_t linkAdrAccepted = 0;
+  uint32_t dutyCycleAns = 0;
+  uint32_t newChannelAns = 0;
+  uint32_t newChannelAccepted = 0;
+  uint32_t devStatusAns = 0;
+
+  // device-initiated MAC commands
+  uint32_t rekeyInd = 0;
+  uint32_t linkCheckReq = 0;
+  uint32_t deviceTimeReq = 0;
+  uint32_t deviceModeInd = 0;
+};
+
+// state of a single end device as seen by the network server
+struct NsDevice {
+  // provisioning
+  uint64_t joinEUI = 0;
+  uint64_t devEUI = 0;
+  uint8_t nwkKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t appKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  bool rev11 = false;
+
+  // session
+  bool joined = false;
+  uint32_t devAddr = 0;
+  uint32_t joinNonce = 0;
+  int32_t lastDevNonce = -1;
+  uint8_t appSKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t fNwkSIntKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t sNwkSIntKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t nwkSEncKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint32_t fCntUp = 0;
+  bool anyUplink = false;
+  uint32_t nFCntDown = 0;
+  uint32_t aFCntDown = 0;
+  int32_t confFCntDown = -1;
+
+  // uplink channel frequencies (Hz) by channel index, needed for the LoRaWAN v1.1 MIC
+  uint32_t chFreq[NS_EMULATOR_MAX_CHANNELS] = { 0 };
+
+  // NewChannelReq waiting for an answer
+  uint8_t newChIdx = 0;
+  uint32_t newChFreq = 0;
+
+  // MAC commands and application payload waiting for the next downlink
+  uint8_t macQueue[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE] = { 0 };
+  size_t macQueueLen = 0;
+  uint8_t appDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE] = { 0 };
+  size_t appDownLen = 0;
+  uint8_t appDownPort = 0;
+  bool appDownConfirmed = false;
+};
+
+// in-process stand-in for a LoRaWAN network and join server
+// handles OTAA joins, uplink MIC checks and decryption, acknowledgements,
+// and answers or sends MAC commands - all in the Rx1 window of the uplink
+// only dynamic-channel bands (e.g. EU868) are supported, Rx1 is on the uplink frequency
+class NetworkServerEmulator : public VirtualChannel {
+  public:
+    NsStats stats;
+    std::vector<NsDevice> devices;
+
+    // add CFList with five extra channels to every JoinAccept
+    bool cfList = true;
+
+    // GPS time returned in DeviceTimeAns
+    uint32_t gpsTime = 1400000000UL;
+
+    explicit NetworkServerEmulator(const LoRaWANBand_t* band) : band(band) {}
+
+    // register a device, nwkKey is NULL for LoRaWAN v1.0.x devices; returns the device index
+    size_t addDevice(uint64_t joinEUI, uint64_t devEUI, const uint8_t* nwkKey, const uint8_t* appKey) {
+      NsDevice dev;
+      dev.joinEUI = joinEUI;
+      dev.devEUI = devEUI;
+      dev.rev11 = (nwkKey != NULL);
+      memcpy(dev.appKey, appKey, RADIOLIB_AES128_KEY_SIZE);
+      if(nwkKey) {
+        memcpy(dev.nwkKey, nwkKey, RADIOLIB_AES128_KEY_SIZE);
+      }
+      this->devices.push_back(dev);
+      return(this->devices.size() - 1);
+    }
+
+    // queue LinkADRReq, dr/txPower of 0x0F keep the current values
+    bool queueLinkAdrReq(size_t idx, uint8_t dr, uint8_t txPower, uint16_t chMask, uint8_t nbTrans) {
+      uint8_t cmd[4] = { (uint8_t)((dr << 4) | (txPower & 0x0F)), (uint8_t)(chMask & 0xFF), (uint8_t)(chMask >> 8), (uint8_t)(nbTrans & 0x0F) };
+      return(this->queueMac(idx, RADIOLIB_LORAWAN_MAC_LINK_ADR, cmd, 4));
+    }
+
+    // queue DutyCycleReq, the aggregated duty cycle is 1/2^maxDCycle
+    bool queueDutyCycleReq(size_t idx, uint8_t maxDCycle) {
+      uint8_t cmd = maxDCycle & 0x0F;
+      return(this->queueMac(idx, RADIOLIB_LORAWAN_MAC_DUTY_CYCLE, &cmd, 1));
+    }
+
+    // queue NewChannelReq for a channel at given frequency in Hz
+    bool queueNewChannelReq(size_t idx, uint8_t chIdx, uint32_t freq, uint8_t drMin, uint8_t drMax) {
+      uint8_t cmd[5];
+      cmd[0] = chIdx;
+      putLE(&cmd[1], freq / 100, 3);
+      cmd[4] = (uint8_t)((drMax << 4) | (drMin & 0x0F));
+      if(!this->queueMac(idx, RADIOLIB_LORAWAN_MAC_NEW_CHANNEL, cmd, 5)) {
+        return(false);
+      }
+      this->devices[idx].newChIdx = chIdx;
+      this->devices[idx].newChFreq = freq;
+      return(true);
+    }
+
+    // queue DevStatusReq
+    bool queueDevStatusReq(size_t idx) {
+      return(this->queueMac(idx, RADIOLIB_LORAWAN_MAC_DEV_STATUS, NULL, 0));
+    }
+
+    // queue application payload for the next downlink
+    bool queueDownlink(size_t idx, uint8_t fPort, const uint8_t* data, size_t len, bool confirmed = false) {
+      NsDevice& dev = this->devices[idx];
+      if((fPort == 0) || (len > sizeof(dev.appDown))) {
+        return(false);
+      }
+      memcpy(dev.appDown, data, len);
+      dev.appDownLen = len;
+      dev.appDownPort = fPort;
+      dev.appDownConfirmed = confirmed;
+      return(true);
+    }
+
+    void transmit(VirtualRadio* radio, const VirtualFrame& frame, RadioLibTime_t start, RadioLibTime_t toa) override {
+      (void)start;
+      (void)toa;
+
+      // the network only listens to uplinks
+      if(frame.invertIq || (frame.len < 1)) {
+        return;
+      }
+
+      uint8_t mType = frame.data[0] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK;
+      if(mType == RADIOLIB_LORAWAN_MHDR_MTYPE_JOIN_REQUEST) {
+        this->handleJoinRequest(radio, frame);
+      } else if((mType == RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_UP) || (mType == RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP)) {
+        this->handleUplink(radio, frame);
+      } else {
+        this->stats.malformed++;
+      }
+    }
+
+  private:
+    const LoRaWANBand_t* band;
+    RadioLibSoftwareAES128 aes;
+
+    static void putLE(uint8_t* buff, uint64_t val, size_t len) {
+      for(size_t i = 0; i < len; i++) {
+        buff[i] = (uint8_t)(val >> (8*i));
+      }
+    }
+
+    static uint64_t getLE(const uint8_t* buff, size_t len) {
+      uint64_t val = 0;
+      for(size_t i = 0; i < len; i++) {
+        val |= (uint64_t)buff[i] << (8*i);
+      }
+      return(val);
+    }
+
+    // length of MAC commands sent by the device, -1 if unknown
+    static int lenUp(uint8_t cid) {
+      switch(cid) {
+        case(RADIOLIB_LORAWAN_MAC_RESET):
+        case(RADIOLIB_LORAWAN_MAC_LINK_ADR):
+        case(RADIOLIB_LORAWAN_MAC_RX_PARAM_SETUP):
+        case(RADIOLIB_LORAWAN_MAC_NEW_CHANNEL):
+        case(RADIOLIB_LORAWAN_MAC_DL_CHANNEL):
+        case(RADIOLIB_LORAWAN_MAC_REKEY):
+        case(RADIOLIB_LORAWAN_MAC_REJOIN_PARAM_SETUP):
+        case(RADIOLIB_LORAWAN_MAC_DEVICE_MODE):
+          return(1);
+        case(RADIOLIB_LORAWAN_MAC_DEV_STATUS):
+          return(2);
+        case(RADIOLIB_LORAWAN_MAC_LINK_CHECK):
+        case(RADIOLIB_LORAWAN_MAC_DUTY_CYCLE):
+        case(RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP):
+        case(RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP):
+        case(RADIOLIB_LORAWAN_MAC_ADR_PARAM_SETUP):
+        case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME):
+          return(0);
+      }
+      return(-1);
+    }
+
+    bool queueMac(size_t idx, uint8_t cid, const uint8_t* payload, size_t len) {
+      NsDevice& dev = this->devices[idx];
+      if(dev.macQueueLen + 1 + len > sizeof(dev.macQueue)) {
+        return(false);
+      }
+      dev.macQueue[dev.macQueueLen++] = cid;
+      if(len) {
+        memcpy(&dev.macQueue[dev.macQueueLen], payload, len);
+      }
+      dev.macQueueLen += len;
+      return(true);
+    }
+
+    void cmac(const uint8_t* key, const uint8_t* data, size_t len, uint8_t* out) {
+      this->aes.init(const_cast<uint8_t*>(key));
+      this->aes.generateCMAC(data, len, out);
+    }
+
+    void deriveKey(const uint8_t* rootKey, const uint8_t* block, uint8_t type, uint8_t* out) {
+      uint8_t buff[RADIOLIB_AES128_BLOCK_SIZE];
+      memcpy(buff, block, RADIOLIB_AES128_BLOCK_SIZE);
+      buff[0] = type;
+      this->aes.init(const_cast<uint8_t*>(rootKey));
+      this->aes.encryptECB(buff, RADIOLIB_AES128_BLOCK_SIZE, out);
+    }
+
+    // same keystream as LoRaWANNode::processAES
+    void cryptPayload(uint8_t* data, size_t len, const uint8_t* key, uint32_t addr, uint32_t fCnt, uint8_t dir, uint8_t ctrId) {
+      uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+      uint8_t stream[RADIOLIB_AES128_BLOCK_SIZE];
+      block[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_ENC_BLOCK_MAGIC;
+      block[RADIOLIB_LORAWAN_ENC_BLOCK_COUNTER_ID_POS] = ctrId;
+      block[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = dir;
+      putLE(&block[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], addr, 4);
+      putLE(&block[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt, 4);
+      this->aes.init(const_cast<uint8_t*>(key));
+      for(size_t i = 0; i*RADIOLIB_AES128_BLOCK_SIZE < len; i++) {
+        block[RADIOLIB_LORAWAN_ENC_BLOCK_COUNTER_POS] = (uint8_t)(i + 1);
+        this->aes.encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, stream);
+        for(size_t j = 0; (j < RADIOLIB_AES128_BLOCK_SIZE) && (i*RADIOLIB_AES128_BLOCK_SIZE + j < len); j++) {
+          data[i*RADIOLIB_AES128_BLOCK_SIZE + j] ^= stream[j];
+        }
+      }
+    }
+
+    // data rate index of the frame in the band table
+    int findDataRate(const VirtualFrame& frame) {
+      for(int i = 0; i < RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES; i++) {
+        const LoRaWANDataRate_t& dr = this->band->dataRates[i];
+        if(dr.modem != frame.modem) {
+          continue;
+        }
+        if((dr.modem == RADIOLIB_MODEM_LORA) &&
+           (dr.dr.lora.spreadingFactor == frame.dr.lora.spreadingFactor) &&
+           (dr.dr.lora.bandwidth == frame.dr.lora.bandwidth)) {
+          return(i);
+        }
+        if((dr.modem == RADIOLIB_MODEM_FSK) && (dr.dr.fsk.bitRate == frame.dr.fsk.bitRate)) {
+          return(i);
+        }
+      }
+      return(-1);
+    }
+
+    // the device tunes to a float frequency in MHz, allow for the rounding
+    static bool sameFreq(uint32_t a, uint32_t b) {
+      return((a > b ? a - b : b - a) < 100);
+    }
+
+    // channel index of the frequency the device used
+    int findChannel(const NsDevice& dev, uint32_t freq) {
+      for(int i = 0; i < NS_EMULATOR_MAX_CHANNELS; i++) {
+        if(dev.chFreq[i] && sameFreq(dev.chFreq[i], freq)) {
+          return(i);
+        }
+      }
+
+      // the uplink carrying NewChannelAns may already use the new channel
+      if(dev.newChFreq && sameFreq(dev.newChFreq, freq)) {
+        return(dev.newChIdx);
+      }
+      return(-1);
+    }
+
+    // send a downlink in Rx1, which for dynamic bands is on the uplink frequency
+    void reply(VirtualRadio* radio, const VirtualFrame& uplink, const uint8_t* data, size_t len) {
+      VirtualFrame frame = uplink;
+      memcpy(frame.data, data, len);
+      frame.len = len;
+      frame.invertIq = true;
+      radio->deliver(frame, 1);
+      this->stats.downlinks++;
+    }
+
+    void handleJoinRequest(VirtualRadio* radio, const VirtualFrame& frame) {
+      this->stats.joinRequests++;
+      if(frame.len != RADIOLIB_LORAWAN_JOIN_REQUEST_LEN) {
+        this->stats.malformed++;
+        return;
+      }
+
+      uint64_t joinEUI = getLE(&frame.data[RADIOLIB_LORAWAN_JOIN_REQUEST_JOIN_EUI_POS], 8);
+      uint64_t devEUI = getLE(&frame.data[RADIOLIB_LORAWAN_JOIN_REQUEST_DEV_EUI_POS], 8);
+      uint16_t devNonce = (uint16_t)getLE(&frame.data[RADIOLIB_LORAWAN_JOIN_REQUEST_DEV_NONCE_POS], 2);
+      size_t idx = 0;
+      for(; idx < this->devices.size(); idx++) {
+        if((this->devices[idx].devEUI == devEUI) && (this->devices[idx].joinEUI == joinEUI)) {
+          break;
+        }
+      }
+      if(idx == this->devices.size()) {
+        this->stats.unknownDevices++;
+        return;
+      }
+      NsDevice& dev = this->devices[idx];
+      const uint8_t* rootKey = dev.rev11 ? dev.nwkKey : dev.appKey;
+
+      // check the MIC
+      uint8_t mic[RADIOLIB_AES128_BLOCK_SIZE];
+      this->cmac(rootKey, frame.data, frame.len - 4, mic);
+      if(memcmp(mic, &frame.data[frame.len - 4], 4) != 0) {
+        this->stats.micFailures++;
+        return;
+      }
+
+      // LoRaWAN v1.1 devices must use increasing nonces
+      if(dev.rev11 && ((int32_t)devNonce <= dev.lastDevNonce)) {
+        this->stats.replays++;
+        return;
+      }
+      dev.lastDevNonce = devNonce;
+
+      // build the JoinAccept, with 16 bytes of prefix for the v1.1 MIC
+      uint8_t buff[11 + RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN] = { 0 };
+      uint8_t* msg = &buff[11];
+      size_t len = RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN - (this->cfList ? 0 : RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_LEN);
+      dev.joinNonce++;
+      dev.devAddr = NS_EMULATOR_DEV_ADDR_BASE | (uint32_t)idx;
+      msg[0] = RADIOLIB_LORAWAN_MHDR_MTYPE_JOIN_ACCEPT | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+      putLE(&msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_JOIN_NONCE_POS], dev.joinNonce, 3);
+      putLE(&msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_HOME_NET_ID_POS], NS_EMULATOR_NET_ID, 3);
+      putLE(&msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS], dev.devAddr, 4);
+      msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_DL_SETTINGS_POS] = (dev.rev11 ? RADIOLIB_LORAWAN_JOIN_ACCEPT_R_1_1 : 0) | this->band->rx2.dr;
+      msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_RX_DELAY_POS] = 1;
+
+      // default channels, then the CFList ones at 867.1 - 867.9 MHz
+      memset(dev.chFreq, 0, sizeof(dev.chFreq));
+      for(int i = 0; i < 3; i++) {
+        dev.chFreq[this->band->txFreqs[i].idx] = this->band->txFreqs[i].freq*100;
+      }
+      if(this->cfList) {
+        for(int i = 0; i < 5; i++) {
+          uint32_t freq = 8671000 + 2000*i;
+          putLE(&msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_POS + 3*i], freq, 3);
+          dev.chFreq[3 + i] = freq*100;
+        }
+        msg[RADIOLIB_LORAWAN_JOIN_ACCEPT_CFLIST_TYPE_POS] = RADIOLIB_LORAWAN_BAND_DYNAMIC;
+      }
+
+      // sign it
+      uint8_t mic2[RADIOLIB_AES128_BLOCK_SIZE];
+      if(dev.rev11) {
+        uint8_t jsIntKey[RADIOLIB_AES128_KEY_SIZE];
+        uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+        putLE(&block[1], dev.devEUI, 8);
+        this->deriveKey(dev.nwkKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_JS_INT_KEY, jsIntKey);
+        buff[0] = RADIOLIB_LORAWAN_JOIN_REQUEST_TYPE;
+        putLE(&buff[1], dev.joinEUI, 8);
+        putLE(&buff[9], devNonce, 2);
+        this->cmac(jsIntKey, buff, 11 + len - 4, mic2);
+      } else {
+        this->cmac(dev.appKey, msg, len - 4, mic2);
+      }
+      memcpy(&msg[len - 4], mic2, 4);
+
+      // derive the session keys
+      uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+      putLE(&block[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_JOIN_NONCE_POS], dev.joinNonce, 3);
+      if(dev.rev11) {
+        putLE(&block[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_JOIN_EUI_POS], dev.joinEUI, 8);
+        putLE(&block[RADIOLIB_LORAWAN_JOIN_ACCEPT_AES_DEV_NONCE_POS], devNonce, 2);
+        this->deriveKey(dev.appKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_APP_S_KEY, dev.appSKey);
+        this->deriveKey(dev.nwkKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_F_NWK_S_INT_KEY, dev.fNwkSIntKey);
+        this->deriveKey(dev.nwkKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_S_NWK_S_INT_KEY, dev.sNwkSIntKey);
+        this->deriveKey(dev.nwkKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_NWK_S_ENC_KEY, dev.nwkSEncKey);
+      } else {
+        putLE(&block[RADIOLIB_LORAWAN_JOIN_ACCEPT_HOME_NET_ID_POS], NS_EMULATOR_NET_ID, 3);
+        putLE(&block[RADIOLIB_LORAWAN_JOIN_ACCEPT_DEV_ADDR_POS], devNonce, 2);
+        this->deriveKey(dev.appKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_APP_S_KEY, dev.appSKey);
+        this->deriveKey(dev.appKey, block, RADIOLIB_LORAWAN_JOIN_ACCEPT_F_NWK_S_INT_KEY, dev.fNwkSIntKey);
+        memcpy(dev.sNwkSIntKey, dev.fNwkSIntKey, RADIOLIB_AES128_KEY_SIZE);
+        memcpy(dev.nwkSEncKey, dev.fNwkSIntKey, RADIOLIB_AES128_KEY_SIZE);
+      }
+
+      // reset the session
+      dev.joined = true;
+      dev.fCntUp = 0;
+      dev.anyUplink = false;
+      dev.nFCntDown = 0;
+      dev.aFCntDown = 0;
+      dev.confFCntDown = -1;
+      dev.macQueueLen = 0;
+      dev.appDownLen = 0;
+
+      // the device decrypts by encrypting, so the server has to decrypt
+      uint8_t enc[RADIOLIB_LORAWAN_JOIN_ACCEPT_MAX_LEN];
+      enc[0] = msg[0];
+      this->aes.init(const_cast<uint8_t*>(rootKey));
+      this->aes.decryptECB(&msg[1], len - 1, &enc[1]);
+      this->reply(radio, frame, enc, len);
+      this->stats.joinAccepts++;
+    }
+
+    void handleUplink(VirtualRadio* radio, const VirtualFrame& frame) {
+      // MHDR, DevAddr, FCtrl, FCnt, MIC
+      if(frame.len < 12) {
+        this->stats.malformed++;
+        return;
+      }
+      uint8_t fCtrl = frame.data[5];
+      uint8_t fOptsLen = fCtrl & RADIOLIB_LORAWAN_FHDR_FOPTS_LEN_MASK;
+      if(frame.len < 12 + (size_t)fOptsLen) {
+        this->stats.malformed++;
+        return;
+      }
+
+      uint32_t devAddr = (uint32_t)getLE(&frame.data[1], 4);
+      size_t idx = devAddr & ~NS_EMULATOR_DEV_ADDR_BASE;
+      if(((devAddr & 0xFF000000UL) != NS_EMULATOR_DEV_ADDR_BASE) || (idx >= this->devices.size()) || !this->devices[idx].joined) {
+        this->stats.unknownDevices++;
+        return;
+      }
+      NsDevice& dev = this->devices[idx];
+
+      // restore the 32-bit frame counter
+      uint16_t fCnt16 = (uint16_t)getLE(&frame.data[6], 2);
+      uint32_t fCnt = (dev.fCntUp & 0xFFFF0000UL) | fCnt16;
+      if(dev.anyUplink && (fCnt < dev.fCntUp)) {
+        fCnt += 0x10000;
+      }
+
+      // check the MIC
+      uint8_t buff[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE] = { 0 };
+      size_t msgLen = frame.len - 4;
+      memcpy(&buff[RADIOLIB_AES128_BLOCK_SIZE], frame.data, frame.len);
+      buff[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+      buff[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_UPLINK;
+      putLE(&buff[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], devAddr, 4);
+      putLE(&buff[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt, 4);
+      buff[RADIOLIB_LORAWAN_MIC_BLOCK_LEN_POS] = (uint8_t)msgLen;
+      uint8_t micF[RADIOLIB_AES128_BLOCK_SIZE];
+      this->cmac(dev.fNwkSIntKey, buff, RADIOLIB_AES128_BLOCK_SIZE + msgLen, micF);
+      uint8_t mic[4] = { micF[0], micF[1], micF[2], micF[3] };
+      if(dev.rev11) {
+        int dr = this->findDataRate(frame);
+        int ch = this->findChannel(dev, frame.freq);
+        if((dr < 0) || (ch < 0)) {
+          this->stats.micFailures++;
+          return;
+        }
+        if((fCtrl & RADIOLIB_LORAWAN_FCTRL_ACK) && (dev.confFCntDown >= 0)) {
+          putLE(&buff[RADIOLIB_LORAWAN_BLOCK_CONF_FCNT_POS], (uint16_t)dev.confFCntDown, 2);
+        }
+        buff[RADIOLIB_LORAWAN_MIC_DATA_RATE_POS] = (uint8_t)dr;
+        buff[RADIOLIB_LORAWAN_MIC_CH_INDEX_POS] = (uint8_t)ch;
+        uint8_t micS[RADIOLIB_AES128_BLOCK_SIZE];
+        this->cmac(dev.sNwkSIntKey, buff, RADIOLIB_AES128_BLOCK_SIZE + msgLen, micS);
+        mic[0] = micS[0];
+        mic[1] = micS[1];
+        mic[2] = micF[0];
+        mic[3] = micF[1];
+      }
+      if(memcmp(mic, &frame.data[msgLen], 4) != 0) {
+        this->stats.micFailures++;
+        return;
+      }
+
+      // the same frame counter is a retransmission, which only gets acknowledged again
+      bool confirmed = (frame.data[0] & RADIOLIB_LORAWAN_MHDR_MTYPE_MASK) == RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_UP;
+      bool retransmission = dev.anyUplink && (fCnt == dev.fCntUp);
+      if(dev.anyUplink && (fCnt < dev.fCntUp)) {
+        this->stats.replays++;
+        return;
+      }
+      dev.fCntUp = fCnt;
+      dev.anyUplink = true;
+      if(fCtrl & RADIOLIB_LORAWAN_FCTRL_ACK) {
+        dev.confFCntDown = -1;
+      }
+
+      if(retransmission) {
+        this->stats.retransmissions++;
+      } else {
+        this->stats.uplinks++;
+
+        // FOpts, followed by the optional FPort and FRMPayload
+        uint8_t* fOpts = &buff[RADIOLIB_AES128_BLOCK_SIZE + 8];
+        if(fOptsLen && dev.rev11) {
+          this->cryptPayload(fOpts, fOptsLen, dev.nwkSEncKey, devAddr, fCnt, RADIOLIB_LORAWAN_UPLINK, 0x01);
+        }
+        this->processMac(dev, fOpts, fOptsLen);
+        size_t payLen = msgLen - 8 - fOptsLen;
+        if(payLen > 1) {
+          uint8_t fPort = fOpts[fOptsLen];
+          uint8_t* payload = &fOpts[fOptsLen + 1];
+          this->cryptPayload(payload, payLen - 1, fPort == 0 ? dev.nwkSEncKey : dev.appSKey, devAddr, fCnt, RADIOLIB_LORAWAN_UPLINK, 0x00);
+          if(fPort == 0) {
+            this->processMac(dev, payload, payLen - 1);
+          }
+        }
+      }
+
+      // reply if there is anything to say
+      bool adrAckReq = fCtrl & RADIOLIB_LORAWAN_FCTRL_ADR_ACK_REQ;
+      if(!confirmed && !adrAckReq && !dev.macQueueLen && !dev.appDownLen) {
+        return;
+      }
+      this->sendDownlink(radio, frame, dev, confirmed);
+    }
+
+    // handle MAC commands sent by the device
+    void processMac(NsDevice& dev, const uint8_t* cmds, size_t len) {
+      size_t pos = 0;
+      while(pos < len) {
+        uint8_t cid = cmds[pos];
+        int cLen = lenUp(cid);
+        if((cLen < 0) || (pos + 1 + cLen > len)) {
+          this->stats.malformed++;
+          return;
+        }
+        const uint8_t* payload = &cmds[pos + 1];
+        switch(cid) {
+          case(RADIOLIB_LORAWAN_MAC_LINK_ADR):
+            this->stats.linkAdrAns++;
+            if((payload[0] & 0x07) == 0x07) {
+              this->stats.linkAdrAccepted++;
+            }
+            break;
+          case(RADIOLIB_LORAWAN_MAC_DUTY_CYCLE):
+            this->stats.dutyCycleAns++;
+            break;
+          case(RADIOLIB_LORAWAN_MAC_NEW_CHANNEL):
+            this->stats.newChannelAns++;
+            if(((payload[0] & 0x03) == 0x03) && (dev.newChIdx < NS_EMULATOR_MAX_CHANNELS)) {
+              this->stats.newChannelAccepted++;
+              dev.chFreq[dev.newChIdx] = dev.newChFreq;
+            }
+            break;
+          case(RADIOLIB_LORAWAN_MAC_DEV_STATUS):
+            this->stats.devStatusAns++;
+            break;
+          case(RADIOLIB_LORAWAN_MAC_REKEY): {
+            this->stats.rekeyInd++;
+            uint8_t version = 1;
+            this->queueMacFront(dev, cid, &version, 1);
+          } break;
+          case(RADIOLIB_LORAWAN_MAC_LINK_CHECK): {
+            this->stats.linkCheckReq++;
+            uint8_t ans[2] = { 20, 1 };
+            this->queueMacFront(dev, cid, ans, 2);
+          } break;
+          case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME): {
+            this->stats.deviceTimeReq++;
+            uint8_t ans[5];
+            putLE(ans, this->gpsTime, 4);
+            ans[4] = 0;
+            this->queueMacFront(dev, cid, ans, 5);
+          } break;
+          case(RADIOLIB_LORAWAN_MAC_DEVICE_MODE): {
+            this->stats.deviceModeInd++;
+            this->queueMacFront(dev, cid, payload, 1);
+          } break;
+          default:
+            break;
+        }
+        pos += 1 + cLen;
+      }
+    }
+
+    // answers go before any pending requests, so they always fit into the next downlink
+    void queueMacFront(NsDevice& dev, uint8_t cid, const uint8_t* payload, size_t len) {
+      if(dev.macQueueLen + 1 + len > sizeof(dev.macQueue)) {
+        return;
+      }
+      memmove(&dev.macQueue[1 + len], dev.macQueue, dev.macQueueLen);
+      dev.macQueue[0] = cid;
+      memcpy(&dev.macQueue[1], payload, len);
+      dev.macQueueLen += 1 + len;
+    }
+
+    // length of the MAC commands at the start of the queue which fit into maxLen
+    static size_t macChunk(const NsDevice& dev, size_t maxLen) {
+      size_t pos = 0;
+      while(pos < dev.macQueueLen) {
+        uint8_t cLen = 0;
+        switch(dev.macQueue[pos]) {
+          case(RADIOLIB_LORAWAN_MAC_LINK_ADR): cLen = 4; break;
+          case(RADIOLIB_LORAWAN_MAC_DUTY_CYCLE): cLen = 1; break;
+          case(RADIOLIB_LORAWAN_MAC_NEW_CHANNEL): cLen = 5; break;
+          case(RADIOLIB_LORAWAN_MAC_REKEY): cLen = 1; break;
+          case(RADIOLIB_LORAWAN_MAC_LINK_CHECK): cLen = 2; break;
+          case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME): cLen = 5; break;
+          case(RADIOLIB_LORAWAN_MAC_DEVICE_MODE): cLen = 1; break;
+          default: cLen = 0; break;
+        }
+        if(pos + 1 + cLen > maxLen) {
+          break;
+        }
+        pos += 1 + cLen;
+      }
+      return(pos);
+    }
+
+    void sendDownlink(VirtualRadio* radio, const VirtualFrame& uplink, NsDevice& dev, bool ack) {
+      uint8_t buff[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE] = { 0 };
+      uint8_t* msg = &buff[RADIOLIB_AES128_BLOCK_SIZE];
+
+      // MAC commands go into FOpts when there is application data, otherwise into FRMPayload on port 0
+      bool app = dev.appDownLen > 0;
+      size_t macLen = macChunk(dev, app ? RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN : RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE);
+      size_t fOptsLen = app ? macLen : 0;
+
+      // LoRaWAN v1.0 uses a single downlink counter, v1.1 separate ones for network and application
+      bool appCounter = app || !dev.rev11;
+      uint32_t fCnt = appCounter ? dev.aFCntDown : dev.nFCntDown;
+      bool confirmed = app && dev.appDownConfirmed;
+
+      msg[0] = (confirmed ? RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_DOWN : RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN) | RADIOLIB_LORAWAN_MHDR_MAJOR_R1;
+      putLE(&msg[1], dev.devAddr, 4);
+      msg[5] = (uint8_t)fOptsLen | (ack ? RADIOLIB_LORAWAN_FCTRL_ACK : 0);
+      putLE(&msg[6], fCnt, 2);
+      size_t len = 8;
+      if(fOptsLen) {
+        memcpy(&msg[len], dev.macQueue, fOptsLen);
+        if(dev.rev11) {
+          this->cryptPayload(&msg[len], fOptsLen, dev.nwkSEncKey, dev.devAddr, fCnt, RADIOLIB_LORAWAN_DOWNLINK, 0x02);
+        }
+        len += fOptsLen;
+      }
+      if(app) {
+        msg[len++] = dev.appDownPort;
+        memcpy(&msg[len], dev.appDown, dev.appDownLen);
+        this->cryptPayload(&msg[len], dev.appDownLen, dev.appSKey, dev.devAddr, fCnt, RADIOLIB_LORAWAN_DOWNLINK, 0x00);
+        len += dev.appDownLen;
+      } else if(macLen) {
+        msg[len++] = RADIOLIB_LORAWAN_FPORT_MAC_COMMAND;
+        memcpy(&msg[len], dev.macQueue, macLen);
+        this->cryptPayload(&msg[len], macLen, dev.nwkSEncKey, dev.devAddr, fCnt, RADIOLIB_LORAWAN_DOWNLINK, 0x00);
+        len += macLen;
+      }
+
+      // sign it
+      buff[RADIOLIB_LORAWAN_BLOCK_MAGIC_POS] = RADIOLIB_LORAWAN_MIC_BLOCK_MAGIC;
+      if(ack && dev.rev11) {
+        putLE(&buff[RADIOLIB_LORAWAN_BLOCK_CONF_FCNT_POS], (uint16_t)dev.fCntUp, 2);
+      }
+      buff[RADIOLIB_LORAWAN_BLOCK_DIR_POS] = RADIOLIB_LORAWAN_DOWNLINK;
+      putLE(&buff[RADIOLIB_LORAWAN_BLOCK_DEV_ADDR_POS], dev.devAddr, 4);
+      putLE(&buff[RADIOLIB_LORAWAN_BLOCK_FCNT_POS], fCnt, 4);
+      buff[RADIOLIB_LORAWAN_MIC_BLOCK_LEN_POS] = (uint8_t)len;
+      uint8_t mic[RADIOLIB_AES128_BLOCK_SIZE];
+      this->cmac(dev.sNwkSIntKey, buff, RADIOLIB_AES128_BLOCK_SIZE + len, mic);
+      memcpy(&msg[len], mic, 4);
+      len += 4;
+
+      // consume what was sent
+      memmove(dev.macQueue, &dev.macQueue[macLen], dev.macQueueLen - macLen);
+      dev.macQueueLen -= macLen;
+      dev.appDownLen = 0;
+      if(confirmed) {
+        dev.confFCntDown = (int32_t)fCnt;
+      }
+      if(appCounter) {
+        dev.aFCntDown++;
+      } else {
+        dev.nFCntDown++;
+      }
+      if(ack) {
+        this->stats.acks++;
+      }
+
+      this->reply(radio, uplink, msg, len);
+    }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef SHARED_CHANNEL_HPP
+#define SHARED_CHANNEL_HPP
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include <RadioLib.h>
+
+#include "VirtualRadio.hpp"
+
+// reasons why a transmission was not received by the gateway
+enum ChannelLoss : uint8_t {
+  CHANNEL_DELIVERED = 0,
+  CHANNEL_LOST_SENSITIVITY,
+  CHANNEL_LOST_DEMODULATOR,
+  CHANNEL_LOST_COLLISION,
+  CHANNEL_LOSS_REASONS,
+};
+
+// a single uplink as seen by the channel
+struct ChannelTx {
+  uint32_t node;
+  RadioLibTime_t start;
+  RadioLibTime_t end;
+  uint32_t freq;
+  float bw;
+  uint8_t sf;
+  float rssi;
+  uint8_t result;
+};
+
+// parameters of the channel and gateway model
+struct ChannelModel {
+  // gateway demodulator paths, 8 for SX1301/SX1302-based gateways
+  size_t demodulators = 8;
+
+  // a transmission survives a collision with the same SF if it is this much stronger (dB)
+  float captureThreshold = 6.0f;
+
+  // different spreading factors are quasi-orthogonal, until the interferer is this much stronger (dB)
+  float sfRejection = 16.0f;
+
+  // gateway sensitivity at 125 kHz for SF7 - SF12 (dBm)
+  float sensitivity[6] = { -123.0f, -126.0f, -129.0f, -132.0f, -134.5f, -137.0f };
+
+  // log-distance path loss, roughly Okumura-Hata at 868 MHz for an urban area
+  float pathLossRef = 128.95f;
+  float distanceRef = 1000.0f;
+  float pathLossExp = 3.52f;
+
+  float pathLoss(float distance) const {
+    if(distance < this->distanceRef) {
+      distance = this->distanceRef;
+    }
+    return(this->pathLossRef + 10.0f*this->pathLossExp*log10f(distance / this->distanceRef));
+  }
+
+  float sensitivityFor(uint8_t sf, float bw) const {
+    if(sf < 7) {
+      sf = 7;
+    } else if(sf > 12) {
+      sf = 12;
+    }
+    // the noise floor rises by 3 dB with every doubling of the bandwidth
+    return(this->sensitivity[sf - 7] + 10.0f*log10f(bw / 125.0f));
+  }
+};
+
+// records uplinks of the nodes driven by one thread
+// the recorder is not shared between threads, so no locking is needed
+class ChannelRecorder : public VirtualChannel {
+  public:
+    std::vector<ChannelTx> log;
+
+    // node which is currently driven and its RSSI at the gateway
+    uint32_t node = 0;
+    float rssi = 0;
+
+    void transmit(VirtualRadio* radio, const VirtualFrame& frame, RadioLibTime_t start, RadioLibTime_t toa) override {
+      (void)radio;
+
+      // only LoRa uplinks are modelled
+      if(frame.invertIq || (frame.modem != RADIOLIB_MODEM_LORA)) {
+        return;
+      }
+
+      ChannelTx tx;
+      tx.node = this->node;
+      tx.start = start;
+      tx.end = start + toa;
+      tx.freq = frame.freq;
+      tx.bw = frame.dr.lora.bandwidth;
+      tx.sf = frame.dr.lora.spreadingFactor;
+      tx.rssi = this->rssi;
+      tx.result = CHANNEL_DELIVERED;
+      this->log.push_back(tx);
+    }
+};
+
+// decide which of the recorded uplinks the gateway received
+// transmissions are swept in order of their start, keeping track of the ones still on air
+inline void resolveChannel(std::vector<ChannelTx>& txs, const ChannelModel& model) {
+  std::sort(txs.begin(), txs.end(), [](const ChannelTx& a, const ChannelTx& b) {
+    return(a.start < b.start);
+  });
+
+  std::vector<size_t> onAir;
+  std::vector<size_t> demodulating;
+  for(size_t i = 0; i < txs.size(); i++) {
+    ChannelTx& tx = txs[i];
+
+    // drop everything that already ended
+    onAir.erase(std::remove_if(onAir.begin(), onAir.end(), [&](size_t j) { return(txs[j].end <= tx.start); }), onAir.end());
+    demodulating.erase(std::remove_if(demodulating.begin(), demodulating.end(), [&](size_t j) { return(txs[j].end <= tx.start); }), demodulating.end());
+
+    // the gateway can only lock onto what it can hear, and only while it has a free demodulator
+    if(tx.rssi < model.sensitivityFor(tx.sf, tx.bw)) {
+      tx.result = CHANNEL_LOST_SENSITIVITY;
+    } else if(demodulating.size() >= model.demodulators) {
+      tx.result = CHANNEL_LOST_DEMODULATOR;
+    } else {
+      demodulating.push_back(i);
+    }
+
+    // check interference with everything on air on the same frequency
+    for(size_t j : onAir) {
+      ChannelTx& other = txs[j];
+      uint32_t df = tx.freq > other.freq ? tx.freq - other.freq : other.freq - tx.freq;
+      if(df*2 >= (uint32_t)(1000.0f*std::max(tx.bw, other.bw))) {
+        continue;
+      }
+
+      float threshold = (tx.sf == other.sf) ? model.captureThreshold : -model.sfRejection;
+      if((tx.result == CHANNEL_DELIVERED) && (tx.rssi - other.rssi < threshold)) {
+        tx.result = CHANNEL_LOST_COLLISION;
+      }
+      if((other.result == CHANNEL_DELIVERED) && (other.rssi - tx.rssi < threshold)) {
+        other.result = CHANNEL_LOST_COLLISION;
+      }
+    }
+    onAir.push_back(i);
+  }
+}
+
+#endif
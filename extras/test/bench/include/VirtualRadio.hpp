@@ -0,0 +1,352 @@
+#ifndef VIRTUAL_RADIO_HPP
+#define VIRTUAL_RADIO_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <RadioLib.h>
+
+// HAL with a virtual clock, which only advances when RadioLib waits
+// this way, a complete LoRaWAN uplink/downlink cycle takes no wall-clock time
+class VirtualHal : public RadioLibHal {
+  public:
+    // current virtual time in microseconds
+    RadioLibTime_t timeUs = 0;
+
+    // level of the radio IRQ pin, the only pin read by LoRaWAN
+    uint32_t irqLevel = 0;
+
+    VirtualHal() : RadioLibHal(0, 1, 0, 1, 0, 1) {}
+
+    void pinMode(uint32_t pin, uint32_t mode) override { (void)pin; (void)mode; }
+    void digitalWrite(uint32_t pin, uint32_t value) override { (void)pin; (void)value; }
+
+    uint32_t digitalRead(uint32_t pin) override { (void)pin; return(this->irqLevel); }
+
+    void attachInterrupt(uint32_t interruptNum, void (*interruptCb)(void), uint32_t mode) override { (void)interruptNum; (void)interruptCb; (void)mode; }
+    void detachInterrupt(uint32_t interruptNum) override { (void)interruptNum; }
+    void delay(RadioLibTime_t ms) override { this->advance(ms*1000); }
+    void delayMicroseconds(RadioLibTime_t us) override { this->advance(us); }
+    RadioLibTime_t millis() override { return(timeUs / 1000); }
+    RadioLibTime_t micros() override { return(timeUs); }
+    long pulseIn(uint32_t pin, uint32_t state, RadioLibTime_t timeout) override { (void)pin; (void)state; (void)timeout; return(0); }
+    void spiBegin() override {}
+    void spiBeginTransaction() override {}
+    void spiTransfer(uint8_t* out, size_t len, uint8_t* in) override { (void)out; if(in) { memset(in, 0, len); } }
+    void spiEndTransaction() override {}
+    void spiEnd() override {}
+
+    // busy-waiting loops must make progress
+    void yield() override { this->advance(1000); }
+
+    // schedule an event (e.g. an interrupt) at the given virtual time, replaces the pending one
+    void schedule(RadioLibTime_t us, void (*cb)(void*), void* ctx) {
+      this->eventUs = us;
+      this->eventCb = cb;
+      this->eventCtx = ctx;
+    }
+
+    // advance the clock, the pending event is fired at its own time if it falls into the interval
+    void advance(RadioLibTime_t us) {
+      RadioLibTime_t target = this->timeUs + us;
+      if(this->eventCb && (this->eventUs <= target)) {
+        if(this->eventUs > this->timeUs) {
+          this->timeUs = this->eventUs;
+        }
+        void (*cb)(void*) = this->eventCb;
+        this->eventCb = nullptr;
+        cb(this->eventCtx);
+      }
+      this->timeUs = target;
+    }
+
+  private:
+    RadioLibTime_t eventUs = 0;
+    void (*eventCb)(void*) = nullptr;
+    void* eventCtx = nullptr;
+};
+
+// a single frame on the virtual channel
+struct VirtualFrame {
+  uint8_t data[RADIOLIB_STATIC_ARRAY_SIZE];
+  size_t len;
+
+  // frequency in Hz
+  uint32_t freq;
+
+  ModemType_t modem;
+  DataRate_t dr;
+  bool invertIq;
+};
+
+class VirtualRadio;
+
+// whatever receives the transmissions of virtual radios - a network server, a shared channel model etc.
+class VirtualChannel {
+  public:
+    virtual ~VirtualChannel() = default;
+
+    // called when a transmission starts, the receiver may answer by VirtualRadio::deliver
+    virtual void transmit(VirtualRadio* radio, const VirtualFrame& frame, RadioLibTime_t start, RadioLibTime_t toa) = 0;
+};
+
+// radio emulated on the level of PhysicalLayer, which makes it cheap enough
+// to run complete LoRaWAN stacks on top of it for benchmarking and simulation
+// Tx done is signalled once the virtual clock reaches the end of the transmission,
+// Rx done and Rx timeout are signalled immediately at launch, which serves both
+// the blocking and the non-blocking (startSendReceive/tick) LoRaWAN API
+class VirtualRadio : public PhysicalLayer {
+  public:
+    Module* mod = nullptr;
+    VirtualHal* hal = nullptr;
+    VirtualChannel* channel = nullptr;
+
+    // statistics
+    uint32_t txCount = 0;
+    uint32_t rxCount = 0;
+    uint32_t rxMismatch = 0;
+    RadioLibTime_t airtimeUs = 0;
+
+    VirtualRadio(Module* mod, VirtualHal* hal, VirtualChannel* channel) : mod(mod), hal(hal), channel(channel) {
+      this->maxPacketLength = RADIOLIB_STATIC_ARRAY_SIZE;
+      for(uint8_t i = 0; i < 10; i++) {
+        this->irqMap[i] = (1UL << i);
+      }
+    }
+
+    Module* getMod() override {
+      return(this->mod);
+    }
+
+    // deliver a frame to this radio, it will be received in the n-th Rx window after the last transmission
+    void deliver(const VirtualFrame& frame, uint8_t window) {
+      this->pending = frame;
+      this->pendingWindow = window;
+    }
+
+    int16_t standby() override { return(RADIOLIB_ERR_NONE); }
+    int16_t standby(uint8_t mode) override { (void)mode; return(RADIOLIB_ERR_NONE); }
+    int16_t sleep() override { return(RADIOLIB_ERR_NONE); }
+
+    int16_t setFrequency(float freq) override {
+      this->freq = (uint32_t)lround((double)freq * 1000000.0);
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t checkDataRate(DataRate_t dr, ModemType_t modem) override {
+      (void)dr;
+      (void)modem;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t setDataRate(DataRate_t dr, ModemType_t modem) override {
+      this->dr = dr;
+      this->modem = modem;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t checkOutputPower(int8_t power, int8_t* clipped) override {
+      if(clipped) {
+        *clipped = power;
+      }
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t setOutputPower(int8_t power) override { this->power = power; return(RADIOLIB_ERR_NONE); }
+    int16_t setSyncWord(uint8_t* sync, size_t len) override { (void)sync; (void)len; return(RADIOLIB_ERR_NONE); }
+    int16_t setPreambleLength(size_t len) override { this->preambleLength = len; return(RADIOLIB_ERR_NONE); }
+    int16_t invertIQ(bool enable) override { this->iq = enable; return(RADIOLIB_ERR_NONE); }
+    int16_t setDataShaping(uint8_t sh) override { (void)sh; return(RADIOLIB_ERR_NONE); }
+    int16_t setEncoding(uint8_t encoding) override { (void)encoding; return(RADIOLIB_ERR_NONE); }
+    float getRSSI() override { return(-60.0); }
+    float getSNR() override { return(8.0); }
+    // xorshift, so that radios do not share any random state
+    uint8_t randomByte() override {
+      this->seed ^= this->seed << 13;
+      this->seed ^= this->seed >> 17;
+      this->seed ^= this->seed << 5;
+      return((uint8_t)(this->seed >> 24));
+    }
+
+    void setSeed(uint32_t seed) {
+      this->seed = seed ? seed : 1;
+    }
+
+    int16_t scanChannel() override { return(RADIOLIB_CHANNEL_FREE); }
+
+    size_t getPacketLength(bool update = true) override {
+      (void)update;
+      return(this->received.len);
+    }
+
+    int16_t readData(uint8_t* data, size_t len) override {
+      if(!data) {
+        return(RADIOLIB_ERR_NULL_POINTER);
+      }
+      memcpy(data, this->received.data, len < this->received.len ? len : this->received.len);
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    // the received frame stays available until the next reception, so peeking is just reading
+    int16_t peekData(uint8_t* data, size_t len) override {
+      return(this->readData(data, len));
+    }
+
+    int16_t finishTransmit() override {
+      this->irqFlags = 0;
+      this->hal->irqLevel = 0;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    // the standard LoRa/FSK Time-on-Air formulas, in microseconds
+    RadioLibTime_t calculateTimeOnAir(ModemType_t modem, DataRate_t dr, PacketConfig_t pc, size_t len) override {
+      if(modem == RADIOLIB_MODEM_LORA) {
+        double tSym = (double)(1UL << dr.lora.spreadingFactor) / (double)dr.lora.bandwidth * 1000.0;
+        int32_t de = pc.lora.ldrOptimize ? 1 : 0;
+        int32_t num = 8*(int32_t)len - 4*dr.lora.spreadingFactor + 28 + (pc.lora.crcEnabled ? 16 : 0) - (pc.lora.implicitHeader ? 20 : 0);
+        int32_t den = 4*(dr.lora.spreadingFactor - 2*de);
+        int32_t symbols = 8;
+        if(num > 0) {
+          symbols += ((num + den - 1) / den) * (dr.lora.codingRate);
+        }
+        return((RadioLibTime_t)(((double)pc.lora.preambleLength + 4.25 + symbols) * tSym));
+
+      } else if(modem == RADIOLIB_MODEM_FSK) {
+        // preamble, sync word, length byte, payload, CRC
+        double bits = pc.fsk.preambleLength + pc.fsk.syncWordLength + 8.0*(1 + len + pc.fsk.crcLength);
+        return((RadioLibTime_t)(bits * 1000.0 / (double)dr.fsk.bitRate));
+
+      }
+
+      // rough LR-FHSS estimate: headers of 233 ms and payload fragments of 102 ms carrying 6 bytes each
+      return((RadioLibTime_t)pc.lrFhss.hdrCount*233472UL + ((len + 7) / 6)*102400UL);
+    }
+
+    RadioLibTime_t calculateRxTimeout(RadioLibTime_t timeoutUs) override {
+      return(timeoutUs);
+    }
+
+    uint32_t getIrqFlags() override { return(this->irqFlags); }
+    int16_t setIrqFlags(uint32_t irq) override { (void)irq; return(RADIOLIB_ERR_NONE); }
+    int16_t clearIrqFlags(uint32_t irq) override {
+      this->irqFlags &= ~irq;
+      this->hal->irqLevel = (this->irqFlags != 0);
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    void setPacketReceivedAction(void (*func)(void)) override { this->rxAction = func; }
+    void clearPacketReceivedAction() override { this->rxAction = nullptr; }
+    void setPacketSentAction(void (*func)(void)) override { this->txAction = func; }
+    void clearPacketSentAction() override { this->txAction = nullptr; }
+
+    int16_t stageMode(RadioModeType_t mode, RadioModeConfig_t* cfg) override {
+      this->stagedMode = mode;
+      if(mode == RADIOLIB_RADIO_MODE_TX) {
+        if(cfg->transmit.len > sizeof(this->staged.data)) {
+          return(RADIOLIB_ERR_PACKET_TOO_LONG);
+        }
+        memcpy(this->staged.data, cfg->transmit.data, cfg->transmit.len);
+        this->staged.len = cfg->transmit.len;
+      }
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t launchMode() override {
+      this->irqFlags = 0;
+      this->hal->irqLevel = 0;
+      if(this->stagedMode == RADIOLIB_RADIO_MODE_TX) {
+        this->staged.freq = this->freq;
+        this->staged.modem = this->modem;
+        this->staged.dr = this->dr;
+        this->staged.invertIq = this->iq;
+        RadioLibTime_t toa = this->getTimeOnAir(this->staged.len);
+        this->txCount++;
+        this->airtimeUs += toa;
+
+        // a new uplink invalidates anything that was not received yet
+        this->pendingWindow = 0;
+        this->windowCount = 0;
+        if(this->channel) {
+          this->channel->transmit(this, this->staged, this->hal->micros(), toa);
+        }
+        this->hal->schedule(this->hal->timeUs + toa, VirtualRadio::onTxDone, this);
+        return(RADIOLIB_ERR_NONE);
+      }
+
+      if(this->stagedMode == RADIOLIB_RADIO_MODE_RX) {
+        this->windowCount++;
+        if(this->pendingWindow && (this->pendingWindow == this->windowCount)) {
+          this->pendingWindow = 0;
+
+          // frames sent at a different frequency or with the wrong polarity are not heard
+          if((this->pending.freq == this->freq) && (this->pending.invertIq == this->iq)) {
+            this->received = this->pending;
+            this->rxCount++;
+            this->irqFlags = (1UL << RADIOLIB_IRQ_RX_DONE);
+          } else {
+            this->rxMismatch++;
+          }
+        }
+        if(!this->irqFlags) {
+          this->irqFlags = (1UL << RADIOLIB_IRQ_TIMEOUT);
+        }
+        this->hal->irqLevel = 1;
+        if(this->rxAction) {
+          this->rxAction();
+        }
+        return(RADIOLIB_ERR_NONE);
+      }
+
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    RadioLibTime_t getTimeOnAir(size_t len) override {
+      PacketConfig_t pc;
+      if(this->modem == RADIOLIB_MODEM_LORA) {
+        pc.lora.preambleLength = this->preambleLength;
+        pc.lora.implicitHeader = false;
+        pc.lora.crcEnabled = !this->iq;
+        pc.lora.ldrOptimize = ((1UL << this->dr.lora.spreadingFactor) / this->dr.lora.bandwidth) >= 16;
+      } else if(this->modem == RADIOLIB_MODEM_FSK) {
+        pc.fsk.preambleLength = this->preambleLength;
+        pc.fsk.syncWordLength = 24;
+        pc.fsk.crcLength = 2;
+      } else {
+        pc.lrFhss.hdrCount = 3;
+      }
+      return(this->calculateTimeOnAir(this->modem, this->dr, pc, len));
+    }
+
+  private:
+    uint32_t freq = 0;
+    ModemType_t modem = RADIOLIB_MODEM_LORA;
+    DataRate_t dr = {};
+    int8_t power = 0;
+    size_t preambleLength = 8;
+    bool iq = false;
+
+    RadioModeType_t stagedMode = RADIOLIB_RADIO_MODE_NONE;
+    VirtualFrame staged = {};
+    VirtualFrame received = {};
+    VirtualFrame pending = {};
+    uint8_t pendingWindow = 0;
+    uint8_t windowCount = 0;
+    uint32_t irqFlags = 0;
+    uint32_t seed = 1;
+
+    void (*rxAction)(void) = nullptr;
+    void (*txAction)(void) = nullptr;
+
+    static void onTxDone(void* ctx) {
+      VirtualRadio* radio = (VirtualRadio*)ctx;
+      radio->irqFlags = (1UL << RADIOLIB_IRQ_TX_DONE);
+      radio->hal->irqLevel = 1;
+      if(radio->txAction) {
+        radio->txAction();
+      }
+    }
+};
+
+#endif
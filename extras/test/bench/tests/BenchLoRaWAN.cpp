@@ -0,0 +1,192 @@
+// LoRaWAN MAC layer throughput benchmark
+// runs complete OTAA joins and uplink/downlink cycles of LoRaWANNode
+// against an in-process network server, without any radio hardware
+// usage: radiolib-bench [devices] [cycles] [minimum cycles per CPU second]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <memory>
+#include <vector>
+
+#include <RadioLib.h>
+
+#include "VirtualRadio.hpp"
+#include "NetworkServerEmulator.hpp"
+
+// everything a single simulated device needs
+struct BenchDevice {
+  VirtualHal hal;
+  Module mod;
+  VirtualRadio radio;
+  LoRaWANNode node;
+
+  BenchDevice(VirtualChannel* channel, const LoRaWANBand_t* band) :
+    mod(&hal, 1, 2, 3, 4),
+    radio(&mod, &hal, channel),
+    node(&radio, band) {}
+
+  // let the virtual clock run until the next uplink is allowed, false if it never will be
+  bool waitForUplink(uint8_t len) {
+    RadioLibTime_t wait = this->node.timeUntilUplink(len);
+    if(wait == RADIOLIB_LORAWAN_UPLINK_NEVER) {
+      return(false);
+    }
+    this->hal.timeUs += (wait + 1)*1000;
+    return(true);
+  }
+};
+
+static double cpuSeconds() {
+  return((double)clock() / (double)CLOCKS_PER_SEC);
+}
+
+int main(int argc, char** argv) {
+  size_t numDevices = (argc > 1) ? (size_t)atoi(argv[1]) : 16;
+  size_t numCycles = (argc > 2) ? (size_t)atoi(argv[2]) : 256;
+  double minRate = (argc > 3) ? atof(argv[3]) : 0;
+  if((numDevices == 0) || (numCycles == 0)) {
+    fprintf(stderr, "usage: %s [devices] [cycles] [minimum cycles per CPU second]\n", argv[0]);
+    return(2);
+  }
+
+  NetworkServerEmulator ns(&EU868);
+  std::vector<std::unique_ptr<BenchDevice>> devices;
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE];
+  for(size_t i = 0; i < numDevices; i++) {
+    for(size_t j = 0; j < sizeof(key); j++) {
+      key[j] = (uint8_t)(i*31 + j);
+    }
+
+    // every other device uses LoRaWAN v1.0.4
+    uint64_t joinEUI = 0x0000000000000000ULL;
+    uint64_t devEUI = 0x70B3D57ED0000000ULL + i;
+    const uint8_t* nwkKey = (i % 2) ? NULL : key;
+    ns.addDevice(joinEUI, devEUI, nwkKey, key);
+    devices.emplace_back(new BenchDevice(&ns, &EU868));
+    devices.back()->radio.setSeed((uint32_t)i + 1);
+    int16_t state = devices.back()->node.beginOTAA(joinEUI, devEUI, nwkKey, key);
+    if(state != RADIOLIB_ERR_NONE) {
+      fprintf(stderr, "beginOTAA failed for device %lu, code %d\n", (unsigned long)i, state);
+      return(1);
+    }
+  }
+
+  // join all devices
+  unsigned long errors = 0;
+  double start = cpuSeconds();
+  for(size_t i = 0; i < numDevices; i++) {
+    int16_t state = devices[i]->node.activateOTAA();
+    if(state != RADIOLIB_LORAWAN_NEW_SESSION) {
+      fprintf(stderr, "activateOTAA failed for device %lu, code %d\n", (unsigned long)i, state);
+      errors++;
+    }
+  }
+  double joinTime = cpuSeconds() - start;
+  if(errors) {
+    return(1);
+  }
+
+  // uplink/downlink cycles with a mix of confirmed uplinks, downlinks and MAC commands
+  uint8_t dataUp[16] = { 0 };
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  unsigned long received = 0;
+  unsigned long acked = 0;
+  unsigned long confirmedUp = 0;
+  start = cpuSeconds();
+  for(size_t c = 0; c < numCycles; c++) {
+    for(size_t i = 0; i < numDevices; i++) {
+      BenchDevice* dev = devices[i].get();
+      if(c % 32 == 1) {
+        ns.queueNewChannelReq(i, 8, 868800000UL, 0, 5);
+        ns.queueDutyCycleReq(i, 0);
+        ns.queueLinkAdrReq(i, 5, 1, 0x01FF, 1);
+      }
+      if(c % 64 == 2) {
+        ns.queueDevStatusReq(i);
+      }
+      if(c % 8 == 5) {
+        ns.queueDownlink(i, 10, dataUp, 8, (c % 16) == 5);
+      }
+      if(c % 16 == 7) {
+        dev->node.sendMacCommandReq(RADIOLIB_LORAWAN_MAC_LINK_CHECK);
+        dev->node.sendMacCommandReq(RADIOLIB_LORAWAN_MAC_DEVICE_TIME);
+      }
+      bool confirmed = (c % 4) == 3;
+      confirmedUp += confirmed;
+
+      dataUp[0] = (uint8_t)c;
+      dataUp[1] = (uint8_t)i;
+      size_t lenDown = 0;
+      LoRaWANEvent_t eventDown;
+      if(!dev->waitForUplink(sizeof(dataUp))) {
+        fprintf(stderr, "uplink of device %lu never fits the duty cycle in cycle %lu\n", (unsigned long)i, (unsigned long)c);
+        errors++;
+        continue;
+      }
+      int16_t state = dev->node.sendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown, confirmed, NULL, &eventDown);
+      if(state < RADIOLIB_ERR_NONE) {
+        fprintf(stderr, "sendReceive failed for device %lu in cycle %lu, code %d\n", (unsigned long)i, (unsigned long)c, state);
+        errors++;
+        continue;
+      }
+      if(state > 0) {
+        received++;
+        acked += eventDown.confirming;
+      }
+    }
+  }
+  double cycleTime = cpuSeconds() - start;
+
+  // a zero duration would only happen on a coarse clock, count it as a single tick
+  if(joinTime <= 0) {
+    joinTime = 1.0 / CLOCKS_PER_SEC;
+  }
+  if(cycleTime <= 0) {
+    cycleTime = 1.0 / CLOCKS_PER_SEC;
+  }
+  unsigned long numUplinks = (unsigned long)(numDevices*numCycles);
+  double joinRate = (double)numDevices / joinTime;
+  double cycleRate = (double)numUplinks / cycleTime;
+
+  printf("devices:              %lu (v1.1 and v1.0.4)\n", (unsigned long)numDevices);
+  printf("joins:                %lu in %.3f s CPU, %.1f joins/s\n", (unsigned long)ns.stats.joinAccepts, joinTime, joinRate);
+  printf("cycles:               %lu in %.3f s CPU, %.1f cycles/s, %.1f us/cycle\n", numUplinks, cycleTime, cycleRate, 1e6 / cycleRate);
+  printf("downlinks received:   %lu of %lu sent\n", received, (unsigned long)(ns.stats.downlinks - ns.stats.joinAccepts));
+  printf("confirmed uplinks:    %lu, %lu acknowledged\n", confirmedUp, acked);
+  printf("LinkADRAns:           %lu, %lu accepted\n", (unsigned long)ns.stats.linkAdrAns, (unsigned long)ns.stats.linkAdrAccepted);
+  printf("NewChannelAns:        %lu, %lu accepted\n", (unsigned long)ns.stats.newChannelAns, (unsigned long)ns.stats.newChannelAccepted);
+  printf("DutyCycleAns:         %lu\n", (unsigned long)ns.stats.dutyCycleAns);
+  printf("DevStatusAns:         %lu\n", (unsigned long)ns.stats.devStatusAns);
+  printf("RekeyInd:             %lu\n", (unsigned long)ns.stats.rekeyInd);
+  printf("LinkCheck/DeviceTime: %lu/%lu\n", (unsigned long)ns.stats.linkCheckReq, (unsigned long)ns.stats.deviceTimeReq);
+  printf("MIC failures:         %lu\n", (unsigned long)ns.stats.micFailures);
+
+  // the benchmark is only meaningful if the whole exchange worked
+  if(ns.stats.micFailures || ns.stats.malformed || ns.stats.unknownDevices || ns.stats.replays) {
+    fprintf(stderr, "network server rejected some frames\n");
+    errors++;
+  }
+  if(received != ns.stats.downlinks - ns.stats.joinAccepts) {
+    fprintf(stderr, "some downlinks were not received\n");
+    errors++;
+  }
+  if(acked != confirmedUp) {
+    fprintf(stderr, "some confirmed uplinks were not acknowledged\n");
+    errors++;
+  }
+  if((numCycles > 1) && ((ns.stats.linkAdrAccepted == 0) || (ns.stats.linkAdrAccepted != ns.stats.linkAdrAns) || (ns.stats.newChannelAccepted != ns.stats.newChannelAns))) {
+    fprintf(stderr, "MAC commands were not accepted\n");
+    errors++;
+  }
+  if(errors) {
+    return(1);
+  }
+
+  if(cycleRate < minRate) {
+    fprintf(stderr, "throughput of %.1f cycles/s is below the required %.1f cycles/s\n", cycleRate, minRate);
+    return(1);
+  }
+
+  return(0);
+}
@@ -0,0 +1,265 @@
+// LoRaWAN device fleet simulator
+// runs thousands of LoRaWANNode instances on virtual radios, partitioned across worker threads,
+// and models a single gateway receiving their uplinks on a shared channel
+// usage: radiolib-fleet [nodes] [hours] [threads] [per-node CSV file]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <RadioLib.h>
+
+#include "VirtualRadio.hpp"
+#include "SharedChannel.hpp"
+
+// simulation parameters
+#define FLEET_RADIUS_M            (3000.0f)
+#define FLEET_TX_POWER_DBM        (14.0f)
+#define FLEET_LINK_MARGIN_DB      (3.0f)
+#define FLEET_PERIOD_S            (600)
+#define FLEET_PAYLOAD_LEN         (20)
+
+// xorshift generator of a single node, the threads must not share the state of rand()
+static uint32_t nodeRandom(uint32_t max, void* ctx) {
+  uint32_t* state = (uint32_t*)ctx;
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return(*state % max);
+}
+
+struct SimNode {
+  VirtualHal hal;
+  Module mod;
+  VirtualRadio radio;
+  LoRaWANNode node;
+  RadioLibSoftwareAES128 aes;
+  uint32_t rngState = 1;
+
+  uint32_t id;
+  float distance = 0;
+  float rssi = 0;
+  uint8_t dr = 0;
+  RadioLibTime_t next = 0;
+
+  uint32_t uplinks = 0;
+  uint32_t errors = 0;
+  uint64_t cpuNs = 0;
+
+  SimNode(uint32_t id, VirtualChannel* channel) :
+    mod(&hal, 1, 2, 3, 4),
+    radio(&mod, &hal, channel),
+    node(&radio, &EU868),
+    id(id) {
+    // the shared software AES of LoRaWANNode must not be used from several threads
+    this->hal.aes128 = &this->aes;
+    this->node.setRandomFunction(nodeRandom, &this->rngState);
+  }
+};
+
+// results of a single node, filled in after the channel is resolved
+struct NodeResult {
+  uint8_t sf = 0;
+  float distance = 0;
+  float rssi = 0;
+  uint32_t uplinks = 0;
+  uint32_t delivered = 0;
+  uint32_t errors = 0;
+  RadioLibTime_t airtimeUs = 0;
+  uint64_t cpuNs = 0;
+};
+
+static uint64_t threadCpuNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+// fastest data rate at which the gateway still hears the node with some margin
+static uint8_t selectDataRate(const ChannelModel& model, float rssi) {
+  for(int dr = 5; dr > 0; dr--) {
+    const LoRaWANDataRate_t& rate = EU868.dataRates[dr];
+    if(rssi >= model.sensitivityFor(rate.dr.lora.spreadingFactor, rate.dr.lora.bandwidth) + FLEET_LINK_MARGIN_DB) {
+      return((uint8_t)dr);
+    }
+  }
+  return(0);
+}
+
+// create, activate and run a contiguous range of nodes for the simulated duration
+static void runWorker(uint32_t first, uint32_t count, RadioLibTime_t durationUs, const ChannelModel* model, ChannelRecorder* recorder, std::vector<NodeResult>* results) {
+  std::vector<std::unique_ptr<SimNode>> nodes;
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE];
+  uint8_t payload[FLEET_PAYLOAD_LEN] = { 0 };
+  for(uint32_t i = first; i < first + count; i++) {
+    // everything random is derived from the node ID, so the results do not depend on the number of threads
+    std::mt19937 rng(i + 1);
+    std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+    nodes.emplace_back(new SimNode(i, recorder));
+    SimNode* sim = nodes.back().get();
+    sim->radio.setSeed(rng());
+    sim->rngState = rng() | 1;
+    sim->distance = FLEET_RADIUS_M*sqrtf(uni(rng));
+    sim->rssi = FLEET_TX_POWER_DBM - model->pathLoss(sim->distance);
+    sim->dr = selectDataRate(*model, sim->rssi);
+    sim->next = (RadioLibTime_t)(uni(rng)*FLEET_PERIOD_S*1000000.0f);
+
+    for(size_t j = 0; j < sizeof(key); j++) {
+      key[j] = (uint8_t)(i + j);
+    }
+    sim->node.beginABP(0x26000000UL | i, key, key, key, key);
+    sim->node.activateABP();
+    sim->node.setADR(false);
+    sim->node.setDatarate(sim->dr);
+  }
+
+  for(auto& ptr : nodes) {
+    SimNode* sim = ptr.get();
+    std::mt19937 rng(sim->id + 0x10000);
+    std::uniform_real_distribution<float> jitter(0.9f, 1.1f);
+    recorder->node = sim->id;
+    recorder->rssi = sim->rssi;
+    while(true) {
+      // wait for the application period and then for whatever the duty cycle requires
+      if(sim->hal.timeUs < sim->next) {
+        sim->hal.timeUs = sim->next;
+      }
+      RadioLibTime_t wait = sim->node.timeUntilUplink(sizeof(payload));
+      if(wait == RADIOLIB_LORAWAN_UPLINK_NEVER) {
+        // the frame is too long for the duty cycle of this node
+        sim->errors++;
+        break;
+      }
+      sim->hal.timeUs += wait*1000;
+      if(sim->hal.timeUs >= durationUs) {
+        break;
+      }
+
+      payload[0] = (uint8_t)sim->uplinks;
+      uint64_t start = threadCpuNs();
+      int16_t state = sim->node.sendReceive(payload, sizeof(payload));
+      sim->cpuNs += threadCpuNs() - start;
+      sim->uplinks++;
+      if(state < RADIOLIB_ERR_NONE) {
+        sim->errors++;
+      }
+      sim->next += (RadioLibTime_t)(jitter(rng)*FLEET_PERIOD_S*1000000.0f);
+    }
+
+    NodeResult& res = (*results)[sim->id];
+    res.sf = EU868.dataRates[sim->dr].dr.lora.spreadingFactor;
+    res.distance = sim->distance;
+    res.rssi = sim->rssi;
+    res.errors = sim->errors;
+    res.airtimeUs = sim->radio.airtimeUs;
+    res.cpuNs = sim->cpuNs;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t numNodes = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000;
+  double hours = (argc > 2) ? atof(argv[2]) : 1.0;
+  uint32_t numThreads = (argc > 3) ? (uint32_t)atoi(argv[3]) : std::thread::hardware_concurrency();
+  const char* csvPath = (argc > 4) ? argv[4] : NULL;
+  if(numThreads == 0) {
+    numThreads = 1;
+  }
+  if((numNodes == 0) || (hours <= 0)) {
+    fprintf(stderr, "usage: %s [nodes] [hours] [threads] [per-node CSV file]\n", argv[0]);
+    return(2);
+  }
+  if(numThreads > numNodes) {
+    numThreads = numNodes;
+  }
+
+  ChannelModel model;
+  RadioLibTime_t durationUs = (RadioLibTime_t)(hours*3600.0*1000000.0);
+  std::vector<NodeResult> results(numNodes);
+  std::vector<ChannelRecorder> recorders(numThreads);
+  std::vector<std::thread> workers;
+
+  auto wallStart = std::chrono::steady_clock::now();
+  uint32_t first = 0;
+  for(uint32_t t = 0; t < numThreads; t++) {
+    uint32_t count = numNodes / numThreads + (t < numNodes % numThreads ? 1 : 0);
+    workers.emplace_back(runWorker, first, count, durationUs, &model, &recorders[t], &results);
+    first += count;
+  }
+  for(auto& w : workers) {
+    w.join();
+  }
+  double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  // merge the uplinks of all threads and let the gateway decide what it received
+  std::vector<ChannelTx> txs;
+  for(auto& rec : recorders) {
+    txs.insert(txs.end(), rec.log.begin(), rec.log.end());
+  }
+  resolveChannel(txs, model);
+
+  uint32_t losses[CHANNEL_LOSS_REASONS] = { 0 };
+  uint32_t sfUplinks[13] = { 0 };
+  uint32_t sfDelivered[13] = { 0 };
+  for(const ChannelTx& tx : txs) {
+    NodeResult& res = results[tx.node];
+    res.uplinks++;
+    losses[tx.result]++;
+    sfUplinks[tx.sf]++;
+    if(tx.result == CHANNEL_DELIVERED) {
+      res.delivered++;
+      sfDelivered[tx.sf]++;
+    }
+  }
+
+  uint64_t cpuNs = 0;
+  RadioLibTime_t airtimeUs = 0;
+  uint32_t errors = 0;
+  for(const NodeResult& res : results) {
+    cpuNs += res.cpuNs;
+    airtimeUs += res.airtimeUs;
+    errors += res.errors;
+  }
+  size_t numUplinks = txs.size();
+
+  printf("nodes:                %lu on %lu threads\n", (unsigned long)numNodes, (unsigned long)numThreads);
+  printf("simulated time:       %.2f h\n", hours);
+  printf("wall time:            %.3f s, %.0f uplinks/s\n", wallTime, numUplinks / wallTime);
+  printf("CPU per uplink:       %.1f us\n", numUplinks ? (double)cpuNs / numUplinks / 1000.0 : 0.0);
+  printf("uplinks:              %lu, %lu delivered, PER %.2f %%\n", (unsigned long)numUplinks, (unsigned long)losses[CHANNEL_DELIVERED],
+    numUplinks ? 100.0*(numUplinks - losses[CHANNEL_DELIVERED]) / numUplinks : 0.0);
+  printf("lost to collisions:   %lu\n", (unsigned long)losses[CHANNEL_LOST_COLLISION]);
+  printf("lost to sensitivity:  %lu\n", (unsigned long)losses[CHANNEL_LOST_SENSITIVITY]);
+  printf("lost to demodulators: %lu\n", (unsigned long)losses[CHANNEL_LOST_DEMODULATOR]);
+  printf("node errors:          %lu\n", (unsigned long)errors);
+  printf("channel load:         %.3f Erlang over %d channels\n", (double)airtimeUs / (double)durationUs, 3);
+  for(int sf = 7; sf <= 12; sf++) {
+    if(sfUplinks[sf]) {
+      printf("  SF%-2d                %7lu uplinks, PER %.2f %%\n", sf, (unsigned long)sfUplinks[sf],
+        100.0*(sfUplinks[sf] - sfDelivered[sf]) / sfUplinks[sf]);
+    }
+  }
+
+  if(csvPath) {
+    FILE* f = fopen(csvPath, "w");
+    if(!f) {
+      fprintf(stderr, "failed to open %s\n", csvPath);
+      return(1);
+    }
+    fprintf(f, "node,sf,distance_m,rssi_dbm,uplinks,delivered,per,airtime_ms,cpu_us_per_uplink\n");
+    for(uint32_t i = 0; i < numNodes; i++) {
+      const NodeResult& res = results[i];
+      fprintf(f, "%lu,%d,%.0f,%.1f,%lu,%lu,%.4f,%.1f,%.1f\n", (unsigned long)i, res.sf, res.distance, res.rssi,
+        (unsigned long)res.uplinks, (unsigned long)res.delivered,
+        res.uplinks ? (double)(res.uplinks - res.delivered) / res.uplinks : 0.0,
+        res.airtimeUs / 1000.0, res.uplinks ? (double)res.cpuNs / res.uplinks / 1000.0 : 0.0);
+    }
+    fclose(f);
+  }
+
+  return(errors ? 1 : 0);
+}
@@ -0,0 +1,82 @@
+#ifndef RECORDING_RADIO_HPP
+#define RECORDING_RADIO_HPP
+
+#include <vector>
+
+#include "TestHal.hpp"
+
+#include "modules/SX126x/SX126x.h"
+#include "modules/SX128x/SX128x.h"
+
+// radio hardware that records every SPI frame, answers with a status byte
+// in the second byte of every frame (as SX126x and SX128x do) and with a fixed byte otherwise
+class RecordingRadio : public EmulatedRadio {
+  public:
+    std::vector<std::vector<uint8_t>> frames;
+    uint8_t resp = 0x01;
+
+    // STDBY_RC on SX126x, parsed as a valid status by both SX126x and SX128x
+    uint8_t status = 0x20;
+
+    void HandleGPIO() override {
+      if(this->cs->event && (this->cs->value == TEST_HAL_LOW)) {
+        this->frames.emplace_back();
+      }
+    }
+
+    uint8_t HandleSPI(uint8_t b) override {
+      if(this->frames.empty()) {
+        return(this->resp);
+      }
+      size_t pos = this->frames.back().size();
+      this->frames.back().push_back(b);
+      return((pos == 1) ? this->status : this->resp);
+    }
+
+    // number of frames starting with the command
+    size_t count(uint8_t cmd) {
+      size_t num = 0;
+      for(const auto& frame : this->frames) {
+        num += (!frame.empty() && (frame[0] == cmd));
+      }
+      return(num);
+    }
+
+    // index of the first frame starting with the command after the given one, -1 if there is none
+    int find(uint8_t cmd, int from = 0) {
+      for(size_t i = from; i < this->frames.size(); i++) {
+        if(!this->frames[i].empty() && (this->frames[i][0] == cmd)) {
+          return(i);
+        }
+      }
+      return(-1);
+    }
+};
+
+// SPI configuration as set by SX126x::modSetup, without probing the chip
+static inline void setupSpiSX126x(Module* mod) {
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_ADDR] = Module::BITS_16;
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_CMD] = Module::BITS_8;
+  mod->spiConfig.statusPos = 1;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_READ] = RADIOLIB_SX126X_CMD_READ_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_WRITE] = RADIOLIB_SX126X_CMD_WRITE_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_NOP] = RADIOLIB_SX126X_CMD_NOP;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_STATUS] = RADIOLIB_SX126X_CMD_GET_STATUS;
+  mod->spiConfig.stream = true;
+  mod->spiConfig.parseStatusCb = SX126x::SPIparseStatus;
+}
+
+// SPI configuration as set by SX128x::modSetup, without probing the chip
+static inline void setupSpiSX128x(Module* mod) {
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_ADDR] = Module::BITS_16;
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_CMD] = Module::BITS_8;
+  mod->spiConfig.statusPos = 1;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_READ] = RADIOLIB_SX128X_CMD_READ_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_WRITE] = RADIOLIB_SX128X_CMD_WRITE_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_NOP] = RADIOLIB_SX128X_CMD_NOP;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_STATUS] = RADIOLIB_SX128X_CMD_GET_STATUS;
+  mod->spiConfig.stream = true;
+  mod->spiConfig.parseStatusCb = SX128x::SPIparseStatus;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// radio without SPI traffic that keeps its interrupt action, so that a test thread can fire it
+class AwaitRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+
+    std::atomic<void (*)(void)> action { nullptr };
+    std::atomic<int> started { 0 };
+    uint8_t value = 0;
+
+    void setPacketSentAction(void (*func)(void)) override { action = func; }
+    void setPacketReceivedAction(void (*func)(void)) override { action = func; }
+    void setChannelScanAction(void (*func)(void)) override { action = func; }
+    void clearPacketSentAction() override { action = nullptr; }
+    void clearPacketReceivedAction() override { action = nullptr; }
+    void clearChannelScanAction() override { action = nullptr; }
+
+    int16_t startTransmit(const uint8_t* data, size_t len, uint8_t addr = 0) override {
+      (void)addr;
+      value = (len > 0) ? data[0] : 0;
+      started++;
+      return(RADIOLIB_ERR_NONE);
+    }
+    int16_t finishTransmit() override { return(RADIOLIB_ERR_NONE); }
+    int16_t startReceive() override { started++; return(RADIOLIB_ERR_NONE); }
+    int16_t startReceive(uint32_t timeout, RadioLibIrqFlags_t irqFlags, RadioLibIrqFlags_t irqMask, size_t len) override {
+      (void)timeout;
+      (void)irqFlags;
+      (void)irqMask;
+      (void)len;
+      started++;
+      return(RADIOLIB_ERR_NONE);
+    }
+    int16_t finishReceive() override { return(RADIOLIB_ERR_NONE); }
+    int16_t readData(uint8_t* data, size_t len) override {
+      memset(data, value, len);
+      return(RADIOLIB_ERR_NONE);
+    }
+    int16_t startChannelScan() override { started++; return(RADIOLIB_ERR_NONE); }
+    int16_t getChannelScanResult() override { return(RADIOLIB_CHANNEL_FREE); }
+    uint32_t getIrqFlags() override { return(0); }
+    int16_t standby() override { return(RADIOLIB_ERR_NONE); }
+    RadioLibTime_t getTimeOnAir(size_t len) override { return(len * 1000); }
+    RadioLibTime_t calculateRxTimeout(RadioLibTime_t timeoutUs) override { return(timeoutUs); }
+};
+
+// fire the interrupt of a radio once its operation was started
+static void fireAfter(AwaitRadio* radio, int started) {
+  while((radio->started < started) || (radio->action == nullptr)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  radio->action.load()();
+}
+
+static RadioLibTask receiveOne(AwaitableClient* client, uint8_t* buff, size_t len) {
+  int16_t state = co_await client->receiveAsync(buff, len, 100000);
+  co_return(state);
+}
+
+static RadioLibTask pingPong(AwaitableClient* tx, AwaitableClient* rx, int16_t* results) {
+  const uint8_t ping[] = { 0x5A, 0x01 };
+  uint8_t pong[4] = { 0 };
+  results[0] = co_await tx->transmitAsync(ping, sizeof(ping));
+  results[1] = co_await receiveOne(rx, pong, sizeof(pong));
+  results[2] = pong[3];
+  results[3] = co_await rx->scanChannelAsync();
+  co_return(RADIOLIB_ERR_NONE);
+}
+
+static RadioLibTask timeout(AwaitableClient* client, int16_t* result) {
+  uint8_t buff[4];
+  *result = co_await client->receiveAsync(buff, sizeof(buff), 1000);
+  co_return(RADIOLIB_ERR_NONE);
+}
+
+BOOST_FIXTURE_TEST_SUITE(suite_Awaitable, ModuleFixture)
+
+BOOST_FIXTURE_TEST_CASE(Awaitable_executor, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test coroutine radio operations ---");
+  hal->spiLogEnabled = false;
+  AwaitRadio radioA(mod);
+  AwaitRadio radioB(mod);
+  AwaitRadio radioC(mod);
+  radioB.value = 0xC3;
+
+  RadioLibExecutor executor;
+  AwaitableClient clientA(&radioA, &executor);
+  AwaitableClient clientB(&radioB, &executor);
+  AwaitableClient clientC(&radioC, &executor);
+
+  // one thread runs both tasks, the interrupts come from other threads
+  int16_t results[4] = { -1, -1, -1, -1 };
+  int16_t timeoutResult = 0;
+  executor.spawn(pingPong(&clientA, &clientB, results));
+  executor.spawn(timeout(&clientC, &timeoutResult));
+  std::thread irqA(fireAfter, &radioA, 1);
+  std::thread irqB(fireAfter, &radioB, 1);
+  std::thread irqScan(fireAfter, &radioB, 2);
+  executor.run();
+  irqA.join();
+  irqB.join();
+  irqScan.join();
+
+  BOOST_TEST(results[0] == RADIOLIB_ERR_NONE);
+  BOOST_TEST(results[1] == RADIOLIB_ERR_NONE);
+  BOOST_TEST(results[2] == 0xC3);
+  BOOST_TEST(results[3] == RADIOLIB_CHANNEL_FREE);
+  BOOST_TEST(radioA.value == 0x5A);
+
+  // the radio without an interrupt was stopped after its timeout and guard time
+  BOOST_TEST(timeoutResult == RADIOLIB_ERR_RX_TIMEOUT);
+  BOOST_TEST(radioC.action == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
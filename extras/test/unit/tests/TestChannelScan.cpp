@@ -0,0 +1,138 @@
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// radio that counts configuration changes and reports activity on some frequencies
+class ScanRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+
+    std::set<float> busyFreqs;
+    float freq = 0;
+    int retunes = 0;
+    int rateChanges = 0;
+    int scans = 0;
+
+    int16_t setFrequency(float freq) override {
+      this->freq = freq;
+      retunes++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t setDataRate(DataRate_t dr, ModemType_t modem) override {
+      (void)dr;
+      (void)modem;
+      rateChanges++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t checkDataRate(DataRate_t dr, ModemType_t modem) override {
+      (void)modem;
+      return((dr.lora.spreadingFactor > 12) ? RADIOLIB_ERR_INVALID_SPREADING_FACTOR : RADIOLIB_ERR_NONE);
+    }
+
+    int16_t startChannelScan() override {
+      scans++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t getChannelScanResult() override {
+      return(busyFreqs.count(this->freq) ? RADIOLIB_LORA_DETECTED : RADIOLIB_CHANNEL_FREE);
+    }
+
+    int16_t standby() override {
+      return(RADIOLIB_ERR_NONE);
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(suite_ChannelScan)
+
+BOOST_FIXTURE_TEST_CASE(ChannelScan_batch, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test batched channel scan ---");
+  hal->spiLogEnabled = false;
+  ScanRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+
+  // scans complete right away
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  // 8 channels with the same data rate
+  ChannelScanTarget_t targets[8];
+  memset(targets, 0, sizeof(targets));
+  for(int i = 0; i < 8; i++) {
+    targets[i].freq = 867.1f + 0.2f*i;
+    targets[i].dr.lora.spreadingFactor = 7;
+    targets[i].dr.lora.bandwidth = 125.0f;
+    targets[i].modem = RADIOLIB_MODEM_LORA;
+  }
+  radio.busyFreqs.insert(targets[2].freq);
+  radio.busyFreqs.insert(targets[5].freq);
+
+  // the data rate is only set once, every channel is scanned the requested number of times
+  uint32_t busy = 0xFFFFFFFF;
+  RadioLibTime_t durations[8] = { 0 };
+  BOOST_TEST(phy->scanChannels(targets, 8, &busy, durations, 2) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(busy == ((1UL << 2) | (1UL << 5)));
+  BOOST_TEST(radio.retunes == 8);
+  BOOST_TEST(radio.rateChanges == 1);
+  BOOST_TEST(radio.scans == 6*2 + 2*1);
+
+  // repeated scans of one channel only tune once
+  radio.retunes = 0;
+  radio.rateChanges = 0;
+  ChannelScanTarget_t same[3] = { targets[0], targets[0], targets[1] };
+  same[2].dr.lora.spreadingFactor = 9;
+  BOOST_TEST(phy->scanChannels(same, 3, &busy) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(busy == 0);
+  BOOST_TEST(radio.retunes == 2);
+  BOOST_TEST(radio.rateChanges == 2);
+
+  // invalid data rates of later channels are caught while the previous scan runs
+  radio.scans = 0;
+  same[2].dr.lora.spreadingFactor = 13;
+  BOOST_TEST(phy->scanChannels(same, 3, &busy) == RADIOLIB_ERR_INVALID_SPREADING_FACTOR);
+  BOOST_TEST(radio.scans == 2);
+
+  // invalid arguments
+  BOOST_TEST(phy->scanChannels(NULL, 3, &busy) == RADIOLIB_ERR_NULL_POINTER);
+  BOOST_TEST(phy->scanChannels(targets, 33, &busy) == RADIOLIB_ERR_INVALID_NUM_SAMPLES);
+  BOOST_TEST(phy->scanChannels(targets, 8, &busy, NULL, 0) == RADIOLIB_ERR_INVALID_NUM_SAMPLES);
+}
+
+BOOST_FIXTURE_TEST_CASE(ChannelScan_csma, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN CSMA channel scan ---");
+  hal->spiLogEnabled = false;
+  ScanRadio radio(mod);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  BOOST_TEST(node.selectChannels() == RADIOLIB_ERR_NONE);
+  float freq = node.channels[RADIOLIB_LORAWAN_UPLINK].freq / 10000.0;
+
+  // all CADs are performed on the selected uplink channel, which is only tuned once
+  radio.retunes = 0;
+  radio.scans = 0;
+  BOOST_TEST(node.csmaChannelClear(2, 3));
+  BOOST_TEST(radio.freq == freq);
+  BOOST_TEST(radio.retunes == 1);
+  BOOST_TEST(radio.scans == 5);
+
+  // activity stops the scan
+  radio.busyFreqs.insert(freq);
+  radio.scans = 0;
+  BOOST_TEST(!node.csmaChannelClear(2, 3));
+  BOOST_TEST(radio.scans == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// feed a byte to the direct mode receiver, MSB first
+static void feedByte(PhysicalLayer* phy, uint8_t b) {
+  for(int i = 7; i >= 0; i--) {
+    phy->updateDirectBuffer((b >> i) & 0x01);
+  }
+}
+
+static void feedWord(PhysicalLayer* phy, uint32_t w) {
+  for(int i = 3; i >= 0; i--) {
+    feedByte(phy, (w >> (8*i)) & 0xFF);
+  }
+}
+
+BOOST_FIXTURE_TEST_SUITE(suite_DirectReceive, ModuleFixture)
+
+BOOST_FIXTURE_TEST_CASE(DirectReceive_ring, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test direct mode receive buffer ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  PhysicalLayer* phy = &radio;
+
+  // nothing is stored until the sync word was received
+  BOOST_TEST(phy->setDirectSyncWord(0x2DD4, 16) == RADIOLIB_ERR_NONE);
+  feedByte(phy, 0x55);
+  BOOST_TEST(phy->available() == 0);
+  feedByte(phy, 0x2D);
+  feedByte(phy, 0xD4);
+  feedByte(phy, 0x12);
+  feedByte(phy, 0x34);
+  BOOST_TEST(phy->available() == 2);
+  BOOST_TEST(phy->read(false) == 0x12);
+  BOOST_TEST(phy->read(false) == 0x34);
+  BOOST_TEST(phy->available() == 0);
+  BOOST_TEST(phy->read(false) == 0);
+
+  // the reader can keep up with a stream longer than the buffer
+  uint32_t sum = 0;
+  uint32_t sumRead = 0;
+  for(int i = 0; i < 3*RADIOLIB_DIRECT_BUFFER_SIZE; i++) {
+    feedByte(phy, (uint8_t)i);
+    sum += (uint8_t)i;
+    if(i % 16 == 15) {
+      while(phy->available()) {
+        sumRead += phy->read(false);
+      }
+    }
+  }
+  BOOST_TEST(sumRead == sum);
+  BOOST_TEST(phy->getDirectOverruns() == 0);
+
+  // once full, new bytes are dropped and counted
+  for(int i = 0; i < RADIOLIB_DIRECT_BUFFER_SIZE + 9; i++) {
+    feedByte(phy, (uint8_t)i);
+  }
+  BOOST_TEST(phy->available() == RADIOLIB_DIRECT_BUFFER_SIZE - 1);
+  BOOST_TEST(phy->getDirectOverruns() == 10);
+
+  // bytes are read in contiguous spans, split where the buffer wraps around
+  const uint8_t* data = NULL;
+  size_t total = 0;
+  size_t spans = 0;
+  uint8_t expected = 0;
+  bool inOrder = true;
+  size_t len;
+  while((len = phy->peekDirect(&data)) > 0) {
+    for(size_t i = 0; i < len; i++) {
+      inOrder &= (data[i] == expected++);
+    }
+    phy->consumeDirect(len);
+    total += len;
+    spans++;
+  }
+  BOOST_TEST(inOrder);
+  BOOST_TEST(total == RADIOLIB_DIRECT_BUFFER_SIZE - 1);
+  BOOST_TEST(spans == 2);
+
+  // dropping sync stops reception until the next sync word
+  feedByte(phy, 0xAB);
+  BOOST_TEST(phy->read() == 0xAB);
+  feedByte(phy, 0xCD);
+  BOOST_TEST(phy->available() == 0);
+  feedByte(phy, 0x2D);
+  feedByte(phy, 0xD4);
+  feedByte(phy, 0xEF);
+  BOOST_TEST(phy->read() == 0xEF);
+}
+
+BOOST_FIXTURE_TEST_CASE(DirectReceive_syncErrors, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test direct mode sync word correlator ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  PhysicalLayer* phy = &radio;
+  const uint32_t sync = 0x7CD215D8;
+  uint8_t errors = 0xFF;
+
+  // too many accepted errors or sync words
+  BOOST_TEST(phy->setDirectSyncWord(sync, 32, 8) == RADIOLIB_ERR_INVALID_SYNC_WORD);
+  BOOST_TEST(phy->setDirectSyncWord(sync, 32, 2) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->addDirectSyncWord(~sync) == RADIOLIB_ERR_NONE);
+  for(int i = 2; i < RADIOLIB_DIRECT_SYNC_WORDS_NUM; i++) {
+    BOOST_TEST(phy->addDirectSyncWord(i) == RADIOLIB_ERR_NONE);
+  }
+  BOOST_TEST(phy->addDirectSyncWord(0) == RADIOLIB_ERR_INVALID_SYNC_WORD);
+  BOOST_TEST(phy->getDirectSyncMatch() == -1);
+
+  // three bit errors are not a match, two are
+  phy->dropSync();
+  feedWord(phy, sync ^ 0x00010101);
+  feedByte(phy, 0x11);
+  BOOST_TEST(phy->available() == 0);
+  BOOST_TEST(phy->getDirectSyncMatch() == -1);
+  feedWord(phy, sync ^ 0x80000001);
+  feedByte(phy, 0x22);
+  BOOST_TEST(phy->getDirectSyncMatch(&errors) == 0);
+  BOOST_TEST(errors == 2);
+  BOOST_TEST(phy->read() == 0x22);
+
+  // the inverted sync word is matched as the second one
+  feedWord(phy, ~sync ^ 0x00100000);
+  feedByte(phy, 0x33);
+  BOOST_TEST(phy->getDirectSyncMatch(&errors) == 1);
+  BOOST_TEST(errors == 1);
+  BOOST_TEST(phy->read() == 0x33);
+
+  // exact matching by default
+  BOOST_TEST(phy->setDirectSyncWord(sync, 32) == RADIOLIB_ERR_NONE);
+  phy->dropSync();
+  feedWord(phy, sync ^ 0x00000100);
+  feedByte(phy, 0x44);
+  BOOST_TEST(phy->available() == 0);
+  feedWord(phy, sync);
+  feedByte(phy, 0x55);
+  BOOST_TEST(phy->getDirectSyncMatch(&errors) == 0);
+  BOOST_TEST(errors == 0);
+  BOOST_TEST(phy->read() == 0x55);
+
+  // a short sync word with few set bits must not match the empty sync buffer
+  BOOST_TEST(phy->setDirectSyncWord(0x0001, 16, 1) == RADIOLIB_ERR_NONE);
+  phy->dropSync();
+  feedByte(phy, 0x00);
+  BOOST_TEST(phy->getDirectSyncMatch() == -1);
+  feedByte(phy, 0x01);
+  BOOST_TEST(phy->getDirectSyncMatch(&errors) == 0);
+  BOOST_TEST(errors == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
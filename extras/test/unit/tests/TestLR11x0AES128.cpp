@@ -0,0 +1,244 @@
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <vector>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/LR11x0/LR1110.h"
+#include "modules/LR11x0/LR11x0_AES128.h"
+
+// crypto engine of LR11x0 emulated on the SPI bus, every command frame is recorded
+// commands that reply are answered in the following frame, after the Stat1 byte
+class CryptoEngineRadio : public EmulatedRadio {
+  public:
+    std::vector<std::vector<uint8_t>> commands;
+    std::map<uint8_t, std::vector<uint8_t>> slots;
+    bool cmacFail = false;
+
+    void HandleGPIO() override {
+      if(!this->cs->event) {
+        return;
+      }
+      if(this->cs->value == TEST_HAL_LOW) {
+        this->frame.clear();
+        this->replying = !this->reply.empty();
+      } else if(this->replying) {
+        this->reply.clear();
+      } else {
+        this->process();
+      }
+    }
+
+    uint8_t HandleSPI(uint8_t b) override {
+      size_t pos = this->frame.size();
+      this->frame.push_back(b);
+      if(pos == 0) {
+        return(RADIOLIB_LRXXXX_STAT_1_CMD_DAT);
+      }
+      if(this->replying && (pos <= this->reply.size())) {
+        return(this->reply[pos - 1]);
+      }
+      return(0x00);
+    }
+
+    // number of frames with the command
+    size_t count(uint16_t cmd) {
+      size_t num = 0;
+      for(const auto& c : this->commands) {
+        num += (command(c) == cmd);
+      }
+      return(num);
+    }
+
+    static uint16_t command(const std::vector<uint8_t>& c) {
+      return(((uint16_t)c[0] << 8) | c[1]);
+    }
+
+  private:
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> reply;
+    bool replying = false;
+
+    void process() {
+      if(this->frame.size() < 3) {
+        return;
+      }
+      this->commands.push_back(this->frame);
+      uint16_t cmd = command(this->frame);
+      uint8_t keyId = this->frame[2];
+      const uint8_t* data = &this->frame[3];
+      size_t len = this->frame.size() - 3;
+
+      this->reply.assign(1, RADIOLIB_LR11X0_CRYPTO_STATUS_SUCCESS);
+      if(cmd == RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY) {
+        this->slots[keyId].assign(data, data + len);
+        return;
+      }
+
+      RadioLibSoftwareAES128 aes;
+      aes.init(this->slots[keyId].data());
+      if(cmd == RADIOLIB_LR11X0_CMD_CRYPTO_COMPUTE_AES_CMAC) {
+        uint8_t mic[4];
+        aes.generateMIC(data, len, mic);
+        this->reply.insert(this->reply.end(), mic, mic + sizeof(mic));
+        if(this->cmacFail) {
+          this->reply[0] = RADIOLIB_LR11X0_CRYPTO_STATUS_FAIL_CMAC;
+        }
+      } else {
+        std::vector<uint8_t> out(len);
+        if(cmd == RADIOLIB_LR11X0_CMD_CRYPTO_AES_ENCRYPT) {
+          aes.encryptECB(data, len, out.data());
+        } else {
+          aes.decryptECB(data, len, out.data());
+        }
+        this->reply.insert(this->reply.end(), out.begin(), out.end());
+      }
+    }
+};
+
+static uint8_t appSKey[RADIOLIB_AES128_KEY_SIZE] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+  0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static uint8_t otherKey[RADIOLIB_AES128_KEY_SIZE] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+BOOST_AUTO_TEST_SUITE(suite_LR11x0AES128)
+
+BOOST_FIXTURE_TEST_CASE(LR11x0AES128_ecb, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LR11x0 AES-128 ECB ---");
+  hal->spiLogEnabled = false;
+  CryptoEngineRadio hw;
+  hal->connectRadio(&hw);
+  LR1110 radio(mod);
+  LR11x0AES128 aes(&radio);
+
+  // keys that are not bound go to the default slot
+  aes.init(appSKey);
+  BOOST_TEST(hw.commands.size() == 1);
+  BOOST_TEST(CryptoEngineRadio::command(hw.commands[0]) == RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY);
+  BOOST_TEST(hw.commands[0].size() == 3 + RADIOLIB_AES128_KEY_SIZE);
+  BOOST_TEST(hw.slots[RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0] == std::vector<uint8_t>(appSKey, appSKey + sizeof(appSKey)));
+
+  // more data than fits into one command is split into whole blocks, the last one is padded
+  std::vector<uint8_t> plain(300);
+  for(size_t i = 0; i < plain.size(); i++) {
+    plain[i] = (uint8_t)(i*7);
+  }
+  std::vector<uint8_t> cipher(304, 0);
+  BOOST_TEST(aes.encryptECB(plain.data(), plain.size(), cipher.data()) == 304);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_AES_ENCRYPT) == 2);
+  BOOST_TEST(hw.commands[1].size() == 3 + 240);
+  BOOST_TEST(hw.commands[2].size() == 3 + 64);
+  BOOST_TEST(hw.commands[2][2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0);
+
+  // the result is the same as from the software implementation
+  RadioLibSoftwareAES128 sw;
+  sw.init(appSKey);
+  std::vector<uint8_t> expected(304, 0);
+  BOOST_TEST(sw.encryptECB(plain.data(), plain.size(), expected.data()) == 304);
+  BOOST_TEST(cipher == expected);
+
+  std::vector<uint8_t> decrypted(304, 0);
+  BOOST_TEST(aes.decryptECB(cipher.data(), cipher.size(), decrypted.data()) == 304);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_AES_DECRYPT) == 2);
+  BOOST_TEST(std::equal(plain.begin(), plain.end(), decrypted.begin()));
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(LR11x0AES128_mic, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LR11x0 AES-128 MIC ---");
+  hal->spiLogEnabled = false;
+  CryptoEngineRadio hw;
+  hal->connectRadio(&hw);
+  LR1110 radio(mod);
+  LR11x0AES128 aes(&radio);
+  aes.init(appSKey);
+
+  RadioLibSoftwareAES128 sw;
+  sw.init(appSKey);
+  uint8_t msg[40];
+  for(size_t i = 0; i < sizeof(msg); i++) {
+    msg[i] = (uint8_t)(0xA5 ^ i);
+  }
+  uint8_t expected[4];
+  sw.generateMIC(msg, sizeof(msg), expected);
+
+  // the MIC is computed by the engine in a single command
+  uint8_t mic[4] = { 0 };
+  aes.generateMIC(msg, sizeof(msg), mic);
+  BOOST_TEST(memcmp(mic, expected, sizeof(mic)) == 0);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_COMPUTE_AES_CMAC) == 1);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_AES_ENCRYPT) == 0);
+
+  // if the engine fails, the CMAC is calculated from blocks encrypted by the engine
+  hw.cmacFail = true;
+  memset(mic, 0, sizeof(mic));
+  aes.generateMIC(msg, sizeof(msg), mic);
+  BOOST_TEST(memcmp(mic, expected, sizeof(mic)) == 0);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_COMPUTE_AES_CMAC) == 2);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_AES_ENCRYPT) > 0);
+
+  // data that does not fit into one command skips the engine CMAC
+  hw.cmacFail = false;
+  std::vector<uint8_t> large(300, 0x3C);
+  sw.generateMIC(large.data(), large.size(), expected);
+  aes.generateMIC(large.data(), large.size(), mic);
+  BOOST_TEST(memcmp(mic, expected, sizeof(mic)) == 0);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_COMPUTE_AES_CMAC) == 2);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(LR11x0AES128_boundKeys, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LR11x0 AES-128 bound keys ---");
+  hal->spiLogEnabled = false;
+  CryptoEngineRadio hw;
+  hal->connectRadio(&hw);
+  LR1110 radio(mod);
+  LR11x0AES128 aes(&radio);
+
+  // the default slot and missing keys can not be bound
+  BOOST_TEST(!aes.bindKey(appSKey, RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0));
+  BOOST_TEST(!aes.bindKey(NULL, RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S));
+  BOOST_TEST(hw.commands.empty());
+
+  // a bound key is transferred once, selecting it later does not touch the engine
+  BOOST_TEST(aes.bindKey(appSKey, RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S));
+  BOOST_TEST(hw.commands.size() == 1);
+  BOOST_TEST(hw.commands[0][2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S);
+  aes.init(appSKey);
+  BOOST_TEST(hw.commands.size() == 1);
+
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  uint8_t out[RADIOLIB_AES128_BLOCK_SIZE];
+  BOOST_TEST(aes.encryptECB(block, sizeof(block), out) == sizeof(block));
+  BOOST_TEST(hw.commands.back()[2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S);
+
+  // other keys are written to the default slot every time
+  aes.init(otherKey);
+  aes.init(otherKey);
+  BOOST_TEST(hw.count(RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY) == 3);
+  BOOST_TEST(aes.encryptECB(block, sizeof(block), out) == sizeof(block));
+  BOOST_TEST(hw.commands.back()[2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0);
+
+  // binding another buffer to the same slot replaces the previous binding
+  BOOST_TEST(aes.bindKey(otherKey, RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S));
+  size_t frames = hw.commands.size();
+  aes.init(appSKey);
+  BOOST_TEST(hw.commands.size() == frames + 1);
+  BOOST_TEST(hw.commands.back()[2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0);
+  aes.init(otherKey);
+  BOOST_TEST(hw.commands.size() == frames + 1);
+  BOOST_TEST(aes.encryptECB(block, sizeof(block), out) == sizeof(block));
+  BOOST_TEST(hw.commands.back()[2] == RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,351 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+// radio on the level of PhysicalLayer, the test decides when its interrupts fire
+class AsyncRadio : public PhysicalLayer {
+  public:
+    Module* mod;
+    RadioModeType_t stagedMode = RADIOLIB_RADIO_MODE_NONE;
+    int txLaunches = 0;
+    int rxLaunches = 0;
+    bool txDoneAtLaunch = false;
+    RadioLibTime_t tLaunch = 0;
+    uint32_t irqFlags = 0;
+    void (*txAction)(void) = nullptr;
+    void (*rxAction)(void) = nullptr;
+
+    explicit AsyncRadio(Module* mod) : mod(mod) {
+      this->maxPacketLength = RADIOLIB_STATIC_ARRAY_SIZE;
+      for(uint8_t i = 0; i < 10; i++) {
+        this->irqMap[i] = (1UL << i);
+      }
+    }
+
+    Module* getMod() override { return(this->mod); }
+
+    int16_t standby() override { return(RADIOLIB_ERR_NONE); }
+    int16_t standby(uint8_t mode) override { (void)mode; return(RADIOLIB_ERR_NONE); }
+    int16_t sleep() override { return(RADIOLIB_ERR_NONE); }
+    int16_t setFrequency(float freq) override { (void)freq; return(RADIOLIB_ERR_NONE); }
+    int16_t checkDataRate(DataRate_t dr, ModemType_t modem) override { (void)dr; (void)modem; return(RADIOLIB_ERR_NONE); }
+    int16_t setDataRate(DataRate_t dr, ModemType_t modem) override { (void)dr; (void)modem; return(RADIOLIB_ERR_NONE); }
+    int16_t checkOutputPower(int8_t power, int8_t* clipped) override { if(clipped) { *clipped = power; } return(RADIOLIB_ERR_NONE); }
+    int16_t setOutputPower(int8_t power) override { (void)power; return(RADIOLIB_ERR_NONE); }
+    int16_t setSyncWord(uint8_t* sync, size_t len) override { (void)sync; (void)len; return(RADIOLIB_ERR_NONE); }
+    int16_t setPreambleLength(size_t len) override { (void)len; return(RADIOLIB_ERR_NONE); }
+    int16_t invertIQ(bool enable) override { (void)enable; return(RADIOLIB_ERR_NONE); }
+    int16_t finishTransmit() override { this->irqFlags = 0; return(RADIOLIB_ERR_NONE); }
+    size_t getPacketLength(bool update = true) override { (void)update; return(0); }
+
+    // every LoRaWAN frame takes 50 ms
+    RadioLibTime_t calculateTimeOnAir(ModemType_t modem, DataRate_t dr, PacketConfig_t pc, size_t len) override {
+      (void)modem;
+      (void)dr;
+      (void)pc;
+      (void)len;
+      return(50000);
+    }
+
+    RadioLibTime_t calculateRxTimeout(RadioLibTime_t timeoutUs) override { return(timeoutUs); }
+
+    uint32_t getIrqFlags() override { return(this->irqFlags); }
+    int16_t setIrqFlags(uint32_t irq) override { (void)irq; return(RADIOLIB_ERR_NONE); }
+    int16_t clearIrqFlags(uint32_t irq) override { this->irqFlags &= ~irq; return(RADIOLIB_ERR_NONE); }
+
+    void setPacketReceivedAction(void (*func)(void)) override { this->rxAction = func; }
+    void clearPacketReceivedAction() override { this->rxAction = nullptr; }
+    void setPacketSentAction(void (*func)(void)) override { this->txAction = func; }
+    void clearPacketSentAction() override { this->txAction = nullptr; }
+
+    int16_t stageMode(RadioModeType_t mode, RadioModeConfig_t* cfg) override {
+      (void)cfg;
+      this->stagedMode = mode;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t launchMode() override {
+      this->irqFlags = 0;
+      this->tLaunch = this->mod->hal->millis();
+      this->txLaunches += (this->stagedMode == RADIOLIB_RADIO_MODE_TX);
+      this->rxLaunches += (this->stagedMode == RADIOLIB_RADIO_MODE_RX);
+      if(this->txDoneAtLaunch && (this->stagedMode == RADIOLIB_RADIO_MODE_TX)) {
+        this->fire(RADIOLIB_IRQ_TX_DONE);
+      }
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    // raise an interrupt, as the DIO pin would
+    void fire(RadioLibIrqType_t irq) {
+      this->irqFlags |= (1UL << irq);
+      void (*action)(void) = (irq == RADIOLIB_IRQ_TX_DONE) ? this->txAction : this->rxAction;
+      BOOST_REQUIRE(action != nullptr);
+      action();
+    }
+};
+
+// start an ABP session with all-zero keys
+static void startSessionABP(LoRaWANNode& node) {
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+}
+
+static int16_t sequenceResult = RADIOLIB_ERR_UNKNOWN;
+static void sequenceCb(int16_t state) {
+  sequenceResult = state;
+}
+
+// call tick() whenever it is due, until a pending step was taken
+static int16_t tickWhenDue(TestHal* hal, LoRaWANNode& node) {
+  uint8_t prev = node.asyncState;
+  int16_t state = RADIOLIB_LORAWAN_SEQUENCE_BUSY;
+  while((state == RADIOLIB_LORAWAN_SEQUENCE_BUSY) && (node.asyncState == prev)) {
+    RadioLibTime_t wait = node.timeUntilTick();
+    if(wait) {
+      hal->delay(wait);
+    }
+    state = node.tick();
+  }
+  return(state);
+}
+
+BOOST_AUTO_TEST_SUITE(suite_LoRaWANAsync)
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANAsync_windows, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN non-blocking sequence ---");
+  hal->spiLogEnabled = false;
+  AsyncRadio radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  AsyncRadio otherRadio(mod);
+  LoRaWANNode other(&otherRadio, &EU868);
+  startSessionABP(node);
+  node.setSendReceiveCallback(sequenceCb);
+  sequenceResult = RADIOLIB_ERR_UNKNOWN;
+
+  // short Rx delays keep the test fast, the windows are still timed from Tx done
+  node.rxDelays[RADIOLIB_LORAWAN_RX1] = 100;
+  node.rxDelays[RADIOLIB_LORAWAN_RX2] = 200;
+  uint32_t fCntUp = node.fCntUp;
+
+  uint8_t dataUp[4] = { 0x01, 0x02, 0x03, 0x04 };
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenDown = 0;
+  BOOST_TEST(node.startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_TX_WAIT);
+  BOOST_TEST(node.startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+
+  // the uplink is staged first, then launched
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_TX_PENDING);
+  BOOST_TEST(radio.stagedMode == RADIOLIB_RADIO_MODE_TX);
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_TX);
+  BOOST_TEST(radio.txLaunches == 1);
+
+  // nothing happens until Tx done, which is only seen by the node that launched the transmission
+  BOOST_TEST(node.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_TX);
+  radio.fire(RADIOLIB_IRQ_TX_DONE);
+  BOOST_TEST(node.asyncAction);
+  BOOST_TEST(!other.asyncAction);
+  BOOST_TEST(node.timeUntilTick() == 0);
+  RadioLibTime_t tTxDone = node.asyncActionTime;
+
+  // a late tick does not shift Rx1, it is staged right away
+  hal->delay(20);
+  BOOST_TEST(node.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_RX1_PENDING);
+  BOOST_TEST(node.tUplinkEnd == tTxDone);
+  BOOST_TEST(radio.stagedMode == RADIOLIB_RADIO_MODE_RX);
+  BOOST_TEST(radio.txAction == nullptr);
+  BOOST_TEST(node.asyncDeadline == tTxDone + 100 - node.launchDuration - node.scanGuard / 2);
+
+  // Rx1 opens on time and closes on RxTimeout
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_RX1);
+  BOOST_TEST(radio.rxLaunches == 1);
+  BOOST_TEST(hal->millis() >= tTxDone + 100 - node.scanGuard);
+  radio.fire(RADIOLIB_IRQ_TIMEOUT);
+  BOOST_TEST(node.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_RX2_PENDING);
+  BOOST_TEST(radio.rxAction == nullptr);
+  BOOST_TEST(node.asyncDeadline == tTxDone + 200 - node.launchDuration - node.scanGuard / 2);
+
+  // Rx2 opens on time, its window passes without an interrupt
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_RX2);
+  BOOST_TEST(radio.rxLaunches == 2);
+  BOOST_TEST(hal->millis() >= tTxDone + 200 - node.scanGuard);
+  BOOST_TEST(node.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  radio.irqFlags = (1UL << RADIOLIB_IRQ_TIMEOUT);
+
+  // the sequence ends without a downlink
+  BOOST_TEST(tickWhenDue(hal, node) == 0);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE);
+  BOOST_TEST(sequenceResult == 0);
+  BOOST_TEST(lenDown == 0);
+  BOOST_TEST(node.fCntUp == fCntUp + 1);
+  BOOST_TEST(node.tick() == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.timeUntilTick() == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANAsync_lateWindow, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN non-blocking sequence with a missed window ---");
+  hal->spiLogEnabled = false;
+  AsyncRadio radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  startSessionABP(node);
+  node.rxDelays[RADIOLIB_LORAWAN_RX1] = 100;
+  node.rxDelays[RADIOLIB_LORAWAN_RX2] = 200;
+
+  uint8_t dataUp[1] = { 0x01 };
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenDown = 0;
+  BOOST_TEST(node.startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(tickWhenDue(hal, node) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  radio.fire(RADIOLIB_IRQ_TX_DONE);
+  BOOST_TEST(node.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+
+  // ticking well after Rx1 should have opened ends the sequence
+  hal->delay(150);
+  BOOST_TEST(node.tick() == RADIOLIB_ERR_NO_RX_WINDOW);
+  BOOST_TEST(node.asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE);
+  BOOST_TEST(radio.rxLaunches == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANAsync_blockingTxDone, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN blocking uplink timed from Tx done ---");
+  hal->spiLogEnabled = false;
+  AsyncRadio radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  startSessionABP(node);
+
+  // the blocking uplink only polls the IRQ pin after sleeping for the 50 ms Time-on-Air,
+  // here the interrupt fires right away, so the Rx windows must be timed from the launch instead
+  radio.txDoneAtLaunch = true;
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  uint8_t frame[16] = { 0 };
+  BOOST_TEST(node.transmitUplink(&node.channels[RADIOLIB_LORAWAN_UPLINK], frame, sizeof(frame)) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.txLaunches == 1);
+  BOOST_TEST(radio.getIrqTime(RADIOLIB_IRQ_TX_DONE) > 0);
+  BOOST_TEST(node.tUplinkEnd >= radio.tLaunch);
+  BOOST_TEST(node.tUplinkEnd <= radio.tLaunch + 10);
+  BOOST_TEST(hal->millis() >= radio.tLaunch + 50);
+  BOOST_TEST(radio.txAction == nullptr);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANAsync_twoNodes, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN non-blocking sequences of two nodes ---");
+  hal->spiLogEnabled = false;
+  AsyncRadio radioA(mod);
+  AsyncRadio radioB(mod);
+  LoRaWANNode nodeA(&radioA, &EU868);
+  LoRaWANNode nodeB(&radioB, &EU868);
+  AsyncRadio* radios[2] = { &radioA, &radioB };
+  LoRaWANNode* nodes[2] = { &nodeA, &nodeB };
+
+  uint8_t dataUp[1] = { 0x01 };
+  uint8_t dataDown[2][RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenDown[2] = { 0, 0 };
+  for(int i = 0; i < 2; i++) {
+    startSessionABP(*nodes[i]);
+    nodes[i]->rxDelays[RADIOLIB_LORAWAN_RX1] = 100;
+    nodes[i]->rxDelays[RADIOLIB_LORAWAN_RX2] = 200;
+    BOOST_TEST(nodes[i]->startSendReceive(dataUp, sizeof(dataUp), 1, dataDown[i], &lenDown[i]) == RADIOLIB_ERR_NONE);
+  }
+  BOOST_TEST(nodeA.asyncSlot != nodeB.asyncSlot);
+
+  // both uplinks are staged and launched, each radio calls its own interrupt slot
+  for(int step = 0; step < 2; step++) {
+    for(int i = 0; i < 2; i++) {
+      BOOST_TEST(tickWhenDue(hal, *nodes[i]) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+    }
+  }
+  BOOST_TEST(nodeA.asyncState == RADIOLIB_LORAWAN_ASYNC_TX);
+  BOOST_TEST(nodeB.asyncState == RADIOLIB_LORAWAN_ASYNC_TX);
+  BOOST_TEST(radioA.txAction != radioB.txAction);
+
+  // Tx done of the second radio only reaches the second node, even though it launched last
+  radioB.fire(RADIOLIB_IRQ_TX_DONE);
+  BOOST_TEST(nodeB.asyncAction);
+  BOOST_TEST(!nodeA.asyncAction);
+  BOOST_TEST(nodeB.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(nodeB.asyncState == RADIOLIB_LORAWAN_ASYNC_RX1_PENDING);
+  BOOST_TEST(nodeA.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(nodeA.asyncState == RADIOLIB_LORAWAN_ASYNC_TX);
+  radioA.fire(RADIOLIB_IRQ_TX_DONE);
+  BOOST_TEST(nodeA.asyncAction);
+  BOOST_TEST(!nodeB.asyncAction);
+  BOOST_TEST(nodeA.tick() == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(nodeA.asyncState == RADIOLIB_LORAWAN_ASYNC_RX1_PENDING);
+
+  // interleave the ticks of both nodes, each window is closed by RxTimeout of its own radio
+  int16_t results[2] = { RADIOLIB_ERR_UNKNOWN, RADIOLIB_ERR_UNKNOWN };
+  for(int guard = 0; (guard < 100) && ((nodeA.asyncState != RADIOLIB_LORAWAN_ASYNC_IDLE) || (nodeB.asyncState != RADIOLIB_LORAWAN_ASYNC_IDLE)); guard++) {
+    hal->delay(5);
+    for(int i = 0; i < 2; i++) {
+      if((nodes[i]->asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE) || (nodes[i]->timeUntilTick() > 0)) {
+        continue;
+      }
+      results[i] = nodes[i]->tick();
+      uint8_t state = nodes[i]->asyncState;
+      if((state == RADIOLIB_LORAWAN_ASYNC_RX1) || (state == RADIOLIB_LORAWAN_ASYNC_RX2)) {
+        bool otherPending = nodes[1 - i]->asyncAction;
+        radios[i]->fire(RADIOLIB_IRQ_TIMEOUT);
+        BOOST_TEST(nodes[i]->asyncAction);
+        BOOST_TEST(nodes[1 - i]->asyncAction == otherPending);
+      }
+    }
+  }
+
+  // both sequences finish without a downlink and free their slots
+  for(int i = 0; i < 2; i++) {
+    BOOST_TEST(nodes[i]->asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE);
+    BOOST_TEST(results[i] == 0);
+    BOOST_TEST(radios[i]->txLaunches == 1);
+    BOOST_TEST(radios[i]->rxLaunches == 2);
+    BOOST_TEST(nodes[i]->asyncSlot == -1);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANAsync_slots, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN non-blocking sequence slots ---");
+  hal->spiLogEnabled = false;
+  AsyncRadio radio(mod);
+  LoRaWANNode node0(&radio, &EU868);
+  LoRaWANNode node1(&radio, &EU868);
+  LoRaWANNode node2(&radio, &EU868);
+  LoRaWANNode node3(&radio, &EU868);
+  LoRaWANNode node4(&radio, &EU868);
+  LoRaWANNode* nodes[RADIOLIB_LORAWAN_ASYNC_NUM_NODES + 1] = { &node0, &node1, &node2, &node3, &node4 };
+
+  // every running sequence takes a slot, once all are taken, no other sequence can start
+  uint8_t dataUp[1] = { 0x01 };
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenDown = 0;
+  for(int i = 0; i <= RADIOLIB_LORAWAN_ASYNC_NUM_NODES; i++) {
+    startSessionABP(*nodes[i]);
+  }
+  for(int i = 0; i < RADIOLIB_LORAWAN_ASYNC_NUM_NODES; i++) {
+    BOOST_TEST(nodes[i]->startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_ERR_NONE);
+  }
+  LoRaWANNode& last = *nodes[RADIOLIB_LORAWAN_ASYNC_NUM_NODES];
+  uint32_t fCntUp = last.fCntUp;
+  BOOST_TEST(last.startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(last.asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE);
+  BOOST_TEST(last.fCntUp == fCntUp);
+
+  // a failed sequence frees its slot
+  BOOST_TEST(tickWhenDue(hal, node0) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(tickWhenDue(hal, node0) == RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  BOOST_TEST(tickWhenDue(hal, node0) == RADIOLIB_ERR_TX_TIMEOUT);
+  BOOST_TEST(node0.asyncSlot == -1);
+  BOOST_TEST(last.startSendReceive(dataUp, sizeof(dataUp), 1, dataDown, &lenDown) == RADIOLIB_ERR_NONE);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
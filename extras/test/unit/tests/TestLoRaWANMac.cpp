@@ -0,0 +1,560 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+#include <map>
+
+// software AES that records which keys are kept in key slots
+class SlotAES128 : public RadioLibSoftwareAES128 {
+  public:
+    std::map<const uint8_t*, uint8_t> slots;
+    int binds = 0;
+
+    bool bindKey(const uint8_t* key, uint8_t keyId) override {
+      slots[key] = keyId;
+      binds++;
+      return(true);
+    }
+};
+
+// radio that counts the Time-on-Air calculations
+class ToaCountingRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+    int calculations = 0;
+
+    RadioLibTime_t calculateTimeOnAir(ModemType_t modem, DataRate_t dr, PacketConfig_t pc, size_t len) override {
+      calculations++;
+      return(SX1262::calculateTimeOnAir(modem, dr, pc, len));
+    }
+};
+
+// HAL with a clock that is only advanced by the test
+class SimulatedClockHal : public TestHal {
+  public:
+    RadioLibTime_t now = 0;
+
+    unsigned long millis() override { return(this->now); }
+    unsigned long micros() override { return(this->now * 1000); }
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite_LoRaWANMac, ModuleFixture)
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_lookup, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN MAC command lookup ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+
+  uint8_t len = 0;
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_LINK_ADR, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 4);
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_DEV_STATUS, &len, RADIOLIB_LORAWAN_UPLINK, true) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 3);
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_DEVICE_MODE, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 1);
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_PROPRIETARY, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 5);
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_PING_SLOT_CHANNEL, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 4);
+  BOOST_TEST(node.getMacLen(RADIOLIB_LORAWAN_MAC_BEACON_FREQ, &len, RADIOLIB_LORAWAN_UPLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 1);
+
+  // gaps in the CID space are rejected
+  BOOST_TEST(node.getMacLen(0x00, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_INVALID_CID);
+  BOOST_TEST(node.getMacLen(0x14, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_INVALID_CID);
+  BOOST_TEST(node.getMacLen(0x21, &len, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_INVALID_CID);
+
+  LoRaWANMacCommand_t cmd = RADIOLIB_LORAWAN_MAC_COMMAND_NONE;
+  BOOST_TEST(node.getMacCommand(RADIOLIB_LORAWAN_MAC_DEVICE_TIME, &cmd) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(cmd.cid == RADIOLIB_LORAWAN_MAC_DEVICE_TIME);
+  BOOST_TEST(cmd.user);
+  BOOST_TEST(node.isPersistentMacCommand(RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP, RADIOLIB_LORAWAN_UPLINK));
+  BOOST_TEST(!node.isPersistentMacCommand(RADIOLIB_LORAWAN_MAC_LINK_ADR, RADIOLIB_LORAWAN_UPLINK));
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_buffer, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN MAC buffer handling ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+
+  // RxTimingSetupAns, LinkAdrAns, TxParamSetupAns, DevStatusAns
+  uint8_t buff[RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN] = {
+    RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP,
+    RADIOLIB_LORAWAN_MAC_LINK_ADR, 0x07,
+    RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP,
+    RADIOLIB_LORAWAN_MAC_DEV_STATUS, 0xFF, 0x20,
+  };
+  uint8_t len = 7;
+
+  // walk the buffer one command at a time
+  const uint8_t cids[] = { RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP, RADIOLIB_LORAWAN_MAC_LINK_ADR,
+                           RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP, RADIOLIB_LORAWAN_MAC_DEV_STATUS };
+  const uint8_t lens[] = { 1, 2, 1, 3 };
+  uint8_t pos = 0;
+  uint8_t cid = 0;
+  uint8_t fLen = 0;
+  for(size_t i = 0; i < sizeof(cids); i++) {
+    BOOST_TEST(node.nextMacCommand(buff, len, pos, RADIOLIB_LORAWAN_UPLINK, &cid, &fLen) == RADIOLIB_ERR_NONE);
+    BOOST_TEST(cid == cids[i]);
+    BOOST_TEST(fLen == lens[i]);
+    pos += fLen;
+  }
+  BOOST_TEST(node.nextMacCommand(buff, len, pos, RADIOLIB_LORAWAN_UPLINK, &cid, &fLen) == RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+
+  // a truncated command is reported
+  BOOST_TEST(node.nextMacCommand(buff, 6, 4, RADIOLIB_LORAWAN_UPLINK, &cid, &fLen) == RADIOLIB_ERR_INVALID_PAYLOAD);
+
+  uint8_t payload[2] = { 0 };
+  BOOST_TEST(node.getMacPayload(RADIOLIB_LORAWAN_MAC_DEV_STATUS, buff, len, payload, RADIOLIB_LORAWAN_UPLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(payload[0] == 0xFF);
+  BOOST_TEST(payload[1] == 0x20);
+  BOOST_TEST(node.getMacPayload(RADIOLIB_LORAWAN_MAC_REKEY, buff, len, NULL, RADIOLIB_LORAWAN_UPLINK) == RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+
+  // deleting a command removes the CID together with its payload
+  BOOST_TEST(node.deleteMacCommand(RADIOLIB_LORAWAN_MAC_LINK_ADR, buff, &len, RADIOLIB_LORAWAN_UPLINK) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(len == 5);
+  BOOST_TEST(buff[1] == RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP);
+  BOOST_TEST(buff[5] == 0x00);
+
+  // clearing keeps every persistent command, including adjacent ones
+  BOOST_TEST(node.pushMacCommand(RADIOLIB_LORAWAN_MAC_LINK_ADR, &payload[1], buff, &len, RADIOLIB_LORAWAN_UPLINK) == RADIOLIB_ERR_NONE);
+  node.clearMacCommands(buff, &len, RADIOLIB_LORAWAN_UPLINK);
+  BOOST_TEST(len == 2);
+  BOOST_TEST(buff[0] == RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP);
+  BOOST_TEST(buff[1] == RADIOLIB_LORAWAN_MAC_TX_PARAM_SETUP);
+  BOOST_TEST(buff[2] == 0x00);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_malformed, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN malformed MAC commands ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+
+  // RxTimingSetupReq, unknown CID
+  uint8_t unknown[] = { RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP, 0x01, 0x21, 0x00 };
+  uint8_t cid = 0;
+  uint8_t fLen = 0;
+  BOOST_TEST(node.nextMacCommand(unknown, sizeof(unknown), 0, RADIOLIB_LORAWAN_DOWNLINK, &cid, &fLen) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(fLen == 2);
+  BOOST_TEST(node.nextMacCommand(unknown, sizeof(unknown), 2, RADIOLIB_LORAWAN_DOWNLINK, &cid, &fLen) == RADIOLIB_ERR_INVALID_CID);
+  BOOST_TEST(cid == 0x21);
+
+  // RxTimingSetupReq, LinkAdrReq with only two of its four payload bytes
+  uint8_t truncated[] = { RADIOLIB_LORAWAN_MAC_RX_TIMING_SETUP, 0x01, RADIOLIB_LORAWAN_MAC_LINK_ADR, 0x50, 0xFF };
+  BOOST_TEST(node.nextMacCommand(truncated, sizeof(truncated), 2, RADIOLIB_LORAWAN_DOWNLINK, &cid, &fLen) == RADIOLIB_ERR_INVALID_PAYLOAD);
+  BOOST_TEST(cid == RADIOLIB_LORAWAN_MAC_LINK_ADR);
+  BOOST_TEST(fLen == 5);
+
+  // both errors are passed on when searching the buffer
+  BOOST_TEST(node.getMacPayload(RADIOLIB_LORAWAN_MAC_DEV_STATUS, unknown, sizeof(unknown), NULL, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_INVALID_CID);
+  BOOST_TEST(node.getMacPayload(RADIOLIB_LORAWAN_MAC_DEV_STATUS, truncated, sizeof(truncated), NULL, RADIOLIB_LORAWAN_DOWNLINK) == RADIOLIB_ERR_INVALID_PAYLOAD);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_downlinkHeader, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN downlink header check ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+
+  // MHDR, DevAddr, FCtrl, FCnt
+  uint8_t fhdr[8] = { RADIOLIB_LORAWAN_MHDR_MTYPE_UNCONF_DATA_DOWN, 0x34, 0x12, 0x0B, 0x26, 0x00, 0x05, 0x00 };
+  bool multicast = true;
+  uint8_t mcGroupId = 0xFF;
+  BOOST_TEST(node.checkDownlinkHeader(fhdr, RADIOLIB_LORAWAN_RX1, &multicast, &mcGroupId) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(!multicast);
+
+  // the last accepted frame counter is a replay
+  node.aFCntDown = 5;
+  BOOST_TEST(node.checkDownlinkHeader(fhdr, RADIOLIB_LORAWAN_RX1, &multicast, &mcGroupId) == RADIOLIB_ERR_MIC_MISMATCH);
+  fhdr[6] = 0x06;
+  BOOST_TEST(node.checkDownlinkHeader(fhdr, RADIOLIB_LORAWAN_RX1, &multicast, &mcGroupId) == RADIOLIB_ERR_NONE);
+
+  // frames for other devices are rejected
+  fhdr[1] = 0x35;
+  BOOST_TEST(node.checkDownlinkHeader(fhdr, RADIOLIB_LORAWAN_RX1, &multicast, &mcGroupId) == RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  BOOST_TEST(node.checkDownlinkHeader(fhdr, RADIOLIB_LORAWAN_RX_BC, &multicast, &mcGroupId) == RADIOLIB_ERR_DOWNLINK_MALFORMED);
+}
+
+// returns the number of calls so far, counted in the context
+static uint32_t countingRandom(uint32_t max, void* ctx) {
+  uint32_t* calls = (uint32_t*)ctx;
+  return((*calls)++ % max);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_random, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN random number callback ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  LoRaWANNode other(&radio, &EU868);
+  uint32_t calls = 0;
+  uint32_t otherCalls = 10;
+  node.setRandomFunction(countingRandom, &calls);
+  other.setRandomFunction(countingRandom, &otherCalls);
+
+  // every node draws from its own context
+  BOOST_TEST(node.randomNumber(100) == 0);
+  BOOST_TEST(node.randomNumber(100) == 1);
+  BOOST_TEST(other.randomNumber(100) == 10);
+  BOOST_TEST(calls == 2);
+  BOOST_TEST(otherCalls == 11);
+
+  // the result is kept in range, and no call is made for an empty range
+  BOOST_TEST(other.randomNumber(5) == 1);
+  BOOST_TEST(node.randomNumber(0) == 0);
+  BOOST_TEST(calls == 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_dwellTime, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN dwell time payload limits ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  ToaCountingRadio counting(mod);
+  LoRaWANNode as923(&counting, &AS923);
+  as923.setDwellTime(true, 400);
+
+  // at SF12, not even the frame header fits into 400 ms, which is a valid limit as well
+  as923.channels[RADIOLIB_LORAWAN_UPLINK].dr = 0;
+  BOOST_TEST(as923.getMaxPayloadLen() == 0);
+  BOOST_TEST(as923.maxLenDwell[0] < 13);
+  BOOST_TEST(counting.calculations > 0);
+  int calculations = counting.calculations;
+  BOOST_TEST(as923.getMaxPayloadLen() == 0);
+  BOOST_TEST(counting.calculations == calculations);
+
+  // the limit of a faster datarate is calculated separately, and also only once
+  as923.channels[RADIOLIB_LORAWAN_UPLINK].dr = 5;
+  uint8_t maxLen = as923.getMaxPayloadLen();
+  BOOST_TEST(maxLen > 0);
+  BOOST_TEST(counting.calculations > calculations);
+  calculations = counting.calculations;
+  BOOST_TEST(as923.getMaxPayloadLen() == maxLen);
+  BOOST_TEST(counting.calculations == calculations);
+
+  // a new dwell time invalidates the limits
+  as923.setDwellTime(true, 4000);
+  as923.channels[RADIOLIB_LORAWAN_UPLINK].dr = 0;
+  BOOST_TEST(as923.getMaxPayloadLen() > 0);
+  BOOST_TEST(counting.calculations > calculations);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_dutyCycle, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN duty cycle sub-bands ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  node.setDutyCycle(true);
+
+  // 868.1 MHz is in the 1 % sub-band, 868.65 MHz is outside of all sub-bands
+  uint8_t buckets[2];
+  BOOST_TEST(node.dutyCycleBuckets(8681000, buckets) == 1);
+  BOOST_TEST(buckets[0] == 2);
+  BOOST_TEST(node.dutyCycleBuckets(8686500, buckets) == 1);
+  BOOST_TEST(buckets[0] == RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS);
+
+  // the bucket holds 3.6 s, so the first uplink leaves airtime for a shorter one only
+  RadioLibTime_t tStart = hal->millis();
+  BOOST_TEST(node.getNextUplinkTime() <= hal->millis());
+  BOOST_TEST(node.dutyCycleReadyTime(8681000, 2000) <= hal->millis());
+  node.dutyCycleCharge(8681000, 2000);
+  BOOST_TEST(node.dutyCycleReadyTime(8681000, 1500) <= hal->millis());
+
+  // the second one has to wait until 0.4 s are refilled, which takes 40 s
+  RadioLibTime_t tReady = node.dutyCycleReadyTime(8681000, 2000);
+  BOOST_TEST(tReady >= tStart + 40000);
+  BOOST_TEST(tReady <= hal->millis() + 40000);
+  BOOST_TEST(node.dutyCycleNextTime(2000) == tReady);
+  BOOST_TEST(node.dutyCycleTokens(2, hal->millis()) >= 0);
+
+  // other sub-bands are not affected
+  BOOST_TEST(node.dutyCycleReadyTime(8671000, 2000) <= hal->millis());
+  BOOST_TEST(node.dutyCycleReadyTime(8695250, 2000) <= hal->millis());
+
+  // the 0.1 % sub-band saves up 3 s, so after a 2.5 s uplink,
+  // the second one has to wait until 2 s are refilled at 3.6 s per hour
+  BOOST_TEST(node.dutyCycleReadyTime(8640000, 2500) <= hal->millis());
+  node.dutyCycleCharge(8640000, 2500);
+  tReady = node.dutyCycleReadyTime(8640000, 2500);
+  BOOST_TEST(tReady >= tStart + 2000000UL);
+  BOOST_TEST(tReady <= hal->millis() + 2000000UL);
+  BOOST_TEST(node.dutyCycleTokens(0, hal->millis() + 3600000UL) == 3000000);
+
+  // an uplink longer than the bucket can never be sent
+  BOOST_TEST(node.dutyCycleReadyTime(8640000, 3500) == RADIOLIB_LORAWAN_UPLINK_NEVER);
+
+  // the uplink is refused when staged on the exhausted sub-band
+  LoRaWANChannel_t chnl = { .idx = 0, .freq = 8640000, .drMin = 0, .drMax = 5, .dr = 0 };
+  uint8_t drPrev = node.channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  node.channels[RADIOLIB_LORAWAN_UPLINK].dr = 0;
+  uint8_t frame[64] = { 0 };
+  RadioLibTime_t toa = 0;
+  BOOST_TEST(node.stageUplink(&chnl, frame, sizeof(frame), &toa) == RADIOLIB_ERR_UPLINK_UNAVAILABLE);
+  BOOST_TEST(toa > 2500);
+  node.channels[RADIOLIB_LORAWAN_UPLINK].dr = drPrev;
+
+  // a channel in another sub-band can be used right away, and is preferred
+  node.dynamicChannels[RADIOLIB_LORAWAN_UPLINK][3] = { .idx = 3, .freq = 8671000, .drMin = 0, .drMax = 5, .dr = 3 };
+  node.dynamicChannels[RADIOLIB_LORAWAN_DOWNLINK][3] = node.dynamicChannels[RADIOLIB_LORAWAN_UPLINK][3];
+  node.channelMasks[0] |= (0x0001 << 3);
+  node.dcToA = 2000;
+  BOOST_TEST(node.dutyCycleReadyChannels(node.dcToA) == (0x0001 << 3));
+  BOOST_TEST(node.dutyCycleNextTime(node.dcToA) <= hal->millis());
+  for(int i = 0; i < 8; i++) {
+    BOOST_TEST(node.selectChannels() == RADIOLIB_ERR_NONE);
+    BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].freq == 8671000UL);
+  }
+
+  // a custom duty cycle replaces the sub-bands
+  node.setDutyCycle(true, 3600000);
+  BOOST_TEST(node.dutyCycleReadyTime(8681000, 2000) <= hal->millis());
+
+  // with 2 s per hour at SF12, an empty uplink fits, but a full one never does
+  node.setDutyCycle(true, 2000);
+  node.channels[RADIOLIB_LORAWAN_UPLINK].dr = 0;
+  BOOST_TEST(node.timeUntilUplink() == 0);
+  BOOST_TEST(node.timeUntilUplink(51) == RADIOLIB_LORAWAN_UPLINK_NEVER);
+  BOOST_TEST(node.getNextUplinkTime(51) == RADIOLIB_LORAWAN_UPLINK_NEVER);
+  node.channels[RADIOLIB_LORAWAN_UPLINK].dr = drPrev;
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_dutyCycleSteady, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN duty cycle over several hours ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  node.setDutyCycle(true);
+
+  // the hours are simulated, so the duty cycle runs on a clock set by the test
+  SimulatedClockHal clock;
+  RadioLibHal* halPrev = mod->hal;
+  mod->hal = &clock;
+
+  // transmit 1 s uplinks in the 0.1 % sub-band as soon as they are allowed
+  RadioLibTime_t airtime[8] = { 0 };
+  while(clock.now < 8 * 3600000UL) {
+    clock.now = RADIOLIB_MAX(clock.now, node.dutyCycleReadyTime(8640000, 1000));
+    node.dutyCycleCharge(8640000, 1000);
+    airtime[clock.now / 3600000UL] += 1000;
+    clock.now += 1000;
+  }
+  mod->hal = halPrev;
+
+  // the saved up airtime is sent in the first hour, after that, every hour gets about 3.6 s
+  BOOST_TEST(airtime[0] <= 3600 + 3000);
+  RadioLibTime_t total = 0;
+  for(int i = 1; i < 8; i++) {
+    BOOST_TEST(airtime[i] >= 3000);
+    BOOST_TEST(airtime[i] <= 4000);
+    total += airtime[i];
+  }
+  BOOST_TEST(total >= 7 * 3600 - 1000);
+  BOOST_TEST(total <= 7 * 3600 + 1000);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_ratePredictor, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN rate predictor ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  node.setADR(false);
+  BOOST_TEST(node.setDatarate(3) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.netDr == 3);
+
+  // without samples, nothing is changed
+  node.setRatePredictor(true);
+  node.predictRate(10);
+  BOOST_TEST(!node.predicted);
+  BOOST_TEST(node.predictedMargin == RADIOLIB_LORAWAN_MARGIN_UNKNOWN);
+
+  // 10 dB at SF9 is 22.5 dB above the floor, enough for SF7 and three power steps
+  node.predictorSample(10);
+  node.predictRate(10);
+  BOOST_TEST(node.predicted);
+  BOOST_TEST(node.predictedMargin == 22);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 5);
+  BOOST_TEST(node.txPowerSteps == 3);
+
+  // a weak link falls back to the slowest datarate at full power
+  node.setRatePredictor(true);
+  node.predictorSample(-15);
+  node.predictRate(10);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 0);
+  BOOST_TEST(node.txPowerSteps == 0);
+
+  // large payloads limit the datarate
+  node.setRatePredictor(true);
+  node.predictorSample(10);
+  node.predictRate(RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 0);
+
+  // with ADR, the network datarate and power are the limit
+  node.setADR(true);
+  node.netDr = 3;
+  node.netTxSteps = 1;
+  node.predictRate(10);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 3);
+  BOOST_TEST(node.txPowerSteps == 1);
+
+  // 1 dB at SF9 is one step above the margin at full power, so one of the two network power steps is given back
+  node.netTxSteps = 2;
+  node.setRatePredictor(true);
+  node.predictorSample(1);
+  node.predictRate(10);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 3);
+  BOOST_TEST(node.txPowerSteps == 1);
+
+  // a weaker link gets full power before the datarate is lowered
+  node.setRatePredictor(true);
+  node.predictorSample(-5);
+  node.predictRate(10);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 2);
+  BOOST_TEST(node.txPowerSteps == 0);
+
+  // old samples expire, together with the last prediction
+  for(int i = 0; i < RADIOLIB_LORAWAN_PREDICTOR_MAX_AGE; i++) {
+    node.predictRate(10);
+  }
+  BOOST_TEST(!node.predicted);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 3);
+  BOOST_TEST(node.txPowerSteps == 2);
+
+  // disabling goes back to the network settings
+  node.setRatePredictor(true);
+  node.predictorSample(-5);
+  node.predictRate(10);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 2);
+  node.setRatePredictor(false);
+  BOOST_TEST(node.channels[RADIOLIB_LORAWAN_UPLINK].dr == 3);
+  BOOST_TEST(node.txPowerSteps == 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_keySlots, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN keys in AES engine key slots ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  RadioLibAES128* aesDefault = hal->aes128;
+  SlotAES128 aes;
+  hal->aes128 = &aes;
+
+  // the software engine has no key slots
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0x01 };
+  BOOST_TEST(!aesDefault->bindKey(key, 1));
+
+  // keys are only stored once a slot was assigned, and again whenever they are set
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(aes.binds == 0);
+  node.setKeyId(RADIOLIB_LORAWAN_KEY_APP_S, 12);
+  node.setKeyId(RADIOLIB_LORAWAN_KEY_NWK_S_ENC, 15);
+  node.setKeyId(RADIOLIB_LORAWAN_NUM_KEYS, 1);
+  BOOST_TEST(aes.binds == 2);
+  BOOST_TEST(aes.slots[node.appSKey] == 12);
+  BOOST_TEST(aes.slots[node.nwkSEncKey] == 15);
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(aes.binds == 4);
+
+  // the MIC is the start of the CMAC
+  uint8_t msg[20] = { 0x40, 0x34, 0x12, 0x0B, 0x26 };
+  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
+  aes.init(key);
+  aes.generateCMAC(msg, sizeof(msg), cmac);
+  uint32_t mic = node.generateMIC(msg, sizeof(msg), key);
+  BOOST_TEST(mic == LoRaWANNode::ntoh<uint32_t>(cmac));
+  hal->aes128 = aesDefault;
+}
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANMac_classB, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN Class B beacon and ping slots ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+
+  // Class B is only possible once the beacon was found
+  BOOST_TEST(node.setClass(RADIOLIB_LORAWAN_CLASS_B) == RADIOLIB_ERR_NO_BEACON);
+
+  // RFU, Time = 1400000000, CRC
+  uint8_t beacon[17] = { 0x00, 0x00, 0x00, 0x4E, 0x72, 0x53, 0x01, 0x02 };
+  uint32_t beaconTime = 0;
+  BOOST_TEST(node.parseBeacon(beacon, sizeof(beacon), &beaconTime) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(beaconTime == 1400000000UL);
+  beacon[2] ^= 0x01;
+  BOOST_TEST(node.parseBeacon(beacon, sizeof(beacon), &beaconTime) == RADIOLIB_ERR_CRC_MISMATCH);
+
+  // the offset is derived with an all-zero key, without touching the key of the shared AES
+  SlotAES128 shared;
+  RadioLibAES128* prevAes = hal->aes128;
+  hal->aes128 = &shared;
+  uint8_t sessionKey[RADIOLIB_AES128_KEY_SIZE] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+  shared.init(sessionKey);
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  uint8_t expected[RADIOLIB_AES128_BLOCK_SIZE];
+  shared.encryptECB(block, sizeof(block), expected);
+  uint16_t offset = node.getPingOffset(1400000000UL);
+  hal->aes128 = prevAes;
+  uint8_t out[RADIOLIB_AES128_BLOCK_SIZE];
+  shared.encryptECB(block, sizeof(block), out);
+  BOOST_TEST(memcmp(out, expected, sizeof(out)) == 0);
+
+  uint8_t zeroKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  RadioLibSoftwareAES128 zero;
+  zero.init(zeroKey);
+  LoRaWANNode::hton<uint32_t>(&block[0], 1400000000UL);
+  LoRaWANNode::hton<uint32_t>(&block[RADIOLIB_LORAWAN_BEACON_TIME_LEN], 0x260B1234);
+  zero.encryptECB(block, sizeof(block), out);
+  BOOST_TEST(offset == ((uint16_t)out[0] | ((uint16_t)out[1] << 8)) % RADIOLIB_LORAWAN_PING_SLOTS);
+
+  // with the default periodicity, there is a single slot per beacon period
+  BOOST_TEST(node.setPingSlotPeriodicity(8) == RADIOLIB_ERR_INVALID_RX_PERIOD);
+  BOOST_TEST(node.getPingOffset(1400000000UL) < RADIOLIB_LORAWAN_PING_SLOTS);
+  BOOST_TEST(node.setPingSlotPeriodicity(0) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.getPingOffset(1400000000UL) < 32);
+
+  // slots follow the beacon reservation, every 32 slots of 30 ms
+  node.timeRef = 1400000000UL;
+  node.tTimeRef = 10000;
+  node.timeRefError = 0;
+  node.timeRefValid = true;
+  RadioLibTime_t tEvent = 0;
+  bool isBeacon = true;
+  node.nextClassBEvent(10000, &tEvent, &beaconTime, &isBeacon);
+  offset = node.getPingOffset(1400000000UL);
+  BOOST_TEST(!isBeacon);
+  BOOST_TEST(beaconTime == 1400000000UL);
+  BOOST_TEST(tEvent == 10000 + RADIOLIB_LORAWAN_BEACON_RESERVED_MS + offset*RADIOLIB_LORAWAN_PING_SLOT_LEN_MS);
+  node.nextClassBEvent(tEvent + 1, &tEvent, &beaconTime, &isBeacon);
+  BOOST_TEST(tEvent == 10000 + RADIOLIB_LORAWAN_BEACON_RESERVED_MS + (offset + 32)*RADIOLIB_LORAWAN_PING_SLOT_LEN_MS);
+
+  // after the last slot, the next beacon is due
+  node.nextClassBEvent(10000 + 126000, &tEvent, &beaconTime, &isBeacon);
+  BOOST_TEST(isBeacon);
+  BOOST_TEST(beaconTime == 1400000128UL);
+  BOOST_TEST(tEvent == 10000 + 128000);
+
+  LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  node.getBeaconChannel(beaconTime, &chnl);
+  BOOST_TEST(chnl.freq == 8695250UL);
+  BOOST_TEST(chnl.dr == 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,235 @@
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <vector>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+#include "protocols/LoRaWAN/LoRaWANPackageTS004.h"
+
+// fragment storage kept in RAM
+class MemoryFragmentStorage : public LoRaWANFragmentStorage {
+  public:
+    std::vector<uint8_t> data;
+    size_t reads = 0;
+    size_t writes = 0;
+
+    int16_t prepare(size_t len) override {
+      data.assign(len, 0xFF);
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t read(size_t offset, uint8_t* out, size_t len) override {
+      if(offset + len > data.size()) { return(RADIOLIB_ERR_UNKNOWN); }
+      memcpy(out, &data[offset], len);
+      reads++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t write(size_t offset, const uint8_t* in, size_t len) override {
+      if(offset + len > data.size()) { return(RADIOLIB_ERR_UNKNOWN); }
+      memcpy(&data[offset], in, len);
+      writes++;
+      return(RADIOLIB_ERR_NONE);
+    }
+};
+
+static RadioLibTime_t getSeconds() {
+  return(1000);
+}
+
+// the largest number in range
+static uint32_t lastRandom(uint32_t max, void* ctx) {
+  (void)ctx;
+  return(max - 1);
+}
+
+static uint32_t doneDescriptor = 0;
+static size_t doneLen = 0;
+static void fragDone(uint32_t descriptor, size_t len) {
+  doneDescriptor = descriptor;
+  doneLen = len;
+}
+
+// build data fragment N the same way the server does
+static std::vector<uint8_t> buildFragment(const std::vector<uint8_t>& block, uint16_t n, uint16_t nbFrag, uint8_t fragSize) {
+  std::vector<uint8_t> frame = { RADIOLIB_LORAWAN_TS004_DATA_FRAGMENT, (uint8_t)(n & 0xFF), (uint8_t)(n >> 8) };
+  std::vector<uint8_t> frag(fragSize, 0);
+  std::vector<uint8_t> row((nbFrag + 7) / 8, 0);
+  if(n <= nbFrag) {
+    row[(n - 1) / 8] |= 1 << ((n - 1) % 8);
+  } else {
+    LoRaWANPackageTS004::getParityRow(n - nbFrag, nbFrag, row.data());
+  }
+  for(uint16_t i = 0; i < nbFrag; i++) {
+    if(row[i / 8] & (1 << (i % 8))) {
+      for(uint8_t j = 0; j < fragSize; j++) {
+        frag[j] ^= block[i*fragSize + j];
+      }
+    }
+  }
+  frame.insert(frame.end(), frag.begin(), frag.end());
+  return(frame);
+}
+
+BOOST_AUTO_TEST_SUITE(suite_LoRaWANPackageTS004)
+
+BOOST_FIXTURE_TEST_CASE(TS004_reassembly, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test TS004 fragment reassembly ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  LoRaWANPackageManager pacMan(&node, getSeconds);
+  MemoryFragmentStorage storage;
+  BOOST_TEST(pacMan.enableTS004(RADIOLIB_LORAWAN_FPORT_TS004, NULL, fragDone) == RADIOLIB_ERR_NULL_POINTER);
+  BOOST_TEST(pacMan.enableTS004(RADIOLIB_LORAWAN_FPORT_TS004, &storage, fragDone) == RADIOLIB_ERR_NONE);
+  LoRaWANPackageTS004* ts004 = static_cast<LoRaWANPackageTS004*>(pacMan.packages[RADIOLIB_LORAWAN_PACKAGE_TS004]);
+
+  LoRaWANEvent_t event;
+  memset(&event, 0, sizeof(event));
+  event.fPort = RADIOLIB_LORAWAN_FPORT_TS004;
+  uint8_t uplink[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenUp = 0;
+  uint8_t fPort = 0;
+
+  // PackageVersionReq
+  uint8_t versionReq[] = { RADIOLIB_LORAWAN_TS004_PACKAGE_VERSION };
+  BOOST_TEST(pacMan.processDownlink(versionReq, sizeof(versionReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(lenUp == 3);
+  BOOST_TEST(fPort == RADIOLIB_LORAWAN_FPORT_TS004);
+  BOOST_TEST(uplink[1] == RADIOLIB_LORAWAN_PACKAGE_TS004);
+  BOOST_TEST(uplink[2] == 1);
+
+  // FragSessionSetupReq for index 1: 100 fragments of 40 bytes, 7 bytes padding
+  const uint16_t nbFrag = 100;
+  const uint8_t fragSize = 40;
+  uint8_t setupReq[] = { RADIOLIB_LORAWAN_TS004_FRAG_SESSION_SETUP, 0x11, nbFrag, 0x00, fragSize, 0x00, 7, 0x44, 0x33, 0x22, 0x11 };
+  BOOST_TEST(pacMan.processDownlink(setupReq, sizeof(setupReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(lenUp == 2);
+  BOOST_TEST(uplink[1] == (1 << 6));
+  BOOST_TEST(ts004->getMissingFragments() == nbFrag);
+
+  // a second session is not supported
+  setupReq[1] = 0x21;
+  BOOST_TEST(pacMan.processDownlink(setupReq, sizeof(setupReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == ((2 << 6) | RADIOLIB_LORAWAN_TS004_SETUP_INDEX_NOT_SUPPORTED));
+
+  // send the block over a channel that loses 30 % of the fragments
+  std::mt19937 rng(4);
+  std::vector<uint8_t> block(nbFrag*fragSize);
+  for(auto& b : block) {
+    b = (uint8_t)rng();
+  }
+  doneLen = 0;
+  uint16_t n = 1;
+  uint16_t delivered = 0;
+  while((doneLen == 0) && (n < 3*nbFrag)) {
+    std::vector<uint8_t> frame = buildFragment(block, n++, nbFrag, fragSize);
+    frame[2] |= 1 << 6;
+    if(rng() % 10 < 3) {
+      continue;
+    }
+    BOOST_TEST(pacMan.processDownlink(frame.data(), frame.size(), &event) == RADIOLIB_ERR_NONE);
+    delivered++;
+  }
+  BOOST_TEST(doneLen == nbFrag*fragSize - 7);
+  BOOST_TEST(doneDescriptor == 0x11223344);
+  BOOST_TEST(memcmp(storage.data.data(), block.data(), doneLen) == 0);
+  BOOST_TEST(ts004->getMissingFragments() == 0);
+  BOOST_TEST(!ts004->matrixFull);
+
+  // the parity fragments recover the losses with little overhead
+  BOOST_TEST_MESSAGE("Fragments needed: " << delivered);
+  BOOST_TEST(delivered < nbFrag + 10);
+
+  // fragments received after completion do not touch the storage
+  size_t writes = storage.writes;
+  std::vector<uint8_t> frame = buildFragment(block, n, nbFrag, fragSize);
+  frame[2] |= 1 << 6;
+  BOOST_TEST(pacMan.processDownlink(frame.data(), frame.size(), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(storage.writes == writes);
+
+  // FragSessionStatusReq is only answered by devices with missing fragments, unless all are asked
+  uint8_t statusReq[] = { RADIOLIB_LORAWAN_TS004_FRAG_SESSION_STATUS, 0x02 };
+  BOOST_TEST(pacMan.processDownlink(statusReq, sizeof(statusReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(!pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  statusReq[1] = 0x03;
+  BOOST_TEST(pacMan.processDownlink(statusReq, sizeof(statusReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(lenUp == 5);
+  BOOST_TEST((uplink[1] | (uplink[2] << 8)) == ((delivered + 1) | (1 << 14)));
+  BOOST_TEST(uplink[3] == 0);
+  BOOST_TEST(uplink[4] == 0);
+
+  // answers to a multicast request are spread out using the random generator of the node
+  node.setRandomFunction(lastRandom);
+  event.multicast = true;
+  BOOST_TEST(pacMan.processDownlink(statusReq, sizeof(statusReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(ts004->hasTask().time == getSeconds() + 15);
+  BOOST_TEST(!pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  event.multicast = false;
+
+  // FragSessionDeleteReq
+  uint8_t deleteReq[] = { RADIOLIB_LORAWAN_TS004_FRAG_SESSION_DELETE, 0x01 };
+  BOOST_TEST(pacMan.processDownlink(deleteReq, sizeof(deleteReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == 0x01);
+  BOOST_TEST(pacMan.processDownlink(deleteReq, sizeof(deleteReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == (0x01 | RADIOLIB_LORAWAN_TS004_DELETE_NO_SESSION));
+}
+
+BOOST_FIXTURE_TEST_CASE(TS004_parityOnly, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test TS004 reassembly from parity fragments ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  LoRaWANPackageManager pacMan(&node, getSeconds);
+  MemoryFragmentStorage storage;
+  BOOST_TEST(pacMan.enableTS004(RADIOLIB_LORAWAN_FPORT_TS004, &storage, fragDone) == RADIOLIB_ERR_NONE);
+  LoRaWANPackageTS004* ts004 = static_cast<LoRaWANPackageTS004*>(pacMan.packages[RADIOLIB_LORAWAN_PACKAGE_TS004]);
+
+  // every parity row selects at most half of the fragments
+  uint8_t row[4] = { 0 };
+  LoRaWANPackageTS004::getParityRow(1, 32, row);
+  int ones = 0;
+  for(int i = 0; i < 32; i++) {
+    ones += (row[i / 8] >> (i % 8)) & 0x01;
+  }
+  BOOST_TEST(ones > 0);
+  BOOST_TEST(ones <= 16);
+
+  // only the parity fragments are received, the matrix has to hold all of them
+  const uint16_t nbFrag = 16;
+  const uint8_t fragSize = 8;
+  const uint8_t setupReq[] = { RADIOLIB_LORAWAN_TS004_FRAG_SESSION_SETUP, 0x00, nbFrag, 0x00, fragSize, 0x00, 0, 0x01, 0x00, 0x00, 0x00 };
+  BOOST_TEST(ts004->processData(setupReq, sizeof(setupReq), NULL) == sizeof(setupReq));
+  BOOST_TEST(ts004->dataUp[1] == 0);
+
+  std::mt19937 rng(7);
+  std::vector<uint8_t> block(nbFrag*fragSize);
+  for(auto& b : block) {
+    b = (uint8_t)rng();
+  }
+  doneLen = 0;
+  uint16_t n = nbFrag + 1;
+  while((doneLen == 0) && (n < 5*nbFrag)) {
+    std::vector<uint8_t> frame = buildFragment(block, n++, nbFrag, fragSize);
+    ts004->processData(frame.data(), frame.size(), NULL);
+  }
+  BOOST_TEST(doneLen == nbFrag*fragSize);
+  BOOST_TEST(memcmp(storage.data.data(), block.data(), doneLen) == 0);
+
+  // unsupported fragmentation algorithm
+  uint8_t badReq[sizeof(setupReq)];
+  memcpy(badReq, setupReq, sizeof(setupReq));
+  badReq[5] = 1 << 3;
+  ts004->processData(badReq, sizeof(badReq), NULL);
+  BOOST_TEST(ts004->dataUp[1] == RADIOLIB_LORAWAN_TS004_SETUP_ENCODING_UNSUPPORTED);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+#include "protocols/LoRaWAN/LoRaWANPackageTS005.h"
+
+static RadioLibTime_t timeNow = 1000;
+static RadioLibTime_t getSeconds() {
+  return(timeNow);
+}
+
+BOOST_AUTO_TEST_SUITE(suite_LoRaWANPackageTS005)
+
+BOOST_FIXTURE_TEST_CASE(TS005_multicastSetup, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test TS005 remote multicast setup ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  LoRaWANNode node(&radio, &EU868);
+  LoRaWANPackageManager pacMan(&node, getSeconds);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  const uint8_t genAppKey[RADIOLIB_AES128_KEY_SIZE] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+  };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.enableTS005(RADIOLIB_LORAWAN_FPORT_TS005, &radio, NULL) == RADIOLIB_ERR_NULL_POINTER);
+  BOOST_TEST(pacMan.enableTS005(RADIOLIB_LORAWAN_FPORT_TS005, &radio, genAppKey) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  LoRaWANPackageTS005* ts005 = static_cast<LoRaWANPackageTS005*>(pacMan.packages[RADIOLIB_LORAWAN_PACKAGE_TS005]);
+
+  LoRaWANEvent_t event;
+  memset(&event, 0, sizeof(event));
+  event.fPort = RADIOLIB_LORAWAN_FPORT_TS005;
+  uint8_t uplink[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenUp = 0;
+  uint8_t fPort = 0;
+
+  // McGroupSetupReq for group 1, McAddr 0x12345678, frame counters 0 - 1000
+  const uint8_t setupReq[] = { RADIOLIB_LORAWAN_TS005_MC_GROUP_SETUP, 0x01, 0x78, 0x56, 0x34, 0x12,
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+    0x00, 0x00, 0x00, 0x00, 0xE8, 0x03, 0x00, 0x00 };
+  BOOST_TEST(pacMan.processDownlink(setupReq, sizeof(setupReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(lenUp == 2);
+  BOOST_TEST(uplink[1] == 0x01);
+
+  // keys derived for LoRaWAN 1.0.x from GenAppKey
+  const uint8_t mcAppSKey[RADIOLIB_AES128_KEY_SIZE] = {
+    0x65, 0xB3, 0x35, 0x40, 0x3F, 0x3B, 0xDC, 0x07, 0x84, 0x6E, 0xD5, 0x5C, 0x9E, 0x34, 0x99, 0x31
+  };
+  const uint8_t mcNwkSKey[RADIOLIB_AES128_KEY_SIZE] = {
+    0x41, 0x59, 0xC8, 0x18, 0x25, 0xFC, 0x0E, 0x9B, 0x10, 0x7F, 0x23, 0xB2, 0xF5, 0x56, 0xBD, 0x95
+  };
+  BOOST_TEST(memcmp(ts005->groups[1].mcAppSKey, mcAppSKey, RADIOLIB_AES128_KEY_SIZE) == 0);
+  BOOST_TEST(memcmp(ts005->groups[1].mcNwkSKey, mcNwkSKey, RADIOLIB_AES128_KEY_SIZE) == 0);
+  BOOST_TEST(ts005->groups[1].mcFCntMax == 1000);
+
+  // McGroupStatusReq for all groups
+  const uint8_t statusReq[] = { RADIOLIB_LORAWAN_TS005_MC_GROUP_STATUS, 0x0F };
+  BOOST_TEST(pacMan.processDownlink(statusReq, sizeof(statusReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  const uint8_t statusAns[] = { RADIOLIB_LORAWAN_TS005_MC_GROUP_STATUS, 0x12, 0x01, 0x78, 0x56, 0x34, 0x12 };
+  BOOST_TEST(lenUp == sizeof(statusAns));
+  BOOST_TEST(memcmp(uplink, statusAns, sizeof(statusAns)) == 0);
+
+  // McClassCSessionReq starting in 100 s for 16 s, at 869.525 MHz and DR0
+  uint8_t sessionReq[] = { RADIOLIB_LORAWAN_TS005_MC_CLASS_C_SESSION, 0x01, 0x4C, 0x04, 0x00, 0x00, 0x04, 0xD2, 0xAD, 0x84, 0x00 };
+  BOOST_TEST(pacMan.processDownlink(sessionReq, sizeof(sessionReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  const uint8_t sessionAns[] = { RADIOLIB_LORAWAN_TS005_MC_CLASS_C_SESSION, 0x01, 0x64, 0x00, 0x00 };
+  BOOST_TEST(lenUp == sizeof(sessionAns));
+  BOOST_TEST(memcmp(uplink, sessionAns, sizeof(sessionAns)) == 0);
+
+  // the session is started and stopped by actions
+  LoRaWANTaskInfo task = pacMan.hasTask();
+  BOOST_TEST(task.type == RADIOLIB_LORAWAN_TASK_ACTION);
+  BOOST_TEST(task.time == 1100);
+  BOOST_TEST(!pacMan.doAction());
+  timeNow = 1100;
+  BOOST_TEST(pacMan.doAction());
+  BOOST_TEST(node.mcGroups[1].mcAddr == 0x12345678);
+  BOOST_TEST(node.mcGroups[1].mcFreq == 869525000UL);
+  task = pacMan.hasTask();
+  BOOST_TEST(task.time == 1116);
+  timeNow = 1116;
+  BOOST_TEST(pacMan.doAction());
+  BOOST_TEST(node.mcGroups[1].mcAddr == 0);
+  BOOST_TEST(pacMan.hasTask().type == RADIOLIB_LORAWAN_TASK_NONE);
+
+  // invalid frequency, datarate and group
+  sessionReq[9] = 0x04;
+  BOOST_TEST(pacMan.processDownlink(sessionReq, sizeof(sessionReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(lenUp == 2);
+  BOOST_TEST(uplink[1] == (0x01 | RADIOLIB_LORAWAN_TS005_SESSION_FREQ_ERROR));
+  sessionReq[9] = 0x84;
+  sessionReq[10] = 0x0E;
+  BOOST_TEST(pacMan.processDownlink(sessionReq, sizeof(sessionReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == (0x01 | RADIOLIB_LORAWAN_TS005_SESSION_DR_ERROR));
+  sessionReq[1] = 0x03;
+  BOOST_TEST(pacMan.processDownlink(sessionReq, sizeof(sessionReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == (0x03 | RADIOLIB_LORAWAN_TS005_SESSION_UNDEFINED));
+
+  // McGroupDeleteReq
+  const uint8_t deleteReq[] = { RADIOLIB_LORAWAN_TS005_MC_GROUP_DELETE, 0x01 };
+  BOOST_TEST(pacMan.processDownlink(deleteReq, sizeof(deleteReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == 0x01);
+  BOOST_TEST(pacMan.processDownlink(deleteReq, sizeof(deleteReq), &event) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(pacMan.getUplinkData(uplink, &lenUp, &fPort));
+  BOOST_TEST(uplink[1] == (0x01 | RADIOLIB_LORAWAN_TS005_DELETE_UNDEFINED));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// node that captures the frames instead of sending them
+class QueueNode : public LoRaWANNode {
+  public:
+    using LoRaWANNode::LoRaWANNode;
+    using LoRaWANNode::sendReceive;
+
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> ports;
+    std::vector<bool> confirmed;
+    int16_t result = 0;
+    bool ack = false;
+
+    int16_t sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown, bool isConfirmed, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) override {
+      (void)dataDown;
+      (void)eventUp;
+      *lenDown = 0;
+      if(result == RADIOLIB_ERR_UPLINK_UNAVAILABLE) {
+        return(result);
+      }
+      frames.push_back(std::vector<uint8_t>(dataUp, dataUp + lenUp));
+      ports.push_back(fPort);
+      confirmed.push_back(isConfirmed);
+      if(eventDown) {
+        eventDown->confirming = ack;
+      }
+      return(result);
+    }
+};
+
+static std::vector<std::pair<uint8_t, int16_t>> reports;
+static void queueCb(uint8_t id, int16_t state) {
+  reports.push_back(std::make_pair(id, state));
+}
+
+BOOST_AUTO_TEST_SUITE(suite_LoRaWANQueue)
+
+BOOST_FIXTURE_TEST_CASE(LoRaWANQueue_coalescing, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRaWAN uplink queue ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  QueueNode node(&radio, &EU868);
+  const uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  BOOST_TEST(node.beginABP(0x260B1234, NULL, NULL, key, key) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.activateABP() == RADIOLIB_LORAWAN_NEW_SESSION);
+  node.setQueuedUplinkCb(queueCb);
+  reports.clear();
+
+  uint8_t dataDown[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  size_t lenDown = 0;
+  uint8_t record[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+  for(size_t i = 0; i < sizeof(record); i++) {
+    record[i] = i;
+  }
+  uint8_t maxLen = node.getMaxPayloadLen();
+  BOOST_TEST_MESSAGE("Max payload: " << (int)maxLen);
+
+  // nothing to send from an empty queue, which is not an error
+  BOOST_TEST(node.timeUntilQueuedUplink() == RADIOLIB_LORAWAN_QUEUE_EMPTY);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == RADIOLIB_LORAWAN_QUEUE_WAITING);
+  BOOST_TEST(RADIOLIB_LORAWAN_QUEUE_WAITING > RADIOLIB_ERR_NONE);
+
+  // records that are not due yet are kept
+  uint8_t id = 0xFF;
+  BOOST_TEST(node.queueUplink(record, 10, 1, 60000, false, &id) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(id == 0);
+  BOOST_TEST(node.queueUplink(&record[10], 10, 1, 60000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.queueUplink(&record[20], 5, 2, 60000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == RADIOLIB_LORAWAN_QUEUE_WAITING);
+  BOOST_TEST(node.timeUntilQueuedUplink() > 50000);
+  BOOST_TEST(node.getNumQueuedUplinks() == 3);
+
+  // invalid records are rejected right away
+  BOOST_TEST(node.queueUplink(record, maxLen + 1, 1, 0) == RADIOLIB_ERR_PACKET_TOO_LONG);
+  BOOST_TEST(node.queueUplink(record, 1, 0, 0) == RADIOLIB_ERR_INVALID_PORT);
+
+  // a due record is sent together with all other records for its FPort, due record first
+  BOOST_TEST(node.queueUplink(&record[30], 3, 1, 0, false, &id) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(id == 3);
+  BOOST_TEST(node.timeUntilQueuedUplink() == 0);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == 0);
+  BOOST_TEST(node.frames.size() == 1);
+  BOOST_TEST(node.ports[0] == 1);
+  std::vector<uint8_t> expected(&record[30], &record[33]);
+  expected.insert(expected.end(), &record[0], &record[20]);
+  BOOST_TEST(node.frames[0] == expected);
+  BOOST_TEST(reports.size() == 3);
+  BOOST_TEST(reports[0].first == 0);
+  BOOST_TEST(reports[2].first == 3);
+  BOOST_TEST(reports[2].second == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.getNumQueuedUplinks() == 1);
+
+  // the remaining record is only sent when forced
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == RADIOLIB_LORAWAN_QUEUE_WAITING);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown, true) == 0);
+  BOOST_TEST(node.ports[1] == 2);
+  BOOST_TEST(node.frames[1].size() == 5);
+  BOOST_TEST(node.getNumQueuedUplinks() == 0);
+  BOOST_TEST(node.timeUntilQueuedUplink() == RADIOLIB_LORAWAN_QUEUE_EMPTY);
+
+  // once a frame can be filled, it is sent without waiting for the deadline
+  size_t chunk = maxLen / 2;
+  BOOST_TEST(node.queueUplink(record, chunk, 3, 60000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == RADIOLIB_LORAWAN_QUEUE_WAITING);
+  BOOST_TEST(node.queueUplink(record, maxLen - chunk, 3, 60000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.queueUplink(record, 1, 3, 60000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == 0);
+  BOOST_TEST(node.frames[2].size() == maxLen);
+  BOOST_TEST(node.getNumQueuedUplinks() == 1);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown, true) == 0);
+
+  // confirmed records are only delivered once acknowledged, and stay queued while dutycycle blocks
+  reports.clear();
+  BOOST_TEST(node.queueUplink(record, 4, 1, 0, true) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(node.queueUplink(record, 4, 1, 0) == RADIOLIB_ERR_NONE);
+  node.result = RADIOLIB_ERR_UPLINK_UNAVAILABLE;
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == RADIOLIB_ERR_UPLINK_UNAVAILABLE);
+  BOOST_TEST(node.getNumQueuedUplinks() == 2);
+  BOOST_TEST(reports.size() == 0);
+  node.result = 0;
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == 0);
+  BOOST_TEST(node.confirmed.back());
+  BOOST_TEST(reports.size() == 2);
+  BOOST_TEST(reports[0].second == RADIOLIB_ERR_ACK_NOT_RECEIVED);
+  BOOST_TEST(reports[1].second == RADIOLIB_ERR_NONE);
+
+  // the queue has a limited number of records
+  for(int i = 0; i < RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN; i++) {
+    BOOST_TEST(node.queueUplink(record, 1, 4, 60000) == RADIOLIB_ERR_NONE);
+  }
+  BOOST_TEST(node.queueUplink(record, 1, 4, 60000) == RADIOLIB_ERR_UPLINK_QUEUE_FULL);
+  BOOST_TEST(node.timeUntilQueuedUplink() == 0);
+  BOOST_TEST(node.sendQueued(dataDown, &lenDown) == 0);
+  BOOST_TEST(node.frames.back().size() == RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
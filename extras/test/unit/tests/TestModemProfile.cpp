@@ -0,0 +1,141 @@
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// radio hardware that records every SPI frame and answers with a fixed byte
+class ProfileRadioHardware : public EmulatedRadio {
+  public:
+    std::vector<std::vector<uint8_t>> frames;
+    uint8_t resp = RADIOLIB_SX126X_PACKET_TYPE_LORA;
+
+    void HandleGPIO() override {
+      if(this->cs->event && (this->cs->value == TEST_HAL_LOW)) {
+        this->frames.emplace_back();
+      }
+    }
+
+    uint8_t HandleSPI(uint8_t b) override {
+      if(!this->frames.empty()) {
+        this->frames.back().push_back(b);
+      }
+      return(this->resp);
+    }
+
+    size_t count(uint8_t cmd) {
+      size_t num = 0;
+      for(const auto& frame : this->frames) {
+        num += (!frame.empty() && (frame[0] == cmd));
+      }
+      return(num);
+    }
+};
+
+// SPI configuration as set by SX126x::modSetup, without probing the chip
+static void setupSpi(Module* mod) {
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_ADDR] = Module::BITS_16;
+  mod->spiConfig.widths[RADIOLIB_MODULE_SPI_WIDTH_CMD] = Module::BITS_8;
+  mod->spiConfig.statusPos = 1;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_READ] = RADIOLIB_SX126X_CMD_READ_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_WRITE] = RADIOLIB_SX126X_CMD_WRITE_REGISTER;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_NOP] = RADIOLIB_SX126X_CMD_NOP;
+  mod->spiConfig.cmds[RADIOLIB_MODULE_SPI_COMMAND_STATUS] = RADIOLIB_SX126X_CMD_GET_STATUS;
+  mod->spiConfig.stream = true;
+}
+
+BOOST_AUTO_TEST_SUITE(suite_ModemProfile)
+
+BOOST_FIXTURE_TEST_CASE(ModemProfile_lora, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test LoRa modem profile ---");
+  hal->spiLogEnabled = false;
+  ProfileRadioHardware hw;
+  hal->connectRadio(&hw);
+  setupSpi(mod);
+  SX1262 radio(mod);
+
+  SX126xProfile profile;
+  BOOST_TEST(radio.compileProfile(NULL) == RADIOLIB_ERR_NULL_POINTER);
+  BOOST_TEST(radio.applyProfile(&profile) == RADIOLIB_ERR_WRONG_MODEM);
+
+  radio.spreadingFactor = 10;
+  radio.bandwidth = RADIOLIB_SX126X_LORA_BW_125_0;
+  radio.bandwidthKhz = 125.0f;
+  radio.codingRate = RADIOLIB_SX126X_LORA_CR_4_5;
+  radio.preambleLengthLoRa = 16;
+  BOOST_TEST(radio.compileProfile(&profile) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(profile.modem == RADIOLIB_SX126X_PACKET_TYPE_LORA);
+  BOOST_TEST(profile.modParamsLen == 4);
+  BOOST_TEST(profile.packetParamsLen == 6);
+  BOOST_TEST(profile.packetParams[1] == 16);
+
+  // applying the profile restores the driver state with no recalibration
+  radio.spreadingFactor = 7;
+  radio.bandwidthKhz = 500.0f;
+  hw.frames.clear();
+  BOOST_TEST(radio.applyProfile(&profile) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.spreadingFactor == 10);
+  BOOST_TEST(radio.bandwidthKhz == 125.0f);
+
+  // wakeup, standby, packet type, modulation, packet parameters and 3 registers
+  BOOST_TEST(hw.frames.size() == 8);
+  BOOST_TEST(hw.frames[1][0] == RADIOLIB_SX126X_CMD_SET_STANDBY);
+  BOOST_TEST(hw.frames[2][0] == RADIOLIB_SX126X_CMD_SET_PACKET_TYPE);
+  BOOST_TEST(hw.frames[2][1] == RADIOLIB_SX126X_PACKET_TYPE_LORA);
+  BOOST_TEST(hw.frames[3][0] == RADIOLIB_SX126X_CMD_SET_MODULATION_PARAMS);
+  BOOST_TEST(hw.frames[3][1] == 10);
+  BOOST_TEST(hw.frames[4][0] == RADIOLIB_SX126X_CMD_SET_PACKET_PARAMS);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_WRITE_REGISTER) == 3);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_CALIBRATE) == 0);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(ModemProfile_staged, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test staged FSK modem profile ---");
+  hal->spiLogEnabled = false;
+  ProfileRadioHardware hw;
+  hw.resp = RADIOLIB_SX126X_PACKET_TYPE_GFSK;
+  hal->connectRadio(&hw);
+  setupSpi(mod);
+  SX1262 radio(mod);
+
+  radio.bitRate = 0x001400;
+  radio.frequencyDev = 0x000A3D;
+  radio.preambleLengthFSK = 32;
+  SX126xProfile profile;
+  BOOST_TEST(radio.compileProfile(&profile) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(profile.modem == RADIOLIB_SX126X_PACKET_TYPE_GFSK);
+  BOOST_TEST(profile.modParamsLen == 8);
+  BOOST_TEST(profile.packetParamsLen == 9);
+
+  // the staged profile is written by the next receive, packet parameters only once
+  radio.bitRate = 0;
+  radio.stageProfile(&profile);
+  hw.frames.clear();
+  RadioModeConfig_t cfg = {
+    .receive = {
+      .timeout = RADIOLIB_SX126X_RX_TIMEOUT_INF,
+      .irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS,
+      .irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK,
+      .len = 0,
+    }
+  };
+  BOOST_TEST(radio.stageMode(RADIOLIB_RADIO_MODE_RX, &cfg) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.bitRate == 0x001400);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_PACKET_TYPE) == 1);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_MODULATION_PARAMS) == 1);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_PACKET_PARAMS) == 1);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_WRITE_REGISTER) == 6);
+
+  // the profile is only applied once
+  hw.frames.clear();
+  BOOST_TEST(radio.stageMode(RADIOLIB_RADIO_MODE_RX, &cfg) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_PACKET_TYPE) == 0);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
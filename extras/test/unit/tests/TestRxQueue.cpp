@@ -0,0 +1,242 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// radio that receives fixed-length packets of a counter value
+class QueueRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+
+    size_t len = 0;
+    uint8_t counter = 0;
+    int restarts = 0;
+    int16_t readState = RADIOLIB_ERR_NONE;
+
+    size_t getPacketLength(bool update = true) override {
+      (void)update;
+      return(len);
+    }
+
+    int16_t readData(uint8_t* data, size_t length) override {
+      memset(data, counter++, length);
+      return(readState);
+    }
+
+    int16_t finishReceive() override {
+      counter++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t startReceive() override {
+      restarts++;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    float getRSSI() override {
+      return(-100.0 + counter);
+    }
+
+    // interrupt actions are kept so that the test can fire them
+    void (*action)(void) = NULL;
+
+    void setPacketReceivedAction(void (*func)(void)) override {
+      action = func;
+    }
+
+    void setPacketSentAction(void (*func)(void)) override {
+      action = func;
+    }
+};
+
+static int actions = 0;
+static void countAction(void) {
+  actions++;
+}
+
+BOOST_FIXTURE_TEST_SUITE(suite_RxQueue, ModuleFixture)
+
+BOOST_FIXTURE_TEST_CASE(RxQueue_entries, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test receive queue ---");
+  hal->spiLogEnabled = false;
+  QueueRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+  uint8_t data[RADIOLIB_RX_QUEUE_POOL_SIZE];
+  RadioLibPacketInfo_t info;
+
+  BOOST_TEST(phy->startReceiveQueued() == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_QUEUE_EMPTY);
+
+  // packets are stored with their details until the queue is full
+  radio.len = 10;
+  for(int i = 0; i < RADIOLIB_RX_QUEUE_LEN + 1; i++) {
+    phy->queueReceived();
+  }
+  BOOST_TEST(radio.restarts == RADIOLIB_RX_QUEUE_LEN + 2);
+  BOOST_TEST(phy->getNumQueued() == RADIOLIB_RX_QUEUE_LEN);
+  BOOST_TEST(phy->getQueueDrops() == 1);
+
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(info.len == 10);
+  BOOST_TEST(data[0] == 0);
+  BOOST_TEST(data[9] == 0);
+  BOOST_TEST(info.rssi == -99.0f);
+
+  // truncated read, the full length is still reported
+  BOOST_TEST(phy->readQueued(data, 4, &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(info.len == 10);
+  BOOST_TEST(data[3] == 1);
+  BOOST_TEST(phy->getNumQueued() == RADIOLIB_RX_QUEUE_LEN - 2);
+
+  phy->stopReceiveQueued();
+}
+
+BOOST_FIXTURE_TEST_CASE(RxQueue_pool, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test receive queue payload pool ---");
+  hal->spiLogEnabled = false;
+  QueueRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+  uint8_t data[RADIOLIB_RX_QUEUE_POOL_SIZE];
+  RadioLibPacketInfo_t info;
+  BOOST_TEST(phy->startReceiveQueued() == RADIOLIB_ERR_NONE);
+
+  // packets longer than the pool are dropped
+  radio.len = RADIOLIB_RX_QUEUE_POOL_SIZE + 1;
+  phy->queueReceived();
+  BOOST_TEST(phy->getNumQueued() == 0);
+  BOOST_TEST(phy->getQueueDrops() == 1);
+
+  // two packets fill most of the pool, the third one does not fit
+  radio.len = 24;
+  phy->queueReceived();
+  phy->queueReceived();
+  phy->queueReceived();
+  BOOST_TEST(phy->getNumQueued() == 2);
+  BOOST_TEST(phy->getQueueDrops() == 2);
+
+  // after reading the oldest packet, the next one wraps to the start of the pool
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(data[0] == 1);
+  phy->queueReceived();
+  BOOST_TEST(phy->getNumQueued() == 2);
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(data[0] == 2);
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(data[23] == 4);
+  BOOST_TEST(info.len == 24);
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_QUEUE_EMPTY);
+
+  // packets that fail to be read are dropped and do not take up the pool
+  radio.readState = RADIOLIB_ERR_CRC_MISMATCH;
+  int restarts = radio.restarts;
+  phy->queueReceived();
+  BOOST_TEST(phy->getNumQueued() == 0);
+  BOOST_TEST(phy->getQueueDrops() == 3);
+  BOOST_TEST(radio.restarts == restarts + 1);
+  radio.readState = RADIOLIB_ERR_NONE;
+  phy->queueReceived();
+  BOOST_TEST(phy->getNumQueued() == 1);
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(data[0] == 6);
+
+  phy->stopReceiveQueued();
+}
+
+BOOST_FIXTURE_TEST_CASE(RxQueue_irqTime, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test interrupt time capture ---");
+  hal->spiLogEnabled = false;
+  QueueRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+  uint8_t data[RADIOLIB_RX_QUEUE_POOL_SIZE];
+  RadioLibPacketInfo_t info;
+
+  // events that were not captured have no time
+  BOOST_TEST(phy->getIrqTime(RADIOLIB_IRQ_TX_DONE) == 0);
+  BOOST_TEST(phy->getIrqTime(RADIOLIB_IRQ_NOT_SUPPORTED) == 0);
+
+  // the time is captured before the user action is called
+  actions = 0;
+  phy->setTimestampedAction(RADIOLIB_IRQ_TX_DONE, countAction);
+  BOOST_REQUIRE(radio.action != nullptr);
+  hal->delayMicroseconds(100);
+  RadioLibTime_t before = hal->micros();
+  radio.action();
+  BOOST_TEST(actions == 1);
+  BOOST_TEST(phy->getIrqTime(RADIOLIB_IRQ_TX_DONE) >= before);
+  BOOST_TEST(phy->getIrqTime(RADIOLIB_IRQ_RX_DONE) == 0);
+
+  phy->setTimestampedAction(RADIOLIB_IRQ_PREAMBLE_DETECTED, NULL);
+  radio.action();
+  BOOST_TEST(actions == 1);
+  BOOST_TEST(phy->getIrqTime(RADIOLIB_IRQ_PREAMBLE_DETECTED) >= before);
+
+  // queued packets carry the captured time of their interrupt
+  BOOST_TEST(phy->startReceiveQueued() == RADIOLIB_ERR_NONE);
+  radio.len = 8;
+  radio.action();
+  BOOST_TEST(phy->readQueued(data, sizeof(data), &info) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(info.timestamp == phy->getIrqTime(RADIOLIB_IRQ_RX_DONE));
+  BOOST_TEST(info.timestamp >= before);
+  phy->stopReceiveQueued();
+}
+
+BOOST_FIXTURE_TEST_CASE(RxQueue_irqTimeRadios, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test interrupt time capture on several radios ---");
+  hal->spiLogEnabled = false;
+  QueueRadio first(mod);
+  QueueRadio second(mod);
+
+  // each radio captures its own event from its own interrupt
+  actions = 0;
+  first.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, countAction);
+  second.setTimestampedAction(RADIOLIB_IRQ_RX_DONE, NULL);
+  BOOST_REQUIRE(first.action != nullptr);
+  BOOST_REQUIRE(second.action != nullptr);
+  BOOST_TEST(first.action != second.action);
+  hal->delayMicroseconds(100);
+  second.action();
+  BOOST_TEST(actions == 0);
+  BOOST_TEST(second.getIrqTime(RADIOLIB_IRQ_RX_DONE) > 0);
+  BOOST_TEST(first.getIrqTime(RADIOLIB_IRQ_TX_DONE) == 0);
+  hal->delayMicroseconds(100);
+  first.action();
+  BOOST_TEST(actions == 1);
+  BOOST_TEST(first.getIrqTime(RADIOLIB_IRQ_TX_DONE) > second.getIrqTime(RADIOLIB_IRQ_RX_DONE));
+  BOOST_TEST(first.getIrqTime(RADIOLIB_IRQ_RX_DONE) == 0);
+
+  // once all slots are taken, the action is attached without capturing the time
+  {
+    QueueRadio third(mod);
+    QueueRadio fourth(mod);
+    third.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, NULL);
+    fourth.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, NULL);
+    QueueRadio fifth(mod);
+    fifth.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, countAction);
+    BOOST_TEST(fifth.action == countAction);
+    fifth.action();
+    BOOST_TEST(actions == 2);
+    BOOST_TEST(fifth.getIrqTime(RADIOLIB_IRQ_TX_DONE) == 0);
+
+    // a cleared action frees the slot
+    second.clearTimestampedAction();
+    fifth.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, countAction);
+    BOOST_TEST(fifth.action != countAction);
+    fifth.action();
+    BOOST_TEST(actions == 3);
+    BOOST_TEST(fifth.getIrqTime(RADIOLIB_IRQ_TX_DONE) > 0);
+  }
+
+  // so does a radio that no longer exists
+  QueueRadio others[3] = { QueueRadio(mod), QueueRadio(mod), QueueRadio(mod) };
+  for(QueueRadio& other : others) {
+    other.setTimestampedAction(RADIOLIB_IRQ_TX_DONE, countAction);
+    BOOST_TEST(other.action != countAction);
+  }
+  for(QueueRadio& other : others) {
+    other.clearTimestampedAction();
+  }
+  first.clearTimestampedAction();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,233 @@
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "ModuleFixture.hpp"
+#include "RecordingRadio.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+static std::vector<size_t> exported;
+static void exportCb(size_t idx, float freq, const uint16_t* histogram, const SX126xSpectrumBin_t* bin, void* ctx) {
+  (void)freq;
+  (void)histogram;
+  (void)bin;
+  BOOST_TEST(ctx == (void*)&exported);
+  exported.push_back(idx);
+}
+
+// SX126x running spectral scans: the status register reports completion after a few reads,
+// and the result of every scan has all samples in one histogram bin, one bin lower for every step
+class SpectralScanRadio : public RecordingRadio {
+  public:
+    size_t numBins = 4;
+    size_t scans = 0;
+    int pollsPerScan = 3;
+    int polls = 0;
+
+    uint8_t HandleSPI(uint8_t b) override {
+      uint8_t out = RecordingRadio::HandleSPI(b);
+      if(this->frames.empty()) {
+        return(out);
+      }
+      const std::vector<uint8_t>& frame = this->frames.back();
+      size_t pos = frame.size() - 1;
+      if((pos == 0) && (b == RADIOLIB_SX126X_CMD_SET_SPECTR_SCAN_PARAMS)) {
+        this->scans++;
+        this->polls = 0;
+      }
+      if((frame[0] != RADIOLIB_SX126X_CMD_READ_REGISTER) || (pos < 4)) {
+        return(out);
+      }
+
+      uint16_t addr = (((uint16_t)frame[1] << 8) | frame[2]) + (pos - 4);
+      if(addr == RADIOLIB_SX126X_REG_SPECTRAL_SCAN_STATUS) {
+        if(this->polls < this->pollsPerScan) {
+          this->polls++;
+          return(RADIOLIB_SX126X_SPECTRAL_SCAN_ONGOING);
+        }
+        return(RADIOLIB_SX126X_SPECTRAL_SCAN_COMPLETED);
+      }
+      if((addr >= RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT) && (addr < RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT + 2*RADIOLIB_SX126X_SPECTRAL_SCAN_RES_SIZE)) {
+        size_t bin = (addr - RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT) / 2;
+        bool low = (addr - RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT) % 2;
+        return((low && (bin == level(this->scans - 1))) ? 100 : 0);
+      }
+      return(out);
+    }
+
+    // histogram bin with the samples of a scan
+    size_t level(size_t scan) {
+      return(scan % this->numBins + 1);
+    }
+
+    // index of the n-th frame reading the register, -1 if there is none
+    int findRead(uint16_t addr, size_t n) {
+      for(size_t i = 0; i < this->frames.size(); i++) {
+        const std::vector<uint8_t>& frame = this->frames[i];
+        if((frame.size() > 3) && (frame[0] == RADIOLIB_SX126X_CMD_READ_REGISTER) && ((((uint16_t)frame[1] << 8) | frame[2]) == addr)) {
+          if(n-- == 0) {
+            return(i);
+          }
+        }
+      }
+      return(-1);
+    }
+};
+
+struct SpectrumSweepLog {
+  SpectralScanRadio* hw;
+  std::vector<size_t> idx;
+  std::vector<size_t> started;
+};
+
+static void logCb(size_t idx, float freq, const uint16_t* histogram, const SX126xSpectrumBin_t* bin, void* ctx) {
+  (void)freq;
+  (void)histogram;
+  (void)bin;
+  SpectrumSweepLog* log = (SpectrumSweepLog*)ctx;
+  log->idx.push_back(idx);
+  log->started.push_back(log->hw->scans);
+}
+
+BOOST_AUTO_TEST_SUITE(suite_SpectrumSweep)
+
+BOOST_FIXTURE_TEST_CASE(SpectrumSweep_accumulate, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test spectrum sweep accumulation ---");
+  hal->spiLogEnabled = false;
+  SX1262 radio(mod);
+  SX126xSpectrumSweep sweep(&radio);
+  SX126xSpectrumBin_t bins[4];
+
+  // invalid configurations
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, NULL, 4) == RADIOLIB_ERR_NULL_POINTER);
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, bins, 0) == RADIOLIB_ERR_INVALID_NUM_SAMPLES);
+  BOOST_TEST(sweep.begin(100.0f, 0.2f, bins, 4) == RADIOLIB_ERR_INVALID_FREQUENCY);
+  BOOST_TEST(sweep.begin(959.9f, 0.2f, bins, 4) == RADIOLIB_ERR_INVALID_FREQUENCY);
+
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, bins, 4) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(sweep.getFrequency(3) == 433.6f, boost::test_tools::tolerance(0.001f));
+  BOOST_TEST(sweep.getAverage(0) == 0.0f);
+  sweep.setExportCb(exportCb, &exported);
+  exported.clear();
+
+  // all samples in the second bin (-15 dBm)
+  uint16_t histogram[RADIOLIB_SX126X_SPECTRAL_SCAN_RES_SIZE] = { 0 };
+  histogram[1] = 100;
+  sweep.accumulate(1, histogram);
+  BOOST_TEST(bins[1].count == 1);
+  BOOST_TEST(bins[1].min == -15);
+  BOOST_TEST(bins[1].max == -15);
+  BOOST_TEST(bins[1].peak == -15);
+
+  // a weak scan with a few strong samples: the average drops, the peak rises
+  memset(histogram, 0, sizeof(histogram));
+  histogram[0] = 1;
+  histogram[20] = 99;
+  sweep.accumulate(1, histogram);
+  BOOST_TEST(bins[1].count == 2);
+  BOOST_TEST(bins[1].min == -90);
+  BOOST_TEST(bins[1].max == -15);
+  BOOST_TEST(bins[1].peak == -11);
+  BOOST_TEST(sweep.getAverage(1) == -52.5f, boost::test_tools::tolerance(0.001f));
+
+  // empty scans are exported but not accumulated
+  memset(histogram, 0, sizeof(histogram));
+  sweep.accumulate(2, histogram);
+  BOOST_TEST(bins[2].count == 0);
+  BOOST_TEST(exported == std::vector<size_t>({ 1, 1, 2 }));
+
+  sweep.reset();
+  BOOST_TEST(bins[1].count == 0);
+  BOOST_TEST(sweep.getAverage(1) == 0.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(SpectrumSweep_pipeline, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test spectrum sweep pipeline ---");
+  hal->spiLogEnabled = false;
+  SpectralScanRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  SX1262 radio(mod);
+  SX126xSpectrumSweep sweep(&radio);
+  SX126xSpectrumBin_t bins[4];
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, bins, 4) == RADIOLIB_ERR_NONE);
+  SpectrumSweepLog log = { &hw, {}, {} };
+  sweep.setExportCb(logCb, &log);
+
+  // two sweeps over four steps, the image is calibrated for the whole range only once
+  BOOST_TEST(sweep.sweep(2) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_CALIBRATE_IMAGE) == 1);
+  BOOST_TEST(hw.scans == 8);
+  BOOST_REQUIRE(hw.count(RADIOLIB_SX126X_CMD_SET_RF_FREQUENCY) == 8);
+  for(size_t n = 0; n < 8; n++) {
+    // retuned to the next step without the automatic calibration
+    int freqIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RF_FREQUENCY);
+    for(size_t i = 0; i < n; i++) {
+      freqIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RF_FREQUENCY, freqIdx + 1);
+    }
+    const std::vector<uint8_t>& frame = hw.frames[freqIdx];
+    uint32_t frf = ((uint32_t)frame[1] << 24) | ((uint32_t)frame[2] << 16) | ((uint32_t)frame[3] << 8) | (uint32_t)frame[4];
+    float freq = sweep.getFrequency(n % 4);
+    BOOST_TEST(frf == (uint32_t)((freq * (uint32_t(1) << RADIOLIB_SX126X_DIV_EXPONENT)) / RADIOLIB_SX126X_CRYSTAL_FREQ));
+
+    // the next step is started once the result of this one is read out
+    int resultIdx = hw.findRead(RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT, n);
+    BOOST_TEST(resultIdx > freqIdx);
+    if(n < 7) {
+      int nextIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RF_FREQUENCY, freqIdx + 1);
+      BOOST_TEST(nextIdx > resultIdx);
+      BOOST_TEST(nextIdx < hw.findRead(RADIOLIB_SX126X_REG_SPECTRAL_SCAN_RESULT, n + 1));
+    }
+  }
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_CALIBRATE_IMAGE) == 1);
+
+  // every result is processed while the next step is scanned
+  BOOST_TEST(log.idx == std::vector<size_t>({ 0, 1, 2, 3, 0, 1, 2, 3 }));
+  BOOST_TEST(log.started == std::vector<size_t>({ 2, 3, 4, 5, 6, 7, 8, 8 }));
+  for(size_t i = 0; i < 4; i++) {
+    int8_t level = RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_OFFSET - RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_STEP*hw.level(i);
+    BOOST_TEST(bins[i].count == 2);
+    BOOST_TEST(bins[i].min == level);
+    BOOST_TEST(bins[i].max == level);
+  }
+
+  // the radio is left in standby
+  BOOST_TEST(hw.frames.back()[0] == RADIOLIB_SX126X_CMD_SET_STANDBY);
+
+  // later sweeps skip the calibration
+  BOOST_TEST(sweep.sweep(1) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_CALIBRATE_IMAGE) == 1);
+  BOOST_TEST(hw.scans == 12);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(SpectrumSweep_timeout, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test spectrum sweep timeout ---");
+  hal->spiLogEnabled = false;
+  SpectralScanRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  SX1262 radio(mod);
+  SX126xSpectrumSweep sweep(&radio);
+  SX126xSpectrumBin_t bins[4];
+
+  // the timeout follows the number of samples, averaging window and interval
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, bins, 4) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(sweep.scanTimeout == 2*((2048UL*8200UL << 5) / 1000UL) + 10000UL);
+  BOOST_TEST(sweep.begin(433.0f, 0.2f, bins, 4, 100, 0, RADIOLIB_SX126X_SCAN_INTERVAL_7_68_US) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(sweep.scanTimeout == 2*768UL + 10000UL);
+
+  // a scan that never completes is reported, and the radio is still put to standby
+  hw.pollsPerScan = 1000000;
+  RadioLibTime_t start = hal->micros();
+  BOOST_TEST(sweep.sweep(1) == RADIOLIB_ERR_RX_TIMEOUT);
+  BOOST_TEST(hal->micros() - start >= sweep.scanTimeout);
+  BOOST_TEST(hw.scans == 1);
+  BOOST_TEST(hw.frames.back()[0] == RADIOLIB_SX126X_CMD_SET_STANDBY);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,185 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+#include "RecordingRadio.hpp"
+
+#include "modules/SX126x/SX1262.h"
+#include "modules/SX128x/SX1280.h"
+
+// radio without a fast turnaround option, switches through standby
+class StandbyTurnaroundRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+
+    int16_t setFastTurnaround(bool enable) override {
+      (void)enable;
+      return(RADIOLIB_ERR_UNSUPPORTED);
+    }
+};
+
+// radio whose standby fails once the receiver was launched
+class FailingStandbyRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+    using SX1262::standby;
+    bool failStandby = false;
+
+    int16_t standby() override {
+      return(this->failStandby ? RADIOLIB_ERR_SPI_CMD_TIMEOUT : SX1262::standby());
+    }
+
+    int16_t launchMode() override {
+      bool rx = (this->stagedMode == RADIOLIB_RADIO_MODE_RX);
+      int16_t state = SX1262::launchMode();
+      this->failStandby = rx;
+      return(state);
+    }
+};
+
+static void setupLoRa(SX1262& radio) {
+  radio.spreadingFactor = 7;
+  radio.bandwidth = RADIOLIB_SX126X_LORA_BW_125_0;
+  radio.bandwidthKhz = 125.0f;
+  radio.codingRate = RADIOLIB_SX126X_LORA_CR_4_5;
+  radio.preambleLengthLoRa = 8;
+}
+
+BOOST_AUTO_TEST_SUITE(suite_Turnaround)
+
+BOOST_FIXTURE_TEST_CASE(Turnaround_fallbackFs, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test transmit-receive with FS fallback ---");
+  hal->spiLogEnabled = false;
+  RecordingRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  SX1262 radio(mod);
+  setupLoRa(radio);
+
+  // transmission and reception complete right away
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  uint8_t tx[4] = { 0x01, 0x02, 0x03, 0x04 };
+  uint8_t rx[4] = { 0 };
+  RadioLibTime_t turnaround = 0;
+  BOOST_TEST(radio.transmitReceive(tx, 4, NULL, 4, 100000) == RADIOLIB_ERR_NULL_POINTER);
+  hw.frames.clear();
+  BOOST_TEST(radio.transmitReceive(tx, 4, rx, 1, 100000, &turnaround) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(turnaround > 0);
+  BOOST_TEST(!radio.fastTurnaround);
+
+  // the radio falls back to FS and goes from transmit to receive without standby
+  int fallbackIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RX_TX_FALLBACK_MODE);
+  int txIdx = hw.find(RADIOLIB_SX126X_CMD_SET_TX);
+  int rxIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RX);
+  BOOST_TEST(fallbackIdx >= 0);
+  BOOST_TEST(hw.frames[fallbackIdx][1] == RADIOLIB_SX126X_RX_TX_FALLBACK_MODE_FS);
+  BOOST_TEST(txIdx > fallbackIdx);
+  BOOST_TEST(rxIdx > txIdx);
+  int standbyIdx = hw.find(RADIOLIB_SX126X_CMD_SET_STANDBY, txIdx);
+  BOOST_TEST(standbyIdx > rxIdx);
+
+  // afterwards, the fallback mode is set back to the standby mode the driver always configures
+  int restoreIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RX_TX_FALLBACK_MODE, rxIdx);
+  BOOST_TEST(restoreIdx > rxIdx);
+  BOOST_TEST(hw.frames[restoreIdx][1] == RADIOLIB_SX126X_RX_TX_FALLBACK_MODE_STDBY_RC);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(Turnaround_standby, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test transmit-receive through standby ---");
+  hal->spiLogEnabled = false;
+  RecordingRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  StandbyTurnaroundRadio radio(mod);
+  setupLoRa(radio);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  uint8_t tx[4] = { 0x01, 0x02, 0x03, 0x04 };
+  uint8_t rx[4] = { 0 };
+  BOOST_TEST(radio.transmitReceive(tx, 4, rx, 1, 100000) == RADIOLIB_ERR_NONE);
+
+  // the fallback mode is left alone, the transmission is finished by standby
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_RX_TX_FALLBACK_MODE) == 0);
+  int txIdx = hw.find(RADIOLIB_SX126X_CMD_SET_TX);
+  int rxIdx = hw.find(RADIOLIB_SX126X_CMD_SET_RX);
+  int standbyIdx = hw.find(RADIOLIB_SX126X_CMD_SET_STANDBY, txIdx);
+  BOOST_TEST(txIdx >= 0);
+  BOOST_TEST(standbyIdx > txIdx);
+  BOOST_TEST(rxIdx > standbyIdx);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(Turnaround_standbyError, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test transmit-receive with failing standby ---");
+  hal->spiLogEnabled = false;
+  RecordingRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  FailingStandbyRadio radio(mod);
+  setupLoRa(radio);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_OUTPUT);
+  hal->digitalWrite(EMULATED_RADIO_IRQ_PIN, TEST_HAL_HIGH);
+  hal->pinMode(EMULATED_RADIO_IRQ_PIN, TEST_HAL_INPUT);
+
+  // the error is reported, and the fast turnaround is still disabled
+  uint8_t tx[4] = { 0x01, 0x02, 0x03, 0x04 };
+  uint8_t rx[4] = { 0 };
+  BOOST_TEST(radio.transmitReceive(tx, 4, rx, 1, 100000) == RADIOLIB_ERR_SPI_CMD_TIMEOUT);
+  BOOST_TEST(!radio.fastTurnaround);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_RX_TX_FALLBACK_MODE) == 2);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(Turnaround_statusError, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test transmit-receive with a failing command ---");
+  hal->spiLogEnabled = false;
+  RecordingRadio hw;
+  hw.status = RADIOLIB_SX126X_STATUS_MODE_STDBY_RC | RADIOLIB_SX126X_STATUS_CMD_TIMEOUT;
+  hal->connectRadio(&hw);
+  setupSpiSX126x(mod);
+  SX1262 radio(mod);
+  setupLoRa(radio);
+
+  // the command status reported by the radio is not ignored
+  uint8_t tx[4] = { 0x01, 0x02, 0x03, 0x04 };
+  uint8_t rx[4] = { 0 };
+  BOOST_TEST(radio.transmitReceive(tx, 4, rx, 1, 100000) == RADIOLIB_ERR_SPI_CMD_TIMEOUT);
+  BOOST_TEST(hw.count(RADIOLIB_SX126X_CMD_SET_TX) == 0);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_FIXTURE_TEST_CASE(Turnaround_autoFsSX128x, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test SX128x fast turnaround ---");
+  hal->spiLogEnabled = false;
+  RecordingRadio hw;
+  hal->connectRadio(&hw);
+  setupSpiSX128x(mod);
+  SX1280 radio(mod);
+
+  // the synthesizer is kept running using the auto FS command
+  BOOST_TEST(radio.setFastTurnaround(true) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.setFastTurnaround(false) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(hw.frames.size() == 2);
+  BOOST_TEST(hw.frames[0].size() == 2);
+  BOOST_TEST(hw.frames[0][0] == RADIOLIB_SX128X_CMD_SET_AUTO_FS);
+  BOOST_TEST(hw.frames[0][1] == RADIOLIB_SX128X_AUTO_FS_ON);
+  BOOST_TEST(hw.frames[1][0] == RADIOLIB_SX128X_CMD_SET_AUTO_FS);
+  BOOST_TEST(hw.frames[1][1] == RADIOLIB_SX128X_AUTO_FS_OFF);
+
+  // errors reported by the radio are passed on
+  hw.status = RADIOLIB_SX128X_STATUS_MODE_STDBY_RC | RADIOLIB_SX128X_STATUS_CMD_FAILED;
+  BOOST_TEST(radio.setFastTurnaround(true) == RADIOLIB_ERR_SPI_CMD_FAILED);
+
+  hal->connectRadio(radioHardware);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+
+#include "ModuleFixture.hpp"
+
+#include "modules/SX126x/SX1262.h"
+
+// radio that records staged payloads and takes a fixed time to launch
+class ScheduleRadio : public SX1262 {
+  public:
+    using SX1262::SX1262;
+
+    size_t stagedLen = 0;
+    int launches = 0;
+
+    int16_t stageMode(RadioModeType_t mode, RadioModeConfig_t* cfg) override {
+      if((mode != RADIOLIB_RADIO_MODE_TX) && (mode != RADIOLIB_RADIO_MODE_RX)) {
+        return(RADIOLIB_ERR_UNSUPPORTED);
+      }
+      if(mode == RADIOLIB_RADIO_MODE_TX) {
+        this->stagedLen = cfg->transmit.len;
+      }
+      this->stagedMode = mode;
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    int16_t launchMode() override {
+      this->getMod()->hal->delayMicroseconds(200);
+      launches++;
+      this->stagedMode = RADIOLIB_RADIO_MODE_NONE;
+      return(RADIOLIB_ERR_NONE);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite_TxSchedule, ModuleFixture)
+
+BOOST_FIXTURE_TEST_CASE(TxSchedule_jitter, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test scheduled transmission ---");
+  hal->spiLogEnabled = false;
+  ScheduleRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+  uint8_t data[16] = { 0 };
+
+  // nothing to launch yet
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_TX_NOT_SCHEDULED);
+  BOOST_TEST(phy->getTimeUntilScheduled() == 0);
+
+  // the payload is staged right away, the launch waits for the deadline
+  RadioLibTime_t start = hal->micros() + 5000;
+  BOOST_TEST(phy->scheduleTransmit(data, sizeof(data), start) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.stagedLen == sizeof(data));
+  BOOST_TEST(radio.launches == 0);
+  BOOST_TEST(phy->getTimeUntilScheduled() > 0);
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.launches == 1);
+  BOOST_TEST(hal->micros() >= start);
+
+  // the first launch is late by its own latency, which is compensated afterwards
+  RadioLibTxJitter_t jitter = phy->getTxJitter();
+  BOOST_TEST(jitter.count == 1);
+  BOOST_TEST(jitter.latency >= 200);
+  BOOST_TEST(jitter.last >= (int32_t)jitter.latency);
+  BOOST_TEST_MESSAGE("First jitter: " << jitter.last << " us");
+
+  start = hal->micros() + 5000;
+  BOOST_TEST(phy->scheduleTransmit(data, 4, start) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_NONE);
+  jitter = phy->getTxJitter();
+  BOOST_TEST_MESSAGE("Second jitter: " << jitter.last << " us");
+  BOOST_TEST(jitter.count == 2);
+  BOOST_TEST(jitter.min == jitter.last);
+  BOOST_TEST(jitter.max >= jitter.min);
+
+  // a scheduled transmission is launched only once
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_TX_NOT_SCHEDULED);
+
+  phy->resetTxJitter();
+  jitter = phy->getTxJitter();
+  BOOST_TEST(jitter.count == 0);
+  BOOST_TEST(jitter.latency >= 200);
+}
+
+BOOST_FIXTURE_TEST_CASE(TxSchedule_deadlines, ModuleFixture) {
+  BOOST_TEST_MESSAGE("--- Test scheduled transmission deadlines ---");
+  hal->spiLogEnabled = false;
+  ScheduleRadio radio(mod);
+  PhysicalLayer* phy = &radio;
+  uint8_t data[16] = { 0 };
+
+  // a deadline an hour ahead is not overdue
+  RadioLibTime_t hour = (RadioLibTime_t)3600 * 1000000UL;
+  BOOST_TEST(phy->scheduleTransmit(data, sizeof(data), hal->micros() + hour) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->getTimeUntilScheduled() > hour - 1000000UL);
+  BOOST_TEST(phy->getTimeUntilScheduled() <= hour);
+
+  // a deadline that already passed is launched right away
+  BOOST_TEST(phy->scheduleTransmit(data, sizeof(data), hal->micros() - 1000) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->getTimeUntilScheduled() == 0);
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_NONE);
+  BOOST_TEST(radio.launches == 1);
+
+  // staging reception cancels the scheduled transmission
+  BOOST_TEST(phy->scheduleTransmit(data, sizeof(data), hal->micros() + 5000) == RADIOLIB_ERR_NONE);
+  RadioModeConfig_t cfg = { .receive = { .timeout = 0, .irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS, .irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK, .len = 0 } };
+  BOOST_TEST(phy->stageMode(RADIOLIB_RADIO_MODE_RX, &cfg) == RADIOLIB_ERR_NONE);
+  BOOST_TEST(phy->getTimeUntilScheduled() == 0);
+  BOOST_TEST(phy->launchScheduled() == RADIOLIB_ERR_TX_NOT_SCHEDULED);
+  BOOST_TEST(radio.launches == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
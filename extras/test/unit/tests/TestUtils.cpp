@@ -0,0 +1,40 @@
+// boost test header
+#include <boost/test/unit_test.hpp>
+
+// the utils header
+#include "utils/Utils.h"
+
+BOOST_AUTO_TEST_SUITE(suite_Utils)
+
+BOOST_AUTO_TEST_CASE(Utils_popcount) {
+  BOOST_TEST_MESSAGE("--- Test Utils::popcount ---");
+  BOOST_TEST(rlb_popcount(0x00000000UL) == 0);
+  BOOST_TEST(rlb_popcount(0x00000001UL) == 1);
+  BOOST_TEST(rlb_popcount(0x0000FFFFUL) == 16);
+  BOOST_TEST(rlb_popcount(0x80000001UL) == 2);
+  BOOST_TEST(rlb_popcount(0xFFFFFFFFUL) == 32);
+}
+
+BOOST_AUTO_TEST_CASE(Utils_select_bit) {
+  BOOST_TEST_MESSAGE("--- Test Utils::select_bit ---");
+  BOOST_TEST(rlb_select_bit(0x00000000UL, 0) == -1);
+  BOOST_TEST(rlb_select_bit(0x00000001UL, 0) == 0);
+  BOOST_TEST(rlb_select_bit(0x00000001UL, 1) == -1);
+  BOOST_TEST(rlb_select_bit(0x0000A410UL, 0) == 4);
+  BOOST_TEST(rlb_select_bit(0x0000A410UL, 1) == 10);
+  BOOST_TEST(rlb_select_bit(0x0000A410UL, 2) == 13);
+  BOOST_TEST(rlb_select_bit(0x0000A410UL, 3) == 15);
+  BOOST_TEST(rlb_select_bit(0x80000000UL, 0) == 31);
+
+  // every set bit must be reachable exactly once and in order
+  uint32_t in = 0x5A3C00F1UL;
+  int8_t last = -1;
+  for(uint8_t n = 0; n < rlb_popcount(in); n++) {
+    int8_t pos = rlb_select_bit(in, n);
+    BOOST_TEST(pos > last);
+    BOOST_TEST((in & (1UL << pos)) != 0);
+    last = pos;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -106,6 +106,43 @@
   #define RADIOLIB_STATIC_ARRAY_SIZE   (256)
 #endif
 
+// set the size of the direct mode receive buffer, must be a power of 2
+// one byte is always kept free to tell a full buffer from an empty one
+#if !defined(RADIOLIB_DIRECT_BUFFER_SIZE)
+  #define RADIOLIB_DIRECT_BUFFER_SIZE   (256)
+#endif
+
+// maximum number of sync words that are searched for at the same time in direct mode
+#if !defined(RADIOLIB_DIRECT_SYNC_WORDS_NUM)
+  #define RADIOLIB_DIRECT_SYNC_WORDS_NUM  (2)
+#endif
+
+// number of packets in the receive queue of PhysicalLayer, the queue is not built when set to 0
+// the queue is filled from the packet received interrupt, see PhysicalLayer::startReceiveQueued
+#if !defined(RADIOLIB_RX_QUEUE_LEN)
+  #define RADIOLIB_RX_QUEUE_LEN   (0)
+#endif
+
+// size of the payload pool of the receive queue, in bytes
+#if !defined(RADIOLIB_RX_QUEUE_POOL_SIZE)
+  #define RADIOLIB_RX_QUEUE_POOL_SIZE   (RADIOLIB_STATIC_ARRAY_SIZE)
+#endif
+
+// C++20 coroutine interface of AwaitableClient, only supported on Linux
+#if !defined(RADIOLIB_AWAITABLE)
+  #define RADIOLIB_AWAITABLE    (0)
+#endif
+
+// maximum number of radios that can be used with coroutines at the same time
+#if !defined(RADIOLIB_AWAITABLE_NUM_RADIOS)
+  #define RADIOLIB_AWAITABLE_NUM_RADIOS   (4)
+#endif
+
+// time added to the expected duration of an operation before it is aborted, in milliseconds
+#if !defined(RADIOLIB_AWAITABLE_GUARD_MS)
+  #define RADIOLIB_AWAITABLE_GUARD_MS   (100)
+#endif
+
 // allow user to set custom SPI buffer size
 // the default covers the maximum supported SPI command, address and status
 #if !defined(RADIOLIB_STATIC_SPI_ARRAY_SIZE)
@@ -135,6 +172,25 @@
   #define RADIOLIB_CUSTOM_AES128  (0)
 #endif
 
+/*
+ * Keep the interrupt flags of LoRaWAN nodes and the timestamped actions of PhysicalLayer per thread.
+ * This is only useful on hosts that run many LoRaWANNode instances in parallel threads
+ * on top of virtual radios, which signal interrupts from the thread driving the node (e.g. simulations).
+ * Do not enable this on microcontrollers, as the flags would not be shared with interrupt handlers.
+ */
+#if !defined(RADIOLIB_LORAWAN_THREAD_LOCAL)
+  #define RADIOLIB_LORAWAN_THREAD_LOCAL  (0)
+#endif
+
+/*
+ * Worst-case drift of the host clock in ppm, after correction by the drift measured from LoRaWAN Class B beacons.
+ * Class B receive windows are widened by this much for every millisecond since the last beacon.
+ * Typical crystals are well within 20 ppm, internal RC oscillators of some microcontrollers need much more.
+ */
+#if !defined(RADIOLIB_LORAWAN_CLOCK_DRIFT_PPM)
+  #define RADIOLIB_LORAWAN_CLOCK_DRIFT_PPM  (20)
+#endif
+
 #if !defined(RADIOLIB_LINE_FEED)
   #define RADIOLIB_LINE_FEED    "\r\n"
 #endif
@@ -40,6 +40,10 @@ uint32_t RadioLibHal::pinToInterrupt(uint32_t pin) {
   return(pin);
 }
 
+RadioLibTime_t RadioLibHal::irqMicros() {
+  return(this->micros());
+}
+
 void RadioLibHal::pullUpDown(uint32_t pin, bool enable, bool up) {
   // the default implementation does nothing
   (void)pin;
@@ -226,6 +226,13 @@ class RadioLibHal {
     */
     virtual uint32_t pinToInterrupt(uint32_t pin);
 
+    /*!
+      \brief Get the time of the radio interrupt that is currently being handled.
+      Platforms with a capture timer on the interrupt pin can override this to return the captured edge time.
+      \returns Time in microseconds, in the same timebase as micros. By default, the current micros value.
+    */
+    virtual RadioLibTime_t irqMicros();
+
     /*!
       \brief Enable or disable pull up or pull down for a specific pin.
       \param pin Pin to change.
@@ -84,6 +84,7 @@
 #include "modules/LR11x0/LR1110.h"
 #include "modules/LR11x0/LR1120.h"
 #include "modules/LR11x0/LR1121.h"
+#include "modules/LR11x0/LR11x0_AES128.h"
 #include "modules/LR2021/LR2021.h"
 #include "modules/nRF24/nRF24.h"
 #include "modules/RF69/RF69.h"
@@ -98,6 +99,7 @@
 #include "modules/SX126x/SX1262.h"
 #include "modules/SX126x/SX1268.h"
 #include "modules/SX126x/STM32WLx.h"
+#include "modules/SX126x/SX126x_SpectrumSweep.h"
 #include "modules/SX127x/SX1272.h"
 #include "modules/SX127x/SX1273.h"
 #include "modules/SX127x/SX1276.h"
@@ -124,7 +126,11 @@
 #include "protocols/BellModem/BellModem.h"
 #include "protocols/LoRaWAN/LoRaWAN.h"
 #include "protocols/LoRaWAN/LoRaWANPacMan.h"
+#include "protocols/LoRaWAN/LoRaWANPackageTS004.h"
+#include "protocols/LoRaWAN/LoRaWANPackageTS005.h"
+#include "protocols/LoRaWAN/LoRaWANJournal.h"
 #include "protocols/ADSB/ADSB.h"
+#include "protocols/Awaitable/Awaitable.h"
 
 // utilities
 #include "utils/CRC.h"
@@ -265,6 +265,16 @@
 */
 #define RADIOLIB_ERR_PACKET_TOO_SHORT                          (-30)
 
+/*!
+  \brief There is no packet in the receive queue.
+*/
+#define RADIOLIB_ERR_QUEUE_EMPTY                               (-31)
+
+/*!
+  \brief There is no scheduled transmission to launch.
+*/
+#define RADIOLIB_ERR_TX_NOT_SCHEDULED                          (-32)
+
 // RF69-specific status codes
 
 /*!
@@ -613,6 +623,27 @@
 */
 #define RADIOLIB_ERR_INVALID_MULTICAST_GROUP                    (-1122)
 
+/*!
+  \brief A non-blocking uplink/downlink sequence is in progress.
+*/
+#define RADIOLIB_LORAWAN_SEQUENCE_BUSY                          (-1123)
+
+/*!
+  \brief No Class B beacon was received or tracking was lost; check that the network server and gateways support Class B.
+*/
+#define RADIOLIB_ERR_NO_BEACON                                  (-1124)
+
+/*!
+  \brief Unable to queue uplink record because the uplink queue is full.
+*/
+#define RADIOLIB_ERR_UPLINK_QUEUE_FULL                          (-1125)
+
+/*!
+  \brief No queued uplink record is due yet, so nothing was sent. This is not a failure,
+  so the value is positive, above all downlink window numbers returned along with it.
+*/
+#define RADIOLIB_LORAWAN_QUEUE_WAITING                          (1126)
+
 // LR11x0-specific status codes
 
 /*!
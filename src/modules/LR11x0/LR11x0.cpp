@@ -483,6 +483,17 @@ int16_t LR11x0::readData(uint8_t* data, size_t len) {
   return(state);
 }
 
+int16_t LR11x0::peekData(uint8_t* data, size_t len) {
+  // get Rx buffer offset, but do not touch the Rx buffer or the interrupt flags
+  uint8_t offset = 0;
+  size_t length = getPacketLength(true, &offset);
+  if(len > length) {
+    len = length;
+  }
+
+  return(readBuffer8(data, len, offset));
+}
+
 int16_t LR11x0::finishReceive() {
   // set mode to standby to disable RF switch
   int16_t state = standby();
@@ -1258,6 +1269,15 @@ int16_t LR11x0::explicitHeader() {
   return(this->setHeaderType(RADIOLIB_LRXXXX_LORA_HEADER_EXPLICIT));
 }
 
+int16_t LR11x0::setLoRaHeader(size_t len, bool crc) {
+  int16_t state = this->setCRC(crc ? 2 : 0);
+  RADIOLIB_ASSERT(state);
+  if(len == 0) {
+    return(this->explicitHeader());
+  }
+  return(this->implicitHeader(len));
+}
+
 int16_t LR11x0::setRegulatorLDO() {
   return(this->setRegMode(RADIOLIB_LR11X0_REG_MODE_LDO));
 }
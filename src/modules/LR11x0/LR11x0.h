@@ -260,6 +260,16 @@ class LR11x0: public LRxxxx {
     */
     int16_t readData(uint8_t* data, size_t len) override;
 
+    /*!
+      \brief Reads the start of a received packet without clearing the interrupt flags,
+      readData can still be called afterwards.
+      \param data Pointer to array to save the received binary data.
+      \param len Number of bytes that will be read. When more bytes than received are requested,
+      only the received bytes will be read.
+      \returns \ref status_codes
+    */
+    int16_t peekData(uint8_t* data, size_t len) override;
+
     /*!
       \brief Clean up after reception is done.
       \returns \ref status_codes
@@ -490,7 +500,7 @@ class LR11x0: public LRxxxx {
       \brief Gets frequency error of the latest received packet.
       \returns Frequency error in Hz.
     */
-    float getFrequencyError();
+    float getFrequencyError() override;
 
     /*!
       \brief Query modem for the packet length of received payload.
@@ -561,6 +571,14 @@ class LR11x0: public LRxxxx {
     */
     int16_t explicitHeader();
 
+    /*!
+      \brief Set LoRa header mode and payload CRC in a single call.
+      \param len Payload length for implicit header mode, 0 to use explicit header mode.
+      \param crc Whether the payload CRC is enabled.
+      \returns \ref status_codes
+    */
+    int16_t setLoRaHeader(size_t len, bool crc) override;
+
     /*!
       \brief Set regulator mode to LDO.
       \returns \ref status_codes
@@ -791,6 +809,9 @@ class LR11x0: public LRxxxx {
 #if !RADIOLIB_GODMODE && !RADIOLIB_LOW_LEVEL
   protected:
 #endif
+    // the AES-128 engine uses the crypto methods
+    friend class LR11x0AES128;
+
     Module* getMod() override;
 
     // method that applies some magic workaround for specific bitrate, frequency deviation,
@@ -0,0 +1,110 @@
+#include "LR11x0_AES128.h"
+
+#include <string.h>
+
+#if !RADIOLIB_EXCLUDE_LR11X0
+
+// largest number of whole blocks that fit into a single crypto engine command
+#define RADIOLIB_LR11X0_AES128_MAX_CHUNK  (((RADIOLIB_LR11X0_SPI_MAX_READ_WRITE_LEN - 1) / RADIOLIB_AES128_BLOCK_SIZE) * RADIOLIB_AES128_BLOCK_SIZE)
+
+LR11x0AES128::LR11x0AES128(LR11x0* radio, uint8_t keyId) {
+  this->radio = radio;
+  this->defaultKeyId = keyId;
+  this->keyId = keyId;
+}
+
+void LR11x0AES128::init(uint8_t* key) {
+  // bound keys are already in the crypto engine
+  for(int i = 0; i < RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS; i++) {
+    if(this->boundKeys[i] == key) {
+      this->keyId = this->boundKeyIds[i];
+      return;
+    }
+  }
+
+  this->keyId = this->defaultKeyId;
+  int16_t state = this->radio->cryptoSetKey(this->keyId, key);
+  if(state != RADIOLIB_ERR_NONE) {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("Failed to set crypto engine key, code %d", state);
+  }
+}
+
+size_t LR11x0AES128::encryptECB(const uint8_t* in, size_t len, uint8_t* out) {
+  return(this->processECB(true, in, len, out));
+}
+
+size_t LR11x0AES128::decryptECB(const uint8_t* in, size_t len, uint8_t* out) {
+  return(this->processECB(false, in, len, out));
+}
+
+void LR11x0AES128::generateMIC(const uint8_t* in, size_t len, uint8_t* mic) {
+  // the crypto engine can only take a limited amount of data at once
+  uint32_t micEngine = 0;
+  if((len < RADIOLIB_LR11X0_SPI_MAX_READ_WRITE_LEN) && (this->radio->cryptoComputeAesCmac(this->keyId, in, len, &micEngine) == RADIOLIB_ERR_NONE)) {
+    mic[0] = (uint8_t)((micEngine >> 24) & 0xFF);
+    mic[1] = (uint8_t)((micEngine >> 16) & 0xFF);
+    mic[2] = (uint8_t)((micEngine >> 8) & 0xFF);
+    mic[3] = (uint8_t)(micEngine & 0xFF);
+    return;
+  }
+
+  // fall back to CMAC from encrypted blocks
+  RadioLibAES128::generateMIC(in, len, mic);
+}
+
+bool LR11x0AES128::bindKey(const uint8_t* key, uint8_t keyId) {
+  // the default slot is overwritten by keys that are not bound
+  if(!key || (keyId == this->defaultKeyId)) {
+    return(false);
+  }
+
+  int16_t state = this->radio->cryptoSetKey(keyId, key);
+  if(state != RADIOLIB_ERR_NONE) {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("Failed to bind crypto engine key %d, code %d", keyId, state);
+    return(false);
+  }
+
+  // replace any previous binding of the buffer or the slot
+  int free = -1;
+  for(int i = 0; i < RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS; i++) {
+    if((this->boundKeys[i] == key) || ((this->boundKeys[i] != nullptr) && (this->boundKeyIds[i] == keyId))) {
+      this->boundKeys[i] = nullptr;
+    }
+    if((this->boundKeys[i] == nullptr) && (free < 0)) {
+      free = i;
+    }
+  }
+  if(free < 0) {
+    return(false);
+  }
+  this->boundKeys[free] = key;
+  this->boundKeyIds[free] = keyId;
+  return(true);
+}
+
+size_t LR11x0AES128::processECB(bool encrypt, const uint8_t* in, size_t len, uint8_t* out) {
+  size_t pos = 0;
+  while(pos < len) {
+    size_t chunk = RADIOLIB_MIN(len - pos, (size_t)RADIOLIB_LR11X0_AES128_MAX_CHUNK);
+    size_t chunkPadded = ((chunk + RADIOLIB_AES128_BLOCK_SIZE - 1) / RADIOLIB_AES128_BLOCK_SIZE) * RADIOLIB_AES128_BLOCK_SIZE;
+
+    // the last block is padded with zeros, same as the software implementation
+    uint8_t buff[RADIOLIB_LR11X0_AES128_MAX_CHUNK] = { 0 };
+    memcpy(buff, &in[pos], chunk);
+
+    int16_t state;
+    if(encrypt) {
+      state = this->radio->cryptoAesEncrypt(this->keyId, buff, chunkPadded, &out[pos]);
+    } else {
+      state = this->radio->cryptoAesDecrypt(this->keyId, buff, chunkPadded, &out[pos]);
+    }
+    if(state != RADIOLIB_ERR_NONE) {
+      RADIOLIB_DEBUG_BASIC_PRINTLN("Crypto engine AES failed, code %d", state);
+      return(0);
+    }
+    pos += chunkPadded;
+  }
+  return(pos);
+}
+
+#endif
@@ -0,0 +1,92 @@
+#if !defined(_RADIOLIB_LR11X0_AES128_H)
+#define _RADIOLIB_LR11X0_AES128_H
+
+#include "../../TypeDef.h"
+
+#if !RADIOLIB_EXCLUDE_LR11X0
+
+#include "../../utils/Cryptography.h"
+#include "LR11x0.h"
+
+// number of key buffers that can be bound to key slots of the crypto engine
+#if !defined(RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS)
+  #define RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS                 (8)
+#endif
+
+/*!
+  \class LR11x0AES128
+  \brief AES-128 engine on top of the crypto engine of %LR11x0 devices.
+  Keys are held in the key slots of the crypto engine; keys bound to a slot by bindKey
+  are transferred to the device only once. The engine computes the MIC directly,
+  the full CMAC is calculated from ECB blocks encrypted by the device.
+  To use it, set RadioLibHal::aes128 to an instance of this class after the LoRaWANNode was created.
+*/
+class LR11x0AES128: public RadioLibAES128 {
+  public:
+    /*!
+      \brief Default constructor.
+      \param radio Pointer to the %LR11x0 radio that provides the crypto engine.
+      \param keyId Key slot used for keys that are not bound to a slot. Defaults to general purpose key 0.
+    */
+    LR11x0AES128(LR11x0* radio, uint8_t keyId = RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0);
+
+    /*!
+      \brief Initialize the AES. Bound keys select their key slot, other keys are written to the default slot.
+      \param key AES key to use.
+    */
+    void init(uint8_t* key) override;
+
+    /*!
+      \brief Perform ECB-type AES encryption.
+      \param in Input plaintext data (unpadded).
+      \param len Length of the input data.
+      \param out Buffer to save the output ciphertext into. It is up to the caller
+      to ensure the buffer is sufficiently large to save the data!
+      \returns The number of bytes saved into the output buffer, 0 if the crypto engine failed.
+    */
+    size_t encryptECB(const uint8_t* in, size_t len, uint8_t* out) override;
+
+    /*!
+      \brief Perform ECB-type AES decryption.
+      \param in Input ciphertext data.
+      \param len Length of the input data.
+      \param out Buffer to save the output plaintext into. It is up to the caller
+      to ensure the buffer is sufficiently large to save the data!
+      \returns The number of bytes saved into the output buffer, 0 if the crypto engine failed.
+    */
+    size_t decryptECB(const uint8_t* in, size_t len, uint8_t* out) override;
+
+    /*!
+      \brief Calculate the 4-byte MIC in the crypto engine.
+      \param in Input data (unpadded).
+      \param len Length of the input data.
+      \param mic Buffer to save the 4-byte MIC into.
+    */
+    void generateMIC(const uint8_t* in, size_t len, uint8_t* mic) override;
+
+    /*!
+      \brief Store a key in a key slot of the crypto engine.
+      \param key Key buffer to bind. If its contents change, the key must be bound again.
+      \param keyId Key slot in the crypto engine, e.g. RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S.
+      Must not be the slot used for keys that are not bound.
+      \returns True if the key was stored in the engine, false otherwise.
+    */
+    bool bindKey(const uint8_t* key, uint8_t keyId) override;
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    LR11x0* radio;
+    uint8_t defaultKeyId;
+    uint8_t keyId;
+
+    // key buffers bound to key slots
+    const uint8_t* boundKeys[RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS] = { nullptr };
+    uint8_t boundKeyIds[RADIOLIB_LR11X0_AES128_NUM_BOUND_KEYS] = { 0 };
+
+    size_t processECB(bool encrypt, const uint8_t* in, size_t len, uint8_t* out);
+};
+
+#endif
+
+#endif
@@ -577,6 +577,22 @@
 #define RADIOLIB_LR11X0_CRYPTO_STATUS_BUF_SIZE                  (0x05UL << 0)   //  7     0                           data buffer size invalid
 #define RADIOLIB_LR11X0_CRYPTO_STATUS_ERROR                     (0x06UL << 0)   //  7     0                           generic error
 
+// RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_MOTHER                    (1)             //  7     0     crypto engine key ID: mother key
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_NWK                       (2)             //  7     0                           NwkKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP                       (3)             //  7     0                           AppKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_J_S_ENC                   (4)             //  7     0                           JSEncKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_J_S_INT                   (5)             //  7     0                           JSIntKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP_KE_0                   (6)             //  7     0                           general purpose key encryption keys 0 - 5
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_APP_S                     (12)            //  7     0                           AppSKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_F_NWK_S_INT               (13)            //  7     0                           FNwkSIntKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_S_NWK_S_INT               (14)            //  7     0                           SNwkSIntKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_NWK_S_ENC                 (15)            //  7     0                           NwkSEncKey
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_MC_APP_S_0                (27)            //  7     0                           multicast McAppSKey 0 - 3
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_MC_NWK_S_0                (31)            //  7     0                           multicast McNwkSKey 0 - 3
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP0                       (35)            //  7     0                           general purpose key 0
+#define RADIOLIB_LR11X0_CRYPTO_KEY_ID_GP1                       (36)            //  7     0                           general purpose key 1
+
 // RADIOLIB_LR11X0_CMD_CRYPTO_PROCESS_JOIN_ACCEPT
 #define RADIOLIB_LR11X0_CRYPTO_LORAWAN_VERSION_1_0              (0x00UL << 0)   //  7     0     LoRaWAN version: 1.0.x
 #define RADIOLIB_LR11X0_CRYPTO_LORAWAN_VERSION_1_1              (0x01UL << 0)   //  7     0                      1.1
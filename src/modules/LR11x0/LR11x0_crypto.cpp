@@ -9,19 +9,37 @@
 
 int16_t LR11x0::cryptoSetKey(uint8_t keyId, const uint8_t* key) {
   RADIOLIB_ASSERT_PTR(key);
-  uint8_t buff[1 + RADIOLIB_AES128_KEY_SIZE] = { 0 };
-  buff[0] = keyId;
-  memcpy(&buff[1], key, RADIOLIB_AES128_KEY_SIZE);
-  return(this->SPIcommand(RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY, false, buff, sizeof(buff)));
+  uint8_t reqBuff[1 + RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t rplBuff[1] = { 0 };
+  reqBuff[0] = keyId;
+  memcpy(&reqBuff[1], key, RADIOLIB_AES128_KEY_SIZE);
+  int16_t state = this->SPIcommand(RADIOLIB_LR11X0_CMD_CRYPTO_SET_KEY, false, rplBuff, sizeof(rplBuff), reqBuff, sizeof(reqBuff));
+  RADIOLIB_ASSERT(state);
+
+  // check the crypto engine state
+  if(rplBuff[0] != RADIOLIB_LR11X0_CRYPTO_STATUS_SUCCESS) {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("Crypto Engine error: %02x", rplBuff[0]);
+    return(RADIOLIB_ERR_SPI_CMD_FAILED);
+  }
+  return(state);
 }
 
 int16_t LR11x0::cryptoDeriveKey(uint8_t srcKeyId, uint8_t dstKeyId, const uint8_t* key) {
   RADIOLIB_ASSERT_PTR(key);
-  uint8_t buff[2 + RADIOLIB_AES128_KEY_SIZE] = { 0 };
-  buff[0] = srcKeyId;
-  buff[1] = dstKeyId;
-  memcpy(&buff[2], key, RADIOLIB_AES128_KEY_SIZE);
-  return(this->SPIcommand(RADIOLIB_LR11X0_CMD_CRYPTO_DERIVE_KEY, false, buff, sizeof(buff)));
+  uint8_t reqBuff[2 + RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t rplBuff[1] = { 0 };
+  reqBuff[0] = srcKeyId;
+  reqBuff[1] = dstKeyId;
+  memcpy(&reqBuff[2], key, RADIOLIB_AES128_KEY_SIZE);
+  int16_t state = this->SPIcommand(RADIOLIB_LR11X0_CMD_CRYPTO_DERIVE_KEY, false, rplBuff, sizeof(rplBuff), reqBuff, sizeof(reqBuff));
+  RADIOLIB_ASSERT(state);
+
+  // check the crypto engine state
+  if(rplBuff[0] != RADIOLIB_LR11X0_CRYPTO_STATUS_SUCCESS) {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("Crypto Engine error: %02x", rplBuff[0]);
+    return(RADIOLIB_ERR_SPI_CMD_FAILED);
+  }
+  return(state);
 }
 
 int16_t LR11x0::cryptoProcessJoinAccept(uint8_t decKeyId, uint8_t verKeyId, uint8_t lwVer, const uint8_t* header, const uint8_t* dataIn, size_t len, uint8_t* dataOut) {
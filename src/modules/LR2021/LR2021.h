@@ -766,6 +766,14 @@ class LR2021: public LRxxxx {
     */
     int16_t explicitHeader();
 
+    /*!
+      \brief Set LoRa header mode and payload CRC in a single call.
+      \param len Payload length for implicit header mode, 0 to use explicit header mode.
+      \param crc Whether the payload CRC is enabled.
+      \returns \ref status_codes
+    */
+    int16_t setLoRaHeader(size_t len, bool crc) override;
+
     /*!
       \brief Set OOK detector properties. The default values are set to allow ADS-B reception.
       \param pattern Preamble pattern, should end with 01 or 10 (binary).
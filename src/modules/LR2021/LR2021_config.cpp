@@ -1034,6 +1034,15 @@ int16_t LR2021::explicitHeader() {
   return(this->setLoRaHeaderType(RADIOLIB_LRXXXX_LORA_HEADER_EXPLICIT));
 }
 
+int16_t LR2021::setLoRaHeader(size_t len, bool crc) {
+  int16_t state = this->setCRC(crc ? 2 : 0);
+  RADIOLIB_ASSERT(state);
+  if(len == 0) {
+    return(this->explicitHeader());
+  }
+  return(this->implicitHeader(len));
+}
+
 int16_t LR2021::setNodeAddress(uint8_t nodeAddr) {
   // check active modem
   uint8_t type = RADIOLIB_LR2021_PACKET_TYPE_NONE;
@@ -574,6 +574,17 @@ int16_t SX126x::readData(uint8_t* data, size_t len) {
   return(state);
 }
 
+int16_t SX126x::peekData(uint8_t* data, size_t len) {
+  // get Rx buffer offset, but do not touch the interrupt flags
+  uint8_t offset = 0;
+  size_t length = getPacketLength(true, &offset);
+  if(len > length) {
+    len = length;
+  }
+
+  return(readBuffer(data, len, offset));
+}
+
 int16_t SX126x::startChannelScan() {
   ChannelScanConfig_t cfg = {
     .cad = {
@@ -948,6 +959,13 @@ int16_t SX126x::getModem(ModemType_t* modem) {
 int16_t SX126x::stageMode(RadioModeType_t mode, RadioModeConfig_t* cfg) {
   int16_t state;
 
+  // switch the modem first, packet parameters are written below anyway
+  if(this->stagedProfile) {
+    state = writeProfile(this->stagedProfile, (mode != RADIOLIB_RADIO_MODE_RX) && (mode != RADIOLIB_RADIO_MODE_TX));
+    this->stagedProfile = NULL;
+    RADIOLIB_ASSERT(state);
+  }
+
   switch(mode) {
     case(RADIOLIB_RADIO_MODE_RX): {
       // in implicit header mode, use the provided length if it is nonzero
@@ -956,9 +974,11 @@ int16_t SX126x::stageMode(RadioModeType_t mode, RadioModeConfig_t* cfg) {
         this->implicitLen = cfg->receive.len;
       }
 
-      // ensure we are in standby
-      state = standby();
-      RADIOLIB_ASSERT(state);
+      // ensure we are in standby, unless the radio fell back to FS after transmission
+      if(!this->fastTurnaround) {
+        state = standby();
+        RADIOLIB_ASSERT(state);
+      }
 
       // set DIO mapping
       if(cfg->receive.timeout != RADIOLIB_SX126X_RX_TIMEOUT_INF) {
@@ -1131,6 +1151,204 @@ int16_t SX126x::launchMode() {
   return(state);
 }
 
+int16_t SX126x::setFastTurnaround(bool enable) {
+  // when disabled, fall back to the same standby mode as configured by setPacketMode and setStandbyXOSC
+  uint8_t mode = RADIOLIB_SX126X_RX_TX_FALLBACK_MODE_FS;
+  if(!enable) {
+    mode = this->standbyXOSC ? RADIOLIB_SX126X_RX_TX_FALLBACK_MODE_STDBY_XOSC : RADIOLIB_SX126X_RX_TX_FALLBACK_MODE_STDBY_RC;
+  }
+  int16_t state = this->mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_RX_TX_FALLBACK_MODE, &mode, 1);
+  RADIOLIB_ASSERT(state);
+  this->fastTurnaround = enable;
+  return(state);
+}
+
+int16_t SX126x::compileProfile(SX126xProfile* profile) {
+  if(!profile) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  int16_t state = RADIOLIB_ERR_NONE;
+  uint8_t modem = getPacketType();
+  switch(modem) {
+    case(RADIOLIB_SX126X_PACKET_TYPE_LORA): {
+      const uint8_t modParams[] = { this->spreadingFactor, this->bandwidth, this->codingRate, this->ldrOptimize };
+      memcpy(profile->modParams, modParams, sizeof(modParams));
+      profile->modParamsLen = sizeof(modParams);
+      const uint8_t packetParams[] = { (uint8_t)((this->preambleLengthLoRa >> 8) & 0xFF), (uint8_t)(this->preambleLengthLoRa & 0xFF),
+        this->headerType, (uint8_t)this->implicitLen, this->crcTypeLoRa, this->invertIQEnabled };
+      memcpy(profile->packetParams, packetParams, sizeof(packetParams));
+      profile->packetParamsLen = sizeof(packetParams);
+
+      // sync word and errata fixes
+      state = readRegister(RADIOLIB_SX126X_REG_LORA_SYNC_WORD_MSB, &profile->regs[0], 2);
+      RADIOLIB_ASSERT(state);
+      state = readRegister(RADIOLIB_SX126X_REG_IQ_CONFIG, &profile->regs[2], 1);
+      RADIOLIB_ASSERT(state);
+      state = readRegister(RADIOLIB_SX126X_REG_SENSITIVITY_CONFIG, &profile->regs[3], 1);
+      RADIOLIB_ASSERT(state);
+
+      profile->spreadingFactor = this->spreadingFactor;
+      profile->codingRate = this->codingRate;
+      profile->ldrOptimize = this->ldrOptimize;
+      profile->crcTypeLoRa = this->crcTypeLoRa;
+      profile->headerType = this->headerType;
+      profile->bandwidth = this->bandwidth;
+      profile->preambleLengthLoRa = this->preambleLengthLoRa;
+      profile->bandwidthKhz = this->bandwidthKhz;
+      profile->ldroAuto = this->ldroAuto;
+      profile->invertIQEnabled = this->invertIQEnabled;
+    } break;
+
+    case(RADIOLIB_SX126X_PACKET_TYPE_GFSK):
+    case(RADIOLIB_SX126X_PACKET_TYPE_LR_FHSS): {
+      const uint8_t modParams[] = { (uint8_t)((this->bitRate >> 16) & 0xFF), (uint8_t)((this->bitRate >> 8) & 0xFF), (uint8_t)(this->bitRate & 0xFF),
+        this->pulseShape, this->rxBandwidth,
+        (uint8_t)((this->frequencyDev >> 16) & 0xFF), (uint8_t)((this->frequencyDev >> 8) & 0xFF), (uint8_t)(this->frequencyDev & 0xFF) };
+      memcpy(profile->modParams, modParams, sizeof(modParams));
+      profile->modParamsLen = sizeof(modParams);
+
+      // the packet engine is disabled in LR-FHSS mode
+      memset(profile->packetParams, 0, sizeof(profile->packetParams));
+      profile->packetParamsLen = sizeof(profile->packetParams);
+      if(modem == RADIOLIB_SX126X_PACKET_TYPE_GFSK) {
+        uint8_t len = (this->packetType == RADIOLIB_SX126X_GFSK_PACKET_FIXED) ? this->implicitLen : RADIOLIB_SX126X_MAX_PACKET_LENGTH;
+        const uint8_t packetParams[] = { (uint8_t)((this->preambleLengthFSK >> 8) & 0xFF), (uint8_t)(this->preambleLengthFSK & 0xFF),
+          this->preambleDetLength, this->syncWordLength, RADIOLIB_SX126X_GFSK_ADDRESS_FILT_OFF,
+          this->packetType, len, this->crcTypeFSK, this->whitening };
+        memcpy(profile->packetParams, packetParams, sizeof(packetParams));
+
+        // whitening, CRC and sync word, and errata fixes
+        state = readRegister(RADIOLIB_SX126X_REG_WHITENING_INITIAL_MSB, &profile->regs[0], 2);
+        RADIOLIB_ASSERT(state);
+        state = readRegister(RADIOLIB_SX126X_REG_CRC_INITIAL_MSB, &profile->regs[2], 12);
+        RADIOLIB_ASSERT(state);
+        state = readRegister(RADIOLIB_SX126X_REG_GFSK_FIX_1, &profile->fixRegs[0], 1);
+        RADIOLIB_ASSERT(state);
+        state = readRegister(RADIOLIB_SX126X_REG_RSSI_AVG_WINDOW, &profile->fixRegs[1], 1);
+        RADIOLIB_ASSERT(state);
+        state = readRegister(RADIOLIB_SX126X_REG_GFSK_FIX_3, &profile->fixRegs[2], 1);
+        RADIOLIB_ASSERT(state);
+        state = readRegister(RADIOLIB_SX126X_REG_GFSK_FIX_4, &profile->fixRegs[3], 1);
+        RADIOLIB_ASSERT(state);
+      }
+
+      profile->bitRate = this->bitRate;
+      profile->frequencyDev = this->frequencyDev;
+      profile->preambleDetLength = this->preambleDetLength;
+      profile->rxBandwidth = this->rxBandwidth;
+      profile->pulseShape = this->pulseShape;
+      profile->crcTypeFSK = this->crcTypeFSK;
+      profile->syncWordLength = this->syncWordLength;
+      profile->whitening = this->whitening;
+      profile->packetType = this->packetType;
+      profile->preambleLengthFSK = this->preambleLengthFSK;
+      profile->rxBandwidthKhz = this->rxBandwidthKhz;
+      profile->lrFhssCr = this->lrFhssCr;
+      profile->lrFhssBw = this->lrFhssBw;
+      profile->lrFhssHdrCount = this->lrFhssHdrCount;
+      memcpy(profile->lrFhssSyncWord, this->lrFhssSyncWord, RADIOLIB_SX126X_LR_FHSS_SYNC_WORD_BYTES);
+      profile->lrFhssGridNonFcc = this->lrFhssGridNonFcc;
+      profile->lrFhssHopSeqId = this->lrFhssHopSeqId;
+    } break;
+
+    default:
+      return(RADIOLIB_ERR_WRONG_MODEM);
+  }
+
+  profile->modem = modem;
+  profile->implicitLen = this->implicitLen;
+  return(state);
+}
+
+int16_t SX126x::applyProfile(const SX126xProfile* profile) {
+  return(this->writeProfile(profile, true));
+}
+
+void SX126x::stageProfile(const SX126xProfile* profile) {
+  this->stagedProfile = profile;
+}
+
+int16_t SX126x::writeProfile(const SX126xProfile* profile, bool packetParams) {
+  if(!profile) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if(profile->modem == 0xFF) {
+    return(RADIOLIB_ERR_WRONG_MODEM);
+  }
+
+  // packet type can only be changed in standby
+  int16_t state = standby();
+  RADIOLIB_ASSERT(state);
+  state = this->mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_PACKET_TYPE, &profile->modem, 1);
+  RADIOLIB_ASSERT(state);
+  state = this->mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_MODULATION_PARAMS, profile->modParams, profile->modParamsLen);
+  RADIOLIB_ASSERT(state);
+
+  // LR-FHSS packet parameters are not written by stageMode
+  if(packetParams || (profile->modem == RADIOLIB_SX126X_PACKET_TYPE_LR_FHSS)) {
+    state = this->mod->SPIwriteStream(RADIOLIB_SX126X_CMD_SET_PACKET_PARAMS, profile->packetParams, profile->packetParamsLen);
+    RADIOLIB_ASSERT(state);
+  }
+
+  if(profile->modem == RADIOLIB_SX126X_PACKET_TYPE_LORA) {
+    state = writeRegister(RADIOLIB_SX126X_REG_LORA_SYNC_WORD_MSB, &profile->regs[0], 2);
+    RADIOLIB_ASSERT(state);
+    state = writeRegister(RADIOLIB_SX126X_REG_IQ_CONFIG, &profile->regs[2], 1);
+    RADIOLIB_ASSERT(state);
+    state = writeRegister(RADIOLIB_SX126X_REG_SENSITIVITY_CONFIG, &profile->regs[3], 1);
+    RADIOLIB_ASSERT(state);
+
+    this->spreadingFactor = profile->spreadingFactor;
+    this->codingRate = profile->codingRate;
+    this->ldrOptimize = profile->ldrOptimize;
+    this->crcTypeLoRa = profile->crcTypeLoRa;
+    this->headerType = profile->headerType;
+    this->bandwidth = profile->bandwidth;
+    this->preambleLengthLoRa = profile->preambleLengthLoRa;
+    this->bandwidthKhz = profile->bandwidthKhz;
+    this->ldroAuto = profile->ldroAuto;
+    this->invertIQEnabled = profile->invertIQEnabled;
+
+  } else {
+    if(profile->modem == RADIOLIB_SX126X_PACKET_TYPE_GFSK) {
+      state = writeRegister(RADIOLIB_SX126X_REG_WHITENING_INITIAL_MSB, &profile->regs[0], 2);
+      RADIOLIB_ASSERT(state);
+      state = writeRegister(RADIOLIB_SX126X_REG_CRC_INITIAL_MSB, &profile->regs[2], 12);
+      RADIOLIB_ASSERT(state);
+      state = writeRegister(RADIOLIB_SX126X_REG_GFSK_FIX_1, &profile->fixRegs[0], 1);
+      RADIOLIB_ASSERT(state);
+      state = writeRegister(RADIOLIB_SX126X_REG_RSSI_AVG_WINDOW, &profile->fixRegs[1], 1);
+      RADIOLIB_ASSERT(state);
+      state = writeRegister(RADIOLIB_SX126X_REG_GFSK_FIX_3, &profile->fixRegs[2], 1);
+      RADIOLIB_ASSERT(state);
+      state = writeRegister(RADIOLIB_SX126X_REG_GFSK_FIX_4, &profile->fixRegs[3], 1);
+      RADIOLIB_ASSERT(state);
+    }
+
+    this->bitRate = profile->bitRate;
+    this->frequencyDev = profile->frequencyDev;
+    this->preambleDetLength = profile->preambleDetLength;
+    this->rxBandwidth = profile->rxBandwidth;
+    this->pulseShape = profile->pulseShape;
+    this->crcTypeFSK = profile->crcTypeFSK;
+    this->syncWordLength = profile->syncWordLength;
+    this->whitening = profile->whitening;
+    this->packetType = profile->packetType;
+    this->preambleLengthFSK = profile->preambleLengthFSK;
+    this->rxBandwidthKhz = profile->rxBandwidthKhz;
+    this->lrFhssCr = profile->lrFhssCr;
+    this->lrFhssBw = profile->lrFhssBw;
+    this->lrFhssHdrCount = profile->lrFhssHdrCount;
+    memcpy(this->lrFhssSyncWord, profile->lrFhssSyncWord, RADIOLIB_SX126X_LR_FHSS_SYNC_WORD_BYTES);
+    this->lrFhssGridNonFcc = profile->lrFhssGridNonFcc;
+    this->lrFhssHopSeqId = profile->lrFhssHopSeqId;
+  }
+
+  this->implicitLen = profile->implicitLen;
+  return(state);
+}
+
 #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
 void SX126x::setDirectAction(void (*func)(void)) {
   setDio1Action(func);
@@ -29,6 +29,48 @@
 #define RADIOLIB_SX126X_LR_FHSS_BLOCK_PREAMBLE_BITS             (2)
 #define RADIOLIB_SX126X_LR_FHSS_BLOCK_BITS                      (RADIOLIB_SX126X_LR_FHSS_FRAG_BITS + RADIOLIB_SX126X_LR_FHSS_BLOCK_PREAMBLE_BITS)
 
+/*!
+  \class SX126xProfile
+  \brief Modem configuration of %SX126x compiled into raw command payloads by SX126x::compileProfile,
+  so that it can be restored by a short burst of SPI commands. Frequency, output power
+  and other settings shared by all modems are not a part of the profile.
+*/
+class SX126xProfile {
+#if RADIOLIB_GODMODE
+  public:
+#endif
+    // raw SPI command payloads and registers
+    uint8_t modem = 0xFF;
+    uint8_t modParams[8] = { 0 };
+    uint8_t modParamsLen = 0;
+    uint8_t packetParams[9] = { 0 };
+    uint8_t packetParamsLen = 0;
+    uint8_t regs[14] = { 0 };
+    uint8_t fixRegs[4] = { 0 };
+
+    // cached LoRa configuration
+    uint8_t spreadingFactor = 0, codingRate = 0, ldrOptimize = 0, crcTypeLoRa = 0, headerType = 0, bandwidth = 0;
+    uint16_t preambleLengthLoRa = 0;
+    float bandwidthKhz = 0;
+    bool ldroAuto = true;
+    uint8_t invertIQEnabled = 0;
+
+    // cached FSK configuration, also used by LR-FHSS
+    uint32_t bitRate = 0, frequencyDev = 0;
+    uint8_t preambleDetLength = 0, rxBandwidth = 0, pulseShape = 0, crcTypeFSK = 0, syncWordLength = 0, whitening = 0, packetType = 0;
+    uint16_t preambleLengthFSK = 0;
+    float rxBandwidthKhz = 0;
+    size_t implicitLen = 0;
+
+    // cached LR-FHSS configuration
+    uint8_t lrFhssCr = 0, lrFhssBw = 0, lrFhssHdrCount = 0;
+    uint8_t lrFhssSyncWord[RADIOLIB_SX126X_LR_FHSS_SYNC_WORD_BYTES] = { 0 };
+    bool lrFhssGridNonFcc = false;
+    uint16_t lrFhssHopSeqId = 0;
+
+    friend class SX126x;
+};
+
 /*!
   \class SX126x
   \brief Base class for %SX126x series. All derived classes for %SX126x (e.g. SX1262 or SX1268) inherit from this base class.
@@ -357,6 +399,16 @@ class SX126x: public PhysicalLayer {
       \returns \ref status_codes
     */
     int16_t readData(uint8_t* data, size_t len) override;
+
+    /*!
+      \brief Reads the start of a received packet without clearing the interrupt flags,
+      readData can still be called afterwards.
+      \param data Pointer to array to save the received binary data.
+      \param len Number of bytes that will be read. When more bytes than received are requested,
+      only the received bytes will be read.
+      \returns \ref status_codes
+    */
+    int16_t peekData(uint8_t* data, size_t len) override;
     
     /*!
       \brief Interrupt-driven channel activity detection method. DIO1 will be activated
@@ -573,7 +625,7 @@ class SX126x: public PhysicalLayer {
 
       \returns Frequency error in Hz.
     */
-    float getFrequencyError();
+    float getFrequencyError() override;
 
     /*!
       \brief Query modem for the packet length of received payload.
@@ -673,6 +725,14 @@ class SX126x: public PhysicalLayer {
     */
     int16_t explicitHeader();
 
+    /*!
+      \brief Set LoRa header mode and payload CRC in a single call.
+      \param len Payload length for implicit header mode, 0 to use explicit header mode.
+      \param crc Whether the payload CRC is enabled.
+      \returns \ref status_codes
+    */
+    int16_t setLoRaHeader(size_t len, bool crc) override;
+
     /*!
       \brief Set regulator mode to LDO.
       \returns \ref status_codes
@@ -742,6 +802,38 @@ class SX126x: public PhysicalLayer {
     /*! \copydoc PhysicalLayer::launchMode */
     int16_t launchMode() override;
 
+    /*!
+      \brief Keep the frequency synthesizer running after transmission or reception, by setting the Rx/Tx fallback mode to FS.
+      Disabling does not restore a previous fallback mode, it sets the one the driver uses everywhere else:
+      STDBY_RC, or STDBY_XOSC if enabled by setStandbyXOSC.
+      \param enable Whether to keep the synthesizer running.
+      \returns \ref status_codes
+    */
+    int16_t setFastTurnaround(bool enable) override;
+
+    /*!
+      \brief Save the current modem configuration into a profile. Configure the modem
+      the usual way first, the profile can then be applied any number of times.
+      \param profile Profile to save the configuration into.
+      \returns \ref status_codes
+    */
+    int16_t compileProfile(SX126xProfile* profile);
+
+    /*!
+      \brief Switch to a modem configuration saved by compileProfile.
+      The radio is left in standby.
+      \param profile Profile to apply.
+      \returns \ref status_codes
+    */
+    int16_t applyProfile(const SX126xProfile* profile);
+
+    /*!
+      \brief Apply a profile as a part of the next call to stageMode, so that switching the modem
+      and staging the mode are done in a single pass.
+      \param profile Profile to apply, NULL to cancel.
+    */
+    void stageProfile(const SX126xProfile* profile);
+
     #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
     /*!
       \brief Set interrupt service routine function to call when data bit is received in direct mode.
@@ -938,6 +1030,10 @@ class SX126x: public PhysicalLayer {
     size_t implicitLen = 0;
     uint8_t invertIQEnabled = RADIOLIB_SX126X_LORA_IQ_STANDARD;
     uint32_t rxTimeout = 0;
+    bool fastTurnaround = false;
+
+    // profile to apply by the next stageMode
+    const SX126xProfile* stagedProfile = NULL;
 
     // LR-FHSS stuff - there's a lot of it because all the encoding happens in software
     uint8_t lrFhssCr = RADIOLIB_SX126X_LR_FHSS_CR_2_3;
@@ -969,6 +1065,9 @@ class SX126x: public PhysicalLayer {
     int16_t fixInvertedIQ(uint8_t iqConfig);
     int16_t fixGFSK();
 
+    // modem profiles
+    int16_t writeProfile(const SX126xProfile* profile, bool packetParams);
+
     // LR-FHSS utilities
     int16_t buildLRFHSSPacket(const uint8_t* in, size_t in_len, uint8_t* out, size_t* out_len, size_t* out_bits, size_t* out_hops);
     int16_t resetLRFHSS();
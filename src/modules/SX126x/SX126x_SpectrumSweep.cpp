@@ -0,0 +1,183 @@
+#include "SX126x_SpectrumSweep.h"
+
+#include <math.h>
+#include <string.h>
+
+#if !RADIOLIB_EXCLUDE_SX126X
+
+SX126xSpectrumSweep::SX126xSpectrumSweep(SX1262* radio) {
+  this->radio = radio;
+  this->sx1262 = radio;
+}
+
+SX126xSpectrumSweep::SX126xSpectrumSweep(SX1268* radio) {
+  this->radio = radio;
+  this->sx1268 = radio;
+}
+
+int16_t SX126xSpectrumSweep::begin(float freqStart, float freqStep, SX126xSpectrumBin_t* bins, size_t numBins, uint16_t numSamples, uint8_t window, uint8_t interval) {
+  if(!bins) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if((numBins == 0) || (numSamples == 0)) {
+    return(RADIOLIB_ERR_INVALID_NUM_SAMPLES);
+  }
+  RADIOLIB_CHECK_RANGE(freqStart, 150.0f, 960.0f, RADIOLIB_ERR_INVALID_FREQUENCY);
+  float freqEnd = freqStart + freqStep*(numBins - 1);
+  RADIOLIB_CHECK_RANGE(freqEnd, 150.0f, 960.0f, RADIOLIB_ERR_INVALID_FREQUENCY);
+
+  this->freqStart = freqStart;
+  this->freqStep = freqStep;
+  this->bins = bins;
+  this->numBins = numBins;
+  this->numSamples = numSamples;
+  this->window = window;
+  this->interval = interval;
+  this->calibrated = false;
+
+  // every sample averages up to 2^n RSSI readings (window = n << 2), one per scan interval
+  uint32_t intervalNs = 8680;
+  if(interval == RADIOLIB_SX126X_SCAN_INTERVAL_7_68_US) {
+    intervalNs = 7680;
+  } else if(interval == RADIOLIB_SX126X_SCAN_INTERVAL_8_20_US) {
+    intervalNs = 8200;
+  }
+  RadioLibTime_t scanUs = ((uint64_t)numSamples * intervalNs << ((window >> 2) & 0x07)) / 1000;
+
+  // twice the longest possible scan, with some margin for the scan setup
+  this->scanTimeout = 2*scanUs + 10000UL;
+  this->reset();
+  return(RADIOLIB_ERR_NONE);
+}
+
+void SX126xSpectrumSweep::setExportCb(void (*cb)(size_t, float, const uint16_t*, const SX126xSpectrumBin_t*, void*), void* ctx) {
+  this->exportCb = cb;
+  this->exportCtx = ctx;
+}
+
+int16_t SX126xSpectrumSweep::sweep(uint16_t num) {
+  if(!this->bins) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // calibrate the image rejection once for the whole range, so that retuning is just a frequency change
+  int16_t state;
+  if(!this->calibrated) {
+    float freqEnd = this->getFrequency(this->numBins - 1);
+    state = this->radio->calibrateImageRejection(RADIOLIB_MIN(this->freqStart, freqEnd), RADIOLIB_MAX(this->freqStart, freqEnd));
+    RADIOLIB_ASSERT(state);
+    this->calibrated = true;
+  }
+
+  size_t total = (size_t)num * this->numBins;
+  state = RADIOLIB_ERR_NONE;
+  if(total > 0) {
+    state = this->startScan(0);
+  }
+  for(size_t n = 0; (n < total) && (state == RADIOLIB_ERR_NONE); n++) {
+    state = this->waitScan();
+    if(state != RADIOLIB_ERR_NONE) {
+      break;
+    }
+
+    uint16_t* histogram = this->results[n % 2];
+    state = this->radio->spectralScanGetResult(histogram);
+    if(state != RADIOLIB_ERR_NONE) {
+      break;
+    }
+
+    // the result is read out, so the next step can be scanned while this one is processed
+    if(n + 1 < total) {
+      state = this->startScan((n + 1) % this->numBins);
+    }
+    this->accumulate(n % this->numBins, histogram);
+  }
+
+  this->radio->spectralScanAbort();
+  int16_t standbyState = this->radio->standby();
+  RADIOLIB_ASSERT(state);
+  return(standbyState);
+}
+
+void SX126xSpectrumSweep::reset() {
+  if(this->bins) {
+    memset(this->bins, 0, this->numBins*sizeof(SX126xSpectrumBin_t));
+  }
+}
+
+float SX126xSpectrumSweep::getFrequency(size_t idx) {
+  return(this->freqStart + this->freqStep*idx);
+}
+
+float SX126xSpectrumSweep::getAverage(size_t idx) {
+  if(!this->bins || (idx >= this->numBins) || (this->bins[idx].count == 0)) {
+    return(0);
+  }
+  return((float)this->bins[idx].sum / (float)this->bins[idx].count);
+}
+
+int16_t SX126xSpectrumSweep::setFrequency(float freq) {
+  // the whole range was calibrated in advance, so the calibration is skipped
+  if(this->sx1262) {
+    return(this->sx1262->setFrequency(freq, true));
+  }
+  return(this->sx1268->setFrequency(freq, true));
+}
+
+int16_t SX126xSpectrumSweep::startScan(size_t idx) {
+  int16_t state = this->setFrequency(this->getFrequency(idx));
+  RADIOLIB_ASSERT(state);
+  return(this->radio->spectralScanStart(this->numSamples, this->window, this->interval));
+}
+
+int16_t SX126xSpectrumSweep::waitScan() {
+  RadioLibHal* hal = static_cast<PhysicalLayer*>(this->radio)->getMod()->hal;
+  RadioLibTime_t start = hal->micros();
+  while(this->radio->spectralScanGetStatus() != RADIOLIB_ERR_NONE) {
+    if(hal->micros() - start > this->scanTimeout) {
+      return(RADIOLIB_ERR_RX_TIMEOUT);
+    }
+    hal->yield();
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+void SX126xSpectrumSweep::accumulate(size_t idx, const uint16_t* histogram) {
+  // the first bin with any samples holds the strongest level, the average is weighted by the samples
+  uint32_t samples = 0;
+  int32_t weighted = 0;
+  int8_t peak = 0;
+  for(int i = 0; i < RADIOLIB_SX126X_SPECTRAL_SCAN_RES_SIZE; i++) {
+    if(histogram[i] == 0) {
+      continue;
+    }
+    int32_t level = RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_OFFSET - RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_STEP*i;
+    if(samples == 0) {
+      peak = (int8_t)level;
+    }
+    samples += histogram[i];
+    weighted += level*(int32_t)histogram[i];
+  }
+
+  SX126xSpectrumBin_t* bin = &this->bins[idx];
+  if((samples > 0) && (bin->count < 0xFFFF)) {
+    int8_t avg = (int8_t)roundf((float)weighted / (float)samples);
+    if(bin->count == 0) {
+      bin->min = avg;
+      bin->max = avg;
+      bin->peak = peak;
+    } else {
+      bin->min = RADIOLIB_MIN(bin->min, avg);
+      bin->max = RADIOLIB_MAX(bin->max, avg);
+      bin->peak = RADIOLIB_MAX(bin->peak, peak);
+    }
+    bin->count++;
+    bin->sum += avg;
+  }
+
+  if(this->exportCb) {
+    this->exportCb(idx, this->getFrequency(idx), histogram, bin, this->exportCtx);
+  }
+}
+
+#endif
@@ -0,0 +1,144 @@
+#if !defined(_RADIOLIB_SX126X_SPECTRUM_SWEEP_H)
+#define _RADIOLIB_SX126X_SPECTRUM_SWEEP_H
+
+#include "../../TypeDef.h"
+
+#if !RADIOLIB_EXCLUDE_SX126X
+
+#include "SX1262.h"
+#include "SX1268.h"
+
+// power level of the first spectral scan histogram bin, each following bin is 4 dB lower
+#if !defined(RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_OFFSET)
+  #define RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_OFFSET             (-11)
+#endif
+
+#define RADIOLIB_SX126X_SPECTRAL_SCAN_RSSI_STEP                 (4)
+
+/*!
+  \struct SX126xSpectrumBin_t
+  \brief Accumulated power of one frequency step of a spectrum sweep.
+*/
+struct SX126xSpectrumBin_t {
+  /*! \brief Lowest average power of a single scan, in dBm */
+  int8_t min;
+
+  /*! \brief Highest average power of a single scan, in dBm */
+  int8_t max;
+
+  /*! \brief Strongest power level seen in any scan, in dBm */
+  int8_t peak;
+
+  /*! \brief Number of accumulated scans */
+  uint16_t count;
+
+  /*! \brief Sum of the average power of all scans, in dBm */
+  int32_t sum;
+};
+
+/*!
+  \class SX126xSpectrumSweep
+  \brief Frequency sweep on top of the %SX126x spectral scan. Each step is scanned
+  once per sweep and the results are accumulated into a min/average/max matrix.
+  The result of a step is processed while the next step is scanned.
+  Requires the spectral scan patch to be uploaded and the radio to be in FSK mode,
+  with the receiver bandwidth set to the frequency step or slightly above it.
+*/
+class SX126xSpectrumSweep {
+  public:
+    /*!
+      \brief Constructor for %SX1262 and the radios derived from it (%SX1261, %LLCC68, %STM32WLx).
+      \param radio Pointer to the radio to scan with.
+    */
+    SX126xSpectrumSweep(SX1262* radio);
+
+    /*!
+      \brief Constructor for %SX1268.
+      \param radio Pointer to the radio to scan with.
+    */
+    SX126xSpectrumSweep(SX1268* radio);
+
+    /*!
+      \brief Configure the sweep and clear the accumulated results.
+      \param freqStart Frequency of the first step in MHz.
+      \param freqStep Frequency step in MHz.
+      \param bins Array of numBins entries to accumulate the results into, one entry per step.
+      \param numBins Number of frequency steps.
+      \param numSamples Number of samples for each scan. Fewer samples = faster sweep.
+      \param window RSSI averaging window size.
+      \param interval Scan interval length, one of RADIOLIB_SX126X_SCAN_INTERVAL_* macros.
+      \returns \ref status_codes
+    */
+    int16_t begin(float freqStart, float freqStep, SX126xSpectrumBin_t* bins, size_t numBins,
+      uint16_t numSamples = 2048, uint8_t window = RADIOLIB_SX126X_SPECTRAL_SCAN_WINDOW_DEFAULT,
+      uint8_t interval = RADIOLIB_SX126X_SCAN_INTERVAL_8_20_US);
+
+    /*!
+      \brief Set a callback to be called with every scan result. The histogram and bin
+      are passed without copying and are only valid until the callback returns.
+      \param cb Callback with step index, frequency in MHz, histogram of
+      RADIOLIB_SX126X_SPECTRAL_SCAN_RES_SIZE entries, accumulated bin and the user context.
+      \param ctx User context passed to the callback.
+    */
+    void setExportCb(void (*cb)(size_t, float, const uint16_t*, const SX126xSpectrumBin_t*, void*), void* ctx = NULL);
+
+    /*!
+      \brief Sweep the frequency range. The radio is left in standby.
+      \param num Number of sweeps to perform.
+      \returns \ref status_codes
+    */
+    int16_t sweep(uint16_t num = 1);
+
+    /*!
+      \brief Clear the accumulated results.
+    */
+    void reset();
+
+    /*!
+      \brief Get the frequency of a step.
+      \param idx Step index.
+      \returns Frequency in MHz.
+    */
+    float getFrequency(size_t idx);
+
+    /*!
+      \brief Get the average power of a step over all sweeps.
+      \param idx Step index.
+      \returns Average power in dBm, 0 if nothing was accumulated yet.
+    */
+    float getAverage(size_t idx);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    SX126x* radio;
+
+    // only one of these is set, used to retune without the automatic image calibration
+    SX1262* sx1262 = NULL;
+    SX1268* sx1268 = NULL;
+
+    float freqStart = 0;
+    float freqStep = 0;
+    SX126xSpectrumBin_t* bins = NULL;
+    size_t numBins = 0;
+    uint16_t numSamples = 0;
+    uint8_t window = 0;
+    uint8_t interval = 0;
+    RadioLibTime_t scanTimeout = 0;
+    bool calibrated = false;
+
+    void (*exportCb)(size_t, float, const uint16_t*, const SX126xSpectrumBin_t*, void*) = NULL;
+    void* exportCtx = NULL;
+
+    // the previous result is processed while the next scan runs
+    uint16_t results[2][RADIOLIB_SX126X_SPECTRAL_SCAN_RES_SIZE];
+
+    int16_t setFrequency(float freq);
+    int16_t startScan(size_t idx);
+    int16_t waitScan();
+    void accumulate(size_t idx, const uint16_t* histogram);
+};
+
+#endif
+
+#endif
@@ -607,6 +607,15 @@ int16_t SX126x::explicitHeader() {
   return(setHeaderType(RADIOLIB_SX126X_LORA_HEADER_EXPLICIT));
 }
 
+int16_t SX126x::setLoRaHeader(size_t len, bool crc) {
+  int16_t state = this->setCRC(crc ? 2 : 0);
+  RADIOLIB_ASSERT(state);
+  if(len == 0) {
+    return(this->explicitHeader());
+  }
+  return(this->implicitHeader(len));
+}
+
 int16_t SX126x::setRegulatorLDO() {
   return(setRegulatorMode(RADIOLIB_SX126X_REGULATOR_LDO));
 }
@@ -555,6 +555,15 @@ int16_t SX1272::explicitHeader() {
   return(setHeaderType(RADIOLIB_SX1272_HEADER_EXPL_MODE, 2));
 }
 
+int16_t SX1272::setLoRaHeader(size_t len, bool crc) {
+  int16_t state = this->setCRC(crc);
+  RADIOLIB_ASSERT(state);
+  if(len == 0) {
+    return(this->explicitHeader());
+  }
+  return(this->implicitHeader(len));
+}
+
 int16_t SX1272::setBandwidthRaw(uint8_t newBandwidth) {
   // set mode to standby
   int16_t state = SX127x::standby();
@@ -329,6 +329,14 @@ class SX1272: public SX127x {
       \returns \ref status_codes
     */
     int16_t explicitHeader();
+
+    /*!
+      \brief Set LoRa header mode and payload CRC in a single call.
+      \param len Payload length for implicit header mode, 0 to use explicit header mode.
+      \param crc Whether the payload CRC is enabled.
+      \returns \ref status_codes
+    */
+    int16_t setLoRaHeader(size_t len, bool crc) override;
     
     /*!
       \brief Set modem for the radio to use. Will perform full reset and reconfigure the radio
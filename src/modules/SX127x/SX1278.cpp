@@ -600,6 +600,15 @@ int16_t SX1278::explicitHeader() {
   return(setHeaderType(RADIOLIB_SX1278_HEADER_EXPL_MODE, 0));
 }
 
+int16_t SX1278::setLoRaHeader(size_t len, bool crc) {
+  int16_t state = this->setCRC(crc);
+  RADIOLIB_ASSERT(state);
+  if(len == 0) {
+    return(this->explicitHeader());
+  }
+  return(this->implicitHeader(len));
+}
+
 int16_t SX1278::setBandwidthRaw(uint8_t newBandwidth) {
   // set mode to standby
   int16_t state = SX127x::standby();
@@ -921,12 +921,18 @@ class SX127x: public PhysicalLayer {
     */
     int16_t invertPreamble(bool enable);
 
+    /*!
+      \brief Gets frequency error of the latest received packet.
+      \returns Frequency error in Hz.
+    */
+    float getFrequencyError() override;
+
     /*!
       \brief Gets frequency error of the latest received packet.
       \param autoCorrect When set to true, frequency will be automatically corrected.
       \returns Frequency error in Hz.
     */
-    float getFrequencyError(bool autoCorrect = false);
+    float getFrequencyError(bool autoCorrect);
 
     /*!
       \brief Gets current AFC error.
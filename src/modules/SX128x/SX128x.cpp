@@ -523,6 +523,22 @@ int16_t SX128x::readData(uint8_t* data, size_t len) {
   return(state);
 }
 
+int16_t SX128x::peekData(uint8_t* data, size_t len) {
+  // check active modem
+  if(getPacketType() == RADIOLIB_SX128X_PACKET_TYPE_RANGING) {
+    return(RADIOLIB_ERR_WRONG_MODEM);
+  }
+
+  // get Rx buffer offset, but do not touch the interrupt flags
+  uint8_t offset = 0;
+  size_t length = getPacketLength(true, &offset);
+  if(len > length) {
+    len = length;
+  }
+
+  return(readBuffer(data, len, offset));
+}
+
 int16_t SX128x::finishReceive() {
   // set mode to standby to disable RF switch
   int16_t state = standby();
@@ -1605,6 +1621,11 @@ int16_t SX128x::launchMode() {
   return(state);
 }
 
+int16_t SX128x::setFastTurnaround(bool enable) {
+  uint8_t data[] = { (uint8_t)(enable ? RADIOLIB_SX128X_AUTO_FS_ON : RADIOLIB_SX128X_AUTO_FS_OFF) };
+  return(this->mod->SPIwriteStream(RADIOLIB_SX128X_CMD_SET_AUTO_FS, data, 1));
+}
+
 #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
 void SX128x::setDirectAction(void (*func)(void)) {
   // SX128x is unable to perform direct mode reception
@@ -342,6 +342,10 @@
 #define RADIOLIB_SX128X_RANGING_ROLE_MASTER                     0x01        //  7     0   ranging role: master
 #define RADIOLIB_SX128X_RANGING_ROLE_SLAVE                      0x00        //  7     0                 slave
 
+//RADIOLIB_SX128X_CMD_SET_AUTO_FS
+#define RADIOLIB_SX128X_AUTO_FS_OFF                             0x00        //  7     0   after Rx/Tx go to: standby (default)
+#define RADIOLIB_SX128X_AUTO_FS_ON                              0x01        //  7     0                      FS mode
+
 //RADIOLIB_SX128X_REG_LORA_SYNC_WORD_1 - RADIOLIB_SX128X_REG_LORA_SYNC_WORD_2
 #define RADIOLIB_SX128X_SYNC_WORD_PRIVATE                       0x12
 
@@ -614,6 +618,16 @@ class SX128x: public PhysicalLayer {
     */
     int16_t readData(uint8_t* data, size_t len) override;
 
+    /*!
+      \brief Reads the start of a received packet without clearing the interrupt flags,
+      readData can still be called afterwards.
+      \param data Pointer to array to save the received binary data.
+      \param len Number of bytes that will be read. When more bytes than received are requested,
+      only the received bytes will be read.
+      \returns \ref status_codes
+    */
+    int16_t peekData(uint8_t* data, size_t len) override;
+
     /*!
       \brief Clean up after reception is done.
       \returns \ref status_codes
@@ -847,7 +861,7 @@ class SX128x: public PhysicalLayer {
       \brief Gets frequency error of the latest received packet.
       \returns Frequency error in Hz.
     */
-    float getFrequencyError();
+    float getFrequencyError() override;
 
     /*!
       \brief Query modem for the packet length of received payload.
@@ -955,6 +969,9 @@ class SX128x: public PhysicalLayer {
     /*! \copydoc PhysicalLayer::launchMode */
     int16_t launchMode() override;
 
+    /*! \copydoc PhysicalLayer::setFastTurnaround */
+    int16_t setFastTurnaround(bool enable) override;
+
     #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
     /*!
       \brief Dummy method, to ensure PhysicalLayer compatibility.
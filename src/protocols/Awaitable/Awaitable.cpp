@@ -0,0 +1,280 @@
+#include "Awaitable.h"
+
+#if RADIOLIB_AWAITABLE
+
+#include <array>
+#include <utility>
+
+// the radio interrupt has no context, so each client gets one of a fixed number of global-scope ISRs
+static AwaitableClient* awaitableClients[RADIOLIB_AWAITABLE_NUM_RADIOS] = { nullptr };
+static std::mutex awaitableClientsLock;
+
+void AwaitableClientInterrupt(int8_t slot) {
+  AwaitableClient* client = awaitableClients[slot];
+  if(!client) {
+    return;
+  }
+
+  client->executor->notify(client);
+}
+
+template<size_t N>
+static void AwaitableClientOnAction(void) {
+  AwaitableClientInterrupt(N);
+}
+
+template<size_t... N>
+static constexpr std::array<void (*)(void), sizeof...(N)> AwaitableClientActions(std::index_sequence<N...>) {
+  std::array<void (*)(void), sizeof...(N)> actions = {{ AwaitableClientOnAction<N>... }};
+  return(actions);
+}
+
+static constexpr std::array<void (*)(void), RADIOLIB_AWAITABLE_NUM_RADIOS> awaitableActions =
+  AwaitableClientActions(std::make_index_sequence<RADIOLIB_AWAITABLE_NUM_RADIOS>());
+
+RadioLibTask RadioLibTask::promise_type::get_return_object() {
+  return(RadioLibTask(std::coroutine_handle<promise_type>::from_promise(*this)));
+}
+
+std::coroutine_handle<> RadioLibTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+  promise_type& promise = handle.promise();
+  if(promise.continuation) {
+    return(promise.continuation);
+  }
+
+  // spawned tasks are owned by the executor
+  RadioLibExecutor* executor = promise.executor;
+  handle.destroy();
+  if(executor) {
+    std::lock_guard<std::mutex> guard(executor->lock);
+    executor->numTasks--;
+  }
+  return(std::noop_coroutine());
+}
+
+RadioLibTask::RadioLibTask(RadioLibTask&& other) noexcept : handle(other.handle) {
+  other.handle = nullptr;
+}
+
+RadioLibTask::~RadioLibTask() {
+  if(this->handle) {
+    this->handle.destroy();
+  }
+}
+
+std::coroutine_handle<> RadioLibTask::await_suspend(std::coroutine_handle<> handle) noexcept {
+  this->handle.promise().continuation = handle;
+  return(this->handle);
+}
+
+int16_t RadioLibTask::await_resume() noexcept {
+  return(this->handle.promise().result);
+}
+
+void RadioLibExecutor::spawn(RadioLibTask&& task) {
+  std::coroutine_handle<RadioLibTask::promise_type> handle = task.handle;
+  task.handle = nullptr;
+  handle.promise().executor = this;
+
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->numTasks++;
+  this->ready.push_back(handle);
+}
+
+void RadioLibExecutor::run() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  while(this->numTasks > 0) {
+    // resume tasks without holding the lock, they may start new operations
+    while(!this->ready.empty()) {
+      std::coroutine_handle<> handle = this->ready.front();
+      this->ready.pop_front();
+      guard.unlock();
+      handle.resume();
+      guard.lock();
+    }
+    if(this->numTasks == 0) {
+      break;
+    }
+
+    // take out the operations that are done, and find the next deadline
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    std::vector<std::pair<AwaitableClient*, bool>> done;
+    for(size_t i = 0; i < this->waiting.size();) {
+      AwaitableClient* client = this->waiting[i];
+      if(client->fired || (now >= client->opDeadline)) {
+        done.push_back(std::make_pair(client, !client->fired));
+        client->fired = false;
+        this->waiting.erase(this->waiting.begin() + i);
+        continue;
+      }
+      if(client->opDeadline < next) {
+        next = client->opDeadline;
+      }
+      i++;
+    }
+
+    if(done.empty()) {
+      this->wake.wait_until(guard, next);
+      continue;
+    }
+
+    // finish the operations outside of the lock, as that needs SPI
+    guard.unlock();
+    for(size_t i = 0; i < done.size(); i++) {
+      done[i].first->finish(done[i].second);
+    }
+    guard.lock();
+    for(size_t i = 0; i < done.size(); i++) {
+      this->ready.push_back(done[i].first->opHandle);
+    }
+  }
+}
+
+void RadioLibExecutor::notify(AwaitableClient* client) {
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    client->fired = true;
+  }
+  this->wake.notify_one();
+}
+
+void RadioLibExecutor::wait(AwaitableClient* client) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->waiting.push_back(client);
+}
+
+AwaitableClient::AwaitableClient(PhysicalLayer* phy, RadioLibExecutor* executor) {
+  this->phyLayer = phy;
+  this->executor = executor;
+
+  std::lock_guard<std::mutex> guard(awaitableClientsLock);
+  for(int8_t i = 0; i < RADIOLIB_AWAITABLE_NUM_RADIOS; i++) {
+    if(!awaitableClients[i]) {
+      awaitableClients[i] = this;
+      this->slot = i;
+      break;
+    }
+  }
+  if(this->slot < 0) {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("No free awaitable radio slot, increase RADIOLIB_AWAITABLE_NUM_RADIOS");
+  }
+}
+
+AwaitableClient::~AwaitableClient() {
+  std::lock_guard<std::mutex> guard(awaitableClientsLock);
+  if(this->slot >= 0) {
+    awaitableClients[this->slot] = nullptr;
+  }
+}
+
+bool AwaitableClient::Operation::await_suspend(std::coroutine_handle<> handle) {
+  AwaitableClient* client = this->client;
+  client->opHandle = handle;
+  client->opResult = client->start();
+  if(client->opResult != RADIOLIB_ERR_NONE) {
+    return(false);
+  }
+  client->executor->wait(client);
+  return(true);
+}
+
+int16_t AwaitableClient::Operation::await_resume() noexcept {
+  return(this->client->opResult);
+}
+
+AwaitableClient::Operation AwaitableClient::transmitAsync(const uint8_t* data, size_t len, uint8_t addr) {
+  this->opType = OP_TRANSMIT;
+  this->txData = data;
+  this->txAddr = addr;
+  this->opLen = len;
+  return(Operation { this });
+}
+
+AwaitableClient::Operation AwaitableClient::receiveAsync(uint8_t* data, size_t len, RadioLibTime_t timeout) {
+  this->opType = OP_RECEIVE;
+  this->rxData = data;
+  this->opLen = len;
+  this->opTimeout = timeout;
+  return(Operation { this });
+}
+
+AwaitableClient::Operation AwaitableClient::scanChannelAsync() {
+  this->opType = OP_SCAN;
+  return(Operation { this });
+}
+
+int16_t AwaitableClient::start() {
+  if(this->slot < 0) {
+    return(RADIOLIB_ERR_MEMORY_ALLOCATION_FAILED);
+  }
+
+  this->fired = false;
+  void (*action)(void) = awaitableActions[this->slot];
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::chrono::milliseconds guard(RADIOLIB_AWAITABLE_GUARD_MS);
+  int16_t state = RADIOLIB_ERR_NONE;
+  switch(this->opType) {
+    case(OP_TRANSMIT): {
+      // same timeout as the blocking transmit methods
+      this->phyLayer->setPacketSentAction(action);
+      RadioLibTime_t toa = this->phyLayer->getTimeOnAir(this->opLen);
+      this->opDeadline = now + std::chrono::microseconds(toa * 5) + guard;
+      state = this->phyLayer->startTransmit(this->txData, this->opLen, this->txAddr);
+    } break;
+
+    case(OP_RECEIVE): {
+      this->phyLayer->setPacketReceivedAction(action);
+      if(this->opTimeout == 0) {
+        this->opDeadline = std::chrono::steady_clock::time_point::max();
+        state = this->phyLayer->startReceive();
+      } else {
+        this->opDeadline = now + std::chrono::microseconds(this->opTimeout) + guard;
+        uint32_t timeout = this->phyLayer->calculateRxTimeout(this->opTimeout);
+        RadioLibIrqFlags_t mask = (1UL << RADIOLIB_IRQ_RX_DONE) | (1UL << RADIOLIB_IRQ_TIMEOUT);
+        state = this->phyLayer->startReceive(timeout, RADIOLIB_IRQ_RX_DEFAULT_FLAGS, mask, 0);
+      }
+    } break;
+
+    case(OP_SCAN): {
+      this->phyLayer->setChannelScanAction(action);
+      this->opDeadline = now + guard;
+      state = this->phyLayer->startChannelScan();
+    } break;
+  }
+
+  if(state != RADIOLIB_ERR_NONE) {
+    this->finish(true);
+  }
+  return(state);
+}
+
+void AwaitableClient::finish(bool expired) {
+  switch(this->opType) {
+    case(OP_TRANSMIT):
+      this->phyLayer->clearPacketSentAction();
+      this->opResult = expired ? RADIOLIB_ERR_TX_TIMEOUT : this->phyLayer->finishTransmit();
+      break;
+
+    case(OP_RECEIVE):
+      this->phyLayer->clearPacketReceivedAction();
+      if(expired || (this->phyLayer->checkIrq(RADIOLIB_IRQ_TIMEOUT) == 1)) {
+        (void)this->phyLayer->finishReceive();
+        this->opResult = RADIOLIB_ERR_RX_TIMEOUT;
+      } else {
+        this->opResult = this->phyLayer->readData(this->rxData, this->opLen);
+      }
+      break;
+
+    case(OP_SCAN):
+      this->phyLayer->clearChannelScanAction();
+      this->opResult = expired ? RADIOLIB_ERR_RX_TIMEOUT : this->phyLayer->getChannelScanResult();
+      break;
+  }
+
+  if(expired) {
+    (void)this->phyLayer->standby();
+  }
+}
+
+#endif
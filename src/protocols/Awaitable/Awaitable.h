@@ -0,0 +1,249 @@
+#if !defined(_RADIOLIB_AWAITABLE_H)
+#define _RADIOLIB_AWAITABLE_H
+
+#include "../../TypeDef.h"
+
+#if RADIOLIB_AWAITABLE
+
+#if !defined(__linux__) || !defined(__cpp_impl_coroutine)
+  #error "RADIOLIB_AWAITABLE requires Linux and a compiler with C++20 coroutine support"
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "../PhysicalLayer/PhysicalLayer.h"
+
+class RadioLibExecutor;
+class AwaitableClient;
+
+/*!
+  \class RadioLibTask
+  \brief Coroutine returning a status code. Tasks are started by RadioLibExecutor::spawn,
+  or by awaiting them from another task.
+*/
+class RadioLibTask {
+  public:
+    /*!
+      \brief Coroutine promise, used by the compiler.
+    */
+    struct promise_type {
+      /*! \brief Task that awaits this one, resumed when this one returns. */
+      std::coroutine_handle<> continuation;
+
+      /*! \brief Executor of a spawned task, notified when the task returns. */
+      RadioLibExecutor* executor = nullptr;
+
+      /*! \brief Status code returned by the task. */
+      int16_t result = RADIOLIB_ERR_NONE;
+
+      /*! \brief Create the task object. */
+      RadioLibTask get_return_object();
+
+      /*! \brief Tasks are only started when spawned or awaited. */
+      std::suspend_always initial_suspend() noexcept { return {}; }
+
+      /*!
+        \brief Awaiter at the end of the task, resumes the awaiting task.
+      */
+      struct FinalAwaiter {
+        /*! \brief Always suspends. */
+        bool await_ready() noexcept { return(false); }
+        /*! \brief Transfers to the awaiting task, or releases a spawned one. */
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+        /*! \brief Never resumed. */
+        void await_resume() noexcept {}
+      };
+
+      /*! \brief Get the final awaiter. */
+      FinalAwaiter final_suspend() noexcept { return {}; }
+
+      /*! \brief Save the returned status code. */
+      void return_value(int16_t value) { this->result = value; }
+
+      /*! \brief Exceptions are not supported. */
+      void unhandled_exception() {}
+    };
+
+    /*!
+      \brief Move constructor.
+      \param other Task to take over.
+    */
+    RadioLibTask(RadioLibTask&& other) noexcept;
+
+    /*!
+      \brief Default destructor, destroys a task that was not spawned.
+    */
+    ~RadioLibTask();
+
+    RadioLibTask(const RadioLibTask&) = delete;
+    RadioLibTask& operator=(const RadioLibTask&) = delete;
+
+    /*! \brief Tasks always run when awaited. */
+    bool await_ready() noexcept { return(false); }
+
+    /*!
+      \brief Start the task, the awaiting task is resumed once it returns.
+      \param handle Awaiting coroutine.
+      \returns Coroutine to transfer to.
+    */
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept;
+
+    /*!
+      \brief Get the result of the task.
+      \returns Status code returned by the task.
+    */
+    int16_t await_resume() noexcept;
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    std::coroutine_handle<promise_type> handle;
+
+    explicit RadioLibTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    friend class RadioLibExecutor;
+};
+
+/*!
+  \class RadioLibExecutor
+  \brief Runs coroutines on a single thread. Tasks are resumed only when a radio interrupt
+  was received or an operation timed out; the thread sleeps in between.
+*/
+class RadioLibExecutor {
+  public:
+    /*!
+      \brief Start a task, it will be run by the next call to run.
+      \param task Task to start.
+    */
+    void spawn(RadioLibTask&& task);
+
+    /*!
+      \brief Run all spawned tasks until they have returned.
+    */
+    void run();
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<AwaitableClient*> waiting;
+    size_t numTasks = 0;
+
+    // called from the radio interrupt
+    void notify(AwaitableClient* client);
+
+    // add a client with a pending operation
+    void wait(AwaitableClient* client);
+
+    friend class AwaitableClient;
+    friend struct RadioLibTask::promise_type::FinalAwaiter;
+    friend void AwaitableClientInterrupt(int8_t slot);
+};
+
+/*!
+  \class AwaitableClient
+  \brief Awaitable radio operations for C++20 coroutines. The radio interrupt only marks
+  the operation as done, all SPI transfers are made from the executor thread.
+*/
+class AwaitableClient {
+  public:
+    /*!
+      \brief Default constructor.
+      \param phy Pointer to the wireless module providing PhysicalLayer communication.
+      \param executor Executor that runs the coroutines using this radio.
+    */
+    AwaitableClient(PhysicalLayer* phy, RadioLibExecutor* executor);
+
+    /*!
+      \brief Default destructor, releases the interrupt slot.
+    */
+    ~AwaitableClient();
+
+    /*!
+      \brief Awaitable operation of the radio, resumed with its status code.
+    */
+    struct Operation {
+      /*! \brief Client running the operation. */
+      AwaitableClient* client;
+
+      /*! \brief Operation is never complete before it was started. */
+      bool await_ready() noexcept { return(false); }
+
+      /*!
+        \brief Start the operation.
+        \param handle Awaiting coroutine.
+        \returns False if it failed to start, the coroutine then continues right away.
+      */
+      bool await_suspend(std::coroutine_handle<> handle);
+
+      /*!
+        \brief Get the result of the operation.
+        \returns \ref status_codes
+      */
+      int16_t await_resume() noexcept;
+    };
+
+    /*!
+      \brief Transmit a packet, resumes once it was sent.
+      \param data Binary data to transmit, must be valid until the operation returns.
+      \param len Length of binary data to transmit (in bytes).
+      \param addr Node address to transmit the packet to. Only used in FSK mode.
+      \returns Awaitable operation, \ref status_codes.
+    */
+    Operation transmitAsync(const uint8_t* data, size_t len, uint8_t addr = 0);
+
+    /*!
+      \brief Receive a packet, resumes once it was received or the timeout expired.
+      The packet length can be read afterwards by PhysicalLayer::getPacketLength.
+      \param data Buffer to save the received data into.
+      \param len Number of bytes to read, 0 to read the complete packet.
+      \param timeout Receive timeout in microseconds, 0 to wait for a packet indefinitely.
+      \returns Awaitable operation, \ref status_codes, RADIOLIB_ERR_RX_TIMEOUT if nothing was received.
+    */
+    Operation receiveAsync(uint8_t* data, size_t len, RadioLibTime_t timeout = 0);
+
+    /*!
+      \brief Scan the channel for activity, resumes with the result.
+      \returns Awaitable operation, same results as PhysicalLayer::getChannelScanResult.
+    */
+    Operation scanChannelAsync();
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    PhysicalLayer* phyLayer;
+    RadioLibExecutor* executor;
+    int8_t slot = -1;
+
+    // the pending operation, parameters are only used by the executor thread
+    enum OperationType_t { OP_TRANSMIT, OP_RECEIVE, OP_SCAN };
+    OperationType_t opType = OP_TRANSMIT;
+    const uint8_t* txData = nullptr;
+    uint8_t txAddr = 0;
+    uint8_t* rxData = nullptr;
+    size_t opLen = 0;
+    RadioLibTime_t opTimeout = 0;
+    int16_t opResult = RADIOLIB_ERR_NONE;
+    std::coroutine_handle<> opHandle;
+    std::chrono::steady_clock::time_point opDeadline;
+
+    // set from the radio interrupt
+    bool fired = false;
+
+    int16_t start();
+    void finish(bool expired);
+
+    friend class RadioLibExecutor;
+    friend void AwaitableClientInterrupt(int8_t slot);
+};
+
+#endif
+
+#endif
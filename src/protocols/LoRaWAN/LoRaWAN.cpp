@@ -1,4 +1,5 @@
 #include "LoRaWAN.h"
+#include "../../utils/CRC.h"
 #include <string.h>
 #if defined(ESP_PLATFORM)
 #include "esp_attr.h"
@@ -6,6 +7,13 @@
 
 #if !RADIOLIB_EXCLUDE_LORAWAN
 
+// storage of the flags set from interrupt service routines
+#if RADIOLIB_LORAWAN_THREAD_LOCAL
+  #define RADIOLIB_LORAWAN_ISR_FLAG   static thread_local
+#else
+  #define RADIOLIB_LORAWAN_ISR_FLAG   static
+#endif
+
 constexpr LoRaWANMacCommand_t MacTable[RADIOLIB_LORAWAN_NUM_MAC_COMMANDS] = {
   { RADIOLIB_LORAWAN_MAC_RESET,               1, 1, true,  false },
   { RADIOLIB_LORAWAN_MAC_LINK_CHECK,          2, 0, false, true  },
@@ -22,10 +30,42 @@ constexpr LoRaWANMacCommand_t MacTable[RADIOLIB_LORAWAN_NUM_MAC_COMMANDS] = {
   { RADIOLIB_LORAWAN_MAC_DEVICE_TIME,         5, 0, false, true  },
   { RADIOLIB_LORAWAN_MAC_FORCE_REJOIN,        2, 0, false, false },
   { RADIOLIB_LORAWAN_MAC_REJOIN_PARAM_SETUP,  1, 1, false, false },
+  { RADIOLIB_LORAWAN_MAC_PING_SLOT_INFO,      0, 1, false, false },
+  { RADIOLIB_LORAWAN_MAC_PING_SLOT_CHANNEL,   4, 1, true,  false },
+  { RADIOLIB_LORAWAN_MAC_BEACON_TIMING,       3, 0, false, true  },
+  { RADIOLIB_LORAWAN_MAC_BEACON_FREQ,         3, 1, true,  false },
   { RADIOLIB_LORAWAN_MAC_DEVICE_MODE,         1, 1, true,  false },
   { RADIOLIB_LORAWAN_MAC_PROPRIETARY,         5, 0, false, true  },
 };
 
+// MacTable is indexed by CID: the standard commands are contiguous from ResetInd up to BeaconFreqReq,
+// followed by DeviceModeInd and the proprietary command
+#define RADIOLIB_LORAWAN_MAC_SLOT_DEVICE_MODE   (RADIOLIB_LORAWAN_MAC_BEACON_FREQ)
+#define RADIOLIB_LORAWAN_MAC_SLOT_PROPRIETARY   (RADIOLIB_LORAWAN_MAC_BEACON_FREQ + 1)
+
+constexpr bool macTableOrdered(size_t slot) {
+  return((slot >= RADIOLIB_LORAWAN_MAC_BEACON_FREQ) || 
+         ((MacTable[slot].cid == slot + RADIOLIB_LORAWAN_MAC_RESET) && macTableOrdered(slot + 1)));
+}
+
+static_assert(macTableOrdered(0), "MacTable must be ordered by CID");
+static_assert(MacTable[RADIOLIB_LORAWAN_MAC_SLOT_DEVICE_MODE].cid == RADIOLIB_LORAWAN_MAC_DEVICE_MODE, "MacTable must be ordered by CID");
+static_assert(MacTable[RADIOLIB_LORAWAN_MAC_SLOT_PROPRIETARY].cid == RADIOLIB_LORAWAN_MAC_PROPRIETARY, "MacTable must be ordered by CID");
+
+// constant-time lookup of a MAC command in MacTable, NULL if it is not a base specification command
+static inline const LoRaWANMacCommand_t* findMacCommand(uint8_t cid) {
+  if((cid >= RADIOLIB_LORAWAN_MAC_RESET) && (cid <= RADIOLIB_LORAWAN_MAC_BEACON_FREQ)) {
+    return(&MacTable[cid - RADIOLIB_LORAWAN_MAC_RESET]);
+  }
+  if(cid == RADIOLIB_LORAWAN_MAC_DEVICE_MODE) {
+    return(&MacTable[RADIOLIB_LORAWAN_MAC_SLOT_DEVICE_MODE]);
+  }
+  if(cid == RADIOLIB_LORAWAN_MAC_PROPRIETARY) {
+    return(&MacTable[RADIOLIB_LORAWAN_MAC_SLOT_PROPRIETARY]);
+  }
+  return(NULL);
+}
+
 LoRaWANNode::LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand) {
   this->phyLayer = phy;
   this->band = band;
@@ -37,6 +77,16 @@ LoRaWANNode::LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t
   for(int i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS; i++) {
     this->mcGroups[i] = RADIOLIB_MULTICAST_GROUP_NONE;
   }
+  this->clearTimeOnAirCache();
+
+  // all duty cycle buckets start out full
+  for(int i = 0; i <= RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS; i++) {
+    this->dcTokens[i] = INT32_MAX;
+    this->dcTime[i] = 0;
+  }
+
+  // keys are not kept in the AES engine unless requested
+  memset(this->keyIds, RADIOLIB_LORAWAN_KEY_ID_NONE, sizeof(this->keyIds));
 
   // if the user does not provide their own AES-128, use the software one
   #if !RADIOLIB_CUSTOM_AES128
@@ -97,6 +147,277 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   if((lenUp > 0 && !dataUp) || !dataDown || !lenDown) {
     return(RADIOLIB_ERR_NULL_POINTER);
   }
+
+  // the radio is in use by a non-blocking sequence
+  if(this->asyncState != RADIOLIB_LORAWAN_ASYNC_IDLE) {
+    return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  }
+
+  int16_t state = this->prepareUplink(lenUp, fPort);
+  RADIOLIB_ASSERT(state);
+
+  // the first 16 bytes are reserved for MIC calculation blocks
+  size_t uplinkMsgLen = RADIOLIB_LORAWAN_FRAME_LEN(lenUp, this->fOptsUpLen);
+  #if RADIOLIB_STATIC_ONLY
+  uint8_t uplinkMsg[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
+  #else
+  uint8_t* uplinkMsg = new uint8_t[uplinkMsgLen];
+  #endif
+
+  // build the encrypted uplink message
+  this->buildUplink(dataUp, lenUp, fPort, isConfirmed, uplinkMsg);
+
+  // repeat uplink+downlink up to 'nbTrans' times (ADR)
+  uint8_t trans = 0;
+  for(; trans < this->nbTrans; trans++) {
+
+    // select channels, set the MIC and perform CSMA if enabled
+    this->selectUplinkChannel(uplinkMsg, uplinkMsgLen);
+    
+    // send it (without the MIC calculation blocks)
+    state = this->transmitUplink(&this->channels[RADIOLIB_LORAWAN_UPLINK],
+                                &uplinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS], 
+                                (uint8_t)(uplinkMsgLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS));
+    if(state != RADIOLIB_ERR_NONE) {
+      // sometimes, a spurious error can occur even though the uplink was transmitted
+      // therefore, just to be safe, increase frame counter by one for the next uplink
+      this->fCntUp += 1;
+
+      #if !RADIOLIB_STATIC_ONLY
+      delete[] uplinkMsg;
+      #endif
+      return(state);
+    }
+
+    // handle Rx windows - returns window > 0 if a downlink is received
+    state = this->receiveDownlink();
+
+    // if an error occured or a downlink was received, stop retransmission
+    if(state != RADIOLIB_ERR_NONE) {
+      break;
+    }
+    // if no downlink was received, go on
+
+    // When an end-device has requested an ACK from the Network but has not yet received it, 
+    // it SHALL wait RETRANSMIT_TIMEOUT seconds after RECEIVE_DELAY2 seconds have elapsed 
+    // after the end of the previous uplink transmission before sending a new uplink (repetition or new frame). 
+    // The RETRANSMIT_TIMEOUT delay is not required between unconfirmed uplinks, 
+    // or after the ACK has been successfully demodulated by the end-device.
+    if(isConfirmed) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Retransmit timeout");
+      int min = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MIN_MS;
+      int max = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MAX_MS;
+      this->sleepDelay(min + this->randomNumber(max - min));
+    }
+
+  } // end of transmission & reception
+
+  #if !RADIOLIB_STATIC_ONLY
+    delete[] uplinkMsg;
+  #endif
+
+  return(this->finishSendReceive(state, trans, fPort, isConfirmed, dataDown, lenDown, eventUp, eventDown));
+}
+
+int16_t LoRaWANNode::queueUplink(const uint8_t* data, size_t len, uint8_t fPort, RadioLibTime_t maxDelay, bool isConfirmed, uint8_t* id) {
+  if(len > 0 && !data) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // the record must fit into a single frame on its own
+  int16_t state = this->isValidUplink(len, fPort);
+  RADIOLIB_ASSERT(state);
+
+  if((this->upQueueNum >= RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN) || (this->upQueueUsed + len > RADIOLIB_LORAWAN_UPLINK_QUEUE_SIZE)) {
+    return(RADIOLIB_ERR_UPLINK_QUEUE_FULL);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  LoRaWANQueuedUplink_t* record = &this->upQueue[this->upQueueNum++];
+  record->id = this->upQueueId++;
+  record->fPort = fPort;
+  record->isConfirmed = isConfirmed;
+  record->len = len;
+  record->deadline = mod->hal->millis() + maxDelay;
+  memcpy(&this->upQueueData[this->upQueueUsed], data, len);
+  this->upQueueUsed += len;
+
+  if(id) {
+    *id = record->id;
+  }
+  return(RADIOLIB_ERR_NONE);
+}
+
+int8_t LoRaWANNode::queuedUplinkLead(RadioLibTime_t tNow, bool force) {
+  if(this->upQueueNum == 0) {
+    return(-1);
+  }
+
+  // the record with the earliest deadline goes first
+  int8_t lead = 0;
+  for(uint8_t i = 1; i < this->upQueueNum; i++) {
+    if(this->upQueue[i].deadline < this->upQueue[lead].deadline) {
+      lead = i;
+    }
+  }
+  if(force || (this->upQueue[lead].deadline <= tNow)) {
+    return(lead);
+  }
+
+  // if any FPort has enough records to fill a frame, send that one
+  uint8_t maxLen = this->getMaxPayloadLen();
+  for(uint8_t i = 0; i < this->upQueueNum; i++) {
+    size_t total = 0;
+    for(uint8_t j = i; j < this->upQueueNum; j++) {
+      if(this->upQueue[j].fPort == this->upQueue[i].fPort) {
+        total += this->upQueue[j].len;
+      }
+    }
+    if(total >= maxLen) {
+      return(i);
+    }
+  }
+
+  // make room if the queue cannot take another record
+  if((this->upQueueNum >= RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN) || (this->upQueueUsed + maxLen > RADIOLIB_LORAWAN_UPLINK_QUEUE_SIZE)) {
+    return(lead);
+  }
+
+  return(-1);
+}
+
+int16_t LoRaWANNode::sendQueued(uint8_t* dataDown, size_t* lenDown, bool force, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if(!dataDown || !lenDown) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  int8_t lead = this->queuedUplinkLead(mod->hal->millis(), force);
+  if(lead < 0) {
+    return(RADIOLIB_LORAWAN_QUEUE_WAITING);
+  }
+
+  // the datarate may have dropped since the record was queued
+  uint8_t maxLen = this->getMaxPayloadLen();
+  bool packed[RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN] = { false };
+  int16_t state = RADIOLIB_ERR_NONE;
+  if(this->upQueue[lead].len > maxLen) {
+    packed[lead] = true;
+    state = RADIOLIB_ERR_PACKET_TOO_LONG;
+    if(this->upQueueCb) {
+      this->upQueueCb(this->upQueue[lead].id, state);
+    }
+
+  } else {
+    // pack the lead record first, then all other records for the same FPort that still fit
+    uint8_t frame[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE];
+    size_t frameLen = 0;
+    uint8_t fPort = this->upQueue[lead].fPort;
+    bool isConfirmed = false;
+    for(int i = -1; i < this->upQueueNum; i++) {
+      uint8_t idx = (i < 0) ? lead : i;
+      const LoRaWANQueuedUplink_t* record = &this->upQueue[idx];
+      if(packed[idx] || (record->fPort != fPort) || (frameLen + record->len > maxLen)) {
+        continue;
+      }
+      size_t offset = 0;
+      for(uint8_t j = 0; j < idx; j++) {
+        offset += this->upQueue[j].len;
+      }
+      memcpy(&frame[frameLen], &this->upQueueData[offset], record->len);
+      frameLen += record->len;
+      isConfirmed |= record->isConfirmed;
+      packed[idx] = true;
+    }
+
+    LoRaWANEvent_t event;
+    if(!eventDown) {
+      eventDown = &event;
+    }
+    state = this->sendReceive(frame, frameLen, fPort, dataDown, lenDown, isConfirmed, eventUp, eventDown);
+
+    // nothing was sent, so the records stay queued
+    if((state == RADIOLIB_ERR_UPLINK_UNAVAILABLE) || (state == RADIOLIB_LORAWAN_SEQUENCE_BUSY) || 
+       (state == RADIOLIB_ERR_NETWORK_NOT_JOINED)) {
+      return(state);
+    }
+    bool acked = (state > 0) && eventDown->confirming;
+
+    // report delivery, confirmed records are only delivered once acknowledged
+    for(uint8_t i = 0; i < this->upQueueNum; i++) {
+      if(packed[i] && this->upQueueCb) {
+        int16_t recordState = (state < RADIOLIB_ERR_NONE) ? state : RADIOLIB_ERR_NONE;
+        if(this->upQueue[i].isConfirmed && !acked && (recordState == RADIOLIB_ERR_NONE)) {
+          recordState = RADIOLIB_ERR_ACK_NOT_RECEIVED;
+        }
+        this->upQueueCb(this->upQueue[i].id, recordState);
+      }
+    }
+  }
+
+  // remove the sent records, keeping the rest in order
+  uint8_t num = 0;
+  size_t used = 0;
+  size_t offset = 0;
+  for(uint8_t i = 0; i < this->upQueueNum; i++) {
+    uint8_t len = this->upQueue[i].len;
+    if(!packed[i]) {
+      memmove(&this->upQueueData[used], &this->upQueueData[offset], len);
+      this->upQueue[num++] = this->upQueue[i];
+      used += len;
+    }
+    offset += len;
+  }
+  this->upQueueNum = num;
+  this->upQueueUsed = used;
+
+  return(state);
+}
+
+RadioLibTime_t LoRaWANNode::timeUntilQueuedUplink() {
+  if(this->upQueueNum == 0) {
+    return(RADIOLIB_LORAWAN_QUEUE_EMPTY);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  RadioLibTime_t tNext = tNow;
+  int8_t lead = this->queuedUplinkLead(tNow, false);
+  if(lead < 0) {
+    lead = 0;
+    for(uint8_t i = 1; i < this->upQueueNum; i++) {
+      if(this->upQueue[i].deadline < this->upQueue[lead].deadline) {
+        lead = i;
+      }
+    }
+    tNext = this->upQueue[lead].deadline;
+  }
+
+  // the frame cannot be sent before dutycycle allows it, so it has to include all records packed with the lead one
+  size_t frameLen = 0;
+  for(uint8_t i = 0; i < this->upQueueNum; i++) {
+    if(this->upQueue[i].fPort == this->upQueue[lead].fPort) {
+      frameLen += this->upQueue[i].len;
+    }
+  }
+  frameLen = RADIOLIB_MIN(frameLen, (size_t)this->getMaxPayloadLen());
+  RadioLibTime_t wait = this->timeUntilUplink((uint8_t)frameLen);
+  if(wait == RADIOLIB_LORAWAN_UPLINK_NEVER) {
+    return(RADIOLIB_LORAWAN_UPLINK_NEVER);
+  }
+  tNext = RADIOLIB_MAX(tNext, tNow + wait);
+  return(tNext - tNow);
+}
+
+uint8_t LoRaWANNode::getNumQueuedUplinks() {
+  return(this->upQueueNum);
+}
+
+void LoRaWANNode::setQueuedUplinkCb(QueuedUplinkCb_t cb) {
+  this->upQueueCb = cb;
+}
+
+int16_t LoRaWANNode::prepareUplink(size_t lenUp, uint8_t fPort) {
   int16_t state = RADIOLIB_ERR_UNKNOWN;
   
   // if after (at) ADR_ACK_LIMIT frames no RekeyConf was received, revert to Join state
@@ -119,32 +440,37 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
     this->tUplink = tNow;
   }
 
-  // if dutycycle is enabled and the time since last uplink + interval has not elapsed, return an error
-  if(this->dutyCycleEnabled) {
-    if(this->tUplinkEnd + (RadioLibTime_t)dutyCycleInterval(this->dutyCycle, this->lastToA) > this->tUplink) {
-      return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
-    }
-  }
-
   if(lenUp == 0 && fPort == 0) {
     this->isMACPayload = true;
   }
 
-  // check if the requested payload + fPort are allowed, also given dutycycle
+  // let the rate predictor pick datarate and power for this uplink
+  this->predictRate(lenUp);
+
+  // check if the requested payload + fPort are allowed
   state = this->isValidUplink(lenUp, fPort);
   RADIOLIB_ASSERT(state);
 
+  // if dutycycle is enabled and no channel has airtime left for this uplink at the scheduled time, return an error
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  this->dcToA = this->getTimeOnAir(drUp, lenUp + this->fOptsUpLen + 13) / 1000;
+  if(this->dutyCycleEnabled) {
+    if(this->dutyCycleNextTime(this->dcToA) > this->tUplink) {
+      return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
+    }
+  }
+
   // clear the MAC downlink buffer as we are going to transmit a new uplink
   memset(this->fOptsDown, 0, RADIOLIB_LORAWAN_FHDR_FOPTS_MAX_LEN);
   this->fOptsDownLen = 0;
 
-  // the first 16 bytes are reserved for MIC calculation blocks
-  size_t uplinkMsgLen = RADIOLIB_LORAWAN_FRAME_LEN(lenUp, this->fOptsUpLen);
+  return(RADIOLIB_ERR_NONE);
+}
+
+void LoRaWANNode::buildUplink(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, bool isConfirmed, uint8_t* uplinkMsg) {
   #if RADIOLIB_STATIC_ONLY
-  uint8_t uplinkMsg[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
   uint8_t frmPayload[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
   #else
-  uint8_t* uplinkMsg = new uint8_t[uplinkMsgLen];
   uint8_t* frmPayload = new uint8_t[lenUp + this->fOptsUpLen];
   #endif
 
@@ -169,71 +495,36 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   // build the encrypted uplink message
   this->composeUplink(frmPayload, frmLen, uplinkMsg, fPort, isConfirmed);
 
+  #if !RADIOLIB_STATIC_ONLY
+  delete[] frmPayload;
+  #endif
+
   // reset Time-on-Air as we are starting new uplink sequence
   this->lastToA = 0;
+}
 
-  // repeat uplink+downlink up to 'nbTrans' times (ADR)
-  uint8_t trans = 0;
-  for(; trans < this->nbTrans; trans++) {
-
-    // keep track of number of hopped channels
-    uint8_t numHops = this->maxChanges;
-
-    // number of additional CAD tries
-    uint8_t numBackoff = 0;
-    if(this->backoffMax) {
-      numBackoff = 1 + rand() % this->backoffMax;
-    }
-
-    do {
-      // select a pair of Tx/Rx channels for uplink+downlink
-      this->selectChannels();
-
-      // generate and set uplink MIC (depends on selected channel)
-      this->micUplink(uplinkMsg, uplinkMsgLen);
-
-    // if CSMA is enabled, repeat channel selection & encryption up to numHops times
-    } while(this->csmaEnabled && numHops-- > 0 && !this->csmaChannelClear(this->difsSlots, numBackoff));
-    
-    // send it (without the MIC calculation blocks)
-    state = this->transmitUplink(&this->channels[RADIOLIB_LORAWAN_UPLINK],
-                                &uplinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS], 
-                                (uint8_t)(uplinkMsgLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS));
-    if(state != RADIOLIB_ERR_NONE) {
-      // sometimes, a spurious error can occur even though the uplink was transmitted
-      // therefore, just to be safe, increase frame counter by one for the next uplink
-      this->fCntUp += 1;
-
-      #if !RADIOLIB_STATIC_ONLY
-      delete[] uplinkMsg;
-      delete[] frmPayload;
-      #endif
-      return(state);
-    }
+void LoRaWANNode::selectUplinkChannel(uint8_t* uplinkMsg, size_t uplinkMsgLen) {
+  // keep track of number of hopped channels
+  uint8_t numHops = this->maxChanges;
 
-    // handle Rx windows - returns window > 0 if a downlink is received
-    state = this->receiveDownlink();
+  // number of additional CAD tries
+  uint8_t numBackoff = 0;
+  if(this->backoffMax) {
+    numBackoff = 1 + this->randomNumber(this->backoffMax);
+  }
 
-    // if an error occured or a downlink was received, stop retransmission
-    if(state != RADIOLIB_ERR_NONE) {
-      break;
-    }
-    // if no downlink was received, go on
+  do {
+    // select a pair of Tx/Rx channels for uplink+downlink
+    this->selectChannels();
 
-    // When an end-device has requested an ACK from the Network but has not yet received it, 
-    // it SHALL wait RETRANSMIT_TIMEOUT seconds after RECEIVE_DELAY2 seconds have elapsed 
-    // after the end of the previous uplink transmission before sending a new uplink (repetition or new frame). 
-    // The RETRANSMIT_TIMEOUT delay is not required between unconfirmed uplinks, 
-    // or after the ACK has been successfully demodulated by the end-device.
-    if(isConfirmed) {
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Retransmit timeout");
-      int min = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MIN_MS;
-      int max = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MAX_MS;
-      this->sleepDelay(min + rand() % (max - min));
-    }
+    // generate and set uplink MIC (depends on selected channel)
+    this->micUplink(uplinkMsg, uplinkMsgLen);
 
-  } // end of transmission & reception
+  // if CSMA is enabled, repeat channel selection & encryption up to numHops times
+  } while(this->csmaEnabled && numHops-- > 0 && !this->csmaChannelClear(this->difsSlots, numBackoff));
+}
 
+int16_t LoRaWANNode::finishSendReceive(int16_t state, uint8_t trans, uint8_t fPort, bool isConfirmed, uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
   // note: if an error occurred, it may still be the case that a transmission occurred
   // therefore, we act as if a transmission occurred before throwing the actual error
   // this feels to be the best way to comply to spec
@@ -256,13 +547,10 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
     eventUp->fPort = fPort;
     eventUp->nbTrans = trans;
     eventUp->multicast = false;
+    eventUp->predicted = this->predicted;
+    eventUp->margin = this->predictedMargin;
   }
 
-  #if !RADIOLIB_STATIC_ONLY
-    delete[] uplinkMsg;
-    delete[] frmPayload;
-  #endif
-
   // if a hardware error occurred, return
   if(state < RADIOLIB_ERR_NONE) {
     return(state);
@@ -284,6 +572,11 @@ int16_t LoRaWANNode::sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fP
   state = this->parseDownlink(dataDown, lenDown, rxWindow, eventDown);
   RADIOLIB_ASSERT(state);
 
+  // the downlink SNR is a sample of the link quality
+  if(this->predictorEnabled) {
+    this->predictorSample((int8_t)this->phyLayer->getSNR());
+  }
+
   // open RxC window (this returns if not applicable)
   this->receiveClassC();
   
@@ -376,6 +669,7 @@ void LoRaWANNode::clearSession() {
 
   // revert to default Class A
   this->lwClass = RADIOLIB_LORAWAN_CLASS_A;
+  this->pingOffsetTime = RADIOLIB_LORAWAN_FCNT_NONE;
 
   // reset all channels
   memset(this->channels, 0, sizeof(this->channels));
@@ -392,7 +686,10 @@ void LoRaWANNode::clearSession() {
 
 void LoRaWANNode::createSession() {  
   // set a seed for the pseudo-rng using a truly random value from radio noise
-  srand(this->phyLayer->random(INT32_MAX));
+  // not needed when the user provides a generator, which may be private to this node
+  if(!this->randomCb) {
+    srand(this->phyLayer->random(INT32_MAX));
+  }
 
   // setup default channels
   if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
@@ -431,15 +728,8 @@ void LoRaWANNode::createSession() {
   // set maximum dutycycle
   cid = RADIOLIB_LORAWAN_MAC_DUTY_CYCLE;
   this->getMacLen(cid, &cLen, RADIOLIB_LORAWAN_DOWNLINK);
+  // no limit on top of the regulatory one, which is tracked per sub-band
   uint8_t maxDCyclePower = 0;
-  switch(this->band->dutyCycle) {
-    case(3600):
-      maxDCyclePower = 10;
-      break;
-    case(36000):
-      maxDCyclePower = 7;
-      break;
-  }
   cOcts[0]  = maxDCyclePower;
   (void)execMacCommand(cid, cOcts, cLen);
 
@@ -643,10 +933,16 @@ int16_t LoRaWANNode::setBufferSession(const uint8_t* persistentBuffer) {
   memcpy(this->nwkSEncKey,  &this->bufferSession[RADIOLIB_LORAWAN_SESSION_NWK_SENC_KEY],  RADIOLIB_AES128_BLOCK_SIZE);
   memcpy(this->fNwkSIntKey, &this->bufferSession[RADIOLIB_LORAWAN_SESSION_FNWK_SINT_KEY], RADIOLIB_AES128_BLOCK_SIZE);
   memcpy(this->sNwkSIntKey, &this->bufferSession[RADIOLIB_LORAWAN_SESSION_SNWK_SINT_KEY], RADIOLIB_AES128_BLOCK_SIZE);
+  this->bindKeys();
 
   // restore session parameters
   this->rev          = LoRaWANNode::ntoh<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_VERSION]);
   this->lwClass      = LoRaWANNode::ntoh<uint8_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_CLASS]);
+
+  // the beacon must be acquired again before Class B can be resumed
+  if(this->lwClass == RADIOLIB_LORAWAN_CLASS_B) {
+    this->lwClass = RADIOLIB_LORAWAN_CLASS_A;
+  }
   this->aFCntDown    = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_A_FCNT_DOWN]);
   this->nFCntDown    = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_N_FCNT_DOWN]);
   this->confFCntUp   = LoRaWANNode::ntoh<uint32_t>(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_CONF_FCNT_UP]);
@@ -686,6 +982,7 @@ int16_t LoRaWANNode::beginOTAA(uint64_t joinEUI, uint64_t devEUI, const uint8_t*
   }
 
   this->lwMode = RADIOLIB_LORAWAN_MODE_OTAA;
+  this->bindKeys();
 
   return(RADIOLIB_ERR_NONE);
 }
@@ -718,10 +1015,51 @@ int16_t LoRaWANNode::beginABP(uint32_t addr, const uint8_t* fNwkSIntKey, const u
   if(sNwkSIntKey) { this->keyCheckSum ^= LoRaWANNode::checkSum16(sNwkSIntKey, RADIOLIB_AES128_KEY_SIZE); }
 
   this->lwMode = RADIOLIB_LORAWAN_MODE_ABP;
+  this->bindKeys();
 
   return(RADIOLIB_ERR_NONE);
 }
 
+void LoRaWANNode::setKeyId(uint8_t key, uint8_t keyId) {
+  if(key >= RADIOLIB_LORAWAN_NUM_KEYS) {
+    return;
+  }
+  this->keyIds[key] = keyId;
+  if(keyId != RADIOLIB_LORAWAN_KEY_ID_NONE) {
+    Module* mod = this->phyLayer->getMod();
+    mod->hal->aes128->bindKey(this->getKey(key), keyId);
+  }
+}
+
+uint8_t* LoRaWANNode::getKey(uint8_t key) {
+  switch(key) {
+    case(RADIOLIB_LORAWAN_KEY_NWK):
+      return(this->nwkKey);
+    case(RADIOLIB_LORAWAN_KEY_APP):
+      return(this->appKey);
+    case(RADIOLIB_LORAWAN_KEY_APP_S):
+      return(this->appSKey);
+    case(RADIOLIB_LORAWAN_KEY_F_NWK_S_INT):
+      return(this->fNwkSIntKey);
+    case(RADIOLIB_LORAWAN_KEY_S_NWK_S_INT):
+      return(this->sNwkSIntKey);
+    case(RADIOLIB_LORAWAN_KEY_NWK_S_ENC):
+      return(this->nwkSEncKey);
+    case(RADIOLIB_LORAWAN_KEY_J_S_INT):
+      return(this->jSIntKey);
+  }
+  return(NULL);
+}
+
+void LoRaWANNode::bindKeys() {
+  Module* mod = this->phyLayer->getMod();
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_NUM_KEYS; i++) {
+    if(this->keyIds[i] != RADIOLIB_LORAWAN_KEY_ID_NONE) {
+      mod->hal->aes128->bindKey(this->getKey(i), this->keyIds[i]);
+    }
+  }
+}
+
 void LoRaWANNode::composeJoinRequest(uint8_t* out) {
   // copy devNonce currently in use
   uint16_t devNonceUsed = this->devNonce;
@@ -819,6 +1157,7 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
     LoRaWANNode::hton<uint64_t>(&keyDerivationBuff[1], this->devEUI);
     mod->hal->aes128->init(this->nwkKey);
     mod->hal->aes128->encryptECB(keyDerivationBuff, RADIOLIB_AES128_BLOCK_SIZE, this->jSIntKey);
+    this->setKeyId(RADIOLIB_LORAWAN_KEY_J_S_INT, this->keyIds[RADIOLIB_LORAWAN_KEY_J_S_INT]);
 
     // prepare the buffer for MIC calculation
     uint8_t micBuff[3*RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
@@ -900,6 +1239,9 @@ int16_t LoRaWANNode::processJoinAccept(LoRaWANJoinEvent_t *joinEvent) {
   
   }
 
+  // the session keys have changed
+  this->bindKeys();
+
   // for LW v1.1, send the RekeyInd MAC command
   if(this->rev == 1) {
     // enqueue the RekeyInd MAC command to be sent in the next uplink
@@ -961,9 +1303,15 @@ int16_t LoRaWANNode::activateOTAA(LoRaWANJoinEvent_t *joinEvent) {
     this->tUplink = tNow;
   }
 
-  // if dutycycle is enabled and the time since last uplink + interval has not elapsed, return an error
+  // if dutycycle is enabled and no channel has airtime left for the JoinRequest at the scheduled time, return an error
+  // the datarate may not be known before the first JoinRequest, then only the channel selected later is checked
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  this->dcToA = 0;
+  if(drUp < RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) {
+    this->dcToA = this->getTimeOnAir(drUp, RADIOLIB_LORAWAN_JOIN_REQUEST_LEN) / 1000;
+  }
   if(this->dutyCycleEnabled) {
-    if(this->tUplinkEnd + (RadioLibTime_t)dutyCycleInterval(this->dutyCycle, this->lastToA) > this->tUplink) {
+    if(this->dutyCycleNextTime(this->dcToA) > this->tUplink) {
       return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
     }
   }
@@ -1135,13 +1483,25 @@ int16_t LoRaWANNode::setClass(uint8_t cls) {
     return(RADIOLIB_ERR_UNSUPPORTED);
   }
 
-  // Class B is not implemented
+  // Class B is signalled to the network by the FCtrl bit in uplinks, so it can be entered at any time
+  // as long as the beacon is tracked, the ping slot periodicity is sent along with the next uplink
   if(cls == RADIOLIB_LORAWAN_CLASS_B) {
-    return(RADIOLIB_ERR_UNSUPPORTED);
+    if(!this->beaconLocked) {
+      return(RADIOLIB_ERR_NO_BEACON);
+    }
+
+    uint8_t cOct = this->pingPeriodicity;
+    (void)LoRaWANNode::deleteMacCommand(RADIOLIB_LORAWAN_MAC_PING_SLOT_INFO, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+    int16_t state = LoRaWANNode::pushMacCommand(RADIOLIB_LORAWAN_MAC_PING_SLOT_INFO, &cOct, this->fOptsUp, &this->fOptsUpLen, RADIOLIB_LORAWAN_UPLINK);
+    RADIOLIB_ASSERT(state);
+
+    this->phyLayer->standby();
+    this->lwClass = cls;
+    return(RADIOLIB_ERR_NONE);
   }
 
-  // for LoRaWAN v1.0.4, simply switch class
-  if(this->rev == 0) {
+  // for LoRaWAN v1.0.4, or when leaving Class B, simply switch class
+  if((this->rev == 0) || (this->lwClass == RADIOLIB_LORAWAN_CLASS_B && cls == RADIOLIB_LORAWAN_CLASS_A)) {
     this->lwClass = cls;
 
     // stop any ongoing activity
@@ -1180,18 +1540,37 @@ int16_t LoRaWANNode::startMulticastSession(uint8_t cls, uint32_t mcAddr, const u
 }
 
 int16_t LoRaWANNode::startMulticastSession(uint8_t id, MulticastGroup_t* mcGroup) {
-  if(!this->isActivated()) {
+  // check if the multicast group is valid
+  if(id >= RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS) {
+    return(RADIOLIB_ERR_INVALID_MULTICAST_GROUP);
+  }
+
+  int16_t state = this->checkMulticastSession(mcGroup);
+  RADIOLIB_ASSERT(state);
+
+  // all checks passed, so accept group
+  memcpy(&this->mcGroups[id], mcGroup, sizeof(MulticastGroup_t));
+
+  // get the latest multicast properties
+  this->channels[RADIOLIB_LORAWAN_RX_BC].freq = this->getMulticastFrequency();
+  this->channels[RADIOLIB_LORAWAN_RX_BC].dr = this->getMulticastDatarate();
+
+  // open the RxC window with Multicast configuration
+  if(mcGroup->cls == RADIOLIB_LORAWAN_CLASS_C) {
+    this->receiveClassC();
+  }
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::checkMulticastSession(MulticastGroup_t* mcGroup) {
+  if(!this->isActivated()) {
     return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
   }
   
   if(mcGroup == NULL) {
     return(RADIOLIB_ERR_NULL_POINTER);
   }
-  
-  // check if the multicast group is valid
-  if(id >= RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS) {
-    return(RADIOLIB_ERR_INVALID_MULTICAST_GROUP);
-  }
 
   // currently only possible for Class C
   if(mcGroup->cls == RADIOLIB_LORAWAN_CLASS_B) {
@@ -1210,7 +1589,7 @@ int16_t LoRaWANNode::startMulticastSession(uint8_t id, MulticastGroup_t* mcGroup
   if(mcGroup->mcDr == RADIOLIB_LORAWAN_DATA_RATE_UNUSED) {
     mcGroup->mcDr = this->channels[RADIOLIB_LORAWAN_RX2].dr;
   }
-  if(this->band->dataRates[mcGroup->mcDr].modem == RADIOLIB_MODEM_NONE) {
+  if((mcGroup->mcDr >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) || (this->band->dataRates[mcGroup->mcDr].modem == RADIOLIB_MODEM_NONE)) {
     return(RADIOLIB_ERR_INVALID_DATA_RATE);
   }
 
@@ -1219,18 +1598,6 @@ int16_t LoRaWANNode::startMulticastSession(uint8_t id, MulticastGroup_t* mcGroup
     return(RADIOLIB_ERR_MULTICAST_FCNT_INVALID);
   }
 
-  // all checks passed, so accept group
-  memcpy(&this->mcGroups[id], mcGroup, sizeof(MulticastGroup_t));
-
-  // get the latest multicast properties
-  this->channels[RADIOLIB_LORAWAN_RX_BC].freq = this->getMulticastFrequency();
-  this->channels[RADIOLIB_LORAWAN_RX_BC].dr = this->getMulticastDatarate();
-
-  // open the RxC window with Multicast configuration
-  if(mcGroup->cls == RADIOLIB_LORAWAN_CLASS_C) {
-    this->receiveClassC();
-  }
-
   return(RADIOLIB_ERR_NONE);
 }
 
@@ -1294,6 +1661,151 @@ int16_t LoRaWANNode::isValidUplink(size_t len, uint8_t fPort) {
   return(RADIOLIB_ERR_NONE);
 }
 
+void LoRaWANNode::predictorSample(int8_t snr) {
+  this->predictorSnr[this->predictorIdx] = snr;
+  this->predictorIdx = (this->predictorIdx + 1) % RADIOLIB_LORAWAN_PREDICTOR_HISTORY;
+  if(this->predictorNum < RADIOLIB_LORAWAN_PREDICTOR_HISTORY) {
+    this->predictorNum++;
+  }
+  this->predictorAge = 0;
+}
+
+int16_t LoRaWANNode::getRequiredSnr(uint8_t dr) {
+  if((dr >= RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) || (this->band->dataRates[dr].modem != RADIOLIB_MODEM_LORA)) {
+    return(INT16_MIN);
+  }
+
+  // demodulation floor is -7.5 dB at SF7 and drops by 2.5 dB per SF
+  int16_t sf = this->band->dataRates[dr].dr.lora.spreadingFactor;
+  return(-75 - 25*(sf - 7));
+}
+
+bool LoRaWANNode::predictorDrValid(uint8_t dr, size_t lenUp) {
+  if(this->getRequiredSnr(dr) == INT16_MIN) {
+    return(false);
+  }
+
+  // with ADR, the network sets the fastest datarate
+  if(this->adrEnabled && (dr > this->netDr)) {
+    return(false);
+  }
+
+  // the uplink must fit and adhere to dwell time
+  if(lenUp + this->fOptsUpLen > this->band->payloadLenMax[dr]) {
+    return(false);
+  }
+  if(this->dwellTimeUp && (this->getTimeOnAir(dr, lenUp + this->fOptsUpLen + 13) / 1000 > this->dwellTimeUp)) {
+    return(false);
+  }
+
+  // at least one enabled channel must allow this datarate
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+    for(int i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_DYNAMIC_CHANNELS; i++) {
+      const LoRaWANChannel_t* chnl = &this->dynamicChannels[RADIOLIB_LORAWAN_UPLINK][i];
+      if((this->channelMasks[0] & (0x0001 << i)) && (dr >= chnl->drMin) && (dr <= chnl->drMax)) {
+        return(true);
+      }
+    }
+    return(false);
+  }
+
+  // fixed bands: the first span uses the first mask banks, the second span the last bank
+  if((dr >= this->band->txSpans[0].drMin) && (dr <= this->band->txSpans[0].drMax)) {
+    for(int i = 0; i < this->band->txSpans[0].numChannels / 16; i++) {
+      if(this->channelMasks[i]) {
+        return(true);
+      }
+    }
+  }
+  if((this->band->numTxSpans > 1) && (dr >= this->band->txSpans[1].drMin) && (dr <= this->band->txSpans[1].drMax)) {
+    if(this->channelMasks[4]) {
+      return(true);
+    }
+  }
+  return(false);
+}
+
+void LoRaWANNode::predictRate(size_t lenUp) {
+  this->predicted = false;
+  this->predictedMargin = RADIOLIB_LORAWAN_MARGIN_UNKNOWN;
+  if(!this->predictorEnabled) {
+    return;
+  }
+
+  // samples that are too old say nothing about the current link, so the last prediction is dropped as well
+  if((this->predictorAge >= RADIOLIB_LORAWAN_PREDICTOR_MAX_AGE) && (this->predictorNum > 0)) {
+    this->predictorNum = 0;
+    this->restoreNetRate();
+  }
+  this->predictorAge++;
+  uint8_t dr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  int16_t snrReq = this->getRequiredSnr(dr);
+  if((this->predictorNum == 0) || (snrReq == INT16_MIN)) {
+    return;
+  }
+
+  // average link SNR at maximum power, in 0.1 dB
+  int16_t snr = 0;
+  for(uint8_t i = 0; i < this->predictorNum; i++) {
+    snr += this->predictorSnr[i];
+  }
+  snr = snr * 10 / this->predictorNum;
+  int16_t margin = snr - snrReq;
+  this->predictedMargin = (int8_t)RADIOLIB_MAX(RADIOLIB_MIN(margin / 10, (int16_t)INT8_MAX), (int16_t)(INT8_MIN + 1));
+
+  // every 2.5 dB of excess margin is one datarate step, or one power step once the datarate is at its maximum
+  margin -= 10*this->predictorMargin;
+  int16_t steps = (margin >= 0) ? (margin / 25) : -((-margin + 24) / 25);
+
+  // start at maximum power, so that power is only reduced once the datarate cannot be increased any further
+  // with ADR, start at the power set by the network, it is only ever increased from there
+  uint8_t maxTxSteps = this->band->powerNumSteps;
+  uint8_t txSteps = 0;
+  if(this->adrEnabled) {
+    maxTxSteps = this->netTxSteps;
+    txSteps = this->netTxSteps;
+    steps -= txSteps;
+  }
+  while(steps > 0) {
+    if(this->predictorDrValid(dr + 1, lenUp)) {
+      dr++;
+    } else if(txSteps < maxTxSteps) {
+      txSteps++;
+    } else {
+      break;
+    }
+    steps--;
+  }
+  while((steps < 0) && (txSteps > 0)) {
+    txSteps--;
+    steps++;
+  }
+  while((steps < 0) && (dr > 0) && this->predictorDrValid(dr - 1, lenUp)) {
+    dr--;
+    steps++;
+  }
+
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Rate predictor: margin %d dB, DR%d, txSteps %d", this->predictedMargin, dr, txSteps);
+  this->txPowerSteps = txSteps;
+  if(dr != this->channels[RADIOLIB_LORAWAN_UPLINK].dr) {
+    this->channels[RADIOLIB_LORAWAN_UPLINK].dr = dr;
+    this->calculateChannelFlags();
+  }
+  this->predicted = true;
+}
+
+void LoRaWANNode::restoreNetRate() {
+  // go back to the datarate and power set by the network or the user
+  if(!this->isActivated()) {
+    return;
+  }
+  this->txPowerSteps = this->netTxSteps;
+  if(this->channels[RADIOLIB_LORAWAN_UPLINK].dr != this->netDr) {
+    this->channels[RADIOLIB_LORAWAN_UPLINK].dr = this->netDr;
+    this->calculateChannelFlags();
+  }
+}
+
 void LoRaWANNode::adrBackoff() {
   // check if we need to do ADR stuff
   uint32_t adrLimit = 0x01 << this->adrLimitExp;
@@ -1331,10 +1843,7 @@ void LoRaWANNode::adrBackoff() {
 
     // check if dwelltime limitation allows a lower datarate
     if(this->dwellTimeUp) {
-      const ModemType_t modem = this->band->dataRates[currentDr - 1].modem;
-      const DataRate_t* dr = &this->band->dataRates[currentDr - 1].dr;
-      const PacketConfig_t* pc = &this->band->dataRates[currentDr - 1].pc;
-      if(this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, 13) / 1000 > this->dwellTimeUp) {
+      if(this->getTimeOnAir(currentDr - 1, 13) / 1000 > this->dwellTimeUp) {
         return;
       }
     } 
@@ -1407,6 +1916,11 @@ void LoRaWANNode::composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out,
     out[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] |= RADIOLIB_LORAWAN_FCTRL_ACK;
   }
 
+  // let the network know that ping slots are open
+  if(this->lwClass == RADIOLIB_LORAWAN_CLASS_B) {
+    out[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] |= RADIOLIB_LORAWAN_FCTRL_CLASS_B;
+  }
+
   // set FCnt and FPort fields
   LoRaWANNode::hton<uint16_t>(&out[RADIOLIB_LORAWAN_FHDR_FCNT_POS], (uint16_t)this->fCntUp);
   out[RADIOLIB_LORAWAN_FHDR_FPORT_POS(this->fOptsUpLen)] = fPort;
@@ -1472,23 +1986,28 @@ void LoRaWANNode::micUplink(uint8_t* inOut, size_t lenInOut) {
   }
 }
 
-int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len) {
+int16_t LoRaWANNode::stageUplink(const LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len, RadioLibTime_t* toa) {
   int16_t state = RADIOLIB_ERR_UNKNOWN;
-  Module* mod = this->phyLayer->getMod();
 
   const uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
-  const ModemType_t modem = this->band->dataRates[currentDr].modem;
-  const DataRate_t* dr = &this->band->dataRates[currentDr].dr;
-  const PacketConfig_t* pc = &this->band->dataRates[currentDr].pc;
-  RadioLibTime_t toa = this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, len) / 1000;
+  *toa = this->getTimeOnAir(currentDr, len) / 1000;
 
   if(this->dwellTimeUp) {
-    if(toa > this->dwellTimeUp) {
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Dwell time exceeded: ToA = %lu, max = %d", (unsigned long)toa, this->dwellTimeUp);
+    if(*toa > this->dwellTimeUp) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Dwell time exceeded: ToA = %lu, max = %d", (unsigned long)*toa, this->dwellTimeUp);
       return(RADIOLIB_ERR_DWELL_TIME_EXCEEDED);
     }
   }
 
+  // the sub-band of the selected channel must have airtime left for the complete uplink
+  if(this->dutyCycleEnabled) {
+    RadioLibTime_t tNow = this->phyLayer->getMod()->hal->millis();
+    if(this->dutyCycleReadyTime(chnl->freq, *toa) > RADIOLIB_MAX(this->tUplink, tNow)) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("No airtime left for ToA = %lu ms", (unsigned long)*toa);
+      return(RADIOLIB_ERR_UPLINK_UNAVAILABLE);
+    }
+  }
+
   // set the physical layer configuration for uplink
   state = this->setPhyProperties(chnl,
                                  RADIOLIB_LORAWAN_UPLINK, 
@@ -1500,6 +2019,14 @@ int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, u
   modeCfg.transmit.len = len;
   modeCfg.transmit.addr = 0;
   state = this->phyLayer->stageMode(RADIOLIB_RADIO_MODE_TX, &modeCfg);
+  return(state);
+}
+
+int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len) {
+  Module* mod = this->phyLayer->getMod();
+
+  RadioLibTime_t toa = 0;
+  int16_t state = this->stageUplink(chnl, in, len, &toa);
   RADIOLIB_ASSERT(state);
   
   // if requested, wait until transmitting uplink
@@ -1516,12 +2043,19 @@ int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, u
     mod->hal->digitalWrite(this->ledPins[0], mod->hal->GpioLevelHigh);
   }
 
+  // capture the time of the Tx done interrupt, as the IRQ pin is only polled after sleeping
+  RadioLibTime_t tIrqPrev = this->phyLayer->getIrqTime(RADIOLIB_IRQ_TX_DONE);
+  this->phyLayer->setTimestampedAction(RADIOLIB_IRQ_TX_DONE, NULL);
+
   // start transmission, and time the duration of launchMode() to offset window timing
   RadioLibTime_t spiStart = mod->hal->millis();
   state = this->phyLayer->launchMode();
   RadioLibTime_t spiEnd = mod->hal->millis();
   this->launchDuration = spiEnd - spiStart;
-  RADIOLIB_ASSERT(state);
+  if(state != RADIOLIB_ERR_NONE) {
+    this->phyLayer->clearTimestampedAction();
+    return(state);
+  }
 
   // sleep for the duration of the transmission
   this->sleepDelay(toa, false);
@@ -1533,13 +2067,20 @@ int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, u
     mod->hal->yield();
 
     if(mod->hal->millis() > txEnd + this->scanGuard) {
+      this->phyLayer->clearTimestampedAction();
       return(RADIOLIB_ERR_TX_TIMEOUT);
     }
   }
-  state = this->phyLayer->finishTransmit();
+  this->phyLayer->clearTimestampedAction();
 
-  // set the timestamp so that we can measure when to start receiving
+  // the Rx windows are timed from the captured interrupt, or from now if it was not captured
+  // the age of the interrupt is used, so that the microsecond timer may overflow in between
   this->tUplinkEnd = mod->hal->millis();
+  RadioLibTime_t tIrq = this->phyLayer->getIrqTime(RADIOLIB_IRQ_TX_DONE);
+  if(tIrq != tIrqPrev) {
+    this->tUplinkEnd -= (mod->hal->micros() - tIrq) / 1000;
+  }
+  state = this->phyLayer->finishTransmit();
 
   if(this->ledPins[0] != RADIOLIB_NC) {
     mod->hal->digitalWrite(this->ledPins[0], mod->hal->GpioLevelLow);
@@ -1549,12 +2090,13 @@ int16_t LoRaWANNode::transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, u
 
   // increase Time on Air of the uplink sequence
   this->lastToA += toa;
+  this->dutyCycleCharge(chnl->freq, toa);
 
   return(state);
 }
 
 // flag to indicate whether there was some action during Rx mode (timeout or downlink)
-static volatile bool downlinkAction = false;
+RADIOLIB_LORAWAN_ISR_FLAG volatile bool downlinkAction = false;
 
 // interrupt service routine to handle downlinks automatically
 #if defined(ESP8266) || defined(ESP32)
@@ -1564,6 +2106,27 @@ static void LoRaWANNodeOnDownlinkAction(void) {
   downlinkAction = true;
 }
 
+int16_t LoRaWANNode::stageReceive(uint8_t dir, const LoRaWANChannel_t* dlChannel, RadioLibTime_t* timeoutUs) {
+  RadioLibTime_t toaMinUs = this->getTimeOnAir(dlChannel->dr, 0);
+
+  // set the physical layer configuration for downlink
+  int16_t state = this->setPhyProperties(dlChannel, dir, this->txPowerMax - 2*this->txPowerSteps);
+  RADIOLIB_ASSERT(state);
+
+  // calculate the timeout of an empty packet plus scanGuard
+  *timeoutUs = toaMinUs + this->scanGuard*1000;
+
+  // set the radio Rx parameters
+  RadioModeConfig_t modeCfg;
+  modeCfg.receive.irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS;
+  modeCfg.receive.irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK;
+  modeCfg.receive.len = 0;
+  modeCfg.receive.timeout = this->phyLayer->calculateRxTimeout(*timeoutUs);
+
+  state = this->phyLayer->stageMode(RADIOLIB_RADIO_MODE_RX, &modeCfg);
+  return(state);
+}
+
 int16_t LoRaWANNode::receiveClassA(uint8_t dir, const LoRaWANChannel_t* dlChannel, uint8_t window, const RadioLibTime_t dlDelay, RadioLibTime_t tReference) {
   Module* mod = this->phyLayer->getMod();
 
@@ -1575,31 +2138,15 @@ int16_t LoRaWANNode::receiveClassA(uint8_t dir, const LoRaWANChannel_t* dlChanne
   }
 
   const uint8_t currentDr = dlChannel->dr;
-  const ModemType_t modem = this->band->dataRates[currentDr].modem;
-  const DataRate_t* dr = &this->band->dataRates[currentDr].dr;
-  const PacketConfig_t* pc = &this->band->dataRates[currentDr].pc;
-  RadioLibTime_t toaMinUs = this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, 0);
 
   // get the maximum allowed Time-on-Air of a packet given the current datarate
   uint8_t maxPayLen = this->band->payloadLenMax[currentDr];
   
-  RadioLibTime_t toaMaxMs = this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, maxPayLen + 13) / 1000;
-
-  // set the physical layer configuration for downlink
-  state = this->setPhyProperties(dlChannel, dir, this->txPowerMax - 2*this->txPowerSteps);
-  RADIOLIB_ASSERT(state);
-
-  // calculate the timeout of an empty packet plus scanGuard
-  RadioLibTime_t timeoutUs = toaMinUs + this->scanGuard*1000;
-
-  // set the radio Rx parameters
-  RadioModeConfig_t modeCfg;
-  modeCfg.receive.irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS;
-  modeCfg.receive.irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK;
-  modeCfg.receive.len = 0;
-  modeCfg.receive.timeout = this->phyLayer->calculateRxTimeout(timeoutUs);
+  RadioLibTime_t toaMaxMs = this->getTimeOnAir(currentDr, maxPayLen + 13) / 1000;
 
-  state = this->phyLayer->stageMode(RADIOLIB_RADIO_MODE_RX, &modeCfg);
+  // configure the radio and stage the Rx window
+  RadioLibTime_t timeoutUs = 0;
+  state = this->stageReceive(dir, dlChannel, &timeoutUs);
   RADIOLIB_ASSERT(state);
 
   // setup interrupt
@@ -1662,6 +2209,11 @@ int16_t LoRaWANNode::receiveClassA(uint8_t dir, const LoRaWANChannel_t* dlChanne
   while(!downlinkAction && mod->hal->millis() - tOpen < toaMaxMs + this->scanGuard) {
     mod->hal->yield();
   }
+
+  // update time of downlink reception
+  if(downlinkAction) {
+    this->tDownlink = mod->hal->millis();
+  }
   
   // sometimes we can get to a state when reception is still ongoing, but has not finished yet
   // this has been observed on LR2021 - wait until either timeout, or Rx done is raised
@@ -1675,11 +2227,6 @@ int16_t LoRaWANNode::receiveClassA(uint8_t dir, const LoRaWANChannel_t* dlChanne
     }
   }
 
-  // update time of downlink reception
-  if(downlinkAction) {
-    this->tDownlink = mod->hal->millis();
-  }
-
   // we have a message, clear actions, go to standby
   this->phyLayer->clearPacketReceivedAction();
   this->phyLayer->standby();
@@ -1853,99 +2400,516 @@ int16_t LoRaWANNode::receiveDownlink() {
   return(state);
 }
 
-int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, LoRaWANEvent_t* event) {
-  int16_t state = RADIOLIB_ERR_UNKNOWN;
-  
-  // set user-data length to 0 to prevent undefined behaviour in case of bad use
-  // if there is user-data, this will be handled at the appropriate place
-  *len = 0;
+// the radio interrupt has no context, so each running non-blocking sequence
+// gets one of a fixed number of ISRs, which forwards the interrupt to the node in its slot
+RADIOLIB_LORAWAN_ISR_FLAG LoRaWANNode* volatile asyncNodes[RADIOLIB_LORAWAN_ASYNC_NUM_NODES] = { nullptr };
 
-  // get the packet length
-  size_t downlinkMsgLen = this->phyLayer->getPacketLength();
+void (* const LoRaWANNode::asyncSlotActions[RADIOLIB_LORAWAN_ASYNC_NUM_NODES])(void) = {
+  LoRaWANNode::onAsyncSlot<0>,
+  LoRaWANNode::onAsyncSlot<1>,
+  LoRaWANNode::onAsyncSlot<2>,
+  LoRaWANNode::onAsyncSlot<3>,
+};
 
-  // check the minimum required frame length
-  // an extra byte is subtracted because downlink frames may not have a fPort
-  if(downlinkMsgLen < RADIOLIB_LORAWAN_FRAME_LEN(0, 0) - 1 - RADIOLIB_AES128_BLOCK_SIZE) {
-    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink message too short (%lu bytes)", (unsigned long)downlinkMsgLen);
-    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+LoRaWANNode::~LoRaWANNode() {
+  if(this->asyncSlot >= 0) {
+    asyncNodes[this->asyncSlot] = nullptr;
   }
-
-  // build the buffer for the downlink message
-  // the first 16 bytes are reserved for MIC calculation block
   #if !RADIOLIB_STATIC_ONLY
-    uint8_t* downlinkMsg = new uint8_t[RADIOLIB_AES128_BLOCK_SIZE + downlinkMsgLen];
-  #else
-    uint8_t downlinkMsg[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
+  delete[] this->asyncMsg;
   #endif
+}
 
-  // read the data
-  state = this->phyLayer->readData(&downlinkMsg[RADIOLIB_AES128_BLOCK_SIZE], downlinkMsgLen);
-  // downlink frames are sent without CRC, which will raise error on SX127x
-  // we can ignore that error
-  if(state == RADIOLIB_ERR_LORA_HEADER_DAMAGED) {
-    state = RADIOLIB_ERR_NONE;
-  }
-  
-  if(state != RADIOLIB_ERR_NONE) {
-    #if !RADIOLIB_STATIC_ONLY
-      delete[] downlinkMsg;
-    #endif
-    return(state);
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+void LoRaWANNode::onAsyncAction(uint8_t slot) {
+  LoRaWANNode* node = asyncNodes[slot];
+  if(!node) {
+    return;
   }
+  node->asyncActionTime = node->phyLayer->getMod()->hal->millis();
+  node->asyncAction = true;
+}
 
-  // check the address
-  uint32_t addr = LoRaWANNode::ntoh<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_DEV_ADDR_POS]);
-  bool multicast = false;
-  uint8_t mcGroupId = 0xFF;
-  if(addr == this->devAddr) {
-    // all good
-  } else if(window == RADIOLIB_LORAWAN_RX_BC && this->isMulticastDevAddr(addr, &mcGroupId)) {
-    multicast = true;
-  } else {
-    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Unexpected device address 0x%08lX", (unsigned long)addr);
-    #if !RADIOLIB_STATIC_ONLY
-      delete[] downlinkMsg;
-    #endif
-    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+int16_t LoRaWANNode::startSendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown, bool isConfirmed, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown) {
+  if((lenUp > 0 && !dataUp) || !dataDown || !lenDown) {
+    return(RADIOLIB_ERR_NULL_POINTER);
   }
 
-  // calculate length of piggy-backed FOpts
-  bool isPiggyBacking = false;
-  uint8_t fOptsLen = downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FHDR_FOPTS_LEN_MASK;
-  isPiggyBacking = fOptsLen > 0;
+  // only a single sequence can be in progress
+  if(this->asyncState != RADIOLIB_LORAWAN_ASYNC_IDLE) {
+    return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+  }
 
-  // MHDR(1) - DevAddr(4) - FCtrl(1) - FCnt(2) - FOpts - Payload - MIC(4)
-  // potentially also an FPort, will find out next
-  // guard against integer underflow when downlinkMsgLen is too short
-  uint8_t minLen = 1 + 4 + 1 + 2 + fOptsLen + 4;
-  if(downlinkMsgLen < minLen) {
-    #if !RADIOLIB_STATIC_ONLY
-      delete[] downlinkMsg;
-    #endif
-    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  // claim an interrupt slot for the duration of the sequence
+  for(int8_t i = 0; i < RADIOLIB_LORAWAN_ASYNC_NUM_NODES; i++) {
+    if(!asyncNodes[i]) {
+      asyncNodes[i] = this;
+      this->asyncSlot = i;
+      break;
+    }
+  }
+  if(this->asyncSlot < 0) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("No free sequence slot, increase RADIOLIB_LORAWAN_ASYNC_NUM_NODES");
+    return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
   }
-  uint8_t payLen = downlinkMsgLen - minLen;
 
-  // in LoRaWAN v1.1, a frame is a Network frame if there is no Application payload
-  // i.e.: either no payload at all (empty frame or FOpts only), or MAC only payload
-  uint8_t fPort = RADIOLIB_LORAWAN_FPORT_MAC_COMMAND;
-  bool isAppDownlink = false;
-  if(this->rev == 0) {
-    isAppDownlink = true;
+  int16_t state = this->prepareUplink(lenUp, fPort);
+  if(state != RADIOLIB_ERR_NONE) {
+    asyncNodes[this->asyncSlot] = nullptr;
+    this->asyncSlot = -1;
+    return(state);
   }
-  if(payLen > 0) {
-    payLen -= 1;  // subtract one as fPort is set
-    fPort = downlinkMsg[RADIOLIB_LORAWAN_FHDR_FPORT_POS(fOptsLen)];
 
-    // check destination fPort
-    bool ok = false;
+  // the first 16 bytes are reserved for MIC calculation blocks
+  this->asyncMsgLen = RADIOLIB_LORAWAN_FRAME_LEN(lenUp, this->fOptsUpLen);
+  #if !RADIOLIB_STATIC_ONLY
+  this->asyncMsg = new uint8_t[this->asyncMsgLen];
+  #endif
 
-    // LoRaWAN v1.0.4 only: A Class B/C downlink SHALL NOT transport any MAC command. 
-    // (...) it SHALL silently discard the entire frame.
-    // However, we also enforce this for LoRaWAN v1.1 (TTS does not allow this anyway).
-    if(fPort == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND) {
-      if(this->lwClass == RADIOLIB_LORAWAN_CLASS_A) { // Class A is good regardless of Rx window
-        ok = true;
+  // build the encrypted uplink message
+  this->buildUplink(dataUp, lenUp, fPort, isConfirmed, this->asyncMsg);
+
+  // save the user buffers, these are filled in once the sequence finishes
+  this->asyncFPort = fPort;
+  this->asyncConfirmed = isConfirmed;
+  this->asyncDataDown = dataDown;
+  this->asyncLenDown = lenDown;
+  this->asyncEventUp = eventUp;
+  this->asyncEventDown = eventDown;
+  this->asyncTrans = 0;
+  *lenDown = 0;
+
+  // channel selection and staging of the uplink is done on the first tick
+  Module* mod = this->phyLayer->getMod();
+  this->asyncDeadline = mod->hal->millis();
+  this->asyncRadioAsleep = false;
+  this->asyncState = RADIOLIB_LORAWAN_ASYNC_TX_WAIT;
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::tick() {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  int16_t state = RADIOLIB_ERR_NONE;
+
+  switch(this->asyncState) {
+    case(RADIOLIB_LORAWAN_ASYNC_IDLE): {
+      return(RADIOLIB_ERR_NONE);
+    }
+
+    case(RADIOLIB_LORAWAN_ASYNC_TX_WAIT): {
+      if(tNow < this->asyncDeadline) {
+        return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+      }
+
+      // select channels, set the MIC and perform CSMA if enabled
+      this->selectUplinkChannel(this->asyncMsg, this->asyncMsgLen);
+
+      // stage the uplink (without the MIC calculation blocks)
+      state = this->stageUplink(&this->channels[RADIOLIB_LORAWAN_UPLINK],
+                                &this->asyncMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS],
+                                (uint8_t)(this->asyncMsgLen - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS),
+                                &this->asyncToA);
+      if(state != RADIOLIB_ERR_NONE) {
+        return(this->endSequence(state, false));
+      }
+
+      // wait for the scheduled uplink time (if any)
+      this->asyncDeadline = this->tUplink - this->launchDuration;
+      this->sleepPending(tNow);
+      this->asyncState = RADIOLIB_LORAWAN_ASYNC_TX_PENDING;
+      return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+    }
+
+    case(RADIOLIB_LORAWAN_ASYNC_TX_PENDING): {
+      if(this->waitPending(tNow)) {
+        return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+      }
+
+      this->asyncAction = false;
+      this->phyLayer->setPacketSentAction(LoRaWANNode::asyncSlotActions[this->asyncSlot]);
+
+      if(this->ledPins[0] != RADIOLIB_NC) {
+        mod->hal->digitalWrite(this->ledPins[0], mod->hal->GpioLevelHigh);
+      }
+
+      // start transmission, and time the duration of launchMode() to offset window timing
+      RadioLibTime_t spiStart = mod->hal->millis();
+      state = this->phyLayer->launchMode();
+      RadioLibTime_t spiEnd = mod->hal->millis();
+      this->launchDuration = spiEnd - spiStart;
+      if(state != RADIOLIB_ERR_NONE) {
+        return(this->endSequence(state, false));
+      }
+
+      // wait for an additional scanGuard as Tx timeout period
+      this->asyncDeadline = spiEnd + this->asyncToA + this->scanGuard;
+      this->asyncState = RADIOLIB_LORAWAN_ASYNC_TX;
+      return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+    }
+
+    case(RADIOLIB_LORAWAN_ASYNC_TX): {
+      if(!this->asyncAction) {
+        if(tNow > this->asyncDeadline) {
+          return(this->endSequence(RADIOLIB_ERR_TX_TIMEOUT, false));
+        }
+        return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+      }
+      this->asyncAction = false;
+      this->phyLayer->clearPacketSentAction();
+      state = this->phyLayer->finishTransmit();
+
+      // Rx windows are timed from the Tx done interrupt, not from the time this tick was called
+      this->tUplinkEnd = this->asyncActionTime;
+
+      if(this->ledPins[0] != RADIOLIB_NC) {
+        mod->hal->digitalWrite(this->ledPins[0], mod->hal->GpioLevelLow);
+      }
+
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Uplink sent (ToA = %lu ms)", (unsigned long)this->asyncToA);
+
+      // increase Time on Air of the uplink sequence
+      this->lastToA += this->asyncToA;
+      this->dutyCycleCharge(this->channels[RADIOLIB_LORAWAN_UPLINK].freq, this->asyncToA);
+      if(state != RADIOLIB_ERR_NONE) {
+        return(this->endSequence(state, false));
+      }
+
+      return(this->stageWindow(RADIOLIB_LORAWAN_RX1, tNow));
+    }
+
+    case(RADIOLIB_LORAWAN_ASYNC_RX1_PENDING):
+    case(RADIOLIB_LORAWAN_ASYNC_RX2_PENDING): {
+      if(this->waitPending(tNow)) {
+        return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+      }
+      uint8_t window = (this->asyncState == RADIOLIB_LORAWAN_ASYNC_RX1_PENDING) ? RADIOLIB_LORAWAN_RX1 : RADIOLIB_LORAWAN_RX2;
+
+      // the window is padded using scanGuard, so a late tick of up to half of it is still fine
+      if(tNow > this->asyncDeadline + this->scanGuard / 2) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Window too late by %lu ms", (unsigned long)(tNow - this->asyncDeadline));
+        this->phyLayer->standby();
+        return(this->endSequence(RADIOLIB_ERR_NO_RX_WINDOW, true));
+      }
+
+      this->asyncAction = false;
+      this->phyLayer->setPacketReceivedAction(LoRaWANNode::asyncSlotActions[this->asyncSlot]);
+
+      if(this->ledPins[window] != RADIOLIB_NC) {
+        mod->hal->digitalWrite(this->ledPins[window], mod->hal->GpioLevelHigh);
+      }
+
+      // open Rx window by starting receive with specified timeout
+      state = this->phyLayer->launchMode();
+      this->asyncWindowOpen = mod->hal->millis();
+      if(state != RADIOLIB_ERR_NONE) {
+        this->closeWindow(window);
+        return(this->endSequence(state, true));
+      }
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Rx%d window open (%lu + %lu ms)", window, (unsigned long)this->asyncWindowLen, (unsigned long)this->scanGuard);
+
+      // use a small additional delay in case the RxTimeout interrupt is slow to fire
+      this->asyncDeadline = this->asyncWindowOpen + this->asyncWindowLen + this->scanGuard;
+      this->asyncReceiving = false;
+      this->asyncState = (window == RADIOLIB_LORAWAN_RX1) ? RADIOLIB_LORAWAN_ASYNC_RX1 : RADIOLIB_LORAWAN_ASYNC_RX2;
+      return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+    }
+
+    case(RADIOLIB_LORAWAN_ASYNC_RX1):
+    case(RADIOLIB_LORAWAN_ASYNC_RX2): {
+      uint8_t window = (this->asyncState == RADIOLIB_LORAWAN_ASYNC_RX1) ? RADIOLIB_LORAWAN_RX1 : RADIOLIB_LORAWAN_RX2;
+      uint8_t maxPayLen = this->band->payloadLenMax[this->channels[window].dr];
+
+      if(!this->asyncAction) {
+        // keep the window open until the deadline
+        if(tNow <= this->asyncDeadline) {
+          return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+        }
+
+        // check IRQ bit for RxTimeout
+        int16_t timedOut = this->phyLayer->checkIrq(RADIOLIB_IRQ_TIMEOUT);
+        if(timedOut == RADIOLIB_ERR_UNSUPPORTED) {
+          this->closeWindow(window);
+          return(this->endSequence(timedOut, true));
+        }
+
+        // if the IRQ bit for RxTimeout is not set, something is being received, 
+        // so keep listening for maximum ToA waiting for the DIO to fire
+        if(!timedOut && !this->asyncReceiving) {
+          RadioLibTime_t toaMaxMs = this->getTimeOnAir(this->channels[window].dr, maxPayLen + 13) / 1000;
+          this->asyncDeadline = this->asyncWindowOpen + toaMaxMs + this->scanGuard;
+          this->asyncReceiving = true;
+          return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+        }
+
+        if(timedOut) {
+          this->phyLayer->clearIrq(1UL << RADIOLIB_IRQ_TIMEOUT);
+        } else {
+          RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink missing!");
+        }
+        this->closeWindow(window);
+        return(this->nextWindow(window, tNow));
+      }
+
+      // the interrupt is raised by RxTimeout as well, in which case the window closes without a downlink
+      if(this->phyLayer->checkIrq(RADIOLIB_IRQ_TIMEOUT) == 1) {
+        this->asyncAction = false;
+        this->phyLayer->clearIrq(1UL << RADIOLIB_IRQ_TIMEOUT);
+        this->closeWindow(window);
+        return(this->nextWindow(window, tNow));
+      }
+
+      // sometimes we can get to a state when reception is still ongoing, but has not finished yet
+      // this has been observed on LR2021 - wait until either timeout, or Rx done is raised
+      if(!this->phyLayer->checkIrq(RADIOLIB_IRQ_TIMEOUT) && !this->phyLayer->checkIrq(RADIOLIB_IRQ_RX_DONE)) {
+        if(tNow - this->asyncActionTime < 300) {
+          return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+        }
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Timeout without IRQ!");
+      }
+      this->asyncAction = false;
+
+      // update time of downlink reception
+      this->tDownlink = this->asyncActionTime;
+      this->closeWindow(window);
+
+      // Any frame received by an end-device containing a MACPayload greater than 
+      // the specified maximum length M over the data rate used to receive the frame 
+      // SHALL be silently discarded.
+      if(this->phyLayer->getPacketLength() > (size_t)(maxPayLen + 13)) {  // mandatory FHDR is 12/13 bytes
+        return(this->nextWindow(window, tNow));  // act as if no downlink was received
+      }
+
+      return(this->endSequence(window, true));
+    }
+  }
+
+  return(RADIOLIB_ERR_UNKNOWN);
+}
+
+RadioLibTime_t LoRaWANNode::timeUntilTick() {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+
+  // nothing to do until the next sequence is started, or the radio interrupt must be handled
+  if(this->asyncState == RADIOLIB_LORAWAN_ASYNC_IDLE || this->asyncAction) {
+    return(0);
+  }
+
+  // the radio must be woken up slightly earlier than the staged mode is launched
+  RadioLibTime_t tNext = this->asyncDeadline;
+  if(this->asyncRadioAsleep) {
+    tNext -= 2;
+  }
+  if(tNext <= tNow) {
+    return(0);
+  }
+  return(tNext - tNow);
+}
+
+void LoRaWANNode::setSendReceiveCallback(SendReceiveCb_t cb) {
+  this->sendReceiveCb = cb;
+}
+
+int16_t LoRaWANNode::stageWindow(uint8_t window, RadioLibTime_t tNow) {
+  // configure the radio and stage the Rx window right away, so that it only has to be launched on time
+  RadioLibTime_t timeoutUs = 0;
+  int16_t state = this->stageReceive(RADIOLIB_LORAWAN_DOWNLINK, &this->channels[window], &timeoutUs);
+  if(state != RADIOLIB_ERR_NONE) {
+    return(this->endSequence(state, true));
+  }
+  this->asyncWindowLen = timeoutUs / 1000;
+
+  // calculate time at which the window should open
+  // - the launch of Rx window takes a few milliseconds, so open it a bit earlier (launchDuration)
+  // - the Rx window is padded using scanGuard, so open it a bit earlier (scanGuard / 2)
+  this->asyncDeadline = this->tUplinkEnd + this->rxDelays[window] - this->launchDuration - this->scanGuard / 2;
+  this->sleepPending(tNow);
+  this->asyncState = (window == RADIOLIB_LORAWAN_RX1) ? RADIOLIB_LORAWAN_ASYNC_RX1_PENDING : RADIOLIB_LORAWAN_ASYNC_RX2_PENDING;
+  return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+}
+
+int16_t LoRaWANNode::nextWindow(uint8_t window, RadioLibTime_t tNow) {
+  if(window == RADIOLIB_LORAWAN_RX1) {
+    return(this->stageWindow(RADIOLIB_LORAWAN_RX2, tNow));
+  }
+
+  // all windows passed without a downlink, check if the uplink must be repeated (ADR)
+  this->asyncTrans++;
+  if(this->asyncTrans >= this->nbTrans) {
+    return(this->endSequence(0, true));
+  }
+
+  // confirmed uplinks must wait for RETRANSMIT_TIMEOUT before repeating
+  this->asyncDeadline = tNow;
+  if(this->asyncConfirmed) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Retransmit timeout");
+    int min = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MIN_MS;
+    int max = RADIOLIB_LORAWAN_RETRANSMIT_TIMEOUT_MAX_MS;
+    this->asyncDeadline += min + this->randomNumber(max - min);
+  }
+  this->asyncState = RADIOLIB_LORAWAN_ASYNC_TX_WAIT;
+  return(RADIOLIB_LORAWAN_SEQUENCE_BUSY);
+}
+
+void LoRaWANNode::closeWindow(uint8_t window) {
+  Module* mod = this->phyLayer->getMod();
+  this->phyLayer->clearPacketReceivedAction();
+  this->phyLayer->standby();
+  if(this->ledPins[window] != RADIOLIB_NC) {
+    mod->hal->digitalWrite(this->ledPins[window], mod->hal->GpioLevelLow);
+  }
+}
+
+void LoRaWANNode::sleepPending(RadioLibTime_t tNow) {
+  // if the staged mode will not be launched any time soon, put the radio to sleep
+  this->asyncRadioAsleep = false;
+  if(this->asyncDeadline > tNow + RADIOLIB_LORAWAN_DELAY_SLEEP_THRESHOLD) {
+    this->phyLayer->sleep();
+    this->asyncRadioAsleep = true;
+  }
+}
+
+bool LoRaWANNode::waitPending(RadioLibTime_t tNow) {
+  // wake up the radio shortly before the staged mode is launched
+  if(this->asyncRadioAsleep && tNow + 2 >= this->asyncDeadline) {
+    this->phyLayer->standby();
+    this->asyncRadioAsleep = false;
+  }
+  return(tNow < this->asyncDeadline);
+}
+
+int16_t LoRaWANNode::endSequence(int16_t state, bool transmitted) {
+  #if !RADIOLIB_STATIC_ONLY
+  delete[] this->asyncMsg;
+  this->asyncMsg = nullptr;
+  #endif
+  this->asyncState = RADIOLIB_LORAWAN_ASYNC_IDLE;
+  if(this->asyncSlot >= 0) {
+    asyncNodes[this->asyncSlot] = nullptr;
+    this->asyncSlot = -1;
+  }
+
+  if(transmitted) {
+    state = this->finishSendReceive(state, this->asyncTrans, this->asyncFPort, this->asyncConfirmed, 
+                                    this->asyncDataDown, this->asyncLenDown, this->asyncEventUp, this->asyncEventDown);
+  } else {
+    // sometimes, a spurious error can occur even though the uplink was transmitted
+    // therefore, just to be safe, increase frame counter by one for the next uplink
+    this->phyLayer->clearPacketSentAction();
+    this->fCntUp += 1;
+  }
+
+  // notify the user that the sequence is done
+  if(this->sendReceiveCb) {
+    this->sendReceiveCb(state);
+  }
+  return(state);
+}
+
+int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, LoRaWANEvent_t* event) {
+  int16_t state = RADIOLIB_ERR_UNKNOWN;
+  
+  // set user-data length to 0 to prevent undefined behaviour in case of bad use
+  // if there is user-data, this will be handled at the appropriate place
+  *len = 0;
+
+  // get the packet length
+  size_t downlinkMsgLen = this->phyLayer->getPacketLength();
+
+  // check the minimum required frame length
+  // an extra byte is subtracted because downlink frames may not have a fPort
+  if(downlinkMsgLen < RADIOLIB_LORAWAN_FRAME_LEN(0, 0) - 1 - RADIOLIB_AES128_BLOCK_SIZE) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink message too short (%lu bytes)", (unsigned long)downlinkMsgLen);
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
+
+  // if the radio supports it, check only the frame header first (MHDR and FHDR without FOpts)
+  // frames for other devices are then rejected before anything is allocated, read or decrypted
+  uint8_t fhdr[RADIOLIB_LORAWAN_FHDR_FOPTS_POS - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS];
+  bool multicast = false;
+  uint8_t mcGroupId = 0xFF;
+  bool isHeaderChecked = false;
+  if(this->phyLayer->peekData(fhdr, sizeof(fhdr)) == RADIOLIB_ERR_NONE) {
+    state = this->checkDownlinkHeader(fhdr, window, &multicast, &mcGroupId);
+    if(state != RADIOLIB_ERR_NONE) {
+      // read just the header to finish the reception
+      (void)this->phyLayer->readData(fhdr, sizeof(fhdr));
+      return(state);
+    }
+    isHeaderChecked = true;
+  }
+
+  // build the buffer for the downlink message
+  // the first 16 bytes are reserved for MIC calculation block
+  #if !RADIOLIB_STATIC_ONLY
+    uint8_t* downlinkMsg = new uint8_t[RADIOLIB_AES128_BLOCK_SIZE + downlinkMsgLen];
+  #else
+    uint8_t downlinkMsg[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
+  #endif
+
+  // read the data
+  state = this->phyLayer->readData(&downlinkMsg[RADIOLIB_AES128_BLOCK_SIZE], downlinkMsgLen);
+  // downlink frames are sent without CRC, which will raise error on SX127x
+  // we can ignore that error
+  if(state == RADIOLIB_ERR_LORA_HEADER_DAMAGED) {
+    state = RADIOLIB_ERR_NONE;
+  }
+
+  // check the header now if the radio could not provide it in advance
+  if((state == RADIOLIB_ERR_NONE) && !isHeaderChecked) {
+    state = this->checkDownlinkHeader(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS], window, &multicast, &mcGroupId);
+  }
+  
+  if(state != RADIOLIB_ERR_NONE) {
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] downlinkMsg;
+    #endif
+    return(state);
+  }
+
+  uint32_t addr = LoRaWANNode::ntoh<uint32_t>(&downlinkMsg[RADIOLIB_LORAWAN_FHDR_DEV_ADDR_POS]);
+
+  // calculate length of piggy-backed FOpts
+  bool isPiggyBacking = false;
+  uint8_t fOptsLen = downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FHDR_FOPTS_LEN_MASK;
+  isPiggyBacking = fOptsLen > 0;
+
+  // MHDR(1) - DevAddr(4) - FCtrl(1) - FCnt(2) - FOpts - Payload - MIC(4)
+  // potentially also an FPort, will find out next
+  // guard against integer underflow when downlinkMsgLen is too short
+  uint8_t minLen = 1 + 4 + 1 + 2 + fOptsLen + 4;
+  if(downlinkMsgLen < minLen) {
+    #if !RADIOLIB_STATIC_ONLY
+      delete[] downlinkMsg;
+    #endif
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
+  uint8_t payLen = downlinkMsgLen - minLen;
+
+  // in LoRaWAN v1.1, a frame is a Network frame if there is no Application payload
+  // i.e.: either no payload at all (empty frame or FOpts only), or MAC only payload
+  uint8_t fPort = RADIOLIB_LORAWAN_FPORT_MAC_COMMAND;
+  bool isAppDownlink = false;
+  if(this->rev == 0) {
+    isAppDownlink = true;
+  }
+  if(payLen > 0) {
+    payLen -= 1;  // subtract one as fPort is set
+    fPort = downlinkMsg[RADIOLIB_LORAWAN_FHDR_FPORT_POS(fOptsLen)];
+
+    // check destination fPort
+    bool ok = false;
+
+    // LoRaWAN v1.0.4 only: A Class B/C downlink SHALL NOT transport any MAC command. 
+    // (...) it SHALL silently discard the entire frame.
+    // However, we also enforce this for LoRaWAN v1.1 (TTS does not allow this anyway).
+    if(fPort == RADIOLIB_LORAWAN_FPORT_MAC_COMMAND) {
+      if(this->lwClass == RADIOLIB_LORAWAN_CLASS_A) { // Class A is good regardless of Rx window
+        ok = true;
       }
       if(window < RADIOLIB_LORAWAN_RX_BC) {           // Rx1 and Rx2 are good regardless of class
         ok = true;
@@ -2023,16 +2987,6 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, L
   devFCnt32 &= ~0xFFFF;     // clear lower 16 bits known by device
   devFCnt32 |= payFCnt16;   // set lower 16 bits from payload
 
-  // for multicast, a maximum FCnt value is defined in TS005
-  if(multicast) {
-    if(devFCnt32 > this->mcGroups[mcGroupId].mcFCntMax) {
-      #if !RADIOLIB_STATIC_ONLY
-        delete[] downlinkMsg;
-      #endif
-      return(RADIOLIB_ERR_MULTICAST_FCNT_INVALID);
-    }
-  }
-
   bool isConfirmedDown = false;
   // check if this is a confirmed downlink and if that is even allowed
   if((downlinkMsg[RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS] & 0xFE) == RADIOLIB_LORAWAN_MHDR_MTYPE_CONF_DATA_DOWN) {
@@ -2155,32 +3109,31 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, L
     uint8_t fOptsRe[RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE] = { 0 };
     uint8_t fOptsReLen = 0;
 
+    // the MAC commands that remain available to the user are compacted to the start of FOpts on the fly
+    uint8_t keptLen = 0;
+
     // indication whether LinkAdr MAC command has been processed
     bool mAdr = false;
 
     while(procLen < fOptsLen) {
-      uint8_t cid = *mPtr;      // MAC id is the first byte
-
-      // fetch length of MAC downlink command and uplink response
+      // fetch MAC id and length of MAC downlink command in one go
+      uint8_t cid = *mPtr;
       uint8_t fLen = 1;
       uint8_t fLenRe = 1;
-      state = this->getMacLen(cid, &fLen, RADIOLIB_LORAWAN_DOWNLINK, true, mPtr + 1);
-      if(state != RADIOLIB_ERR_NONE) {
-        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Unknown MAC CID %02x", cid);
+      state = this->nextMacCommand(fOptsPtr, fOptsLen, procLen, RADIOLIB_LORAWAN_DOWNLINK, &cid, &fLen);
+      if(state == RADIOLIB_ERR_INVALID_PAYLOAD) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Incomplete MAC command %02x (%d bytes, expected %d)", cid, fOptsLen - procLen, fLen);
         RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Skipping remaining MAC payload");
-        fOptsLen = procLen; // truncate to last processed MAC command
         break;
-      }
-      (void)this->getMacLen(cid, &fLenRe, RADIOLIB_LORAWAN_UPLINK, true);
-
-      // check whether the complete payload is present
-      if(procLen + fLen > fOptsLen) {
-        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Incomplete MAC command %02x (%d bytes, expected %d)", cid, fOptsLen - procLen, fLen);
+      } else if(state != RADIOLIB_ERR_NONE) {
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Unknown MAC CID %02x", cid);
         RADIOLIB_DEBUG_PROTOCOL_PRINTLN("WARNING: Skipping remaining MAC payload");
-        fOptsLen = procLen; // truncate to last processed MAC command
         break;
       }
 
+      // fetch length of uplink response
+      (void)this->getMacLen(cid, &fLenRe, RADIOLIB_LORAWAN_UPLINK, true);
+
       bool reply = false;
 
       // if this is a LinkAdr MAC command, pre-process contiguous commands into one atomic block
@@ -2229,16 +3182,19 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, L
         fOptsReLen += fLenRe;
       }
 
+      // keep only the MAC commands whose payload can be requested by the user
+      // (which are LinkCheck and DeviceTime)
+      if(this->isPersistentMacCommand(cid, RADIOLIB_LORAWAN_DOWNLINK)) {
+        memmove(&fOptsPtr[keptLen], mPtr, fLen);
+        keptLen += fLen;
+      }
+
       procLen += fLen;
       mPtr += fLen;
     }
 
-    // remove all MAC commands except those whose payload can be requested by the user
-    // (which are LinkCheck and DeviceTime)  
-    LoRaWANNode::clearMacCommands(fOptsPtr, &fOptsLen, RADIOLIB_LORAWAN_DOWNLINK);
-
     // copy over the remaining FOpts from the downlink to an internal buffer
-    this->fOptsDownLen = fOptsLen;
+    this->fOptsDownLen = keptLen;
     memcpy(this->fOptsDown, fOptsPtr, this->fOptsDownLen);
 
     // if fOptsLen for the next uplink is larger than can be piggybacked onto an uplink, send separate uplink
@@ -2274,65 +3230,438 @@ int16_t LoRaWANNode::parseDownlink(uint8_t* data, size_t* len, uint8_t window, L
       RADIOLIB_DEBUG_PROTOCOL_PRINTLN("! Sending MAC-only uplink (%d bytes):", fOptsReLen);
       RADIOLIB_DEBUG_PROTOCOL_HEXDUMP(fOptsRe, fOptsReLen);
 
-      // temporarily lift dutyCycle restrictions to allow immediate MAC response
-      bool prevDC = this->dutyCycleEnabled;
-      this->dutyCycleEnabled = false;
-      this->sendReceive(fOptsRe, fOptsReLen, RADIOLIB_LORAWAN_FPORT_MAC_COMMAND);
-      this->dutyCycleEnabled = prevDC;
+      // temporarily lift dutyCycle restrictions to allow immediate MAC response
+      bool prevDC = this->dutyCycleEnabled;
+      this->dutyCycleEnabled = false;
+      this->sendReceive(fOptsRe, fOptsReLen, RADIOLIB_LORAWAN_FPORT_MAC_COMMAND);
+      this->dutyCycleEnabled = prevDC;
+
+    } else { // fOptsReLen <= 15
+      memcpy(this->fOptsUp, fOptsRe, fOptsReLen);
+      this->fOptsUpLen = fOptsReLen;
+    }
+  }
+
+  // apparently this downlink contains user-data
+  *len = payLen;
+
+  // pass the event info if requested
+  if(event) {
+    event->dir = RADIOLIB_LORAWAN_DOWNLINK;
+    event->confirmed = isConfirmedDown;
+    event->confirming = isConfirmingUp;
+    event->frmPending = (downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FCTRL_FRAME_PENDING) != 0;
+    event->datarate = this->channels[window].dr;
+    event->freq = this->channels[window].freq / 10000.0;
+    event->power = this->txPowerMax - this->txPowerSteps * 2;
+    event->fCnt = devFCnt32;
+    event->fPort = fPort;
+    event->multicast = multicast;
+    event->mcGroupId = mcGroupId;
+    event->predicted = false;
+    event->margin = RADIOLIB_LORAWAN_MARGIN_UNKNOWN;
+  }
+
+  #if !RADIOLIB_STATIC_ONLY
+    delete[] downlinkMsg;
+  #endif
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::checkDownlinkHeader(const uint8_t* fhdr, uint8_t window, bool* multicast, uint8_t* mcGroupId) {
+  // the header starts at MHDR, so the FHDR positions are offset by the MIC block
+  uint32_t addr = LoRaWANNode::ntoh<uint32_t>(&fhdr[RADIOLIB_LORAWAN_FHDR_DEV_ADDR_POS - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS]);
+  uint16_t payFCnt16 = LoRaWANNode::ntoh<uint16_t>(&fhdr[RADIOLIB_LORAWAN_FHDR_FCNT_POS - RADIOLIB_LORAWAN_FHDR_LEN_START_OFFS]);
+
+  // check the address
+  *multicast = false;
+  if(addr == this->devAddr) {
+    // the FCnt16 of the last accepted downlink can only be valid again after 65536 lost frames,
+    // so this is a replay that would fail the MIC check
+    // in LoRaWAN v1.1, the frame may be on either the Network or the Application counter
+    bool aReplay = (this->aFCntDown > 0) && (payFCnt16 == (uint16_t)this->aFCntDown);
+    bool nReplay = (this->nFCntDown > 0) && (payFCnt16 == (uint16_t)this->nFCntDown);
+    if(aReplay && (nReplay || (this->rev == 0))) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Downlink FCnt %d was already received", payFCnt16);
+      return(RADIOLIB_ERR_MIC_MISMATCH);
+    }
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  if((window != RADIOLIB_LORAWAN_RX_BC) || !this->isMulticastDevAddr(addr, mcGroupId)) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Unexpected device address 0x%08lX", (unsigned long)addr);
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
+  *multicast = true;
+
+  // for multicast, a maximum FCnt value is defined in TS005
+  // assume a rollover if the FCnt16 is equal to / smaller than the previous one (see parseDownlink)
+  uint32_t mcFCnt = this->mcGroups[*mcGroupId].mcFCnt;
+  if(mcFCnt > 0 && payFCnt16 <= (uint16_t)mcFCnt) {
+    mcFCnt += 0x10000;
+  }
+  mcFCnt = (mcFCnt & ~0xFFFF) | payFCnt16;
+  if(mcFCnt > this->mcGroups[*mcGroupId].mcFCntMax) {
+    return(RADIOLIB_ERR_MULTICAST_FCNT_INVALID);
+  }
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANNode::getDownlinkClassC(uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventDown) {
+  // only allow if the device is Unicast-C or Multicast-C, otherwise ignore without error
+  if(this->lwClass != RADIOLIB_LORAWAN_CLASS_C && this->getMulticastClass() != RADIOLIB_LORAWAN_CLASS_C) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  int16_t state = RADIOLIB_ERR_NONE;
+
+  if(downlinkAction) {
+    state = this->parseDownlink(dataDown, lenDown, RADIOLIB_LORAWAN_RX_BC, eventDown);
+
+    // re-latch the IRQ interrupt just to be sure
+    this->phyLayer->setPacketReceivedAction(LoRaWANNodeOnDownlinkAction);
+    downlinkAction = false;
+
+    // if downlink parsed successfully, set state to RxC window
+    if(state == RADIOLIB_ERR_NONE) {
+      state = RADIOLIB_LORAWAN_RX_BC;
+    }
+  }
+
+  return(state);
+}
+
+int16_t LoRaWANNode::acquireBeacon() {
+  if(!this->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+
+  // check if the band has a beacon at all
+  const LoRaWANBeaconSpan_t* bcn = &this->band->beacon;
+  if(bcn->numChannels == 0) {
+    return(RADIOLIB_ERR_UNSUPPORTED);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+  this->beaconLocked = false;
+
+  // with a known network time, the next beacon can be waited for
+  if(this->timeRefValid) {
+    RadioLibTime_t tNow = mod->hal->millis();
+    RadioLibTime_t lead = this->getClassBWidening(tNow) + this->launchDuration + this->scanGuard;
+    uint32_t beaconTime = (uint32_t)(this->localToGps(tNow + lead) / 1000 / RADIOLIB_LORAWAN_BEACON_PERIOD_S + 1) * RADIOLIB_LORAWAN_BEACON_PERIOD_S;
+    RadioLibTime_t tEvent = this->gpsToLocal((uint64_t)beaconTime * 1000);
+    RadioLibTime_t widening = this->getClassBWidening(tEvent);
+    this->getBeaconChannel(beaconTime, &chnl);
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Waiting for beacon at GPS time %lu", (unsigned long)beaconTime);
+    return(this->receiveBeacon(&chnl, tEvent - widening, 2*widening));
+  }
+
+  // otherwise, listen for a complete beacon period, which only works if the beacon stays on the same channel
+  if(bcn->numChannels > 1) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("The network time is required to find the beacon, request DeviceTime first");
+    return(RADIOLIB_ERR_NO_BEACON);
+  }
+  this->getBeaconChannel(0, &chnl);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Searching for beacon");
+  return(this->receiveBeacon(&chnl, mod->hal->millis(), RADIOLIB_LORAWAN_BEACON_PERIOD_S*1000UL + RADIOLIB_LORAWAN_BEACON_RESERVED_MS));
+}
+
+bool LoRaWANNode::isBeaconLocked() {
+  return(this->beaconLocked);
+}
+
+int16_t LoRaWANNode::setPingSlotPeriodicity(uint8_t periodicity) {
+  if(periodicity > RADIOLIB_LORAWAN_PING_PERIODICITY_MAX) {
+    return(RADIOLIB_ERR_INVALID_RX_PERIOD);
+  }
+
+  // the network only learns the periodicity when the device switches to Class B
+  if(this->lwClass == RADIOLIB_LORAWAN_CLASS_B) {
+    return(RADIOLIB_ERR_INVALID_MODE);
+  }
+
+  this->pingPeriodicity = periodicity;
+  this->pingOffsetTime = RADIOLIB_LORAWAN_FCNT_NONE;
+  return(RADIOLIB_ERR_NONE);
+}
+
+RadioLibTime_t LoRaWANNode::timeUntilClassB() {
+  if(this->lwClass != RADIOLIB_LORAWAN_CLASS_B) {
+    return(0);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  RadioLibTime_t tEvent = 0;
+  uint32_t beaconTime = 0;
+  bool isBeacon = false;
+  this->nextClassBEvent(tNow, &tEvent, &beaconTime, &isBeacon);
+  RadioLibTime_t tOpen = tEvent - this->getClassBWidening(tEvent) - this->launchDuration;
+  return(tOpen > tNow ? tOpen - tNow : 0);
+}
+
+int16_t LoRaWANNode::getDownlinkClassB(uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventDown) {
+  // only allow if the device is in Class B, otherwise ignore without error
+  if(this->lwClass != RADIOLIB_LORAWAN_CLASS_B) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+
+  // without beacons, Class B is only kept for a limited time
+  if(tNow - this->tBeacon > RADIOLIB_LORAWAN_BEACON_LESS_PERIOD_MS) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Beacon lost, reverting to Class A");
+    this->beaconLocked = false;
+    this->lwClass = RADIOLIB_LORAWAN_CLASS_A;
+    return(RADIOLIB_ERR_NO_BEACON);
+  }
+
+  RadioLibTime_t tEvent = 0;
+  uint32_t beaconTime = 0;
+  bool isBeacon = false;
+  this->nextClassBEvent(tNow, &tEvent, &beaconTime, &isBeacon);
+  RadioLibTime_t widening = this->getClassBWidening(tEvent);
+  LoRaWANChannel_t chnl = RADIOLIB_LORAWAN_CHANNEL_NONE;
+
+  // a missed beacon is not an error, the device keeps going on its own clock
+  if(isBeacon) {
+    this->getBeaconChannel(beaconTime, &chnl);
+    int16_t state = this->receiveBeacon(&chnl, tEvent - widening, 2*widening);
+    if(state == RADIOLIB_ERR_NO_BEACON) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Beacon missed");
+      state = RADIOLIB_ERR_NONE;
+    }
+    return(state);
+  }
+
+  // a ping slot is handled as a Class A window, opened around the slot start by the widening
+  this->getPingChannel(beaconTime, &chnl);
+  RadioLibTime_t scanGuard = this->scanGuard;
+  this->scanGuard = 2*widening;
+  int16_t state = this->receiveClassA(RADIOLIB_LORAWAN_DOWNLINK, &chnl, RADIOLIB_LORAWAN_RX_BC, tEvent - tNow, tNow);
+  this->scanGuard = scanGuard;
+  if(state <= 0) {
+    return(state);
+  }
+
+  state = this->parseDownlink(dataDown, lenDown, RADIOLIB_LORAWAN_RX_BC, eventDown);
+  RADIOLIB_ASSERT(state);
+  return(RADIOLIB_LORAWAN_RX_BC);
+}
+
+uint64_t LoRaWANNode::localToGps(RadioLibTime_t t) {
+  int64_t elapsed = (int64_t)t - (int64_t)this->tTimeRef;
+  elapsed = elapsed * 1000000LL / (1000000LL + this->clockDrift);
+  return((uint64_t)((int64_t)this->timeRef * 1000LL + elapsed));
+}
+
+RadioLibTime_t LoRaWANNode::gpsToLocal(uint64_t gpsMs) {
+  int64_t elapsed = (int64_t)gpsMs - (int64_t)this->timeRef * 1000LL;
+  elapsed = elapsed * (1000000LL + this->clockDrift) / 1000000LL;
+  return((RadioLibTime_t)((int64_t)this->tTimeRef + elapsed));
+}
+
+RadioLibTime_t LoRaWANNode::getClassBWidening(RadioLibTime_t t) {
+  RadioLibTime_t elapsed = (t > this->tTimeRef) ? t - this->tTimeRef : this->tTimeRef - t;
+  return(this->scanGuard + this->timeRefError + (RadioLibTime_t)((uint64_t)elapsed * RADIOLIB_LORAWAN_CLOCK_DRIFT_PPM / 1000000UL));
+}
+
+void LoRaWANNode::getBeaconChannel(uint32_t beaconTime, LoRaWANChannel_t* chnl) {
+  const LoRaWANBeaconSpan_t* bcn = &this->band->beacon;
+  chnl->idx = 0;
+  chnl->freq = this->beaconFreq;
+
+  // in bands with multiple beacon channels, the beacon hops to the next one every period
+  if(chnl->freq == 0) {
+    chnl->idx = (beaconTime / RADIOLIB_LORAWAN_BEACON_PERIOD_S) % bcn->numChannels;
+    chnl->freq = bcn->freqStart + chnl->idx*bcn->freqStep;
+  }
+  chnl->drMin = bcn->dr;
+  chnl->drMax = bcn->dr;
+  chnl->dr = bcn->dr;
+}
+
+void LoRaWANNode::getPingChannel(uint32_t beaconTime, LoRaWANChannel_t* chnl) {
+  const LoRaWANBeaconSpan_t* bcn = &this->band->beacon;
+  chnl->idx = 0;
+  chnl->freq = this->pingFreq;
+
+  // ping slots use the default beacon channels, hopping with an offset given by the device address
+  if(chnl->freq == 0) {
+    chnl->idx = (this->devAddr + beaconTime / RADIOLIB_LORAWAN_BEACON_PERIOD_S) % bcn->numChannels;
+    chnl->freq = bcn->freqStart + chnl->idx*bcn->freqStep;
+  }
+  chnl->dr = (this->pingDr != RADIOLIB_LORAWAN_DATA_RATE_UNUSED) ? this->pingDr : bcn->dr;
+  chnl->drMin = chnl->dr;
+  chnl->drMax = chnl->dr;
+}
+
+uint16_t LoRaWANNode::getPingOffset(uint32_t beaconTime) {
+  // the offset is the same for all slots in a beacon period, so it only needs to be calculated once
+  if(this->pingOffsetTime == beaconTime) {
+    return(this->pingOffset);
+  }
+
+  // Rand = aes128_encrypt(16 x 0x00, beaconTime | DevAddr | pad16)
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  uint8_t rand[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  LoRaWANNode::hton<uint32_t>(&block[0], beaconTime);
+  LoRaWANNode::hton<uint32_t>(&block[RADIOLIB_LORAWAN_BEACON_TIME_LEN], this->devAddr);
+
+  // a local context, so that the key set up in the shared AES (which may be hardware) is left alone
+  RadioLibSoftwareAES128 aes;
+  aes.init(key);
+  aes.encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, rand);
+
+  uint16_t pingPeriod = RADIOLIB_LORAWAN_PING_SLOTS >> (RADIOLIB_LORAWAN_PING_PERIODICITY_MAX - this->pingPeriodicity);
+  this->pingOffset = ((uint16_t)rand[0] | ((uint16_t)rand[1] << 8)) % pingPeriod;
+  this->pingOffsetTime = beaconTime;
+  return(this->pingOffset);
+}
+
+void LoRaWANNode::nextClassBEvent(RadioLibTime_t tNow, RadioLibTime_t* tEvent, uint32_t* beaconTime, bool* isBeacon) {
+  // the window must still be ahead once the radio is configured
+  RadioLibTime_t lead = this->getClassBWidening(tNow) + this->launchDuration + this->scanGuard;
+  uint64_t gpsNow = this->localToGps(tNow + lead);
+  uint32_t periodStart = (uint32_t)(gpsNow / 1000 / RADIOLIB_LORAWAN_BEACON_PERIOD_S) * RADIOLIB_LORAWAN_BEACON_PERIOD_S;
+
+  // ping slots are spread evenly after the time reserved for the beacon
+  uint16_t pingPeriod = RADIOLIB_LORAWAN_PING_SLOTS >> (RADIOLIB_LORAWAN_PING_PERIODICITY_MAX - this->pingPeriodicity);
+  uint32_t spacing = (uint32_t)pingPeriod * RADIOLIB_LORAWAN_PING_SLOT_LEN_MS;
+  uint64_t gpsFirst = (uint64_t)periodStart * 1000 + RADIOLIB_LORAWAN_BEACON_RESERVED_MS + 
+                      (uint64_t)this->getPingOffset(periodStart) * RADIOLIB_LORAWAN_PING_SLOT_LEN_MS;
+  uint32_t slot = 0;
+  if(gpsNow > gpsFirst) {
+    slot = (uint32_t)((gpsNow - gpsFirst + spacing - 1) / spacing);
+  }
+
+  if(slot < RADIOLIB_LORAWAN_PING_SLOTS / pingPeriod) {
+    *isBeacon = false;
+    *beaconTime = periodStart;
+    *tEvent = this->gpsToLocal(gpsFirst + (uint64_t)slot * spacing);
+    return;
+  }
+
+  // all slots of this period are over, so the next event is the beacon
+  *isBeacon = true;
+  *beaconTime = periodStart + RADIOLIB_LORAWAN_BEACON_PERIOD_S;
+  *tEvent = this->gpsToLocal((uint64_t)*beaconTime * 1000);
+}
+
+int16_t LoRaWANNode::receiveBeacon(const LoRaWANChannel_t* chnl, RadioLibTime_t tWindow, RadioLibTime_t windowLen) {
+  Module* mod = this->phyLayer->getMod();
+  const LoRaWANBeaconSpan_t* bcn = &this->band->beacon;
+
+  // beacons are sent with standard IQ polarity, a longer preamble and in implicit header mode without CRC
+  int16_t state = this->setPhyProperties(chnl, RADIOLIB_LORAWAN_UPLINK, this->txPowerMax - 2*this->txPowerSteps, RADIOLIB_LORAWAN_BEACON_PREAMBLE_LEN);
+  RADIOLIB_ASSERT(state);
+  state = this->phyLayer->setLoRaHeader(bcn->len, false);
+  RADIOLIB_ASSERT(state);
+
+  // a beacon is only reported once it was received completely, so the radio must listen for that long after the window
+  PacketConfig_t pc = this->band->dataRates[chnl->dr].pc;
+  pc.lora.preambleLength = RADIOLIB_LORAWAN_BEACON_PREAMBLE_LEN;
+  pc.lora.implicitHeader = true;
+  pc.lora.crcEnabled = false;
+  RadioLibTime_t toaMs = this->phyLayer->calculateTimeOnAir(this->band->dataRates[chnl->dr].modem, this->band->dataRates[chnl->dr].dr, pc, bcn->len) / 1000;
+
+  // the window is closed by the host, as it may be longer than some radios can time out after
+  RadioModeConfig_t modeCfg;
+  modeCfg.receive.irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS;
+  modeCfg.receive.irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK;
+  modeCfg.receive.len = bcn->len;
+  modeCfg.receive.timeout = 0xFFFFFFFF; // max(uint32_t) is used for RxContinuous
+
+  this->phyLayer->setPacketReceivedAction(LoRaWANNodeOnDownlinkAction);
+  downlinkAction = false;
+
+  RadioLibTime_t tNow = mod->hal->millis();
+  if(tWindow > tNow + this->launchDuration) {
+    this->sleepDelay(tWindow - tNow - this->launchDuration);
+  }
+
+  state = this->phyLayer->stageMode(RADIOLIB_RADIO_MODE_RX, &modeCfg);
+  RADIOLIB_ASSERT(state);
+  state = this->phyLayer->launchMode();
+  RadioLibTime_t tOpen = mod->hal->millis();
+  RADIOLIB_ASSERT(state);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Beacon window open (%lu + %lu ms)", (unsigned long)windowLen, (unsigned long)toaMs);
 
-    } else { // fOptsReLen <= 15
-      memcpy(this->fOptsUp, fOptsRe, fOptsReLen);
-      this->fOptsUpLen = fOptsReLen;
+  uint8_t payload[RADIOLIB_LORAWAN_BEACON_MAX_LEN] = { 0 };
+  uint32_t beaconTime = 0;
+  RadioLibTime_t tStart = 0;
+  state = RADIOLIB_ERR_NO_BEACON;
+  while(mod->hal->millis() - tOpen <= windowLen + toaMs) {
+    if(!downlinkAction) {
+      mod->hal->yield();
+      continue;
     }
-  }
+    downlinkAction = false;
 
-  // apparently this downlink contains user-data
-  *len = payLen;
+    // the beacon started its Time-on-Air before it was reported
+    tStart = mod->hal->millis() - toaMs;
+    if((this->phyLayer->readData(payload, bcn->len) == RADIOLIB_ERR_NONE) && 
+       (this->parseBeacon(payload, bcn->len, &beaconTime) == RADIOLIB_ERR_NONE)) {
+      state = RADIOLIB_ERR_NONE;
+      break;
+    }
 
-  // pass the event info if requested
-  if(event) {
-    event->dir = RADIOLIB_LORAWAN_DOWNLINK;
-    event->confirmed = isConfirmedDown;
-    event->confirming = isConfirmingUp;
-    event->frmPending = (downlinkMsg[RADIOLIB_LORAWAN_FHDR_FCTRL_POS] & RADIOLIB_LORAWAN_FCTRL_FRAME_PENDING) != 0;
-    event->datarate = this->channels[window].dr;
-    event->freq = this->channels[window].freq / 10000.0;
-    event->power = this->txPowerMax - this->txPowerSteps * 2;
-    event->fCnt = devFCnt32;
-    event->fPort = fPort;
-    event->multicast = multicast;
-    event->mcGroupId = mcGroupId;
+    // something else was received, keep listening
+    if(this->phyLayer->stageMode(RADIOLIB_RADIO_MODE_RX, &modeCfg) != RADIOLIB_ERR_NONE || this->phyLayer->launchMode() != RADIOLIB_ERR_NONE) {
+      break;
+    }
   }
 
-  #if !RADIOLIB_STATIC_ONLY
-    delete[] downlinkMsg;
-  #endif
+  // close the window and return to the settings used for all other frames
+  this->phyLayer->clearPacketReceivedAction();
+  this->phyLayer->standby();
+  (void)this->phyLayer->setLoRaHeader(0, true);
+  RADIOLIB_ASSERT(state);
 
+  // the error of the previous prediction shows how much the local clock drifts
+  if(this->beaconLocked && beaconTime > this->timeRef) {
+    int64_t error = (int64_t)tStart - (int64_t)this->gpsToLocal((uint64_t)beaconTime * 1000);
+    int64_t elapsed = (int64_t)(beaconTime - this->timeRef) * 1000;
+    this->clockDrift += (int32_t)(error * 1000000LL / elapsed) / 4;
+  }
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Beacon at GPS time %lu, clock drift %ld ppm", (unsigned long)beaconTime, (long)this->clockDrift);
+
+  // the beacon is the new time reference
+  this->timeRef = beaconTime;
+  this->tTimeRef = tStart;
+  this->timeRefError = 1;
+  this->timeRefValid = true;
+  this->tBeacon = tStart;
+  this->beaconLocked = true;
   return(RADIOLIB_ERR_NONE);
 }
 
-int16_t LoRaWANNode::getDownlinkClassC(uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventDown) {
-  // only allow if the device is Unicast-C or Multicast-C, otherwise ignore without error
-  if(this->lwClass != RADIOLIB_LORAWAN_CLASS_C && this->getMulticastClass() != RADIOLIB_LORAWAN_CLASS_C) {
-    return(RADIOLIB_ERR_NONE);
+int16_t LoRaWANNode::parseBeacon(const uint8_t* payload, size_t len, uint32_t* beaconTime) {
+  const LoRaWANBeaconSpan_t* bcn = &this->band->beacon;
+  if(len < bcn->len) {
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
   }
 
-  int16_t state = RADIOLIB_ERR_NONE;
-
-  if(downlinkAction) {
-    state = this->parseDownlink(dataDown, lenDown, RADIOLIB_LORAWAN_RX_BC, eventDown);
-
-    // re-latch the IRQ interrupt just to be sure
-    this->phyLayer->setPacketReceivedAction(LoRaWANNodeOnDownlinkAction);
-    downlinkAction = false;
-
-    // if downlink parsed successfully, set state to RxC window
-    if(state == RADIOLIB_ERR_NONE) {
-      state = RADIOLIB_LORAWAN_RX_BC;
-    }
+  // the first CRC-16 (CCITT, initial value 0) covers the RFU and time fields, the gateway-specific part is not needed
+  uint8_t crcPos = bcn->rfuLen + RADIOLIB_LORAWAN_BEACON_TIME_LEN;
+  RadioLibCRCInstance.size = 16;
+  RadioLibCRCInstance.poly = RADIOLIB_CRC_CCITT_POLY;
+  RadioLibCRCInstance.init = 0x0000;
+  RadioLibCRCInstance.out = 0x0000;
+  RadioLibCRCInstance.refIn = false;
+  RadioLibCRCInstance.refOut = false;
+  if((uint16_t)RadioLibCRCInstance.checksum(payload, crcPos) != LoRaWANNode::ntoh<uint16_t>(&payload[crcPos])) {
+    return(RADIOLIB_ERR_CRC_MISMATCH);
   }
 
-  return(state);
+  *beaconTime = LoRaWANNode::ntoh<uint32_t>(&payload[bcn->rfuLen]);
+  return(RADIOLIB_ERR_NONE);
 }
 
 bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn) {
@@ -2365,6 +3694,13 @@ bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uin
     case(RADIOLIB_LORAWAN_MAC_LINK_CHECK): {
       RADIOLIB_DEBUG_PROTOCOL_PRINTLN("LinkCheckAns: [user]");
 
+      // the margin is measured at the gateway for the last uplink, convert it to SNR at maximum power
+      int16_t snrReq = this->getRequiredSnr(this->channels[RADIOLIB_LORAWAN_UPLINK].dr);
+      if(this->predictorEnabled && (snrReq != INT16_MIN)) {
+        int16_t snr = (int16_t)optIn[0] + snrReq / 10 + 2*this->txPowerSteps;
+        this->predictorSample((int8_t)RADIOLIB_MIN(snr, (int16_t)INT8_MAX));
+      }
+
       return(false);
     } break;
 
@@ -2477,6 +3813,8 @@ bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uin
 
       // ACK successful, so apply and save
       this->txPowerSteps = macTxSteps;
+      this->netDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+      this->netTxSteps = macTxSteps;
       if(lenIn > 1) {
         uint8_t macNbTrans = optIn[13] & 0x0F;
 
@@ -2742,6 +4080,9 @@ bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uin
       this->dwellTimeUp = ulDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
       this->dwellTimeDn = dlDwell ? RADIOLIB_LORAWAN_DWELL_TIME : 0;
 
+      // payload limits depend on the dwell time
+      this->clearTimeOnAirCache();
+
       memcpy(&this->bufferSession[RADIOLIB_LORAWAN_SESSION_TX_PARAM_SETUP], optIn, lenIn);
 
       return(true);
@@ -2774,6 +4115,15 @@ bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uin
     case(RADIOLIB_LORAWAN_MAC_DEVICE_TIME): {
       RADIOLIB_DEBUG_PROTOCOL_PRINTLN("DeviceTimeAns: [user]");
 
+      // the answer is the GPS time at the end of the uplink, which is the time reference for Class B
+      // until the beacon is received, as a beacon is much more accurate than the 1/256 s fraction
+      if(!this->beaconLocked) {
+        this->timeRef = LoRaWANNode::ntoh<uint32_t>(&optIn[0]);
+        this->tTimeRef = this->tUplinkEnd - (RadioLibTime_t)optIn[4] * 1000UL / 256UL;
+        this->timeRefError = 1000UL / 256UL + 1;
+        this->timeRefValid = true;
+      }
+
       return(false);
     } break;
 
@@ -2808,6 +4158,80 @@ bool LoRaWANNode::execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uin
       return(true);
     } break;
 
+    case(RADIOLIB_LORAWAN_MAC_PING_SLOT_INFO): {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("PingSlotInfoAns");
+
+      return(false);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MAC_PING_SLOT_CHANNEL): {
+      // get the configuration
+      uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[0], 3);
+      uint8_t macDr = optIn[3] & 0x0F;
+      RADIOLIB_DEBUG_PROTOCOL_PRINT("PingSlotChannelReq: dr = %d, freq = ", macDr);
+      RADIOLIB_DEBUG_PROTOCOL_PRINT_FLOAT_NOTAG((double)macFreq / 10000.0, 3);
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN_NOTAG("  MHz");
+      uint8_t freqAck = 0;
+      uint8_t drAck = 0;
+
+      // frequency 0 restores the default ping slot channels of the band
+      if(macFreq == 0 || (macFreq >= this->band->freqMin && macFreq <= this->band->freqMax)) {
+        freqAck = 1;
+      }
+      if(this->band->dataRates[macDr].modem != RADIOLIB_MODEM_NONE) {
+        drAck = 1;
+      }
+
+      // set ACK bits
+      optOut[0] = (drAck << 1) | (freqAck << 0);
+
+      // if not fully acknowledged, return now without applying the requested configuration
+      if(optOut[0] != 0x03) {
+        return(true);
+      }
+
+      this->pingFreq = macFreq;
+      this->pingDr = macDr;
+
+      return(true);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MAC_BEACON_TIMING): {
+      // deprecated since LoRaWAN v1.0.3, DeviceTimeReq should be used instead
+      uint16_t delay = LoRaWANNode::ntoh<uint16_t>(&optIn[0]);
+      uint8_t chIndex = optIn[2];
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("BeaconTimingAns: delay = %d, channel = %d", delay, chIndex);
+
+      // the next beacon starts between 30*(delay + 1) and 30*(delay + 2) ms after the end of the uplink
+      // the actual GPS time is unknown, but any multiple of the beacon period with the correct channel index will do
+      // it is replaced by the real time as soon as the beacon is received
+      if(!this->beaconLocked) {
+        this->timeRef = (uint32_t)chIndex * RADIOLIB_LORAWAN_BEACON_PERIOD_S;
+        this->tTimeRef = this->tUplinkEnd + RADIOLIB_LORAWAN_PING_SLOT_LEN_MS*(delay + 1) + RADIOLIB_LORAWAN_PING_SLOT_LEN_MS/2;
+        this->timeRefError = RADIOLIB_LORAWAN_PING_SLOT_LEN_MS/2 + 1;
+        this->timeRefValid = true;
+      }
+
+      return(false);
+    } break;
+
+    case(RADIOLIB_LORAWAN_MAC_BEACON_FREQ): {
+      // get the configuration
+      uint32_t macFreq = LoRaWANNode::ntoh<uint32_t>(&optIn[0], 3);
+      RADIOLIB_DEBUG_PROTOCOL_PRINT("BeaconFreqReq: freq = ");
+      RADIOLIB_DEBUG_PROTOCOL_PRINT_FLOAT_NOTAG((double)macFreq / 10000.0, 3);
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN_NOTAG("  MHz");
+
+      // frequency 0 restores the default beacon channels of the band
+      optOut[0] = 0;
+      if(macFreq == 0 || (macFreq >= this->band->freqMin && macFreq <= this->band->freqMax)) {
+        optOut[0] = 1;
+        this->beaconFreq = macFreq;
+      }
+
+      return(true);
+    } break;
+
     case(RADIOLIB_LORAWAN_MAC_DEVICE_MODE): {
       // only implemented on LoRaWAN v1.1
       if(this->rev == 0) {
@@ -2942,11 +4366,10 @@ void LoRaWANNode::postprocessMacLinkAdr(uint8_t* ack, uint8_t cLen) {
 }
 
 int16_t LoRaWANNode::getMacCommand(uint8_t cid, LoRaWANMacCommand_t* cmd) {
-  for(size_t i = 0; i < RADIOLIB_LORAWAN_NUM_MAC_COMMANDS; i++) {
-    if(MacTable[i].cid == cid) {
-      memcpy(reinterpret_cast<void*>(cmd), reinterpret_cast<void*>(const_cast<LoRaWANMacCommand_t*>(&MacTable[i])), sizeof(LoRaWANMacCommand_t));
-      return(RADIOLIB_ERR_NONE);
-    }
+  const LoRaWANMacCommand_t* entry = findMacCommand(cid);
+  if(entry) {
+    memcpy(reinterpret_cast<void*>(cmd), reinterpret_cast<const void*>(entry), sizeof(LoRaWANMacCommand_t));
+    return(RADIOLIB_ERR_NONE);
   }
   // didn't find this CID, check if derived class can help (if any)
   int16_t state = this->derivedMacFinder(cid, cmd);
@@ -3027,31 +4450,40 @@ int16_t LoRaWANNode::getMacLen(uint8_t cid, uint8_t* len, uint8_t dir, bool incl
   if(inclusive) {
     *len += 1;    // add one byte for CID
   }
-  
+
+  // base specification commands are read straight from the table, without copying the entry
+  const LoRaWANMacCommand_t* entry = findMacCommand(cid);
   LoRaWANMacCommand_t cmd = RADIOLIB_LORAWAN_MAC_COMMAND_NONE;
-  int16_t state = this->getMacCommand(cid, &cmd);
-  RADIOLIB_ASSERT(state);
+  if(!entry) {
+    int16_t state = this->derivedMacFinder(cid, &cmd);
+    RADIOLIB_ASSERT(state);
+    entry = &cmd;
+  }
   if(dir == RADIOLIB_LORAWAN_UPLINK) {
-    *len += cmd.lenUp;
+    *len += entry->lenUp;
   } else {
-    *len += cmd.lenDn;
+    *len += entry->lenDn;
   }
   return(RADIOLIB_ERR_NONE);
 }
 
 bool LoRaWANNode::isPersistentMacCommand(uint8_t cid, uint8_t dir) {
   // if this MAC command doesn't exist, it wouldn't even get into the queue, so don't care about outcome
+  const LoRaWANMacCommand_t* entry = findMacCommand(cid);
   LoRaWANMacCommand_t cmd = RADIOLIB_LORAWAN_MAC_COMMAND_NONE;
-  (void)this->getMacCommand(cid, &cmd);
+  if(!entry) {
+    (void)this->derivedMacFinder(cid, &cmd);
+    entry = &cmd;
+  }
   
   // in the uplink direction, MAC payload should persist per spec
   if(dir == RADIOLIB_LORAWAN_UPLINK) {
-    return(cmd.persist);
+    return(entry->persist);
 
   // in the downlink direction, MAC payload should persist if it is user-accessible
   // which is the case for LinkCheck and DeviceTime
   } else {
-    return(cmd.user);
+    return(entry->user);
   }
   return(false);
 }
@@ -3073,88 +4505,94 @@ int16_t LoRaWANNode::pushMacCommand(uint8_t cid, const uint8_t* cOcts, uint8_t*
   return(RADIOLIB_ERR_NONE);
 }
 
-int16_t LoRaWANNode::getMacPayload(uint8_t cid, const uint8_t* in, uint8_t lenIn, uint8_t* out, uint8_t dir) {
-  size_t i = 0;
+int16_t LoRaWANNode::nextMacCommand(const uint8_t* in, uint8_t lenIn, uint8_t pos, uint8_t dir, uint8_t* cid, uint8_t* fLen) {
+  if(pos >= lenIn) {
+    return(RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+  }
 
-  while(i < lenIn) {
-    uint8_t id = in[i];
-    uint8_t fLen = 0;
-    int16_t state = this->getMacLen(id, &fLen, dir, true);
-    RADIOLIB_ASSERT(state);
-    if(lenIn < i + fLen) {
-      return(RADIOLIB_ERR_INVALID_CID);
-    }
+  // the length includes the CID byte, so unknown commands can still be skipped by one byte
+  *cid = in[pos];
+  int16_t state = this->getMacLen(*cid, fLen, dir, true, const_cast<uint8_t*>(&in[pos + 1]));
+  RADIOLIB_ASSERT(state);
+  if(pos + *fLen > lenIn) {
+    return(RADIOLIB_ERR_INVALID_PAYLOAD);
+  }
+  return(RADIOLIB_ERR_NONE);
+}
 
+int16_t LoRaWANNode::getMacPayload(uint8_t cid, const uint8_t* in, uint8_t lenIn, uint8_t* out, uint8_t dir) {
+  uint8_t pos = 0;
+  uint8_t id = 0;
+  uint8_t fLen = 0;
+  int16_t state = RADIOLIB_ERR_NONE;
+  while((state = this->nextMacCommand(in, lenIn, pos, dir, &id, &fLen)) == RADIOLIB_ERR_NONE) {
     // if this is the requested MAC id, copy the payload over
     if(id == cid) {
       // only copy payload if destination is supplied
       if(out) {
-        memcpy(out, &in[i + 1], fLen - 1);
+        memcpy(out, &in[pos + 1], fLen - 1);
       }
       return(RADIOLIB_ERR_NONE);
     }
 
     // move on to next MAC command
-    i += fLen;
+    pos += fLen;
   }
 
-  return(RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+  return(state);
 }
 
 int16_t LoRaWANNode::deleteMacCommand(uint8_t cid, uint8_t* inOut, uint8_t* lenInOut, uint8_t dir) {
-  size_t i = 0;
-  while(i < *lenInOut) {
-    uint8_t id = inOut[i];
-    uint8_t fLen = 0;
-    int16_t state = this->getMacLen(id, &fLen, dir);
-    RADIOLIB_ASSERT(state);
-    if(*lenInOut < i + fLen) {
-      return(RADIOLIB_ERR_INVALID_CID);
-    }
-
+  uint8_t pos = 0;
+  uint8_t id = 0;
+  uint8_t fLen = 0;
+  int16_t state = RADIOLIB_ERR_NONE;
+  while((state = this->nextMacCommand(inOut, *lenInOut, pos, dir, &id, &fLen)) == RADIOLIB_ERR_NONE) {
     // if this is the requested MAC id, 
     if(id == cid) {
       // remove it by moving the rest of the payload forward
-      memmove(&inOut[i], &inOut[i + fLen], *lenInOut - i - fLen);
+      memmove(&inOut[pos], &inOut[pos + fLen], *lenInOut - pos - fLen);
 
       // set the remainder of the queue to 0
-      memset(&inOut[i + fLen], 0, *lenInOut - i - fLen);
+      memset(&inOut[*lenInOut - fLen], 0, fLen);
 
       *lenInOut -= fLen;
       return(RADIOLIB_ERR_NONE);
     }
 
     // move on to next MAC command
-    i += fLen;
+    pos += fLen;
   }
 
-  return(RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND);
+  return(state);
 }
 
 void LoRaWANNode::clearMacCommands(uint8_t* inOut, uint8_t* lenInOut, uint8_t dir) {
-  size_t i = 0;
-  uint8_t numDeleted = 0;
-  while(i < *lenInOut) {
-    uint8_t id = inOut[i];
-    uint8_t fLen = 0;
-    // include CID byte, so if command fails, we still move one byte forward
-    (void)this->getMacLen(id, &fLen, dir, true, &inOut[i+1]);
-
-    // only clear MAC command if it should not persist until a downlink is received
-    if(!this->isPersistentMacCommand(id, dir)) {
-      // remove it by moving the rest of the payload forward
-      memmove(&inOut[i], &inOut[i + fLen], *lenInOut - i - fLen);
-
-      // set the remainder of the queue to 0
-      memset(&inOut[i + fLen], 0, *lenInOut - i - fLen);
+  // compact the buffer in a single pass, keeping only the commands that should persist
+  uint8_t pos = 0;
+  uint8_t kept = 0;
+  while(pos < *lenInOut) {
+    uint8_t id = 0;
+    uint8_t fLen = 1;
+    // if command fails, it is treated as a single byte and dropped
+    bool valid = (this->nextMacCommand(inOut, *lenInOut, pos, dir, &id, &fLen) == RADIOLIB_ERR_NONE);
+    if(!valid) {
+      fLen = 1;
+    }
 
-      numDeleted += fLen;
+    // only keep MAC command if it should persist until a downlink is received
+    if(valid && this->isPersistentMacCommand(id, dir)) {
+      memmove(&inOut[kept], &inOut[pos], fLen);
+      kept += fLen;
     }
 
     // move on to next MAC command
-    i += fLen;
+    pos += fLen;
   }
-  *lenInOut -= numDeleted;
+
+  // set the remainder of the queue to 0
+  memset(&inOut[kept], 0, *lenInOut - kept);
+  *lenInOut = kept;
 }
 
 int16_t LoRaWANNode::setDatarate(uint8_t drUp) {
@@ -3245,6 +4683,20 @@ void LoRaWANNode::setADR(bool enable) {
   this->adrEnabled = enable;
 }
 
+void LoRaWANNode::setRatePredictor(bool enable, uint8_t margin) {
+  this->predictorEnabled = enable;
+  this->predictorMargin = margin;
+  this->predictorNum = 0;
+  this->predictorIdx = 0;
+  this->predictorAge = 0;
+  this->predicted = false;
+  this->predictedMargin = RADIOLIB_LORAWAN_MARGIN_UNKNOWN;
+
+  if(!enable) {
+    this->restoreNetRate();
+  }
+}
+
 void LoRaWANNode::setDutyCycle(bool enable, RadioLibTime_t msPerHour) {
   this->dutyCycleEnabled = enable;
   if(!enable) {
@@ -3253,8 +4705,10 @@ void LoRaWANNode::setDutyCycle(bool enable, RadioLibTime_t msPerHour) {
   }
   if(msPerHour == 0) {
     this->dutyCycle = this->band->dutyCycle;
+    this->dcSubBands = true;
   } else {
     this->dutyCycle = msPerHour;
+    this->dcSubBands = false;
   }
 }
 
@@ -3267,6 +4721,9 @@ void LoRaWANNode::setDwellTime(bool enable, RadioLibTime_t msPerUplink) {
   } else {  //msPerUplink == 0
     this->dwellTimeUp = this->band->dwellTimeUp;
   }
+
+  // payload limits depend on the dwell time
+  this->clearTimeOnAirCache();
 }
 
 // A user may enable CSMA to provide frames an additional layer of protection from interference.
@@ -3445,29 +4902,24 @@ int16_t LoRaWANNode::setPhyProperties(const LoRaWANChannel_t* chnl, uint8_t dir,
 // The following function implements LMAC, a CSMA scheme for LoRa as specified 
 // in the LoRa Alliance Technical Recommendation #13.
 bool LoRaWANNode::csmaChannelClear(uint8_t difs, uint8_t numBackoff) {
-  // DIFS phase: perform #DIFS CAD operations
-  uint16_t numCads = 0;
-  for (; numCads < difs; numCads++) {
-    if (!this->cadChannelClear()) {
-      return(false);
-    }
-  }
-
-  // BO phase: perform #numBackoff additional CAD operations
-  for (; numCads < difs + numBackoff; numCads++) {
-    if (!this->cadChannelClear()) {
-      return(false);
-    }
+  // DIFS phase followed by BO phase: perform #DIFS + #numBackoff CAD operations
+  uint16_t numCads = difs + numBackoff;
+  if(numCads == 0) {
+    return(true);
   }
 
-  // none of the CADs showed activity, so all clear
-  return(true);
-}
+  // scan the selected uplink channel, the radio is only tuned once for all CADs
+  const LoRaWANChannel_t* chnl = &this->channels[RADIOLIB_LORAWAN_UPLINK];
+  ChannelScanTarget_t target;
+  target.freq = chnl->freq / 10000.0;
+  target.dr = this->band->dataRates[chnl->dr].dr;
+  target.modem = this->band->dataRates[chnl->dr].modem;
+  uint32_t busy = 0;
+  int16_t state = this->phyLayer->scanChannels(&target, 1, &busy, NULL, numCads);
 
-bool LoRaWANNode::cadChannelClear() {
-  int16_t state = this->phyLayer->scanChannel();
   // if activity was detected, channel is not clear
-  if ((state == RADIOLIB_PREAMBLE_DETECTED) || (state == RADIOLIB_LORA_DETECTED)) {
+  // radios that cannot scan the channel treat it as clear
+  if((state == RADIOLIB_ERR_NONE) && busy) {
     return(false);
   }
   return(true);
@@ -3581,8 +5033,9 @@ int16_t LoRaWANNode::selectChannels() {
   }
 
   // check if any channel is flagged available
+  uint8_t numWords = (channelMax + 15) / 16;
   bool flag = false;
-  for(int i = 0; i < (channelMax + 15) / 16; i++) {
+  for(int i = 0; i < numWords; i++) {
     if(this->channelFlags[i]) {
       flag = true;
       break;
@@ -3597,6 +5050,19 @@ int16_t LoRaWANNode::selectChannels() {
     }
   }
 
+  // prefer channels whose sub-band still has airtime left, even if they were used recently
+  // this only applies to dynamic bands, which keep all channels in the first mask word
+  uint16_t prefer = 0xFFFF;
+  if(this->dutyCycleEnabled && this->band->bandType == RADIOLIB_LORAWAN_BAND_DYNAMIC) {
+    uint16_t ready = this->dutyCycleReadyChannels(this->dcToA);
+    if(ready && !(this->channelFlags[0] & ready)) {
+      this->calculateChannelFlags();
+    }
+    if(this->channelFlags[0] & ready) {
+      prefer = ready;
+    }
+  }
+
   int start = 0;
   int end = channelMax;
 
@@ -3620,15 +5086,36 @@ int16_t LoRaWANNode::selectChannels() {
     }
   }
 
-  // select a random channel index using reservoir sampling
+  // count the available channels within [start, end) one mask word at a time
+  uint16_t words[RADIOLIB_LORAWAN_MAX_NUM_FIXED_CHANNELS / 16] = { 0 };
+  uint8_t counts[RADIOLIB_LORAWAN_MAX_NUM_FIXED_CHANNELS / 16] = { 0 };
+  uint8_t total = 0;
+  for(int i = start / 16; i < numWords && i * 16 < end; i++) {
+    uint32_t range = 0xFFFF;
+    if(i * 16 < start) {
+      range &= 0xFFFF << (start % 16);
+    }
+    if((i + 1) * 16 > end) {
+      range &= 0xFFFF >> (16 - (end % 16));
+    }
+    words[i] = this->channelFlags[i] & range;
+    if(i == 0) {
+      words[i] &= prefer;
+    }
+    counts[i] = rlb_popcount(words[i]);
+    total += counts[i];
+  }
+
+  // draw a single random number and select the matching set bit
   uint8_t idx = 0;
-  uint8_t seen = 0;
-  for(int i = start; i < end; i++) {
-    if(this->channelFlags[i/16] & (0x0001 << (i % 16))) {
-      seen++;
-      if(rand() % seen == 0) {
-        idx = i;
+  if(total > 0) {
+    uint8_t n = this->randomNumber(total);
+    for(int i = start / 16; i < numWords; i++) {
+      if(n < counts[i]) {
+        idx = i * 16 + rlb_select_bit(words[i], n);
+        break;
       }
+      n -= counts[i];
     }
   }
 
@@ -3737,8 +5224,8 @@ uint32_t LoRaWANNode::generateMIC(const uint8_t* msg, size_t len, uint8_t* key)
 
   Module* mod = this->phyLayer->getMod();
   mod->hal->aes128->init(key);
-  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
-  mod->hal->aes128->generateCMAC(msg, len, cmac);
+  uint8_t cmac[sizeof(uint32_t)];
+  mod->hal->aes128->generateMIC(msg, len, cmac);
   return(((uint32_t)cmac[0]) | ((uint32_t)cmac[1] << 8) | ((uint32_t)cmac[2] << 16) | ((uint32_t)cmac[3]) << 24);
 }
 
@@ -3773,13 +5260,167 @@ RadioLibTime_t LoRaWANNode::dutyCycleInterval(RadioLibTime_t msPerHour, RadioLib
   return(delayMs);
 }
 
-RadioLibTime_t LoRaWANNode::timeUntilUplink() {
+RadioLibTime_t LoRaWANNode::timeUntilUplink(uint8_t len) {
   Module* mod = this->phyLayer->getMod();
-  RadioLibTime_t nextUplink = this->tUplinkEnd + dutyCycleInterval(this->dutyCycle, this->lastToA);
-  if(mod->hal->millis() > nextUplink){
+  RadioLibTime_t tNow = mod->hal->millis();
+  RadioLibTime_t nextUplink = this->getNextUplinkTime(len);
+  if(nextUplink == RADIOLIB_LORAWAN_UPLINK_NEVER) {
+    return(RADIOLIB_LORAWAN_UPLINK_NEVER);
+  }
+  if(tNow >= nextUplink) {
     return(0);
   }
-  return(nextUplink - mod->hal->millis() + 1);
+  return(nextUplink - tNow);
+}
+
+RadioLibTime_t LoRaWANNode::getNextUplinkTime(uint8_t len) {
+  // the complete frame consists of the payload, FOpts and 13 bytes of header, port and MIC
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  RadioLibTime_t toa = 0;
+  if(drUp < RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES) {
+    toa = this->getTimeOnAir(drUp, len + this->fOptsUpLen + 13) / 1000;
+  }
+  return(this->dutyCycleNextTime(toa));
+}
+
+RadioLibTime_t LoRaWANNode::dutyCycleNextTime(RadioLibTime_t toa) {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  if(!this->dutyCycleEnabled) {
+    return(tNow);
+  }
+
+  // fixed bands have no sub-bands, so any channel will do
+  if(this->band->bandType == RADIOLIB_LORAWAN_BAND_FIXED) {
+    return(this->dutyCycleReadyTime(this->channels[RADIOLIB_LORAWAN_UPLINK].freq, toa));
+  }
+
+  // the earliest time at which any enabled channel is ready
+  uint8_t drUp = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
+  RadioLibTime_t tNext = 0;
+  bool any = false;
+  for(int i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_DYNAMIC_CHANNELS; i++) {
+    const LoRaWANChannel_t* chnl = &this->dynamicChannels[RADIOLIB_LORAWAN_UPLINK][i];
+    if(!(this->channelMasks[0] & (0x0001 << i)) || drUp < chnl->drMin || drUp > chnl->drMax) {
+      continue;
+    }
+    RadioLibTime_t tReady = this->dutyCycleReadyTime(chnl->freq, toa);
+    if(!any || tReady < tNext) {
+      tNext = tReady;
+      any = true;
+    }
+  }
+  if(!any) {
+    return(tNow);
+  }
+  return(tNext);
+}
+
+uint8_t LoRaWANNode::dutyCycleBuckets(uint32_t freq, uint8_t* buckets) {
+  uint8_t num = 0;
+  if(this->dcSubBands) {
+    for(uint8_t i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS; i++) {
+      const LoRaWANDutyCycleBand_t* dcBand = &this->band->dcBands[i];
+      if(dcBand->msPerHour && freq >= dcBand->freqStart && freq <= dcBand->freqEnd) {
+        buckets[num++] = i;
+        break;
+      }
+    }
+  }
+
+  // channels outside of any sub-band use the band-wide limit,
+  // which also applies on top of the sub-bands when the network requested a lower duty cycle
+  if((num == 0) || (this->dutyCycle != this->band->dutyCycle)) {
+    buckets[num++] = RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS;
+  }
+  return(num);
+}
+
+RadioLibTime_t LoRaWANNode::dutyCycleBudget(uint8_t bucket) {
+  if(bucket < RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS) {
+    return(this->band->dcBands[bucket].msPerHour);
+  }
+  return(this->dutyCycle);
+}
+
+RadioLibTime_t LoRaWANNode::dutyCycleCapacity(RadioLibTime_t budget) {
+  // a part of the budget may be saved up, but at least enough for the longest uplink,
+  // and never more than the complete budget
+  RadioLibTime_t capacity = RADIOLIB_MAX(budget / RADIOLIB_LORAWAN_DC_BURST_DIV, (RadioLibTime_t)RADIOLIB_LORAWAN_DC_MAX_TOA);
+  return(RADIOLIB_MIN(capacity, budget));
+}
+
+int32_t LoRaWANNode::dutyCycleTokens(uint8_t bucket, RadioLibTime_t t) {
+  RadioLibTime_t budget = this->dutyCycleBudget(bucket);
+  if(budget == 0) {
+    return(INT32_MAX);
+  }
+
+  // the bucket is refilled with the complete budget over the hour,
+  // so that steady uplinks get the full budget and only bursts are limited by the capacity
+  RadioLibTime_t capacity = this->dutyCycleCapacity(budget);
+  RadioLibTime_t elapsed = 0;
+  if(t > this->dcTime[bucket]) {
+    elapsed = RADIOLIB_MIN(t - this->dcTime[bucket], (RadioLibTime_t)3600000UL);
+  }
+  int64_t tokens = (int64_t)this->dcTokens[bucket] + (int64_t)elapsed * budget / 3600;
+  return((int32_t)RADIOLIB_MIN(tokens, (int64_t)capacity * 1000));
+}
+
+RadioLibTime_t LoRaWANNode::dutyCycleReadyTime(uint32_t freq, RadioLibTime_t toa) {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  RadioLibTime_t tReady = tNow;
+
+  // an uplink may start as soon as all buckets of its sub-band can carry its complete airtime
+  int64_t required = (int64_t)toa * 1000;
+  uint8_t buckets[2];
+  uint8_t num = this->dutyCycleBuckets(freq, buckets);
+  for(uint8_t i = 0; i < num; i++) {
+    int32_t tokens = this->dutyCycleTokens(buckets[i], tNow);
+    if(tokens >= required) {
+      continue;
+    }
+
+    // an uplink longer than the bucket can never be sent within the budget
+    RadioLibTime_t budget = this->dutyCycleBudget(buckets[i]);
+    RadioLibTime_t capacity = this->dutyCycleCapacity(budget);
+    if(required > (int64_t)capacity * 1000) {
+      return(RADIOLIB_LORAWAN_UPLINK_NEVER);
+    }
+    RadioLibTime_t wait = (RadioLibTime_t)(((required - tokens) * 3600 + budget - 1) / budget);
+    tReady = RADIOLIB_MAX(tReady, tNow + wait);
+  }
+  return(tReady);
+}
+
+void LoRaWANNode::dutyCycleCharge(uint32_t freq, RadioLibTime_t toa) {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  uint8_t buckets[2];
+  uint8_t num = this->dutyCycleBuckets(freq, buckets);
+  for(uint8_t i = 0; i < num; i++) {
+    if(this->dutyCycleBudget(buckets[i]) == 0) {
+      continue;
+    }
+    this->dcTokens[buckets[i]] = this->dutyCycleTokens(buckets[i], tNow) - (int32_t)(toa * 1000);
+    this->dcTime[buckets[i]] = tNow;
+  }
+}
+
+uint16_t LoRaWANNode::dutyCycleReadyChannels(RadioLibTime_t toa) {
+  Module* mod = this->phyLayer->getMod();
+  RadioLibTime_t tNow = mod->hal->millis();
+  uint16_t ready = 0;
+  for(int i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_DYNAMIC_CHANNELS; i++) {
+    if(!(this->channelMasks[0] & (0x0001 << i))) {
+      continue;
+    }
+    if(this->dutyCycleReadyTime(this->dynamicChannels[RADIOLIB_LORAWAN_UPLINK][i].freq, toa) <= tNow) {
+      ready |= (0x0001 << i);
+    }
+  }
+  return(ready);
 }
 
 uint8_t LoRaWANNode::getMaxPayloadLen() {
@@ -3795,34 +5436,80 @@ uint8_t LoRaWANNode::getMaxPayloadLen() {
   }
 
   const uint8_t currentDr = this->channels[RADIOLIB_LORAWAN_UPLINK].dr;
-  const ModemType_t modem = this->band->dataRates[currentDr].modem;
-  const DataRate_t* dr = &this->band->dataRates[currentDr].dr;
-  const PacketConfig_t* pc = &this->band->dataRates[currentDr].pc;
 
-  // fast exit in case upper limit is already good
-  if(this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, maxLen) / 1000 <= this->dwellTimeUp) {
-    // subtract FHDR (13 bytes) as well as any FOpts
-    return(maxLen - 13 - this->fOptsUpLen);
+  // if the band has changed, the stored limits are no longer valid
+  if(this->toaCacheBand != this->band) {
+    this->clearTimeOnAirCache();
   }
 
-  // do some binary search to find maximum allowed length
-  uint8_t curLen = (minLen + maxLen) / 2;
-  while(curLen != minLen && curLen != maxLen) {
-    if(this->phyLayer->calculateTimeOnAir(modem, *dr, *pc, curLen) / 1000 > this->dwellTimeUp) {
-      maxLen = curLen;
+  // the limit only depends on datarate and dwell time, so it is calculated once per datarate
+  if(!(this->maxLenDwellValid & (0x0001 << currentDr))) {
+    // fast exit in case upper limit is already good
+    if(this->getTimeOnAir(currentDr, maxLen) / 1000 <= this->dwellTimeUp) {
+      this->maxLenDwell[currentDr] = maxLen;
+
     } else {
-      minLen = curLen;
+      // do some binary search to find maximum allowed length
+      uint8_t curLen = (minLen + maxLen) / 2;
+      while(curLen != minLen && curLen != maxLen) {
+        if(this->getTimeOnAir(currentDr, curLen) / 1000 > this->dwellTimeUp) {
+          maxLen = curLen;
+        } else {
+          minLen = curLen;
+        }
+        curLen = (minLen + maxLen) / 2;
+      }
+      this->maxLenDwell[currentDr] = curLen;
     }
-    curLen = (minLen + maxLen) / 2;
+    this->maxLenDwellValid |= (0x0001 << currentDr);
+  }
+
+  // no application payload fits if the frame header alone exceeds the dwell time
+  if(this->maxLenDwell[currentDr] < 13 + this->fOptsUpLen) {
+    return(0);
   }
+
   // subtract FHDR (13 bytes) as well as any FOpts
-  return(curLen - 13 - this->fOptsUpLen);
+  return(this->maxLenDwell[currentDr] - 13 - this->fOptsUpLen);
+}
+
+RadioLibTime_t LoRaWANNode::getTimeOnAir(uint8_t dr, uint16_t len) {
+  // if the band has changed, all cached values are invalid
+  if(this->toaCacheBand != this->band) {
+    this->clearTimeOnAirCache();
+  }
+
+  // direct-mapped cache, the index spreads both datarate and length over the entries
+  LoRaWANTimeOnAir_t* entry = &this->toaCache[(len ^ (dr * 5)) % RADIOLIB_LORAWAN_TOA_CACHE_SIZE];
+  if(entry->toa && entry->dr == dr && entry->len == len) {
+    return(entry->toa);
+  }
+
+  const ModemType_t modem = this->band->dataRates[dr].modem;
+  const DataRate_t* datarate = &this->band->dataRates[dr].dr;
+  const PacketConfig_t* pc = &this->band->dataRates[dr].pc;
+  entry->dr = dr;
+  entry->len = len;
+  entry->toa = this->phyLayer->calculateTimeOnAir(modem, *datarate, *pc, len);
+  return(entry->toa);
+}
+
+void LoRaWANNode::clearTimeOnAirCache() {
+  memset(this->toaCache, 0, sizeof(this->toaCache));
+  memset(this->maxLenDwell, 0, sizeof(this->maxLenDwell));
+  this->maxLenDwellValid = 0;
+  this->toaCacheBand = this->band;
 }
 
 void LoRaWANNode::setSleepFunction(SleepCb_t cb) {
   this->sleepCb = cb;
 }
 
+void LoRaWANNode::setRandomFunction(RandomCb_t cb, void* ctx) {
+  this->randomCb = cb;
+  this->randomCtx = ctx;
+}
+
 int16_t LoRaWANNode::addAppPackage(uint8_t fPort) {
   return(this->addPackage(fPort, true));
 }
@@ -3919,6 +5606,18 @@ void LoRaWANNode::sleepDelay(RadioLibTime_t ms, bool radioOff) {
   }
 }
 
+uint32_t LoRaWANNode::randomNumber(uint32_t max) {
+  if(max == 0) {
+    return(0);
+  }
+
+  // call the user-provided callback if provided
+  if(this->randomCb) {
+    return(this->randomCb(max, this->randomCtx) % max);
+  }
+  return((uint32_t)rand() % max);
+}
+
 int16_t LoRaWANNode::checkBufferCommon(const uint8_t *buffer, uint16_t size) {
   // check if there are actually values in the buffer
   size_t i = 0;
@@ -39,6 +39,7 @@
 #define RADIOLIB_LORAWAN_FCTRL_ADR_ACK_REQ                      (0x01 << 6) //  6     6     adaptive data rate ACK request
 #define RADIOLIB_LORAWAN_FCTRL_ACK                              (0x01 << 5) //  5     5     confirmed message acknowledge
 #define RADIOLIB_LORAWAN_FCTRL_FRAME_PENDING                    (0x01 << 4) //  4     4     downlink frame is pending
+#define RADIOLIB_LORAWAN_FCTRL_CLASS_B                          (0x01 << 4) //  4     4     uplink from a Class B device
 
 // fPort field
 #define RADIOLIB_LORAWAN_FPORT_MAC_COMMAND                      (0x00 << 0) //  7     0     payload contains MAC commands only
@@ -155,6 +156,18 @@
 #define RADIOLIB_LORAWAN_BACKOFF_MAX_DEFAULT                    (6)
 #define RADIOLIB_LORAWAN_MAX_CHANGES_DEFAULT                    (4)
 
+// Class B beacon and ping slot timing
+#define RADIOLIB_LORAWAN_BEACON_PERIOD_S                        (128)     // beacon period in seconds
+#define RADIOLIB_LORAWAN_BEACON_RESERVED_MS                     (2120)    // time reserved for the beacon after its start
+#define RADIOLIB_LORAWAN_BEACON_PREAMBLE_LEN                    (10)
+#define RADIOLIB_LORAWAN_BEACON_TIME_LEN                        (4)
+#define RADIOLIB_LORAWAN_BEACON_MAX_LEN                         (23)
+#define RADIOLIB_LORAWAN_BEACON_LESS_PERIOD_MS                  (7200000UL) // Class B is kept for 2 hours without beacons
+#define RADIOLIB_LORAWAN_PING_SLOT_LEN_MS                       (30)
+#define RADIOLIB_LORAWAN_PING_SLOTS                             (4096)    // number of ping slots per beacon period
+#define RADIOLIB_LORAWAN_PING_PERIODICITY_DEFAULT               (7)       // a single ping slot per beacon period
+#define RADIOLIB_LORAWAN_PING_PERIODICITY_MAX                   (7)
+
 // MAC commands
 #define RADIOLIB_LORAWAN_NUM_MAC_COMMANDS                       (24)
 
@@ -173,6 +186,10 @@
 #define RADIOLIB_LORAWAN_MAC_DEVICE_TIME                        (0x0D)
 #define RADIOLIB_LORAWAN_MAC_FORCE_REJOIN                       (0x0E)
 #define RADIOLIB_LORAWAN_MAC_REJOIN_PARAM_SETUP                 (0x0F)
+#define RADIOLIB_LORAWAN_MAC_PING_SLOT_INFO                     (0x10)
+#define RADIOLIB_LORAWAN_MAC_PING_SLOT_CHANNEL                  (0x11)
+#define RADIOLIB_LORAWAN_MAC_BEACON_TIMING                      (0x12)
+#define RADIOLIB_LORAWAN_MAC_BEACON_FREQ                        (0x13)
 #define RADIOLIB_LORAWAN_MAC_DEVICE_MODE                        (0x20)
 #define RADIOLIB_LORAWAN_MAC_PROPRIETARY                        (0x80)
 
@@ -194,9 +211,83 @@
 #define RADIOLIB_LORAWAN_SESSION_PENDING                        (0x02)
 #define RADIOLIB_LORAWAN_SESSION_ACTIVE                         (0x03)
 
+// states of the non-blocking uplink/downlink sequence
+#define RADIOLIB_LORAWAN_ASYNC_IDLE                             (0x00)
+#define RADIOLIB_LORAWAN_ASYNC_TX_WAIT                          (0x01)
+#define RADIOLIB_LORAWAN_ASYNC_TX_PENDING                       (0x02)
+#define RADIOLIB_LORAWAN_ASYNC_TX                               (0x03)
+#define RADIOLIB_LORAWAN_ASYNC_RX1_PENDING                      (0x04)
+#define RADIOLIB_LORAWAN_ASYNC_RX1                              (0x05)
+#define RADIOLIB_LORAWAN_ASYNC_RX2_PENDING                      (0x06)
+#define RADIOLIB_LORAWAN_ASYNC_RX2                              (0x07)
+
 // threshold at which sleeping via user callback enabled, in ms
 #define RADIOLIB_LORAWAN_DELAY_SLEEP_THRESHOLD                  (50)
 
+// maximum number of nodes running a non-blocking sequence at the same time
+#define RADIOLIB_LORAWAN_ASYNC_NUM_NODES                        (4)
+
+// number of entries in the Time-on-Air cache
+#define RADIOLIB_LORAWAN_TOA_CACHE_SIZE                         (16)
+
+// number of link quality samples kept by the client-side rate predictor
+#if !defined(RADIOLIB_LORAWAN_PREDICTOR_HISTORY)
+  #define RADIOLIB_LORAWAN_PREDICTOR_HISTORY                    (8)
+#endif
+
+// number of uplinks after which the rate predictor discards its samples if no new ones were received
+#if !defined(RADIOLIB_LORAWAN_PREDICTOR_MAX_AGE)
+  #define RADIOLIB_LORAWAN_PREDICTOR_MAX_AGE                    (16)
+#endif
+
+// default margin (dB) kept by the rate predictor on top of the demodulation floor
+#define RADIOLIB_LORAWAN_PREDICTOR_MARGIN_DEFAULT               (10)
+
+// link margin is not known
+#define RADIOLIB_LORAWAN_MARGIN_UNKNOWN                         (-128)
+
+// keys that can be kept in a key slot of the AES engine
+#define RADIOLIB_LORAWAN_KEY_NWK                                (0)
+#define RADIOLIB_LORAWAN_KEY_APP                                (1)
+#define RADIOLIB_LORAWAN_KEY_APP_S                              (2)
+#define RADIOLIB_LORAWAN_KEY_F_NWK_S_INT                        (3)
+#define RADIOLIB_LORAWAN_KEY_S_NWK_S_INT                        (4)
+#define RADIOLIB_LORAWAN_KEY_NWK_S_ENC                          (5)
+#define RADIOLIB_LORAWAN_KEY_J_S_INT                            (6)
+#define RADIOLIB_LORAWAN_NUM_KEYS                               (7)
+#define RADIOLIB_LORAWAN_KEY_ID_NONE                            (0xFF)
+
+// maximum number of application records in the uplink queue
+#if !defined(RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN)
+  #define RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN                     (8)
+#endif
+
+// total size of the application records in the uplink queue (bytes)
+#if !defined(RADIOLIB_LORAWAN_UPLINK_QUEUE_SIZE)
+  #define RADIOLIB_LORAWAN_UPLINK_QUEUE_SIZE                    (256)
+#endif
+
+// maximum number of regulatory duty cycle sub-bands per band
+#define RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS                       (6)
+
+// fraction of the hourly airtime budget that may be saved up and sent as a burst,
+// the bucket is refilled with the full budget over the hour, so the airtime averages out at the budget
+#if !defined(RADIOLIB_LORAWAN_DC_BURST_DIV)
+  #define RADIOLIB_LORAWAN_DC_BURST_DIV                         (10)
+#endif
+
+// airtime that can always be saved up (in milliseconds), as long as the budget allows it,
+// so that the longest uplinks (SF12, 51 bytes) also fit into the 0.1 % sub-bands
+#if !defined(RADIOLIB_LORAWAN_DC_MAX_TOA)
+  #define RADIOLIB_LORAWAN_DC_MAX_TOA                           (3000)
+#endif
+
+// returned as uplink time when the uplink can never be sent within the duty cycle budget
+#define RADIOLIB_LORAWAN_UPLINK_NEVER                           ((RadioLibTime_t)-1)
+
+// returned as time until the next queued uplink when the uplink queue is empty
+#define RADIOLIB_LORAWAN_QUEUE_EMPTY                            ((RadioLibTime_t)-2)
+
 /*!
   \struct LoRaWANMacCommand_t
   \brief MAC command specification structure.
@@ -376,6 +467,52 @@ struct LoRaWANChannelSpan_t {
 // alias for unused channel span
 #define RADIOLIB_LORAWAN_CHANNEL_SPAN_NONE    { .numChannels = 0, .freqStart = 0, .freqStep = 0, .drMin = 0, .drMax = 0, .drJoinRequest = RADIOLIB_LORAWAN_DATA_RATE_UNUSED }
 
+/*!
+  \struct LoRaWANBeaconSpan_t
+  \brief Structure to save information about the Class B beacon channels of a band.
+  By default, ping slots use the same channels and datarate as the beacon.
+*/
+struct LoRaWANBeaconSpan_t {
+  /*! \brief Number of beacon channels, 0 if the band does not support Class B */
+  uint8_t numChannels;
+
+  /*! \brief Frequency of the first beacon channel (coded in 100 Hz steps) */
+  uint32_t freqStart;
+
+  /*! \brief Frequency step between beacon channels (coded in 100 Hz steps) */
+  uint32_t freqStep;
+
+  /*! \brief Datarate of the beacon */
+  uint8_t dr;
+
+  /*! \brief Length of the RFU field in front of the beacon time */
+  uint8_t rfuLen;
+
+  /*! \brief Total length of the beacon payload */
+  uint8_t len;
+};
+
+// alias for bands without Class B support
+#define RADIOLIB_LORAWAN_BEACON_NONE    { .numChannels = 0, .freqStart = 0, .freqStep = 0, .dr = 0, .rfuLen = 0, .len = 0 }
+
+/*!
+  \struct LoRaWANDutyCycleBand_t
+  \brief Structure to save a regulatory sub-band with its own duty cycle limit.
+*/
+struct LoRaWANDutyCycleBand_t {
+  /*! \brief Lowest frequency in the sub-band (coded in 100 Hz steps) */
+  uint32_t freqStart;
+
+  /*! \brief Highest frequency in the sub-band (coded in 100 Hz steps) */
+  uint32_t freqEnd;
+
+  /*! \brief Number of milliseconds per hour of allowed Time-on-Air, 0 if unused */
+  RadioLibTime_t msPerHour;
+};
+
+// alias for unused duty cycle sub-band
+#define RADIOLIB_LORAWAN_DC_BAND_NONE   { .freqStart = 0, .freqEnd = 0, .msPerHour = 0 }
+
 struct LoRaWANDataRate_t {
   ModemType_t modem;
   DataRate_t dr;
@@ -384,6 +521,42 @@ struct LoRaWANDataRate_t {
 
 #define RADIOLIB_DATARATE_NONE { .modem = RADIOLIB_MODEM_NONE, .dr = {.lora = {0, 0, 0}}, .pc = {.lora = { 8, 0, 0, 0}}}
 
+/*!
+  \struct LoRaWANQueuedUplink_t
+  \brief Structure to save an application record waiting in the uplink queue.
+*/
+struct LoRaWANQueuedUplink_t {
+  /*! \brief Record ID, reported back once the record was sent */
+  uint8_t id;
+
+  /*! \brief FPort of the record, only records for the same FPort share a frame */
+  uint8_t fPort;
+
+  /*! \brief Whether the record must be acknowledged by the server */
+  bool isConfirmed;
+
+  /*! \brief Length of the record in bytes */
+  uint8_t len;
+
+  /*! \brief Time at which the record must be sent at the latest */
+  RadioLibTime_t deadline;
+};
+
+/*!
+  \struct LoRaWANTimeOnAir_t
+  \brief Structure to save a cached Time-on-Air value.
+*/
+struct LoRaWANTimeOnAir_t {
+  /*! \brief Datarate index within the band */
+  uint8_t dr;
+
+  /*! \brief PHY payload length in bytes */
+  uint16_t len;
+
+  /*! \brief Time-on-Air in microseconds, 0 if this entry is not valid */
+  RadioLibTime_t toa;
+};
+
 /*!
   \struct LoRaWANBand_t
   \brief Structure to save information about LoRaWAN band
@@ -447,6 +620,12 @@ struct LoRaWANBand_t {
   
   /*! \brief The corresponding datarates, bandwidths and coding rates for DR index */
   LoRaWANDataRate_t dataRates[RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES];
+
+  /*! \brief Class B beacon channels */
+  LoRaWANBeaconSpan_t beacon;
+
+  /*! \brief Sub-bands with their own duty cycle limit, channels outside of these use the band-wide dutyCycle */
+  LoRaWANDutyCycleBand_t dcBands[RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS];
 };
 
 // supported bands
@@ -543,6 +722,13 @@ struct LoRaWANEvent_t {
 
   /*! \brief Multicast Group ID if this was a multicast downlink */
   uint8_t mcGroupId;
+
+  /*! \brief Whether datarate and power of this uplink were chosen by the client-side rate predictor */
+  bool predicted;
+
+  /*! \brief Link margin in dB above the demodulation floor at the uplink datarate, 
+  as estimated by the rate predictor, or RADIOLIB_LORAWAN_MARGIN_UNKNOWN */
+  int8_t margin;
 };
 
 /*!
@@ -560,6 +746,11 @@ class LoRaWANNode {
     */
     LoRaWANNode(PhysicalLayer* phy, const LoRaWANBand_t* band, uint8_t subBand = 0);
 
+    /*!
+      \brief Default destructor, frees the interrupt slot of a non-blocking sequence that is still running.
+    */
+    ~LoRaWANNode();
+
     /*!
       \brief Returns the pointer to the internal buffer that holds the LW base parameters
       \returns Pointer to uint8_t array of size RADIOLIB_LORAWAN_NONCES_BUF_SIZE
@@ -613,6 +804,15 @@ class LoRaWANNode {
     */
     int16_t beginABP(uint32_t addr, const uint8_t* fNwkSIntKey, const uint8_t* sNwkSIntKey, const uint8_t* nwkSEncKey, const uint8_t* appSKey);
 
+    /*!
+      \brief Keep a key in a key slot of the AES engine set in RadioLibHal::aes128 (e.g. LR11x0AES128).
+      The key is stored in the engine whenever it is set, derived or restored, and is not transferred again each time it is used.
+      \param key Which key, e.g. RADIOLIB_LORAWAN_KEY_APP_S.
+      Once set, the key slot stays in use by the key.
+      \param keyId Key slot in the AES engine.
+    */
+    void setKeyId(uint8_t key, uint8_t keyId);
+
     /*!
       \brief Join network by restoring OTAA session or performing over-the-air activation. By this procedure,
       the device will perform an exchange with the network server and set all necessary configuration. 
@@ -630,7 +830,12 @@ class LoRaWANNode {
     /*! \brief Whether there is an ongoing session active */
     bool isActivated();
 
-    /*! \brief Configure class (RADIOLIB_LORAWAN_CLASS_A or RADIOLIB_LORAWAN_CLASS_C) */
+    /*! 
+      \brief Configure class (RADIOLIB_LORAWAN_CLASS_A, RADIOLIB_LORAWAN_CLASS_B or RADIOLIB_LORAWAN_CLASS_C).
+      Switching to Class B requires the device to be locked on to the beacon, see acquireBeacon().
+      \param cls The new class.
+      \returns \ref status_codes
+    */
     int16_t setClass(uint8_t cls);
 
     /*!
@@ -658,6 +863,14 @@ class LoRaWANNode {
     */
     int16_t startMulticastSession(uint8_t id, MulticastGroup_t* mcGroup);
 
+    /*!
+      \brief Check whether a Multicast session could be started with the given configuration,
+      without starting it. Unset frequency and datarate are filled in with the Rx2 values.
+      \param mcGroup Multicast group specification structure.
+      \returns \ref status_codes
+    */
+    int16_t checkMulticastSession(MulticastGroup_t* mcGroup);
+
     /*! 
       \brief Stop an ongoing multicast session 
       \param id Multicast group ID to stop. Must match the ID used to start the session.
@@ -740,6 +953,108 @@ class LoRaWANNode {
     */
     virtual int16_t sendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown, bool isConfirmed = false, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
 
+    /*!
+      \brief Start a non-blocking uplink/downlink sequence. The sequence is driven by calling tick(),
+      which must be done at least when timeUntilTick() reaches zero or the radio interrupt fires.
+      Rx windows are timed from the moment the Tx done interrupt fired, so a late tick does not shift them.
+      Unlike sendReceive, no RxC windows are opened in between Rx1 and Rx2.
+      All buffers must remain valid until the sequence has finished. Each running sequence occupies
+      one of RADIOLIB_LORAWAN_ASYNC_NUM_NODES interrupt slots, so that nodes on separate radios can run
+      their sequences at the same time. If all slots are taken, RADIOLIB_LORAWAN_SEQUENCE_BUSY is returned.
+      \param dataUp Data to send.
+      \param lenUp Length of the data.
+      \param fPort Port number to send the message to.
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param isConfirmed Whether to send a confirmed uplink or not.
+      \param eventUp Pointer to a structure to store extra information about the uplink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns \ref status_codes
+    */
+    int16_t startSendReceive(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, uint8_t* dataDown, size_t* lenDown, bool isConfirmed = false, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Advance the non-blocking uplink/downlink sequence started by startSendReceive.
+      \returns RADIOLIB_LORAWAN_SEQUENCE_BUSY while the sequence is in progress. Once it finishes,
+      the same value as sendReceive would return: window number > 0 if downlink was received,
+      0 if no downlink was received, otherwise \ref status_codes
+    */
+    int16_t tick();
+
+    /*!
+      \brief Get the time until tick() must be called next.
+      \returns Time in milliseconds, 0 if tick() should be called right away or no sequence is in progress.
+    */
+    RadioLibTime_t timeUntilTick();
+
+    /*!
+      \brief Add an application record to the uplink queue. Records for the same FPort are packed
+      back to back into as few frames as possible, so the application must be able to split them again,
+      e.g. by using fixed-length or self-delimiting records. Call sendQueued() to send the frames.
+      \param data Record to send.
+      \param len Length of the record, at most getMaxPayloadLen() at the current datarate.
+      \param fPort Port number to send the record to.
+      \param maxDelay Maximum time in milliseconds that the record may wait for other records.
+      \param isConfirmed Whether the record must be sent in a confirmed uplink.
+      \param id Pointer to a variable to save the record ID into, may be NULL.
+      \returns \ref status_codes
+    */
+    int16_t queueUplink(const uint8_t* data, size_t len, uint8_t fPort, RadioLibTime_t maxDelay, bool isConfirmed = false, uint8_t* id = NULL);
+
+    /*!
+      \brief Send the next frame from the uplink queue if it is due: a record has reached its deadline,
+      enough records were queued to fill a frame at the current datarate, or the queue is full.
+      The frame is sent and received by sendReceive(), so the same rules apply.
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param force Whether to send a frame even if no record is due yet.
+      \param eventUp Pointer to a structure to store extra information about the uplink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns RADIOLIB_LORAWAN_QUEUE_WAITING (positive) if nothing was sent, otherwise the same value as sendReceive:
+      window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t sendQueued(uint8_t* dataDown, size_t* lenDown, bool force = false, LoRaWANEvent_t* eventUp = NULL, LoRaWANEvent_t* eventDown = NULL);
+
+    /*!
+      \brief Get the time until sendQueued() should be called next, including dutyCycle limits.
+      \returns Time in milliseconds, 0 if a frame can be sent right away, RADIOLIB_LORAWAN_QUEUE_EMPTY if nothing is queued,
+      RADIOLIB_LORAWAN_UPLINK_NEVER if the next frame is too long to ever fit into the duty cycle budget.
+    */
+    RadioLibTime_t timeUntilQueuedUplink();
+
+    /*!
+      \brief Get the number of records in the uplink queue.
+      \returns Number of records waiting to be sent.
+    */
+    uint8_t getNumQueuedUplinks();
+
+    /*!
+      \brief Callback called for every queued record once the frame containing it was sent.
+      \param id Record ID as returned by queueUplink.
+      \param state RADIOLIB_ERR_NONE if the record was sent (and acknowledged, if it was confirmed),
+      RADIOLIB_ERR_ACK_NOT_RECEIVED if a confirmed record was not acknowledged, otherwise \ref status_codes
+    */
+    typedef void (*QueuedUplinkCb_t)(uint8_t id, int16_t state);
+
+    /*!
+      \brief Set callback to be called for every queued record once the frame containing it was sent.
+      \param cb Callback function.
+    */
+    void setQueuedUplinkCb(QueuedUplinkCb_t cb);
+
+    /*! \brief Callback called once a non-blocking uplink/downlink sequence has finished. */
+    typedef void (*SendReceiveCb_t)(int16_t state);
+
+    /*!
+      \brief Set callback to be called from tick() once a non-blocking uplink/downlink sequence has finished.
+      \param cb Callback, its argument is the final result of the sequence (see tick()).
+    */
+    void setSendReceiveCallback(SendReceiveCb_t cb);
+
     /*!
       \brief Check if there is an RxC downlink and parse it if available.
       \param dataDown Buffer to save received data into.
@@ -750,6 +1065,47 @@ class LoRaWANNode {
     */
     int16_t getDownlinkClassC(uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventDown = NULL);
 
+    /*!
+      \brief Search for the Class B beacon and lock on to it, which is required before switching to Class B.
+      If the network time is known from DeviceTimeAns or BeaconTimingAns, only the next beacon is listened for.
+      Otherwise, the radio is kept in receive mode for a complete beacon period, which takes over two minutes.
+      In bands where the beacon hops between channels (US915, AU915), the network time must be known.
+      \returns \ref status_codes
+    */
+    int16_t acquireBeacon();
+
+    /*!
+      \brief Check whether the device is locked on to the Class B beacon.
+      \returns True if the beacon was acquired and has not been lost since.
+    */
+    bool isBeaconLocked();
+
+    /*!
+      \brief Set the Class B ping slot periodicity. This can only be changed while not in Class B,
+      the network is informed of the periodicity when switching to Class B.
+      \param periodicity Ping slots open every 2^periodicity seconds, 0 to 7 (default).
+      \returns \ref status_codes
+    */
+    int16_t setPingSlotPeriodicity(uint8_t periodicity);
+
+    /*!
+      \brief Get the time until the next Class B event, which is either a beacon or a ping slot.
+      \returns Time in milliseconds, 0 if the device is not in Class B.
+    */
+    RadioLibTime_t timeUntilClassB();
+
+    /*!
+      \brief Wait for the next Class B event and handle it. Beacons keep track of the network time and
+      the drift of the local clock, ping slots are listened to for downlinks. While waiting, the sleep callback is used.
+      If no beacon was received for two hours, the device reverts to Class A.
+      \param dataDown Buffer to save received data into.
+      \param lenDown Pointer to variable that will be used to save the number of received bytes.
+      \param eventDown Pointer to a structure to store extra information about the downlink event
+      (fPort, frame counter, etc.). If set to NULL, no extra information will be passed to the user.
+      \returns Window number > 0 if downlink was received, 0 is no downlink was received, otherwise \ref status_codes
+    */
+    int16_t getDownlinkClassB(uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventDown = NULL);
+
     /*!
       \brief Add a MAC command to the uplink queue.
       Only LinkCheck and DeviceTime are available to the user. 
@@ -807,11 +1163,23 @@ class LoRaWANNode {
     */
     void setADR(bool enable = true);
 
+    /*!
+      \brief Toggle the client-side rate predictor. It tracks the SNR of received downlinks
+      and the margins reported in LinkCheckAns, and picks the fastest datarate and lowest power
+      for every uplink that still leaves the requested margin. If ADR is enabled, it never uses
+      a higher datarate or lower power than set by the network, but it can fall back to a lower
+      datarate long before ADR backoff would.
+      \param enable Whether to enable the rate predictor or not.
+      \param margin Margin in dB to keep above the demodulation floor.
+    */
+    void setRatePredictor(bool enable = true, uint8_t margin = RADIOLIB_LORAWAN_PREDICTOR_MARGIN_DEFAULT);
+
     /*!
       \brief Toggle adherence to dutyCycle limits to on or off.
       \param enable Whether to adhere to dutyCycle limits or not (default true).
       \param msPerHour The maximum allowed Time-on-Air per hour in milliseconds 
-      (default 0 = maximum allowed for configured band).
+      (default 0 = maximum allowed for configured band, tracked per regulatory sub-band).
+      A custom value applies to all channels together and replaces the sub-band limits.
     */
     void setDutyCycle(bool enable = true, RadioLibTime_t msPerHour = 0);
 
@@ -928,8 +1296,24 @@ class LoRaWANNode {
     */
     RadioLibTime_t dutyCycleInterval(RadioLibTime_t msPerHour, RadioLibTime_t airtime);
 
-    /*! \brief Returns time in milliseconds until next uplink is available under dutyCycle limits */
-    RadioLibTime_t timeUntilUplink();
+    /*!
+      \brief Returns time in milliseconds until next uplink is available under dutyCycle limits.
+      \param len Application payload length of the uplink. The default of 0 only accounts for an empty uplink,
+      so the real length must be passed to get the time at which the actual frame fits into the budget.
+      \returns Time in milliseconds, or RADIOLIB_LORAWAN_UPLINK_NEVER if the uplink is too long to ever fit.
+    */
+    RadioLibTime_t timeUntilUplink(uint8_t len = 0);
+
+    /*!
+      \brief Get the earliest time at which an uplink is allowed under dutyCycle limits.
+      Airtime is accounted per regulatory sub-band, so this is the time at which
+      the first enabled channel has enough airtime left for the complete uplink.
+      \param len Application payload length of the uplink. The default of 0 only accounts for an empty uplink,
+      so the real length must be passed to get the time at which the actual frame fits into the budget.
+      \returns Timestamp in milliseconds (same clock as the HAL millis()),
+      or RADIOLIB_LORAWAN_UPLINK_NEVER if the uplink is too long to ever fit.
+    */
+    RadioLibTime_t getNextUplinkTime(uint8_t len = 0);
 
     /*! 
       \brief Returns the maximum allowed uplink payload size given the current MAC state.
@@ -955,6 +1339,27 @@ class LoRaWANNode {
     */
     void setSleepFunction(SleepCb_t cb); 
 
+    /*! \brief Callback to a user-provided random number generator. */
+    typedef uint32_t (*RandomCb_t)(uint32_t max, void* ctx);
+
+    /*! 
+      \brief Set custom random number generator callback. If set, LoRaWAN node will call
+      this function whenever it needs a random number (channel selection, backoff, retransmission timeout).
+      Otherwise, the C library rand() will be used, seeded by the radio TRNG on activation.
+      This can be used to make the channel scheduler reproducible, e.g. in simulation.
+      \param cb Callback that returns a random number in range 0 - max (non-inclusive).
+      \param ctx User context passed to the callback, e.g. to keep a separate generator per node.
+    */
+    void setRandomFunction(RandomCb_t cb, void* ctx = NULL);
+
+    /*!
+      \brief Get a pseudo-random number from the generator set by setRandomFunction, or rand() if there is none.
+      Application packages use this, so that they draw from the same generator as the node.
+      \param max Upper limit (non-inclusive).
+      \returns Random number in range 0 - max (non-inclusive), 0 if max is 0.
+    */
+    uint32_t randomNumber(uint32_t max);
+
     /*!
       \brief Enable a reserved FPort that can be used for application traffic.
       \param fPort FPort number in reserved range (>= RADIOLIB_LORAWAN_FPORT_RESERVED).
@@ -1024,6 +1429,9 @@ class LoRaWANNode {
     uint8_t nwkSEncKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
     uint8_t jSIntKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
 
+    // key slots of the AES engine that the keys are kept in
+    uint8_t keyIds[RADIOLIB_LORAWAN_NUM_KEYS];
+
     uint16_t keyCheckSum = 0;
     
     // device-specific parameters, persistent through sessions
@@ -1047,10 +1455,35 @@ class LoRaWANNode {
     // ADR is enabled by default
     bool adrEnabled = true;
 
+    // datarate and power as last set by the network or the user, the rate predictor stays below these
+    uint8_t netDr = 0;
+    uint8_t netTxSteps = 0;
+
+    // client-side rate predictor, the samples are estimated uplink SNR at maximum power (dB)
+    bool predictorEnabled = false;
+    uint8_t predictorMargin = RADIOLIB_LORAWAN_PREDICTOR_MARGIN_DEFAULT;
+    int8_t predictorSnr[RADIOLIB_LORAWAN_PREDICTOR_HISTORY] = { 0 };
+    uint8_t predictorNum = 0;
+    uint8_t predictorIdx = 0;
+    uint8_t predictorAge = 0;
+    bool predicted = false;
+    int8_t predictedMargin = RADIOLIB_LORAWAN_MARGIN_UNKNOWN;
+
     // duty cycle is set upon initialization and activated in regions that impose this
     bool dutyCycleEnabled = false;
     uint32_t dutyCycle = 0;
 
+    // whether airtime is tracked per sub-band, disabled when the user sets a custom duty cycle
+    bool dcSubBands = true;
+
+    // airtime token bucket per duty cycle sub-band, the last one is the band-wide bucket
+    // tokens are in microseconds of airtime, an uplink is only allowed if it fits into the bucket
+    int32_t dcTokens[RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS + 1];
+    RadioLibTime_t dcTime[RADIOLIB_LORAWAN_MAX_NUM_DC_BANDS + 1];
+
+    // airtime of the uplink being prepared, used to prefer channels which can carry it
+    RadioLibTime_t dcToA = 0;
+
     // dwell time is set upon initialization and activated in regions that impose this
     uint16_t dwellTimeUp = 0;
     uint16_t dwellTimeDn = 0;
@@ -1107,6 +1540,15 @@ class LoRaWANNode {
     // Time on Air of last uplink
     RadioLibTime_t lastToA = 0;
 
+    // cached Time-on-Air values, only valid for the band they were calculated for
+    LoRaWANTimeOnAir_t toaCache[RADIOLIB_LORAWAN_TOA_CACHE_SIZE];
+    const LoRaWANBand_t* toaCacheBand = nullptr;
+
+    // maximum PHY payload length per datarate given the current dwell time,
+    // only valid for the datarates set in maxLenDwellValid (the length may be 0 if no frame fits)
+    uint8_t maxLenDwell[RADIOLIB_LORAWAN_CHANNEL_NUM_DATARATES] = { 0 };
+    uint16_t maxLenDwellValid = 0;
+
     // timestamp to measure the Rx1/2 delay (from uplink end)
     RadioLibTime_t tUplinkEnd = 0;
 
@@ -1125,6 +1567,66 @@ class LoRaWANNode {
     // user-provided sleep callback
     SleepCb_t sleepCb = nullptr;
 
+    // user-provided random number generator callback
+    RandomCb_t randomCb = nullptr;
+    void* randomCtx = nullptr;
+
+    // state of the non-blocking uplink/downlink sequence
+    uint8_t asyncState = RADIOLIB_LORAWAN_ASYNC_IDLE;
+    #if RADIOLIB_STATIC_ONLY
+    uint8_t asyncMsg[RADIOLIB_AES128_BLOCK_SIZE + RADIOLIB_STATIC_ARRAY_SIZE];
+    #else
+    uint8_t* asyncMsg = nullptr;
+    #endif
+    size_t asyncMsgLen = 0;
+    uint8_t asyncFPort = 0;
+    bool asyncConfirmed = false;
+    uint8_t asyncTrans = 0;
+    uint8_t* asyncDataDown = nullptr;
+    size_t* asyncLenDown = nullptr;
+    LoRaWANEvent_t* asyncEventUp = nullptr;
+    LoRaWANEvent_t* asyncEventDown = nullptr;
+    RadioLibTime_t asyncToA = 0;          // Time-on-Air of the staged uplink
+    RadioLibTime_t asyncDeadline = 0;     // time at which the next step is due
+    RadioLibTime_t asyncWindowOpen = 0;   // time at which the current Rx window was opened
+    RadioLibTime_t asyncWindowLen = 0;    // length of the staged Rx window
+    bool asyncReceiving = false;          // Rx window was extended because something is being received
+    bool asyncRadioAsleep = false;        // radio was put to sleep while waiting for the deadline
+    volatile bool asyncAction = false;    // Tx done / Rx done interrupt was raised
+    volatile RadioLibTime_t asyncActionTime = 0;  // time at which the interrupt was raised
+    int8_t asyncSlot = -1;                // interrupt slot claimed by the running sequence
+
+    // user-provided callback for the end of a non-blocking sequence
+    SendReceiveCb_t sendReceiveCb = nullptr;
+
+    // application records waiting to be packed into frames, the data is kept back to back in queue order
+    LoRaWANQueuedUplink_t upQueue[RADIOLIB_LORAWAN_UPLINK_QUEUE_LEN];
+    uint8_t upQueueData[RADIOLIB_LORAWAN_UPLINK_QUEUE_SIZE];
+    uint8_t upQueueNum = 0;
+    size_t upQueueUsed = 0;
+    uint8_t upQueueId = 0;
+    QueuedUplinkCb_t upQueueCb = nullptr;
+
+    // Class B time reference: at local time tTimeRef, the GPS time was timeRef seconds
+    // it is set by DeviceTimeAns or BeaconTimingAns, and by every received beacon
+    bool timeRefValid = false;
+    uint32_t timeRef = 0;
+    RadioLibTime_t tTimeRef = 0;
+    RadioLibTime_t timeRefError = 0;      // uncertainty of the time reference in ms
+
+    // Class B beacon tracking
+    bool beaconLocked = false;
+    RadioLibTime_t tBeacon = 0;           // local time at which the last beacon started
+    int32_t clockDrift = 0;               // measured drift of the local clock in ppm, positive if it runs fast
+    uint32_t beaconFreq = 0;              // set by BeaconFreqReq (coded in 100 Hz steps), 0 for band default
+
+    // Class B ping slots
+    uint8_t pingPeriodicity = RADIOLIB_LORAWAN_PING_PERIODICITY_DEFAULT;
+    uint32_t pingFreq = 0;                // set by PingSlotChannelReq (coded in 100 Hz steps), 0 for band default
+    uint8_t pingDr = RADIOLIB_LORAWAN_DATA_RATE_UNUSED;
+    uint32_t pingOffsetTime = RADIOLIB_LORAWAN_FCNT_NONE;  // beacon time for which pingOffset is valid
+    uint16_t pingOffset = 0;
+
     // this will reset the device credentials, so the device starts completely new
     void clearNonces();
 
@@ -1142,31 +1644,118 @@ class LoRaWANNode {
 
     // check whether payload length and fport are allowed
     int16_t isValidUplink(size_t len, uint8_t fPort);
+
+    // get the buffer of one of the keys
+    uint8_t* getKey(uint8_t key);
+
+    // store all keys that have a key slot in the AES engine
+    void bindKeys();
+
+    // add a link quality sample to the rate predictor
+    void predictorSample(int8_t snr);
+
+    // check whether the rate predictor may use a datarate for an uplink of this length
+    bool predictorDrValid(uint8_t dr, size_t lenUp);
+
+    // pick datarate and power for the next uplink from the link quality samples
+    void predictRate(size_t lenUp);
+
+    // drop any prediction and go back to the datarate and power set by the network or the user
+    void restoreNetRate();
+
+    // get the SNR (in 0.1 dB) required to demodulate a LoRa datarate, or INT16_MIN if not LoRa
+    int16_t getRequiredSnr(uint8_t dr);
+
+    // find the queued record the next frame is built around, -1 if no frame is due
+    int8_t queuedUplinkLead(RadioLibTime_t tNow, bool force);
     
     // perform ADR backoff
     void adrBackoff();
 
+    // check whether an uplink can be sent right now and reset the MAC downlink buffer
+    int16_t prepareUplink(size_t lenUp, uint8_t fPort);
+
+    // build the encrypted uplink message from user data and/or pending MAC commands
+    void buildUplink(const uint8_t* dataUp, size_t lenUp, uint8_t fPort, bool isConfirmed, uint8_t* uplinkMsg);
+
+    // select channels and set the MIC, repeating if CSMA finds the channel busy
+    void selectUplinkChannel(uint8_t* uplinkMsg, size_t uplinkMsgLen);
+
+    // common handling of the result of an uplink/downlink sequence (events, ADR backoff, downlink parsing)
+    int16_t finishSendReceive(int16_t state, uint8_t trans, uint8_t fPort, bool isConfirmed, uint8_t* dataDown, size_t* lenDown, LoRaWANEvent_t* eventUp, LoRaWANEvent_t* eventDown);
+
     // create an encrypted uplink buffer, composing metadata, user data and MAC data
     void composeUplink(const uint8_t* in, uint8_t lenIn, uint8_t* out, uint8_t fPort, bool isConfirmed);
 
     // generate and set the MIC of an uplink buffer (depends on selected channels)
     void micUplink(uint8_t* inOut, size_t lenInOut);
 
+    // configure the radio for uplink on a specified channel and stage the transmission
+    int16_t stageUplink(const LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len, RadioLibTime_t* toa);
+
     // transmit uplink buffer on a specified channel
     int16_t transmitUplink(const LoRaWANChannel_t* chnl, uint8_t* in, uint8_t len);
 
+    // configure the radio for a Class A downlink channel and stage the reception
+    int16_t stageReceive(uint8_t dir, const LoRaWANChannel_t* dlChannel, RadioLibTime_t* timeoutUs);
+
     // handle one of the Class A receive windows with a given channel and certain timestamps
     int16_t receiveClassA(uint8_t dir, const LoRaWANChannel_t* dlChannel, uint8_t window, const RadioLibTime_t dlDelay, RadioLibTime_t tReference);
 
     // handle a Class C receive window with timeout (between Class A windows) or without (between uplinks)
     int16_t receiveClassC(RadioLibTime_t timeout = 0);
 
+    // Class B: convert between local time and GPS time in milliseconds, correcting the clock drift
+    uint64_t localToGps(RadioLibTime_t t);
+    RadioLibTime_t gpsToLocal(uint64_t gpsMs);
+
+    // Class B: half the width of a receive window at local time t, including the possible clock drift
+    RadioLibTime_t getClassBWidening(RadioLibTime_t t);
+
+    // Class B: channels of the beacon and ping slots in the beacon period starting at beaconTime
+    void getBeaconChannel(uint32_t beaconTime, LoRaWANChannel_t* chnl);
+    void getPingChannel(uint32_t beaconTime, LoRaWANChannel_t* chnl);
+
+    // Class B: pseudo-random offset of the ping slots in the beacon period starting at beaconTime
+    uint16_t getPingOffset(uint32_t beaconTime);
+
+    // Class B: find the next beacon or ping slot after local time tNow
+    void nextClassBEvent(RadioLibTime_t tNow, RadioLibTime_t* tEvent, uint32_t* beaconTime, bool* isBeacon);
+
+    // Class B: listen for a beacon in a window, and lock on to it if it is received
+    int16_t receiveBeacon(const LoRaWANChannel_t* chnl, RadioLibTime_t tWindow, RadioLibTime_t windowLen);
+
+    // Class B: check the beacon CRC and extract its GPS time
+    int16_t parseBeacon(const uint8_t* payload, size_t len, uint32_t* beaconTime);
+
     // open a series of Class A (and C) downlinks
     virtual int16_t receiveDownlink();
 
+    // non-blocking sequence helpers: stage an Rx window, move on after a window, close a window
+    int16_t stageWindow(uint8_t window, RadioLibTime_t tNow);
+    int16_t nextWindow(uint8_t window, RadioLibTime_t tNow);
+    void closeWindow(uint8_t window);
+
+    // non-blocking sequence helpers: put the radio to sleep while waiting, wake it up before the deadline
+    void sleepPending(RadioLibTime_t tNow);
+    bool waitPending(RadioLibTime_t tNow);
+
+    // finish the non-blocking sequence and notify the user
+    int16_t endSequence(int16_t state, bool transmitted);
+
+    // interrupt service routines of the non-blocking sequence, timestamp Tx done / Rx done of the node in the slot
+    static void onAsyncAction(uint8_t slot);
+    template<uint8_t N>
+    static void onAsyncSlot(void) { LoRaWANNode::onAsyncAction(N); }
+    static void (* const asyncSlotActions[RADIOLIB_LORAWAN_ASYNC_NUM_NODES])(void);
+
     // extract downlink payload and process MAC commands
     int16_t parseDownlink(uint8_t* data, size_t* len, uint8_t window, LoRaWANEvent_t* event = NULL);
 
+    // check the address and frame counter in a downlink header (MHDR and FHDR without FOpts)
+    // this is cheap enough to do before the complete frame is read, verified and decrypted
+    int16_t checkDownlinkHeader(const uint8_t* fhdr, uint8_t window, bool* multicast, uint8_t* mcGroupId);
+
     // execute mac command, return the number of processed bytes for sequential processing
     bool execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn);
     bool execMacCommand(uint8_t cid, uint8_t* optIn, uint8_t lenIn, uint8_t* optOut);
@@ -1191,6 +1780,11 @@ class LoRaWANNode {
     // include payload in case the MAC command has a dynamic length
     virtual int16_t getMacLen(uint8_t cid, uint8_t* len, uint8_t dir, bool inclusive = false, uint8_t* payload = NULL);
 
+    // tokenize a MAC buffer: get the CID and length (including CID) of the command at a given position
+    // returns RADIOLIB_ERR_COMMAND_QUEUE_ITEM_NOT_FOUND at the end of the buffer,
+    // RADIOLIB_ERR_INVALID_CID for an unknown CID and RADIOLIB_ERR_INVALID_PAYLOAD for a truncated command
+    int16_t nextMacCommand(const uint8_t* in, uint8_t lenIn, uint8_t pos, uint8_t dir, uint8_t* cid, uint8_t* fLen);
+
     // find out of a MAC command should persist destruction
     // in uplink direction, some commands must persist if no downlink is received
     // in downlink direction, the user-accessible MAC commands remain available for retrieval
@@ -1211,12 +1805,9 @@ class LoRaWANNode {
     // configure the common physical layer properties (frequency, sync word etc.)
     int16_t setPhyProperties(const LoRaWANChannel_t* chnl, uint8_t dir, int8_t pwr, size_t pre = 0);
 
-    // Performs CSMA as per LoRa Alliance Technical Recommendation 13 (TR-013).
+    // Performs CSMA as per LoRa Alliance Technical Recommendation 13 (TR-013) on the selected uplink channel.
     bool csmaChannelClear(uint8_t difs, uint8_t numBackoff);
 
-    // perform a single CAD operation for the under SF/CH combination. Returns either busy or otherwise.
-    bool cadChannelClear();
-
     // enable all default channels on top of the current channels
     void enableDefaultChannels(bool addDynamic = false);
 
@@ -1227,6 +1818,31 @@ class LoRaWANNode {
     // select a set of random TX/RX channels for up- and downlink
     int16_t selectChannels();
 
+    // get the duty cycle buckets charged for a frequency (100 Hz steps), returns the number of buckets
+    uint8_t dutyCycleBuckets(uint32_t freq, uint8_t* buckets);
+
+    // get the hourly airtime budget of a duty cycle bucket, 0 if unlimited
+    RadioLibTime_t dutyCycleBudget(uint8_t bucket);
+
+    // get the airtime a duty cycle bucket may save up for a burst (in milliseconds)
+    RadioLibTime_t dutyCycleCapacity(RadioLibTime_t budget);
+
+    // get the airtime available in a duty cycle bucket at a given time (in microseconds)
+    int32_t dutyCycleTokens(uint8_t bucket, RadioLibTime_t t);
+
+    // get the time at which a channel on this frequency may transmit an uplink with the given airtime,
+    // RADIOLIB_LORAWAN_UPLINK_NEVER if it is longer than the bucket can hold
+    RadioLibTime_t dutyCycleReadyTime(uint32_t freq, RadioLibTime_t toa);
+
+    // get the earliest time at which any enabled channel may transmit an uplink with the given airtime
+    RadioLibTime_t dutyCycleNextTime(RadioLibTime_t toa);
+
+    // charge the airtime of an uplink to the buckets of its frequency
+    void dutyCycleCharge(uint32_t freq, RadioLibTime_t toa);
+
+    // get the dynamic channels which may transmit an uplink with the given airtime right now
+    uint16_t dutyCycleReadyChannels(RadioLibTime_t toa);
+
     // get the properties of the first active multicast session, if any
     uint32_t getMulticastFrequency();
     uint8_t getMulticastDatarate();
@@ -1248,6 +1864,12 @@ class LoRaWANNode {
     // function that allows sleeping via user-provided callback
     void sleepDelay(RadioLibTime_t ms, bool radioOff = true);
 
+    // get Time-on-Air (in us) of a PHY payload at a given datarate, using the cache when possible
+    RadioLibTime_t getTimeOnAir(uint8_t dr, uint16_t len);
+
+    // invalidate all cached Time-on-Air values and payload limits
+    void clearTimeOnAirCache();
+
     // 16-bit checksum method that takes a uint8_t array of even length and calculates the checksum
     static uint16_t checkSum16(const uint8_t *key, uint16_t keyLen);
 
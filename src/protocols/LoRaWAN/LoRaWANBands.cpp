@@ -82,6 +82,15 @@ const LoRaWANBand_t EU868 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
+  },
+  .beacon = { .numChannels = 1, .freqStart = 8695250, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = {
+    { .freqStart = 8630000, .freqEnd = 8650000, .msPerHour = 3600 },
+    { .freqStart = 8650000, .freqEnd = 8680000, .msPerHour = 36000 },
+    { .freqStart = 8680000, .freqEnd = 8686000, .msPerHour = 36000 },
+    { .freqStart = 8687000, .freqEnd = 8692000, .msPerHour = 3600 },
+    { .freqStart = 8694000, .freqEnd = 8696500, .msPerHour = 360000 },
+    { .freqStart = 8697000, .freqEnd = 8700000, .msPerHour = 36000 }
   }
 };
 
@@ -171,7 +180,9 @@ const LoRaWANBand_t US915 = {
     { .modem = RADIOLIB_MODEM_LORA,   .dr = {.lora = { 8, 500, 5}}, .pc = {.lora = {8, false, true, false}}},
     { .modem = RADIOLIB_MODEM_LORA,   .dr = {.lora = { 7, 500, 5}}, .pc = {.lora = {8, false, true, false}}},
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 8, .freqStart = 9233000, .freqStep = 6000, .dr = 8, .rfuLen = 5, .len = 23 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t EU433 = {
@@ -239,7 +250,9 @@ const LoRaWANBand_t EU433 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 4346650, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t AU915 = {
@@ -328,7 +341,9 @@ const LoRaWANBand_t AU915 = {
     { .modem = RADIOLIB_MODEM_LORA,   .dr = {.lora = { 8, 500, 5}}, .pc = {.lora = {8, false, true, false}}},
     { .modem = RADIOLIB_MODEM_LORA,   .dr = {.lora = { 7, 500, 5}}, .pc = {.lora = {8, false, true, false}}},
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 8, .freqStart = 9233000, .freqStep = 6000, .dr = 8, .rfuLen = 5, .len = 23 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t CN470 = {
@@ -410,7 +425,9 @@ const LoRaWANBand_t CN470 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = RADIOLIB_LORAWAN_BEACON_NONE,
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t AS923 = {
@@ -478,7 +495,9 @@ const LoRaWANBand_t AS923 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 9234000, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t AS923_2 = {
@@ -546,7 +565,9 @@ const LoRaWANBand_t AS923_2 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 9216000, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t AS923_3 = {
@@ -614,7 +635,9 @@ const LoRaWANBand_t AS923_3 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 9168000, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t AS923_4 = {
@@ -682,7 +705,9 @@ const LoRaWANBand_t AS923_4 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 9175000, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t KR920 = {
@@ -750,7 +775,9 @@ const LoRaWANBand_t KR920 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = { .numChannels = 1, .freqStart = 9231000, .freqStep = 0, .dr = 3, .rfuLen = 2, .len = 17 },
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 const LoRaWANBand_t IN865 = {
@@ -818,7 +845,9 @@ const LoRaWANBand_t IN865 = {
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE,
     RADIOLIB_DATARATE_NONE
-  }
+  },
+  .beacon = RADIOLIB_LORAWAN_BEACON_NONE,
+  .dcBands = { RADIOLIB_LORAWAN_DC_BAND_NONE }
 };
 
 #endif
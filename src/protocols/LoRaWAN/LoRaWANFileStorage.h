@@ -0,0 +1,90 @@
+#ifndef LORAWAN_FILE_STORAGE_H
+#define LORAWAN_FILE_STORAGE_H
+
+// include RadioLib
+#include <RadioLib.h>
+
+// POSIX file I/O
+#include <stdio.h>
+#include <unistd.h>
+
+// maximum length of the journal file path
+#define LORAWAN_FILE_STORAGE_PATH_MAX     (256)
+
+// LoRaWAN journal storage backed by a file on a POSIX file system (e.g. Linux)
+// this is not included by RadioLib.h, include it explicitly when needed
+// the storage must inherit from the base LoRaWANStorage class
+// and implement all of its virtual methods
+class LoRaWANFileStorage : public LoRaWANStorage {
+  public:
+    // the file will be created on first write if it does not exist
+    explicit LoRaWANFileStorage(const char* path) {
+      snprintf(_path, sizeof(_path), "%s", path);
+      snprintf(_tmpPath, sizeof(_tmpPath), "%s.tmp", path);
+    }
+
+    size_t size() override {
+      FILE* f = fopen(_path, "rb");
+      if(!f) {
+        return(0);
+      }
+      long len = -1;
+      if(fseek(f, 0, SEEK_END) == 0) {
+        len = ftell(f);
+      }
+      fclose(f);
+      return(len < 0 ? 0 : (size_t)len);
+    }
+
+    size_t read(size_t offset, uint8_t* data, size_t len) override {
+      FILE* f = fopen(_path, "rb");
+      if(!f) {
+        return(0);
+      }
+      size_t num = 0;
+      if(fseek(f, (long)offset, SEEK_SET) == 0) {
+        num = fread(data, 1, len, f);
+      }
+      fclose(f);
+      return(num);
+    }
+
+    int16_t append(const uint8_t* data, size_t len) override {
+      FILE* f = fopen(_path, "ab");
+      if(!f) {
+        return(RADIOLIB_ERR_UNKNOWN);
+      }
+      return(finish(f, fwrite(data, 1, len, f) == len));
+    }
+
+    int16_t replace(const uint8_t* data, size_t len) override {
+      // write into a temporary file first and rename it,
+      // so that either the old or the new journal survives a crash
+      FILE* f = fopen(_tmpPath, "wb");
+      if(!f) {
+        return(RADIOLIB_ERR_UNKNOWN);
+      }
+      int16_t state = finish(f, fwrite(data, 1, len, f) == len);
+      if(state != RADIOLIB_ERR_NONE) {
+        remove(_tmpPath);
+        return(state);
+      }
+      if(rename(_tmpPath, _path) != 0) {
+        return(RADIOLIB_ERR_UNKNOWN);
+      }
+      return(RADIOLIB_ERR_NONE);
+    }
+
+  private:
+    char _path[LORAWAN_FILE_STORAGE_PATH_MAX];
+    char _tmpPath[LORAWAN_FILE_STORAGE_PATH_MAX + 4];
+
+    // flush the data all the way to the disk and close the file
+    int16_t finish(FILE* f, bool ok) {
+      ok = ok && (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+      ok = (fclose(f) == 0) && ok;
+      return(ok ? RADIOLIB_ERR_NONE : RADIOLIB_ERR_UNKNOWN);
+    }
+};
+
+#endif
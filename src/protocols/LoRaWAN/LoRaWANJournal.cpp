@@ -0,0 +1,243 @@
+#include "LoRaWANJournal.h"
+#include "../../utils/CRC.h"
+#include <string.h>
+
+#if !RADIOLIB_EXCLUDE_LORAWAN
+
+LoRaWANJournal::LoRaWANJournal(LoRaWANNode* node, LoRaWANStorage* storage, size_t maxSize) {
+  this->node = node;
+  this->storage = storage;
+
+  // there must be room for at least one snapshot and some deltas
+  this->maxSize = maxSize;
+  if(this->maxSize < 2*RADIOLIB_LORAWAN_JOURNAL_SNAPSHOT_LEN) {
+    this->maxSize = 2*RADIOLIB_LORAWAN_JOURNAL_SNAPSHOT_LEN;
+  }
+}
+
+int16_t LoRaWANJournal::restore() {
+  memset(this->imageNonces, 0, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+  memset(this->imageSession, 0, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  this->synced = false;
+
+  // first find the end of the last complete save, so that a save interrupted
+  // halfway through is not applied partially
+  uint8_t rec[RADIOLIB_LORAWAN_JOURNAL_OVERHEAD + RADIOLIB_LORAWAN_SESSION_BUF_SIZE];
+  size_t total = this->storage->size();
+  size_t committed = 0;
+  size_t pos = 0;
+  size_t recLen = 0;
+  while((recLen = this->readRecord(pos, total, rec)) > 0) {
+    pos += recLen;
+    if(rec[1] & RADIOLIB_LORAWAN_JOURNAL_COMMIT) {
+      committed = pos;
+    }
+  }
+
+  // now replay the committed records
+  bool foundNonces = false;
+  bool foundSession = false;
+  pos = 0;
+  while(pos < committed) {
+    recLen = this->readRecord(pos, total, rec);
+    uint8_t id = rec[1] & ~RADIOLIB_LORAWAN_JOURNAL_COMMIT;
+    uint16_t offset = (uint16_t)rec[2] | ((uint16_t)rec[3] << 8);
+    uint16_t len = (uint16_t)rec[4] | ((uint16_t)rec[5] << 8);
+    if(id == RADIOLIB_LORAWAN_JOURNAL_BUFFER_NONCES) {
+      memcpy(&this->imageNonces[offset], &rec[RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN], len);
+      foundNonces = true;
+    } else {
+      memcpy(&this->imageSession[offset], &rec[RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN], len);
+      foundSession = true;
+    }
+    pos += recLen;
+  }
+
+  // anything after the last complete save would hide future appends,
+  // so drop it by rewriting the journal with what was recovered
+  int16_t state = RADIOLIB_ERR_NONE;
+  if(committed != total) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Journal has invalid tail at %lu/%lu, compacting", (unsigned long)committed, (unsigned long)total);
+    state = this->writeSnapshot(foundNonces, foundSession);
+    RADIOLIB_ASSERT(state);
+  }
+  this->synced = true;
+
+  // the session can only be restored on top of the nonces
+  if(foundNonces) {
+    state = this->node->setBufferNonces(this->imageNonces);
+    RADIOLIB_ASSERT(state);
+  }
+  if(foundSession) {
+    state = this->node->setBufferSession(this->imageSession);
+  }
+
+  return(state);
+}
+
+int16_t LoRaWANJournal::save() {
+  // if the journal contents are unknown or it grew too large, start over
+  if(!this->synced || (this->storage->size() >= this->maxSize)) {
+    return(this->compact());
+  }
+
+  // the getters update the buffers, so call each of them only once
+  const uint8_t* nonces = this->node->getBufferNonces();
+  const uint8_t* session = this->node->getBufferSession();
+
+  // collect all changes into a single append
+  uint8_t out[RADIOLIB_LORAWAN_JOURNAL_SNAPSHOT_LEN];
+  size_t outLen = 0;
+  size_t lastRec = 0;
+  if(!LoRaWANJournal::diffBuffer(out, &outLen, &lastRec, sizeof(out), RADIOLIB_LORAWAN_JOURNAL_BUFFER_NONCES, this->imageNonces, nonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE) ||
+     !LoRaWANJournal::diffBuffer(out, &outLen, &lastRec, sizeof(out), RADIOLIB_LORAWAN_JOURNAL_BUFFER_SESSION, this->imageSession, session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE)) {
+    // so much has changed that a snapshot is smaller
+    return(this->compact());
+  }
+
+  // nothing to do
+  if(outLen == 0) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  LoRaWANJournal::commitRecord(&out[lastRec]);
+  int16_t state = this->storage->append(out, outLen);
+  if(state != RADIOLIB_ERR_NONE) {
+    // a partial save may have been written, so the journal must be compacted
+    this->synced = false;
+    return(state);
+  }
+
+  memcpy(this->imageNonces, nonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+  memcpy(this->imageSession, session, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  return(state);
+}
+
+int16_t LoRaWANJournal::compact() {
+  memcpy(this->imageNonces, this->node->getBufferNonces(), RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+  memcpy(this->imageSession, this->node->getBufferSession(), RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  return(this->writeSnapshot(true, true));
+}
+
+size_t LoRaWANJournal::writeRecord(uint8_t* out, uint8_t id, uint16_t offset, const uint8_t* data, uint16_t len) {
+  out[0] = RADIOLIB_LORAWAN_JOURNAL_MAGIC;
+  out[1] = id;
+  out[2] = (uint8_t)(offset & 0xFF);
+  out[3] = (uint8_t)(offset >> 8);
+  out[4] = (uint8_t)(len & 0xFF);
+  out[5] = (uint8_t)(len >> 8);
+  memcpy(&out[RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN], data, len);
+  size_t pos = RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN + len;
+  uint16_t crc = LoRaWANJournal::recordCrc(out, pos);
+  out[pos++] = (uint8_t)(crc & 0xFF);
+  out[pos++] = (uint8_t)(crc >> 8);
+  return(pos);
+}
+
+void LoRaWANJournal::commitRecord(uint8_t* rec) {
+  rec[1] |= RADIOLIB_LORAWAN_JOURNAL_COMMIT;
+  size_t pos = RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN + ((uint16_t)rec[4] | ((uint16_t)rec[5] << 8));
+  uint16_t crc = LoRaWANJournal::recordCrc(rec, pos);
+  rec[pos] = (uint8_t)(crc & 0xFF);
+  rec[pos + 1] = (uint8_t)(crc >> 8);
+}
+
+uint16_t LoRaWANJournal::recordCrc(const uint8_t* rec, size_t len) {
+  RadioLibCRCInstance.size = 16;
+  RadioLibCRCInstance.poly = RADIOLIB_CRC_CCITT_POLY;
+  RadioLibCRCInstance.init = RADIOLIB_CRC_CCITT_INIT;
+  RadioLibCRCInstance.out = RADIOLIB_CRC_CCITT_OUT;
+  RadioLibCRCInstance.refIn = false;
+  RadioLibCRCInstance.refOut = false;
+  return((uint16_t)RadioLibCRCInstance.checksum(rec, len));
+}
+
+size_t LoRaWANJournal::readRecord(size_t pos, size_t total, uint8_t* rec) {
+  if(pos + RADIOLIB_LORAWAN_JOURNAL_OVERHEAD > total) {
+    return(0);
+  }
+  if(this->storage->read(pos, rec, RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN) != RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN) {
+    return(0);
+  }
+
+  // check the header
+  uint8_t id = rec[1] & ~RADIOLIB_LORAWAN_JOURNAL_COMMIT;
+  uint16_t offset = (uint16_t)rec[2] | ((uint16_t)rec[3] << 8);
+  uint16_t len = (uint16_t)rec[4] | ((uint16_t)rec[5] << 8);
+  size_t bufLen = 0;
+  if(id == RADIOLIB_LORAWAN_JOURNAL_BUFFER_NONCES) {
+    bufLen = RADIOLIB_LORAWAN_NONCES_BUF_SIZE;
+  } else if(id == RADIOLIB_LORAWAN_JOURNAL_BUFFER_SESSION) {
+    bufLen = RADIOLIB_LORAWAN_SESSION_BUF_SIZE;
+  }
+  if((rec[0] != RADIOLIB_LORAWAN_JOURNAL_MAGIC) || (len == 0) || ((size_t)offset + len > bufLen)) {
+    return(0);
+  }
+
+  // read the rest of the record and check its CRC
+  size_t recLen = RADIOLIB_LORAWAN_JOURNAL_OVERHEAD + len;
+  size_t rem = recLen - RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN;
+  if(pos + recLen > total) {
+    return(0);
+  }
+  if(this->storage->read(pos + RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN, &rec[RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN], rem) != rem) {
+    return(0);
+  }
+  uint16_t crc = (uint16_t)rec[recLen - 2] | ((uint16_t)rec[recLen - 1] << 8);
+  if(crc != LoRaWANJournal::recordCrc(rec, recLen - RADIOLIB_LORAWAN_JOURNAL_CRC_LEN)) {
+    return(0);
+  }
+
+  return(recLen);
+}
+
+bool LoRaWANJournal::diffBuffer(uint8_t* out, size_t* outLen, size_t* lastRec, size_t maxLen, uint8_t id, const uint8_t* image, const uint8_t* buff, size_t len) {
+  size_t i = 0;
+  while(i < len) {
+    // skip unchanged bytes
+    if(image[i] == buff[i]) {
+      i++;
+      continue;
+    }
+
+    // extend the run while the next change is closer than the overhead of a new record
+    size_t end = i + 1;
+    for(size_t j = end; (j < len) && (j < end + RADIOLIB_LORAWAN_JOURNAL_OVERHEAD); j++) {
+      if(image[j] != buff[j]) {
+        end = j + 1;
+      }
+    }
+
+    if(*outLen + RADIOLIB_LORAWAN_JOURNAL_OVERHEAD + (end - i) > maxLen) {
+      return(false);
+    }
+    *lastRec = *outLen;
+    *outLen += LoRaWANJournal::writeRecord(&out[*outLen], id, (uint16_t)i, &buff[i], (uint16_t)(end - i));
+    i = end;
+  }
+
+  return(true);
+}
+
+int16_t LoRaWANJournal::writeSnapshot(bool nonces, bool session) {
+  uint8_t snapshot[RADIOLIB_LORAWAN_JOURNAL_SNAPSHOT_LEN];
+  size_t snapLen = 0;
+  size_t lastRec = 0;
+  if(nonces) {
+    snapLen += LoRaWANJournal::writeRecord(&snapshot[snapLen], RADIOLIB_LORAWAN_JOURNAL_BUFFER_NONCES, 0, this->imageNonces, RADIOLIB_LORAWAN_NONCES_BUF_SIZE);
+  }
+  if(session) {
+    lastRec = snapLen;
+    snapLen += LoRaWANJournal::writeRecord(&snapshot[snapLen], RADIOLIB_LORAWAN_JOURNAL_BUFFER_SESSION, 0, this->imageSession, RADIOLIB_LORAWAN_SESSION_BUF_SIZE);
+  }
+  if(snapLen > 0) {
+    LoRaWANJournal::commitRecord(&snapshot[lastRec]);
+  }
+
+  // if this fails, the storage is in an unknown state - compact again on next save
+  int16_t state = this->storage->replace(snapshot, snapLen);
+  this->synced = (state == RADIOLIB_ERR_NONE);
+  return(state);
+}
+
+#endif
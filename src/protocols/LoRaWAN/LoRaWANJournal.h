@@ -0,0 +1,148 @@
+#if !defined(_RADIOLIB_LORAWAN_JOURNAL_H) && !RADIOLIB_EXCLUDE_LORAWAN
+#define _RADIOLIB_LORAWAN_JOURNAL_H
+
+#include "LoRaWAN.h"
+
+// journal record layout: magic, buffer ID, offset (LSB first), length (LSB first), data, CRC16 (LSB first)
+#define RADIOLIB_LORAWAN_JOURNAL_MAGIC                          (0xA5)
+#define RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN                     (6)
+#define RADIOLIB_LORAWAN_JOURNAL_CRC_LEN                        (2)
+#define RADIOLIB_LORAWAN_JOURNAL_OVERHEAD                       (RADIOLIB_LORAWAN_JOURNAL_HEADER_LEN + RADIOLIB_LORAWAN_JOURNAL_CRC_LEN)
+
+// buffer IDs, the commit flag marks the last record written by a single save
+#define RADIOLIB_LORAWAN_JOURNAL_BUFFER_NONCES                  (0x00)
+#define RADIOLIB_LORAWAN_JOURNAL_BUFFER_SESSION                 (0x01)
+#define RADIOLIB_LORAWAN_JOURNAL_COMMIT                         (0x80)
+
+// size of a snapshot (one full record of each buffer)
+#define RADIOLIB_LORAWAN_JOURNAL_SNAPSHOT_LEN                   (2*RADIOLIB_LORAWAN_JOURNAL_OVERHEAD + RADIOLIB_LORAWAN_NONCES_BUF_SIZE + RADIOLIB_LORAWAN_SESSION_BUF_SIZE)
+
+// default journal size above which it is compacted into a snapshot
+#define RADIOLIB_LORAWAN_JOURNAL_MAX_SIZE                       (4096)
+
+/*!
+  \class LoRaWANStorage
+  \brief Interface to non-volatile storage used by LoRaWANJournal.
+  Implement this class to keep the journal in flash, EEPROM, a file etc.
+  An implementation for POSIX file systems is provided in LoRaWANFileStorage.h.
+*/
+class LoRaWANStorage {
+  public:
+    /*!
+      \brief Default destructor.
+    */
+    virtual ~LoRaWANStorage() = default;
+
+    /*!
+      \brief Get the number of bytes currently stored.
+      \returns Size of the stored journal in bytes.
+    */
+    virtual size_t size() = 0;
+
+    /*!
+      \brief Read stored data.
+      \param offset Offset from the start of the journal.
+      \param data Buffer to read data into.
+      \param len Number of bytes to read.
+      \returns Number of bytes actually read.
+    */
+    virtual size_t read(size_t offset, uint8_t* data, size_t len) = 0;
+
+    /*!
+      \brief Append data to the end of the journal.
+      A power loss during this call may leave a partially written tail,
+      which is detected and discarded when restoring.
+      \param data Data to append.
+      \param len Number of bytes to append.
+      \returns \ref status_codes
+    */
+    virtual int16_t append(const uint8_t* data, size_t len) = 0;
+
+    /*!
+      \brief Replace the whole journal with new contents.
+      Used for compaction; should be atomic, i.e. either the old or the new
+      contents must survive a power loss.
+      \param data New journal contents.
+      \param len Number of bytes.
+      \returns \ref status_codes
+    */
+    virtual int16_t replace(const uint8_t* data, size_t len) = 0;
+};
+
+/*!
+  \class LoRaWANJournal
+  \brief Append-only persistence of LoRaWAN nonces and session buffers.
+  Instead of rewriting the full buffers after every uplink, only the bytes
+  that changed since the previous save are appended as small CRC-protected records.
+  Records appended by one save are only applied together, so a power loss
+  during a save restores the state of the previous save.
+  Once the journal grows past the configured size, it is compacted into a snapshot.
+*/
+class LoRaWANJournal {
+  public:
+    /*!
+      \brief Default constructor.
+      \param node Pointer to the LoRaWAN node whose buffers will be persisted.
+      \param storage Pointer to the storage backend.
+      \param maxSize Journal size in bytes above which it is compacted into a snapshot.
+      Will be raised to at least twice the snapshot size.
+    */
+    LoRaWANJournal(LoRaWANNode* node, LoRaWANStorage* storage, size_t maxSize = RADIOLIB_LORAWAN_JOURNAL_MAX_SIZE);
+
+    /*!
+      \brief Replay the journal and restore the node buffers.
+      Must be called after beginOTAA/beginABP and before activation.
+      A torn or corrupted tail (e.g. after power loss) is discarded.
+      \returns Status of setBufferSession (or setBufferNonces if there is no session),
+      RADIOLIB_ERR_NONE if the journal is empty.
+    */
+    int16_t restore();
+
+    /*!
+      \brief Append changes of the node buffers since the previous save or restore.
+      Call this after activation and after every uplink.
+      \returns \ref status_codes
+    */
+    int16_t save();
+
+    /*!
+      \brief Rewrite the journal as a single snapshot of the current node buffers.
+      \returns \ref status_codes
+    */
+    int16_t compact();
+
+#if !RADIOLIB_GODMODE
+  protected:
+#endif
+    LoRaWANNode* node;
+    LoRaWANStorage* storage;
+    size_t maxSize;
+
+    // buffer contents as currently represented by the journal
+    uint8_t imageNonces[RADIOLIB_LORAWAN_NONCES_BUF_SIZE] = { 0 };
+    uint8_t imageSession[RADIOLIB_LORAWAN_SESSION_BUF_SIZE] = { 0 };
+
+    // whether the images match the storage contents
+    bool synced = false;
+
+    // write a record into the output buffer, returns the number of bytes written
+    static size_t writeRecord(uint8_t* out, uint8_t id, uint16_t offset, const uint8_t* data, uint16_t len);
+
+    // CRC16 of a record
+    static uint16_t recordCrc(const uint8_t* rec, size_t len);
+
+    // read and validate the record at given position, returns its length or 0 if invalid
+    size_t readRecord(size_t pos, size_t total, uint8_t* rec);
+
+    // set the commit flag of a record previously written by writeRecord
+    static void commitRecord(uint8_t* rec);
+
+    // write records for all bytes in which the buffer differs from its image at out[*outLen]
+    // updates outLen and the position of the last record, returns false if they do not fit into maxLen
+    static bool diffBuffer(uint8_t* out, size_t* outLen, size_t* lastRec, size_t maxLen, uint8_t id, const uint8_t* image, const uint8_t* buff, size_t len);
+
+    // replace the journal with a snapshot of the images
+    int16_t writeSnapshot(bool nonces, bool session);
+};
+
+#endif
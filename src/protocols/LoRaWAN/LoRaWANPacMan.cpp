@@ -2,6 +2,8 @@
 
 #include "LoRaWANPacMan.h"
 #include "LoRaWANPackageTS003.h"
+#include "LoRaWANPackageTS004.h"
+#include "LoRaWANPackageTS005.h"
 #include "LoRaWANPackageTS009.h"
 #include <string.h>
 
@@ -88,6 +90,61 @@ int16_t LoRaWANPackageManager::enableTS003(uint8_t fPort, SetSecondsCb_t setSeco
   return(RADIOLIB_ERR_NONE);
 }
 
+int16_t LoRaWANPackageManager::enableTS004(uint8_t fPort, LoRaWANFragmentStorage* storage, FragDoneCb_t doneCb) {
+  // check if node is not activated
+  if(this->lorawanNode == NULL || this->lorawanNode->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+
+  // the reassembled data block must go somewhere
+  if(this->getSecondsCb == NULL || storage == NULL) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // create package if not already created
+  if(this->packages[RADIOLIB_LORAWAN_PACKAGE_TS004] == NULL) {
+    this->packages[RADIOLIB_LORAWAN_PACKAGE_TS004] = new LoRaWANPackageTS004(this, this->lorawanNode, this->getSecondsCb);
+    this->packagePorts[RADIOLIB_LORAWAN_PACKAGE_TS004] = fPort;
+  }
+
+  // set storage and callback on TS004 package
+  LoRaWANPackageTS004* ts004 = static_cast<LoRaWANPackageTS004*>(this->packages[RADIOLIB_LORAWAN_PACKAGE_TS004]);
+  ts004->setStorage(storage);
+  ts004->setDoneCb(doneCb);
+
+  // enable the package
+  this->enabledPackages[RADIOLIB_LORAWAN_PACKAGE_TS004] = true;
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+int16_t LoRaWANPackageManager::enableTS005(uint8_t fPort, PhysicalLayer* radio, const uint8_t* rootKey) {
+  // check if node is not activated
+  if(this->lorawanNode == NULL || this->lorawanNode->isActivated()) {
+    return(RADIOLIB_ERR_NETWORK_NOT_JOINED);
+  }
+
+  // the multicast keys can not be derived without the AES engine and root key
+  if(this->getSecondsCb == NULL || radio == NULL || rootKey == NULL) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // create package if not already created
+  if(this->packages[RADIOLIB_LORAWAN_PACKAGE_TS005] == NULL) {
+    this->packages[RADIOLIB_LORAWAN_PACKAGE_TS005] = new LoRaWANPackageTS005(this, this->lorawanNode, this->getSecondsCb);
+    this->packagePorts[RADIOLIB_LORAWAN_PACKAGE_TS005] = fPort;
+  }
+
+  // set radio and key on TS005 package
+  LoRaWANPackageTS005* ts005 = static_cast<LoRaWANPackageTS005*>(this->packages[RADIOLIB_LORAWAN_PACKAGE_TS005]);
+  ts005->setPhysicalLayer(radio);
+  ts005->setRootKey(rootKey);
+
+  // enable the package
+  this->enabledPackages[RADIOLIB_LORAWAN_PACKAGE_TS005] = true;
+
+  return(RADIOLIB_ERR_NONE);
+}
 
 int16_t LoRaWANPackageManager::enableTS009(PhysicalLayer* radio, DelaySecondsCb_t delayCb, UplinkIntervalCb_t intervalCb, RebootCb_t rebootCb) {
   // check if node is not activated
@@ -28,6 +28,9 @@
 // Forward-declare the manager so it can be friended by LoRaWANPackage
 class LoRaWANPackageManager;
 
+// Forward-declare the storage used by TS004
+class LoRaWANFragmentStorage;
+
 /*!
   \enum LoRaWANTaskType_t
   \brief Possible LoRaWAN task types.
@@ -134,6 +137,7 @@ class LoRaWANPackageManager {
     typedef void (*DelaySecondsCb_t)(RadioLibTime_t seconds);
     typedef void (*UplinkIntervalCb_t)(RadioLibTime_t intervalSeconds);
     typedef void (*RebootCb_t)();
+    typedef void (*FragDoneCb_t)(uint32_t descriptor, size_t len);
 
     /*!
       \brief Create a package manager
@@ -151,6 +155,24 @@ class LoRaWANPackageManager {
     */
     int16_t enableTS003(uint8_t fPort, SetSecondsCb_t setSecondsFunc);
 
+    /*!
+      \brief Enable TS004 Fragmented Data Block Transport package
+      \param fPort The FPort to which this package will listen
+      \param storage Pointer to the storage for the reassembled data block
+      \param doneCb Callback called when a data block is complete
+      \returns \ref status_codes
+    */
+    int16_t enableTS004(uint8_t fPort, LoRaWANFragmentStorage* storage, FragDoneCb_t doneCb);
+
+    /*!
+      \brief Enable TS005 Remote Multicast Setup package
+      \param fPort The FPort to which this package will listen
+      \param radio Pointer to the PhysicalLayer radio instance, its AES-128 engine is used to derive the multicast keys
+      \param rootKey GenAppKey for LoRaWAN 1.0.x, AppKey for LoRaWAN 1.1
+      \returns \ref status_codes
+    */
+    int16_t enableTS005(uint8_t fPort, PhysicalLayer* radio, const uint8_t* rootKey);
+
     // Package enablement methods
     /*!
       \brief Enable TS009 Certification Protocol package
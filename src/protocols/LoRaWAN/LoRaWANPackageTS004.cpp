@@ -0,0 +1,402 @@
+#if !RADIOLIB_EXCLUDE_LORAWAN
+
+#include "LoRaWANPackageTS004.h"
+#include <string.h>
+
+static inline bool getBit(const uint8_t* mask, uint16_t i) {
+  return(mask[i / 8] & (1 << (i % 8)));
+}
+
+static inline void setBit(uint8_t* mask, uint16_t i) {
+  mask[i / 8] |= (1 << (i % 8));
+}
+
+static inline void xorBuff(uint8_t* dst, const uint8_t* src, size_t len) {
+  for(size_t i = 0; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
+
+// index of the lowest bit set, or RADIOLIB_LORAWAN_TS004_ROW_NONE if there is none
+static uint16_t lowestBit(const uint8_t* mask, uint16_t len) {
+  for(uint16_t i = 0; i < len; i++) {
+    if(mask[i]) {
+      uint16_t bit = i*8;
+      uint8_t b = mask[i];
+      while(!(b & 0x01)) {
+        b >>= 1;
+        bit++;
+      }
+      return(bit);
+    }
+  }
+  return(RADIOLIB_LORAWAN_TS004_ROW_NONE);
+}
+
+// check whether the bit that is set is the only one
+static bool isSingleBit(const uint8_t* mask, uint16_t len, uint16_t bit) {
+  for(uint16_t i = 0; i < len; i++) {
+    uint8_t b = mask[i];
+    if(i == bit / 8) {
+      b &= ~(1 << (bit % 8));
+    }
+    if(b) {
+      return(false);
+    }
+  }
+  return(true);
+}
+
+LoRaWANPackageTS004::LoRaWANPackageTS004(LoRaWANPackageManager* pacMan, LoRaWANNode* node, GetSecondsCb_t secondsCb)
+  : LoRaWANPackage(RADIOLIB_LORAWAN_PACKAGE_TS004, pacMan, node, secondsCb),
+    storage(NULL), fragDone(NULL), sessionActive(false), fragIndex(0), nbFrag(0), fragSize(0),
+    blockAckDelay(0), padding(0), descriptor(0), nbFragReceived(0), nbSolved(0), rowLen(0), maxRows(0),
+    matrixFull(false), uplinkTime(0) {
+  this->packageVersion = 1;
+}
+
+void LoRaWANPackageTS004::setStorage(LoRaWANFragmentStorage* storage) {
+  this->storage = storage;
+}
+
+void LoRaWANPackageTS004::setDoneCb(FragDoneCb_t doneCb) {
+  this->fragDone = doneCb;
+}
+
+uint16_t LoRaWANPackageTS004::getMissingFragments() {
+  if(!this->sessionActive) {
+    return(0);
+  }
+
+  // every stored parity row will provide one of the missing fragments
+  uint16_t missing = this->nbFrag - this->nbSolved;
+  for(uint16_t s = 0; s < this->maxRows; s++) {
+    if(this->rowPivot[s] != RADIOLIB_LORAWAN_TS004_ROW_NONE) {
+      missing--;
+    }
+  }
+  return(missing);
+}
+
+LoRaWANTaskInfo LoRaWANPackageTS004::hasTask() {
+  LoRaWANTaskInfo task;
+  task.type = RADIOLIB_LORAWAN_TASK_NONE;
+  task.time = 0;
+
+  if(this->lenUp > 0) {
+    task.type = RADIOLIB_LORAWAN_TASK_UPLINK;
+    task.time = this->uplinkTime;
+  }
+
+  return(task);
+}
+
+size_t LoRaWANPackageTS004::processData(const uint8_t* dataDown, size_t lenDown, LoRaWANEvent_t* event) {
+  size_t procLen = 0;
+  this->lenUp = 0;
+  this->uplinkTime = this->getSeconds();
+
+  while(procLen < lenDown) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("CID = %02x, len = %d", dataDown[procLen], lenDown - procLen - 1);
+    size_t remaining = lenDown - procLen - 1;
+
+    switch(dataDown[procLen]) {
+      case(RADIOLIB_LORAWAN_TS004_PACKAGE_VERSION): {
+        procLen += 1;
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS004_PACKAGE_VERSION;
+        this->dataUp[this->lenUp + 1] = this->packageIdentifier;
+        this->dataUp[this->lenUp + 2] = this->packageVersion;
+        this->lenUp += 3;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS004_FRAG_SESSION_STATUS): {
+        if(remaining < 1) {
+          return(lenDown);
+        }
+        uint8_t param = dataDown[procLen + 1];
+        procLen += 2;
+
+        // only answer for an existing session, and only if fragments are missing unless all participants are asked
+        uint8_t idx = (param >> 1) & 0x03;
+        uint16_t missing = this->getMissingFragments();
+        if(!this->sessionActive || (idx != this->fragIndex) || (!(param & 0x01) && (missing == 0))) {
+          break;
+        }
+
+        uint16_t received = (this->nbFragReceived & RADIOLIB_LORAWAN_TS004_FRAG_N_MASK) | ((uint16_t)idx << 14);
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS004_FRAG_SESSION_STATUS;
+        this->dataUp[this->lenUp + 1] = (uint8_t)(received & 0xFF);
+        this->dataUp[this->lenUp + 2] = (uint8_t)(received >> 8);
+        this->dataUp[this->lenUp + 3] = missing > 0xFF ? 0xFF : (uint8_t)missing;
+        this->dataUp[this->lenUp + 4] = this->matrixFull ? RADIOLIB_LORAWAN_TS004_STATUS_NOT_ENOUGH_MATRIX_MEMORY : 0;
+        this->lenUp += 5;
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Received: %d, missing: %d", this->nbFragReceived, missing);
+
+        // a multicast request is answered by many devices, so the answers are spread out
+        if(event && event->multicast) {
+          this->uplinkTime += this->lorawanNode->randomNumber(1UL << (this->blockAckDelay + 4));
+        }
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS004_FRAG_SESSION_SETUP): {
+        if(remaining < 10) {
+          return(lenDown);
+        }
+        uint8_t status = this->setupSession(&dataDown[procLen + 1]);
+        procLen += 11;
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS004_FRAG_SESSION_SETUP;
+        this->dataUp[this->lenUp + 1] = status;
+        this->lenUp += 2;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS004_FRAG_SESSION_DELETE): {
+        if(remaining < 1) {
+          return(lenDown);
+        }
+        uint8_t status = dataDown[procLen + 1] & 0x03;
+        procLen += 2;
+
+        if(!this->sessionActive || (status != this->fragIndex)) {
+          status |= RADIOLIB_LORAWAN_TS004_DELETE_NO_SESSION;
+        } else {
+          this->sessionActive = false;
+        }
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("FragSessionDelete status: %02x", status);
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS004_FRAG_SESSION_DELETE;
+        this->dataUp[this->lenUp + 1] = status;
+        this->lenUp += 2;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS004_DATA_FRAGMENT): {
+        // the fragment takes up the rest of the payload
+        if(remaining < 2) {
+          return(lenDown);
+        }
+        uint16_t indexAndN = (uint16_t)dataDown[procLen + 1] | ((uint16_t)dataDown[procLen + 2] << 8);
+        if(this->sessionActive && ((indexAndN >> 14) == this->fragIndex) && (remaining - 2 >= this->fragSize)) {
+          int16_t state = this->addFragment(indexAndN & RADIOLIB_LORAWAN_TS004_FRAG_N_MASK, &dataDown[procLen + 3]);
+          (void)state;
+          RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Fragment %d, state: %d, missing: %d", indexAndN & RADIOLIB_LORAWAN_TS004_FRAG_N_MASK,
+                                          state, this->getMissingFragments());
+        }
+        procLen = lenDown;
+
+      } break;
+      default: {
+        // unknown command, the rest of the payload can not be parsed
+        return(procLen);
+      }
+    }
+  }
+
+  return(procLen);
+}
+
+uint8_t LoRaWANPackageTS004::setupSession(const uint8_t* param) {
+  uint8_t idx = (param[0] >> 4) & 0x03;
+  uint16_t nbFrag = (uint16_t)param[1] | ((uint16_t)param[2] << 8);
+  uint8_t fragSize = param[3];
+  uint8_t control = param[4];
+  uint8_t status = idx << 6;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("FragSessionSetup: index %d, %d fragments of %d bytes", idx, nbFrag, fragSize);
+
+  if(((control >> 3) & 0x07) != RADIOLIB_LORAWAN_TS004_FRAG_ALGO_PARITY) {
+    status |= RADIOLIB_LORAWAN_TS004_SETUP_ENCODING_UNSUPPORTED;
+  }
+
+  // only a single session is supported at a time
+  if(this->sessionActive && (idx != this->fragIndex)) {
+    status |= RADIOLIB_LORAWAN_TS004_SETUP_INDEX_NOT_SUPPORTED;
+  }
+
+  if((this->storage == NULL) || (nbFrag == 0) || (nbFrag > RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS) ||
+     (fragSize == 0) || (fragSize > RADIOLIB_LORAWAN_TS004_MAX_FRAG_SIZE)) {
+    status |= RADIOLIB_LORAWAN_TS004_SETUP_NOT_ENOUGH_MEMORY;
+  }
+
+  if(status & 0x3F) {
+    return(status);
+  }
+
+  // parity rows take a single bit per fragment, so short blocks can keep more of them
+  uint16_t rowLen = (nbFrag + 7) / 8;
+  uint16_t maxRows = RADIOLIB_LORAWAN_TS004_MATRIX_SIZE / rowLen;
+  maxRows = RADIOLIB_MIN(maxRows, RADIOLIB_LORAWAN_TS004_MAX_ROWS);
+  maxRows = RADIOLIB_MIN(maxRows, nbFrag);
+
+  // parity rows are stored behind the data block
+  if(this->storage->prepare((size_t)(nbFrag + maxRows)*fragSize) != RADIOLIB_ERR_NONE) {
+    return(status | RADIOLIB_LORAWAN_TS004_SETUP_NOT_ENOUGH_MEMORY);
+  }
+
+  this->sessionActive = true;
+  this->fragIndex = idx;
+  this->nbFrag = nbFrag;
+  this->fragSize = fragSize;
+  this->blockAckDelay = control & 0x07;
+  this->padding = param[5];
+  this->descriptor = 0;
+  this->descriptor |= (uint32_t)param[6];
+  this->descriptor |= (uint32_t)param[7] <<  8;
+  this->descriptor |= (uint32_t)param[8] << 16;
+  this->descriptor |= (uint32_t)param[9] << 24;
+  this->nbFragReceived = 0;
+  this->nbSolved = 0;
+  this->rowLen = rowLen;
+  this->maxRows = maxRows;
+  this->matrixFull = false;
+  memset(this->solved, 0, sizeof(this->solved));
+  for(uint16_t s = 0; s < RADIOLIB_LORAWAN_TS004_MAX_ROWS; s++) {
+    this->rowPivot[s] = RADIOLIB_LORAWAN_TS004_ROW_NONE;
+  }
+
+  return(status);
+}
+
+int16_t LoRaWANPackageTS004::addFragment(uint16_t n, const uint8_t* data) {
+  if(n == 0) {
+    return(RADIOLIB_ERR_DOWNLINK_MALFORMED);
+  }
+  this->nbFragReceived++;
+
+  // the block is already complete
+  if(this->nbSolved == this->nbFrag) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // fragments up to NbFrag are uncoded, the following ones are combinations given by the parity matrix
+  uint8_t* row = this->rowBuff;
+  memset(row, 0, this->rowLen);
+  if(n <= this->nbFrag) {
+    setBit(row, n - 1);
+  } else {
+    getParityRow(n - this->nbFrag, this->nbFrag, row);
+  }
+
+  // The stored parity rows are kept in reduced row echelon form: the pivot of each row
+  // (its lowest fragment when it was added) does not appear in any other row, and no row contains solved fragments.
+  // This way, the new row can be reduced in a single pass, and a row that is reduced to its pivot is directly solved.
+  // Reduction is first done on the masks only, so that redundant fragments do not cost any storage access.
+  uint8_t* known = this->knownBuff;
+  uint8_t used[(RADIOLIB_LORAWAN_TS004_MAX_ROWS + 7) / 8] = { 0 };
+  for(uint16_t i = 0; i < this->rowLen; i++) {
+    known[i] = row[i] & this->solved[i];
+    row[i] &= ~this->solved[i];
+  }
+  for(uint16_t s = 0; s < this->maxRows; s++) {
+    if((this->rowPivot[s] != RADIOLIB_LORAWAN_TS004_ROW_NONE) && getBit(row, this->rowPivot[s])) {
+      xorBuff(row, &this->matrix[s*this->rowLen], this->rowLen);
+      setBit(used, s);
+    }
+  }
+
+  // nothing new in this fragment
+  uint16_t pivot = lowestBit(row, this->rowLen);
+  if(pivot == RADIOLIB_LORAWAN_TS004_ROW_NONE) {
+    return(RADIOLIB_ERR_NONE);
+  }
+
+  // a new parity row needs space in the matrix
+  bool single = isSingleBit(row, this->rowLen, pivot);
+  uint16_t slot = RADIOLIB_LORAWAN_TS004_ROW_NONE;
+  if(!single) {
+    for(uint16_t s = 0; s < this->maxRows; s++) {
+      if(this->rowPivot[s] == RADIOLIB_LORAWAN_TS004_ROW_NONE) {
+        slot = s;
+        break;
+      }
+    }
+    if(slot == RADIOLIB_LORAWAN_TS004_ROW_NONE) {
+      this->matrixFull = true;
+      return(RADIOLIB_ERR_NONE);
+    }
+  }
+
+  // apply the same reduction to the fragment data
+  int16_t state = RADIOLIB_ERR_NONE;
+  uint8_t* frag = this->fragBuff;
+  memcpy(frag, data, this->fragSize);
+  for(uint16_t i = 0; i < this->nbFrag; i++) {
+    if(getBit(known, i)) {
+      state = this->storage->read((size_t)i*this->fragSize, this->tmpBuff, this->fragSize);
+      RADIOLIB_ASSERT(state);
+      xorBuff(frag, this->tmpBuff, this->fragSize);
+    }
+  }
+  for(uint16_t s = 0; s < this->maxRows; s++) {
+    if(getBit(used, s)) {
+      state = this->storage->read((size_t)(this->nbFrag + s)*this->fragSize, this->tmpBuff, this->fragSize);
+      RADIOLIB_ASSERT(state);
+      xorBuff(frag, this->tmpBuff, this->fragSize);
+    }
+  }
+
+  // remove the new pivot from all other rows, which may solve some of them
+  for(uint16_t s = 0; s < this->maxRows; s++) {
+    uint8_t* other = &this->matrix[s*this->rowLen];
+    if((this->rowPivot[s] == RADIOLIB_LORAWAN_TS004_ROW_NONE) || !getBit(other, pivot)) {
+      continue;
+    }
+    xorBuff(other, row, this->rowLen);
+    size_t offset = (size_t)(this->nbFrag + s)*this->fragSize;
+    state = this->storage->read(offset, this->tmpBuff, this->fragSize);
+    RADIOLIB_ASSERT(state);
+    xorBuff(this->tmpBuff, frag, this->fragSize);
+    if(isSingleBit(other, this->rowLen, this->rowPivot[s])) {
+      offset = (size_t)this->rowPivot[s]*this->fragSize;
+      setBit(this->solved, this->rowPivot[s]);
+      this->rowPivot[s] = RADIOLIB_LORAWAN_TS004_ROW_NONE;
+      this->nbSolved++;
+    }
+    state = this->storage->write(offset, this->tmpBuff, this->fragSize);
+    RADIOLIB_ASSERT(state);
+  }
+
+  // store the new row, or the fragment itself if it was solved
+  if(single) {
+    state = this->storage->write((size_t)pivot*this->fragSize, frag, this->fragSize);
+    RADIOLIB_ASSERT(state);
+    setBit(this->solved, pivot);
+    this->nbSolved++;
+  } else {
+    memcpy(&this->matrix[slot*this->rowLen], row, this->rowLen);
+    this->rowPivot[slot] = pivot;
+    state = this->storage->write((size_t)(this->nbFrag + slot)*this->fragSize, frag, this->fragSize);
+    RADIOLIB_ASSERT(state);
+  }
+
+  if(this->nbSolved == this->nbFrag) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Data block complete after %d fragments", this->nbFragReceived);
+    if(this->fragDone) {
+      this->fragDone(this->descriptor, (size_t)this->nbFrag*this->fragSize - this->padding);
+    }
+  }
+
+  return(RADIOLIB_ERR_NONE);
+}
+
+void LoRaWANPackageTS004::getParityRow(uint16_t n, uint16_t m, uint8_t* row) {
+  // as per TS004 section 7, each row selects m/2 fragments (possibly with repetition)
+  uint16_t mTemp = ((m & (m - 1)) == 0) ? 1 : 0;
+  uint32_t x = 1 + 1001*(uint32_t)n;
+  memset(row, 0, (m + 7) / 8);
+  for(uint16_t nbCoeff = 0; nbCoeff < m / 2; nbCoeff++) {
+    uint32_t r = m;
+    while(r >= m) {
+      x = prbs23(x);
+      r = x % (m + mTemp);
+    }
+    setBit(row, (uint16_t)r);
+  }
+}
+
+uint32_t LoRaWANPackageTS004::prbs23(uint32_t x) {
+  uint32_t b0 = x & 0x01;
+  uint32_t b1 = (x & 0x20) >> 5;
+  return((x >> 1) + ((b0 ^ b1) << 22));
+}
+
+#endif
@@ -0,0 +1,210 @@
+#if !defined(_RADIOLIB_LORAWAN_PACKAGE_TS004_H) && !RADIOLIB_EXCLUDE_LORAWAN
+#define _RADIOLIB_LORAWAN_PACKAGE_TS004_H
+
+#include "LoRaWANPacMan.h"
+
+// TS004 Fragmented Data Block Transport splits a large data block (e.g. a firmware image)
+// into fragments, which are typically sent over a multicast group. Besides the uncoded fragments,
+// the server sends parity fragments, each being the XOR of a pseudo-random half of the uncoded fragments.
+// Any set of received fragments that spans the block is sufficient to reconstruct it.
+
+#define RADIOLIB_LORAWAN_TS004_PACKAGE_VERSION        (0x00)
+#define RADIOLIB_LORAWAN_TS004_FRAG_SESSION_STATUS    (0x01)
+#define RADIOLIB_LORAWAN_TS004_FRAG_SESSION_SETUP     (0x02)
+#define RADIOLIB_LORAWAN_TS004_FRAG_SESSION_DELETE    (0x03)
+#define RADIOLIB_LORAWAN_TS004_DATA_FRAGMENT          (0x08)
+
+// FragSessionSetupAns status bits
+#define RADIOLIB_LORAWAN_TS004_SETUP_ENCODING_UNSUPPORTED       (0x01 << 0)
+#define RADIOLIB_LORAWAN_TS004_SETUP_NOT_ENOUGH_MEMORY          (0x01 << 1)
+#define RADIOLIB_LORAWAN_TS004_SETUP_INDEX_NOT_SUPPORTED        (0x01 << 2)
+
+// FragSessionDeleteAns status bits
+#define RADIOLIB_LORAWAN_TS004_DELETE_NO_SESSION                (0x01 << 2)
+
+// FragSessionStatusAns status bits
+#define RADIOLIB_LORAWAN_TS004_STATUS_NOT_ENOUGH_MATRIX_MEMORY  (0x01 << 0)
+
+// the only fragmentation algorithm defined by TS004
+#define RADIOLIB_LORAWAN_TS004_FRAG_ALGO_PARITY                 (0x00)
+
+// fragment counter is 14 bits wide
+#define RADIOLIB_LORAWAN_TS004_FRAG_N_MASK                      (0x3FFF)
+
+// unused entry in the parity row table
+#define RADIOLIB_LORAWAN_TS004_ROW_NONE                         (0xFFFF)
+
+// maximum number of uncoded fragments in a data block
+#if !defined(RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS)
+  #define RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS                  (1024)
+#endif
+
+// maximum number of parity rows kept while the block is incomplete
+#if !defined(RADIOLIB_LORAWAN_TS004_MAX_ROWS)
+  #define RADIOLIB_LORAWAN_TS004_MAX_ROWS                       (64)
+#endif
+
+// memory for the parity rows (bytes), each row takes one bit per uncoded fragment
+#if !defined(RADIOLIB_LORAWAN_TS004_MATRIX_SIZE)
+  #define RADIOLIB_LORAWAN_TS004_MATRIX_SIZE                    (2048)
+#endif
+
+// largest fragment which fits into a downlink next to the command header
+#define RADIOLIB_LORAWAN_TS004_MAX_FRAG_SIZE                    (RADIOLIB_LORAWAN_MAX_PAYLOAD_SIZE - 3)
+
+/*!
+  \class LoRaWANFragmentStorage
+  \brief Interface to the memory holding the reassembled data block.
+  Implement this class to place the block in flash, external memory, a file etc.
+  Besides the data block itself, the storage also holds the partially decoded parity fragments,
+  these are placed directly behind the data block.
+*/
+class LoRaWANFragmentStorage {
+  public:
+    /*!
+      \brief Default destructor.
+    */
+    virtual ~LoRaWANFragmentStorage() = default;
+
+    /*!
+      \brief Prepare the storage for a new data block, e.g. by erasing it.
+      \param len Number of bytes that will be used, including the space for parity fragments.
+      \returns \ref status_codes
+    */
+    virtual int16_t prepare(size_t len) = 0;
+
+    /*!
+      \brief Read stored data.
+      \param offset Offset from the start of the storage.
+      \param data Buffer to read data into.
+      \param len Number of bytes to read.
+      \returns \ref status_codes
+    */
+    virtual int16_t read(size_t offset, uint8_t* data, size_t len) = 0;
+
+    /*!
+      \brief Write data. The same offset may be written multiple times.
+      \param offset Offset from the start of the storage.
+      \param data Data to write.
+      \param len Number of bytes to write.
+      \returns \ref status_codes
+    */
+    virtual int16_t write(size_t offset, const uint8_t* data, size_t len) = 0;
+};
+
+/*!
+  \class LoRaWANPackageTS004
+  \brief LoRaWAN Application package for TS004 Fragmented Data Block Transport.
+  Every fragment is merged into the decoder as soon as it is received, so the block
+  is complete with the last fragment that was needed, without decoding at the end of the session.
+*/
+class LoRaWANPackageTS004 : public LoRaWANPackage {
+  public:
+
+    /*!
+      \brief Callback called once a data block has been reassembled.
+      \param descriptor Descriptor of the block, as set up by the server.
+      \param len Length of the block in bytes, starting at offset 0 of the storage.
+    */
+    typedef void (*FragDoneCb_t)(uint32_t descriptor, size_t len);
+
+    // copy constructor is removed to prevent users from creating copies of this class
+    LoRaWANPackageTS004(const LoRaWANPackageTS004& obj) = delete;
+
+    /*!
+      \brief Process downlink data for the TS004 fragmentation package
+      \param dataDown Pointer to received downlink data
+      \param lenDown Length of downlink data
+      \param event Downlink event details
+      \returns Number of bytes consumed
+    */
+    size_t processData(const uint8_t* dataDown, size_t lenDown, LoRaWANEvent_t* event) override;
+
+    /*!
+      \brief Find out what the next task is and when it occurs
+      \returns `LoRaWANTaskInfo` containing task type and time
+    */
+    LoRaWANTaskInfo hasTask() override;
+
+    /*!
+      \brief Set the storage for the reassembled data block
+      \param storage Pointer to the storage
+    */
+    void setStorage(LoRaWANFragmentStorage* storage);
+
+    /*!
+      \brief Set the callback called when a data block is complete
+      \param doneCb Callback function
+    */
+    void setDoneCb(FragDoneCb_t doneCb);
+
+    /*!
+      \brief Get the number of fragments still needed to reassemble the data block
+      \returns Number of missing fragments, 0 if there is no session or the block is complete
+    */
+    uint16_t getMissingFragments();
+
+#if !RADIOLIB_GODMODE
+  protected:
+#endif
+
+    LoRaWANFragmentStorage* storage;
+    FragDoneCb_t fragDone;
+
+    // fragmentation session as set up by the server
+    bool sessionActive;
+    uint8_t fragIndex;
+    uint16_t nbFrag;
+    uint8_t fragSize;
+    uint8_t blockAckDelay;
+    uint8_t padding;
+    uint32_t descriptor;
+
+    // decoder state
+    uint16_t nbFragReceived;
+    uint16_t nbSolved;
+    uint16_t rowLen;                // length of a single parity row (bytes)
+    uint16_t maxRows;               // number of parity rows that fit into the matrix
+    bool matrixFull;                // a fragment had to be dropped because the matrix was full
+    uint8_t solved[RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS / 8];
+    uint16_t rowPivot[RADIOLIB_LORAWAN_TS004_MAX_ROWS];
+    uint8_t matrix[RADIOLIB_LORAWAN_TS004_MATRIX_SIZE];
+
+    // scratch buffers for a single row
+    uint8_t rowBuff[RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS / 8];
+    uint8_t knownBuff[RADIOLIB_LORAWAN_TS004_MAX_FRAGMENTS / 8];
+    uint8_t fragBuff[RADIOLIB_LORAWAN_TS004_MAX_FRAG_SIZE];
+    uint8_t tmpBuff[RADIOLIB_LORAWAN_TS004_MAX_FRAG_SIZE];
+
+    // scheduled uplink, answers to multicast requests are spread over BlockAckDelay
+    RadioLibTime_t uplinkTime;
+
+    // set up a new session, returns the FragSessionSetupAns status bits
+    uint8_t setupSession(const uint8_t* param);
+
+    // merge a single fragment into the decoder
+    int16_t addFragment(uint16_t n, const uint8_t* data);
+
+    // build row n of the parity matrix for a block of m fragments as a bit mask
+    static void getParityRow(uint16_t n, uint16_t m, uint8_t* row);
+
+    // pseudo-random sequence generator for the parity matrix
+    static uint32_t prbs23(uint32_t x);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    // private constructor, to not allow the user to create additional instances of this package
+    /*!
+      \brief Constructor
+      \param pacMan Pointer to the package manager
+      \param node Pointer to the LoRaWAN node
+      \param secondsCb Pointer to getSeconds() function
+    */
+    LoRaWANPackageTS004(LoRaWANPackageManager* pacMan, LoRaWANNode* node, GetSecondsCb_t secondsCb);
+
+    // allow LoRaWANPackageManager to access the private constructor
+    friend LoRaWANPackageManager;
+};
+
+#endif
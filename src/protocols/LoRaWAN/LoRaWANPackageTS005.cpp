@@ -0,0 +1,308 @@
+#if !RADIOLIB_EXCLUDE_LORAWAN
+
+#include "LoRaWANPackageTS005.h"
+#include <string.h>
+
+LoRaWANPackageTS005::LoRaWANPackageTS005(LoRaWANPackageManager* pacMan, LoRaWANNode* node, GetSecondsCb_t secondsCb)
+  : LoRaWANPackage(RADIOLIB_LORAWAN_PACKAGE_TS005, pacMan, node, secondsCb),
+    radioModule(NULL) {
+  this->packageVersion = 1;
+  memset(this->rootKey, 0, sizeof(this->rootKey));
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS; i++) {
+    this->groupState[i] = RADIOLIB_LORAWAN_TS005_GROUP_NONE;
+    this->groups[i] = RADIOLIB_MULTICAST_GROUP_NONE;
+    this->sessionStart[i] = 0;
+    this->sessionEnd[i] = 0;
+  }
+}
+
+void LoRaWANPackageTS005::setPhysicalLayer(PhysicalLayer* radio) {
+  this->radioModule = radio;
+}
+
+void LoRaWANPackageTS005::setRootKey(const uint8_t* key) {
+  memcpy(this->rootKey, key, RADIOLIB_AES128_KEY_SIZE);
+}
+
+LoRaWANTaskInfo LoRaWANPackageTS005::hasTask() {
+  LoRaWANTaskInfo task;
+  task.type = RADIOLIB_LORAWAN_TASK_NONE;
+  task.time = 0;
+
+  // check for any pending uplinks
+  if(this->lenUp > 0) {
+    task.type = RADIOLIB_LORAWAN_TASK_UPLINK;
+    task.time = this->getSeconds();
+    return(task);
+  }
+
+  // find the earliest session start or end
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS; i++) {
+    RadioLibTime_t time = 0;
+    if(this->groupState[i] == RADIOLIB_LORAWAN_TS005_GROUP_SCHEDULED) {
+      time = this->sessionStart[i];
+    } else if(this->groupState[i] == RADIOLIB_LORAWAN_TS005_GROUP_RUNNING) {
+      time = this->sessionEnd[i];
+    } else {
+      continue;
+    }
+
+    if((task.type == RADIOLIB_LORAWAN_TASK_NONE) || (time < task.time)) {
+      task.type = RADIOLIB_LORAWAN_TASK_ACTION;
+      task.time = time;
+    }
+  }
+
+  return(task);
+}
+
+void LoRaWANPackageTS005::doAction() {
+  RadioLibTime_t now = this->getSeconds();
+
+  for(uint8_t i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS; i++) {
+    if((this->groupState[i] == RADIOLIB_LORAWAN_TS005_GROUP_SCHEDULED) && (this->sessionStart[i] <= now)) {
+      int16_t state = this->lorawanNode->startMulticastSession(i, &this->groups[i]);
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Starting multicast session %d, state: %d", i, state);
+      this->groupState[i] = (state == RADIOLIB_ERR_NONE) ? RADIOLIB_LORAWAN_TS005_GROUP_RUNNING : RADIOLIB_LORAWAN_TS005_GROUP_DEFINED;
+
+    } else if((this->groupState[i] == RADIOLIB_LORAWAN_TS005_GROUP_RUNNING) && (this->sessionEnd[i] <= now)) {
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("Multicast session %d timed out", i);
+      this->lorawanNode->stopMulticastSession(i);
+      this->groupState[i] = RADIOLIB_LORAWAN_TS005_GROUP_DEFINED;
+
+    }
+  }
+}
+
+size_t LoRaWANPackageTS005::processData(const uint8_t* dataDown, size_t lenDown, LoRaWANEvent_t* event) {
+  (void)event;
+
+  size_t procLen = 0;
+  this->lenUp = 0;
+
+  while(procLen < lenDown) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("CID = %02x, len = %d", dataDown[procLen], lenDown - procLen - 1);
+    size_t remaining = lenDown - procLen - 1;
+
+    switch(dataDown[procLen]) {
+      case(RADIOLIB_LORAWAN_TS005_PACKAGE_VERSION): {
+        procLen += 1;
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS005_PACKAGE_VERSION;
+        this->dataUp[this->lenUp + 1] = this->packageIdentifier;
+        this->dataUp[this->lenUp + 2] = this->packageVersion;
+        this->lenUp += 3;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS005_MC_GROUP_STATUS): {
+        if(remaining < 1) {
+          return(lenDown);
+        }
+        uint8_t reqMask = dataDown[procLen + 1] & 0x0F;
+        procLen += 2;
+
+        // status byte first, followed by ID and address of each requested group
+        size_t statusPos = this->lenUp + 1;
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS005_MC_GROUP_STATUS;
+        this->lenUp += 2;
+        uint8_t ansMask = 0;
+        uint8_t nbTotal = 0;
+        for(uint8_t i = 0; i < RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS; i++) {
+          if(this->groupState[i] == RADIOLIB_LORAWAN_TS005_GROUP_NONE) {
+            continue;
+          }
+          nbTotal++;
+          if(!(reqMask & (1 << i))) {
+            continue;
+          }
+          ansMask |= (1 << i);
+          uint32_t mcAddr = this->groups[i].mcAddr;
+          this->dataUp[this->lenUp + 0] = i;
+          this->dataUp[this->lenUp + 1] = (uint8_t)((mcAddr >> 0)  & 0xFF);
+          this->dataUp[this->lenUp + 2] = (uint8_t)((mcAddr >> 8)  & 0xFF);
+          this->dataUp[this->lenUp + 3] = (uint8_t)((mcAddr >> 16) & 0xFF);
+          this->dataUp[this->lenUp + 4] = (uint8_t)((mcAddr >> 24) & 0xFF);
+          this->lenUp += 5;
+        }
+        this->dataUp[statusPos] = ansMask | (nbTotal << 4);
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McGroupStatus: %02x", this->dataUp[statusPos]);
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS005_MC_GROUP_SETUP): {
+        if(remaining < 29) {
+          return(lenDown);
+        }
+        uint8_t status = this->setupGroup(&dataDown[procLen + 1]);
+        procLen += 30;
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS005_MC_GROUP_SETUP;
+        this->dataUp[this->lenUp + 1] = status;
+        this->lenUp += 2;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS005_MC_GROUP_DELETE): {
+        if(remaining < 1) {
+          return(lenDown);
+        }
+        uint8_t id = dataDown[procLen + 1] & 0x03;
+        uint8_t status = id;
+        procLen += 2;
+
+        if(this->groupState[id] == RADIOLIB_LORAWAN_TS005_GROUP_NONE) {
+          status |= RADIOLIB_LORAWAN_TS005_DELETE_UNDEFINED;
+        } else {
+          if(this->groupState[id] == RADIOLIB_LORAWAN_TS005_GROUP_RUNNING) {
+            this->lorawanNode->stopMulticastSession(id);
+          }
+          this->groupState[id] = RADIOLIB_LORAWAN_TS005_GROUP_NONE;
+          this->groups[id] = RADIOLIB_MULTICAST_GROUP_NONE;
+        }
+        RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McGroupDelete status: %02x", status);
+
+        this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS005_MC_GROUP_DELETE;
+        this->dataUp[this->lenUp + 1] = status;
+        this->lenUp += 2;
+
+      } break;
+      case(RADIOLIB_LORAWAN_TS005_MC_CLASS_C_SESSION): {
+        if(remaining < 10) {
+          return(lenDown);
+        }
+        this->scheduleSession(&dataDown[procLen + 1]);
+        procLen += 11;
+
+      } break;
+      default: {
+        // unknown or unsupported command (e.g. Class B sessions), the rest of the payload can not be parsed
+        return(procLen);
+      }
+    }
+  }
+
+  return(procLen);
+}
+
+uint8_t LoRaWANPackageTS005::setupGroup(const uint8_t* param) {
+  uint8_t id = param[0] & 0x03;
+  if((id >= RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS) || (this->radioModule == NULL)) {
+    return(id | RADIOLIB_LORAWAN_TS005_SETUP_ID_ERROR);
+  }
+
+  // a group that is redefined ends its session
+  if(this->groupState[id] == RADIOLIB_LORAWAN_TS005_GROUP_RUNNING) {
+    this->lorawanNode->stopMulticastSession(id);
+  }
+
+  MulticastGroup_t* group = &this->groups[id];
+  *group = RADIOLIB_MULTICAST_GROUP_NONE;
+  group->cls = RADIOLIB_LORAWAN_CLASS_C;
+  group->mcAddr = 0;
+  group->mcFCnt = 0;
+  group->mcFCntMax = 0;
+  for(uint8_t i = 0; i < 4; i++) {
+    group->mcAddr |= (uint32_t)param[1 + i] << (8*i);
+    group->mcFCnt |= (uint32_t)param[21 + i] << (8*i);
+    group->mcFCntMax |= (uint32_t)param[25 + i] << (8*i);
+  }
+  this->deriveKeys(&param[5], group);
+  this->groupState[id] = RADIOLIB_LORAWAN_TS005_GROUP_DEFINED;
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McGroupSetup: group %d, address %08lx, FCnt %lu - %lu", id,
+                                  (unsigned long)group->mcAddr, (unsigned long)group->mcFCnt, (unsigned long)group->mcFCntMax);
+
+  return(id);
+}
+
+void LoRaWANPackageTS005::scheduleSession(const uint8_t* param) {
+  uint8_t id = param[0] & 0x03;
+  uint8_t status = id;
+  uint32_t sessionTime = 0;
+  for(uint8_t i = 0; i < 4; i++) {
+    sessionTime |= (uint32_t)param[1 + i] << (8*i);
+  }
+  uint8_t timeout = param[5] & 0x0F;
+  uint32_t freq = (uint32_t)param[6] | ((uint32_t)param[7] << 8) | ((uint32_t)param[8] << 16);
+  uint8_t dr = param[9];
+
+  // let the node check the session parameters, the same checks will be done when it starts
+  MulticastGroup_t group = this->groups[id];
+  if(this->groupState[id] == RADIOLIB_LORAWAN_TS005_GROUP_NONE) {
+    status |= RADIOLIB_LORAWAN_TS005_SESSION_UNDEFINED;
+  } else {
+    group.mcFreq = freq * 100;
+    group.mcDr = dr;
+    int16_t state = this->lorawanNode->checkMulticastSession(&group);
+    if(state == RADIOLIB_ERR_INVALID_FREQUENCY) {
+      status |= RADIOLIB_LORAWAN_TS005_SESSION_FREQ_ERROR;
+    } else if(state == RADIOLIB_ERR_INVALID_DATA_RATE) {
+      status |= RADIOLIB_LORAWAN_TS005_SESSION_DR_ERROR;
+    } else if(state != RADIOLIB_ERR_NONE) {
+      status |= RADIOLIB_LORAWAN_TS005_SESSION_UNDEFINED;
+    }
+  }
+
+  this->dataUp[this->lenUp + 0] = RADIOLIB_LORAWAN_TS005_MC_CLASS_C_SESSION;
+  this->dataUp[this->lenUp + 1] = status;
+  this->lenUp += 2;
+  if(status != id) {
+    RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McClassCSession rejected: %02x", status);
+    return;
+  }
+
+  // a session that should have already started, starts right away
+  RadioLibTime_t now = this->getSeconds();
+  int32_t timeToStart = (int32_t)(sessionTime - (uint32_t)now);
+  if(timeToStart < 0) {
+    timeToStart = 0;
+  }
+
+  // a new session replaces the running one
+  if(this->groupState[id] == RADIOLIB_LORAWAN_TS005_GROUP_RUNNING) {
+    this->lorawanNode->stopMulticastSession(id);
+  }
+  this->groups[id] = group;
+  this->groupState[id] = RADIOLIB_LORAWAN_TS005_GROUP_SCHEDULED;
+  this->sessionStart[id] = now + timeToStart;
+  this->sessionEnd[id] = this->sessionStart[id] + ((RadioLibTime_t)1 << timeout);
+  RADIOLIB_DEBUG_PROTOCOL_PRINTLN("McClassCSession: group %d starts in %ld s for %lu s", id, (long)timeToStart, 1UL << timeout);
+
+  this->dataUp[this->lenUp + 0] = (uint8_t)((timeToStart >> 0)  & 0xFF);
+  this->dataUp[this->lenUp + 1] = (uint8_t)((timeToStart >> 8)  & 0xFF);
+  this->dataUp[this->lenUp + 2] = (uint8_t)((timeToStart >> 16) & 0xFF);
+  this->lenUp += 3;
+}
+
+void LoRaWANPackageTS005::deriveKeys(const uint8_t* mcKeyEnc, MulticastGroup_t* group) {
+  RadioLibAES128* aes = this->radioModule->getMod()->hal->aes128;
+  uint8_t block[RADIOLIB_AES128_BLOCK_SIZE] = { 0 };
+  uint8_t key[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+  uint8_t mcKey[RADIOLIB_AES128_KEY_SIZE] = { 0 };
+
+  // McRootKey = aes128_encrypt(GenAppKey, 0x00 | pad16) for LoRaWAN 1.0.x
+  // McRootKey = aes128_encrypt(AppKey, 0x20 | pad16) for LoRaWAN 1.1
+  memcpy(key, this->rootKey, RADIOLIB_AES128_KEY_SIZE);
+  block[0] = (this->lorawanNode->getVersionMajor() == 1) ? 0x20 : 0x00;
+  aes->init(key);
+  aes->encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, mcKey);
+
+  // McKEKey = aes128_encrypt(McRootKey, 0x00 | pad16)
+  block[0] = 0x00;
+  aes->init(mcKey);
+  aes->encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, key);
+
+  // the server encrypts McKey with aes128_decrypt, so it is recovered by encryption
+  aes->init(key);
+  aes->encryptECB(mcKeyEnc, RADIOLIB_AES128_BLOCK_SIZE, mcKey);
+
+  // McAppSKey = aes128_encrypt(McKey, 0x01 | McAddr | pad16)
+  // McNwkSKey = aes128_encrypt(McKey, 0x02 | McAddr | pad16)
+  for(uint8_t i = 0; i < 4; i++) {
+    block[1 + i] = (uint8_t)((group->mcAddr >> (8*i)) & 0xFF);
+  }
+  aes->init(mcKey);
+  block[0] = 0x01;
+  aes->encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, group->mcAppSKey);
+  block[0] = 0x02;
+  aes->encryptECB(block, RADIOLIB_AES128_BLOCK_SIZE, group->mcNwkSKey);
+}
+
+#endif
@@ -0,0 +1,115 @@
+#if !defined(_RADIOLIB_LORAWAN_PACKAGE_TS005_H) && !RADIOLIB_EXCLUDE_LORAWAN
+#define _RADIOLIB_LORAWAN_PACKAGE_TS005_H
+
+#include "LoRaWANPacMan.h"
+
+// TS005 Remote Multicast Setup lets the server create multicast groups on the device
+// and schedule sessions for them. The multicast keys are sent encrypted with a key
+// derived from GenAppKey (LoRaWAN 1.0.x) or AppKey (LoRaWAN 1.1), so they never appear in clear.
+
+#define RADIOLIB_LORAWAN_TS005_PACKAGE_VERSION        (0x00)
+#define RADIOLIB_LORAWAN_TS005_MC_GROUP_STATUS        (0x01)
+#define RADIOLIB_LORAWAN_TS005_MC_GROUP_SETUP         (0x02)
+#define RADIOLIB_LORAWAN_TS005_MC_GROUP_DELETE        (0x03)
+#define RADIOLIB_LORAWAN_TS005_MC_CLASS_C_SESSION     (0x04)
+
+// McGroupSetupAns status bits
+#define RADIOLIB_LORAWAN_TS005_SETUP_ID_ERROR                   (0x01 << 2)
+
+// McGroupDeleteAns status bits
+#define RADIOLIB_LORAWAN_TS005_DELETE_UNDEFINED                 (0x01 << 2)
+
+// McClassCSessionAns status bits
+#define RADIOLIB_LORAWAN_TS005_SESSION_DR_ERROR                 (0x01 << 2)
+#define RADIOLIB_LORAWAN_TS005_SESSION_FREQ_ERROR               (0x01 << 3)
+#define RADIOLIB_LORAWAN_TS005_SESSION_UNDEFINED                (0x01 << 4)
+
+// state of a multicast group
+#define RADIOLIB_LORAWAN_TS005_GROUP_NONE                       (0)
+#define RADIOLIB_LORAWAN_TS005_GROUP_DEFINED                    (1)
+#define RADIOLIB_LORAWAN_TS005_GROUP_SCHEDULED                  (2)
+#define RADIOLIB_LORAWAN_TS005_GROUP_RUNNING                    (3)
+
+/*!
+  \class LoRaWANPackageTS005
+  \brief LoRaWAN Application package for TS005 Remote Multicast Setup.
+  Sessions are started and stopped by the package manager's ACTION tasks,
+  using the multicast sessions of LoRaWANNode.
+*/
+class LoRaWANPackageTS005 : public LoRaWANPackage {
+  public:
+
+    // copy constructor is removed to prevent users from creating copies of this class
+    LoRaWANPackageTS005(const LoRaWANPackageTS005& obj) = delete;
+
+    /*!
+      \brief Process downlink data for the TS005 remote multicast setup package
+      \param dataDown Pointer to received downlink data
+      \param lenDown Length of downlink data
+      \param event Downlink event details
+      \returns Number of bytes consumed
+    */
+    size_t processData(const uint8_t* dataDown, size_t lenDown, LoRaWANEvent_t* event) override;
+
+    /*!
+      \brief Find out what the next task is and when it occurs
+      \returns `LoRaWANTaskInfo` containing task type and time
+    */
+    LoRaWANTaskInfo hasTask() override;
+
+    /*!
+      \brief Start or stop all multicast sessions that are due.
+    */
+    void doAction() override;
+
+    /*!
+      \brief Set the radio, its AES-128 engine is used to derive the multicast keys
+      \param radio Pointer to the PhysicalLayer radio instance
+    */
+    void setPhysicalLayer(PhysicalLayer* radio);
+
+    /*!
+      \brief Set the root key for the multicast keys
+      \param key GenAppKey for LoRaWAN 1.0.x, AppKey for LoRaWAN 1.1
+    */
+    void setRootKey(const uint8_t* key);
+
+#if !RADIOLIB_GODMODE
+  protected:
+#endif
+
+    PhysicalLayer* radioModule;
+    uint8_t rootKey[RADIOLIB_AES128_KEY_SIZE];
+
+    // groups as set up by the server, the session parameters are only used once a session is requested
+    uint8_t groupState[RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS];
+    MulticastGroup_t groups[RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS];
+    RadioLibTime_t sessionStart[RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS];
+    RadioLibTime_t sessionEnd[RADIOLIB_LORAWAN_MAX_NUM_MC_GROUPS];
+
+    // set up a group from McGroupSetupReq, returns the status byte
+    uint8_t setupGroup(const uint8_t* param);
+
+    // schedule a session from McClassCSessionReq, the answer is written to the uplink buffer
+    void scheduleSession(const uint8_t* param);
+
+    // derive the multicast session keys from the encrypted McKey
+    void deriveKeys(const uint8_t* mcKeyEnc, MulticastGroup_t* group);
+
+#if !RADIOLIB_GODMODE
+  private:
+#endif
+    // private constructor, to not allow the user to create additional instances of this package
+    /*!
+      \brief Constructor
+      \param pacMan Pointer to the package manager
+      \param node Pointer to the LoRaWAN node
+      \param secondsCb Pointer to getSeconds() function
+    */
+    LoRaWANPackageTS005(LoRaWANPackageManager* pacMan, LoRaWANNode* node, GetSecondsCb_t secondsCb);
+
+    // allow LoRaWANPackageManager to access the private constructor
+    friend LoRaWANPackageManager;
+};
+
+#endif
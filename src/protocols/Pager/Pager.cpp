@@ -286,9 +286,9 @@ int16_t PagerClient::startReceiveCommon() {
   // the logic here is inverted, because modules like SX1278
   // assume high frequency to be logic 1, which is opposite to POCSAG
   if(!inv) {
-    phyLayer->setDirectSyncWord(~RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD, 32);
+    phyLayer->setDirectSyncWord(~RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD, 32, RADIOLIB_PAGER_SYNC_MAX_ERRORS);
   } else {
-    phyLayer->setDirectSyncWord(RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD, 32);
+    phyLayer->setDirectSyncWord(RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD, 32, RADIOLIB_PAGER_SYNC_MAX_ERRORS);
   }
 
   phyLayer->setDirectAction(PagerClientReadBit);
@@ -361,7 +361,7 @@ int16_t PagerClient::readData(uint8_t* data, size_t* len, uint32_t* addr) {
     }
 
     // check if it's the sync word
-    if(cw == RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD) {
+    if(rlb_popcount(cw ^ RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD) <= RADIOLIB_PAGER_SYNC_MAX_ERRORS) {
       framePos = 0;
       continue;
     }
@@ -408,7 +408,7 @@ int16_t PagerClient::readData(uint8_t* data, size_t* len, uint32_t* addr) {
     }
 
     // skip the sync words
-    if(cw == RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD) {
+    if(rlb_popcount(cw ^ RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD) <= RADIOLIB_PAGER_SYNC_MAX_ERRORS) {
       continue;
     }
 
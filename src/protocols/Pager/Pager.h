@@ -20,6 +20,11 @@
 #define RADIOLIB_PAGER_FRAME_SYNC_CODE_WORD                     (0x7CD215D8)
 #define RADIOLIB_PAGER_IDLE_CODE_WORD                           (0x7A89C197)
 
+// number of bit errors accepted in the frame sync code word
+#if !defined(RADIOLIB_PAGER_SYNC_MAX_ERRORS)
+  #define RADIOLIB_PAGER_SYNC_MAX_ERRORS                        (2)
+#endif
+
 // code word type identification flags
 #define RADIOLIB_PAGER_ADDRESS_CODE_WORD                        (0UL)
 #define RADIOLIB_PAGER_MESSAGE_CODE_WORD                        (1UL)
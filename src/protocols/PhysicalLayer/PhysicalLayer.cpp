@@ -2,15 +2,93 @@
 
 #include <string.h>
 
+// buffers shared with interrupts must be written before their write position is, and read before their read position is
+#if defined(__GNUC__)
+  #define RADIOLIB_MEMORY_FENCE()         __sync_synchronize()
+#else
+  #define RADIOLIB_MEMORY_FENCE()
+#endif
+
+#if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
+#define RADIOLIB_DIRECT_BUFFER_MASK       (RADIOLIB_DIRECT_BUFFER_SIZE - 1)
+#endif
+
+// the radio interrupt has no context, so each radio with a timestamped action
+// gets one of a fixed number of global-scope ISRs, which captures the time before calling the user action
+#if RADIOLIB_LORAWAN_THREAD_LOCAL
+  #define RADIOLIB_IRQ_TIME_STATE         static thread_local
+#else
+  #define RADIOLIB_IRQ_TIME_STATE         static
+#endif
+
+struct IrqTimeSlot_t {
+  PhysicalLayer* volatile radio;
+  RadioLibIrqType_t event;
+  void (*action)(void);
+};
+
+RADIOLIB_IRQ_TIME_STATE IrqTimeSlot_t irqTimeSlots[RADIOLIB_IRQ_TIME_NUM_RADIOS];
+
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+static void PhysicalLayerTimestampedAction(uint8_t slot) {
+  IrqTimeSlot_t* entry = &irqTimeSlots[slot];
+  if(!entry->radio) {
+    return;
+  }
+  entry->radio->captureIrqTime(entry->event);
+  if(entry->action) {
+    entry->action();
+  }
+}
+
+template<uint8_t N>
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+static void PhysicalLayerTimestampedSlot(void) {
+  PhysicalLayerTimestampedAction(N);
+}
+
+static void (* const irqTimeSlotActions[RADIOLIB_IRQ_TIME_NUM_RADIOS])(void) = {
+  PhysicalLayerTimestampedSlot<0>,
+  PhysicalLayerTimestampedSlot<1>,
+  PhysicalLayerTimestampedSlot<2>,
+  PhysicalLayerTimestampedSlot<3>,
+};
+
+#if RADIOLIB_RX_QUEUE_LEN
+// global-scope ISR for the receive queue, same approach as the Pager bit reading
+static PhysicalLayer* rxQueueInstance = NULL;
+
+#if defined(ESP8266) || defined(ESP32)
+  IRAM_ATTR
+#endif
+static void PhysicalLayerQueueReceived(void) {
+  if(rxQueueInstance) {
+    rxQueueInstance->queueReceived();
+  }
+}
+#endif
+
 PhysicalLayer::PhysicalLayer() {
   this->freqStep = 1;
   this->maxPacketLength = 1;
   #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
   this->bufferBitPos = 0;
   this->bufferWritePos = 0;
+  this->bufferReadPos = 0;
   #endif
 }
 
+PhysicalLayer::~PhysicalLayer() {
+  // the slot must not point to a radio that no longer exists
+  if(this->irqTimeSlot >= 0) {
+    irqTimeSlots[this->irqTimeSlot].radio = NULL;
+  }
+}
+
 #if defined(RADIOLIB_BUILD_ARDUINO)
 int16_t PhysicalLayer::transmit(__FlashStringHelper* fstr, uint8_t addr) {
   // read flash string length
@@ -115,6 +193,69 @@ int16_t PhysicalLayer::receive(uint8_t* data, size_t len, RadioLibTime_t timeout
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+int16_t PhysicalLayer::transmitReceive(const uint8_t* txData, size_t txLen, uint8_t* rxData, size_t rxLen, RadioLibTime_t timeout, RadioLibTime_t* turnaround) {
+  if(!txData || !rxData) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+
+  // prepare everything for the reception up front, so that only the mode switch remains after transmission
+  RadioModeConfig_t cfg = {
+    .receive = {
+      .timeout = (uint32_t)this->calculateRxTimeout(timeout),
+      .irqFlags = RADIOLIB_IRQ_RX_DEFAULT_FLAGS,
+      .irqMask = RADIOLIB_IRQ_RX_DEFAULT_MASK,
+      .len = rxLen,
+    }
+  };
+  // 5 ms + 500 % of the expected time-on-air, same as the blocking transmit of the drivers
+  RadioLibTime_t txTimeout = 5000 + this->getTimeOnAir(txLen)*5;
+  Module* mod = this->getMod();
+
+  // radios without the option switch through standby
+  int16_t state = this->setFastTurnaround(true);
+  bool fast = (state == RADIOLIB_ERR_NONE);
+  if(!fast && (state != RADIOLIB_ERR_UNSUPPORTED)) {
+    return(state);
+  }
+
+  state = this->startTransmit(txData, txLen);
+  if((state == RADIOLIB_ERR_NONE) && !this->waitForIrq(txTimeout)) {
+    state = RADIOLIB_ERR_TX_TIMEOUT;
+  }
+
+  // the receiver is started right away, the transmission done flag is cleared by stageMode
+  RadioLibTime_t txDone = mod->hal->micros();
+  if((state == RADIOLIB_ERR_NONE) && !fast) {
+    state = this->finishTransmit();
+  }
+  if(state == RADIOLIB_ERR_NONE) {
+    state = this->stageMode(RADIOLIB_RADIO_MODE_RX, &cfg);
+  }
+  if(state == RADIOLIB_ERR_NONE) {
+    state = this->launchMode();
+  }
+  if((state == RADIOLIB_ERR_NONE) && turnaround) {
+    *turnaround = mod->hal->micros() - txDone;
+  }
+
+  // the radio should time out on its own, this is just a safety check
+  bool received = (state == RADIOLIB_ERR_NONE) && this->waitForIrq(timeout + 10000);
+
+  // always disable the fast turnaround again, even if something failed
+  int16_t standbyState = this->standby();
+  if(fast) {
+    (void)this->setFastTurnaround(false);
+  }
+  RADIOLIB_ASSERT(state);
+  RADIOLIB_ASSERT(standbyState);
+
+  if(!received || (this->getIrqFlags() & this->irqMap[RADIOLIB_IRQ_TIMEOUT])) {
+    (void)this->finishReceive();
+    return(RADIOLIB_ERR_RX_TIMEOUT);
+  }
+  return(this->readData(rxData, rxLen));
+}
+
 int16_t PhysicalLayer::sleep() {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
@@ -228,6 +369,12 @@ int16_t PhysicalLayer::readData(uint8_t* data, size_t len) {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+int16_t PhysicalLayer::peekData(uint8_t* data, size_t len) {
+  (void)data;
+  (void)len;
+  return(RADIOLIB_ERR_UNSUPPORTED);
+}
+
 int16_t PhysicalLayer::transmitDirect(uint32_t frf) {
   (void)frf;
   return(RADIOLIB_ERR_UNSUPPORTED);
@@ -289,6 +436,12 @@ int16_t PhysicalLayer::setPreambleLength(size_t len) {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+int16_t PhysicalLayer::setLoRaHeader(size_t len, bool crc) {
+  (void)len;
+  (void)crc;
+  return(RADIOLIB_ERR_UNSUPPORTED);
+}
+
 int16_t PhysicalLayer::setDataRate(DataRate_t dr, ModemType_t modem) {
   (void)dr;
   (void)modem;
@@ -314,6 +467,10 @@ float PhysicalLayer::getSNR() {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+float PhysicalLayer::getFrequencyError() {
+  return(RADIOLIB_ERR_UNSUPPORTED);
+}
+
 RadioLibTime_t PhysicalLayer::calculateTimeOnAir(ModemType_t modem, DataRate_t dr, PacketConfig_t pc, size_t len) {
   (void)modem;
   (void)dr;
@@ -396,6 +553,74 @@ int16_t PhysicalLayer::scanChannel(const ChannelScanConfig_t &config) {
   return(RADIOLIB_ERR_UNSUPPORTED); 
 }
 
+int16_t PhysicalLayer::scanChannels(const ChannelScanTarget_t* targets, size_t num, uint32_t* busy, RadioLibTime_t* durations, uint16_t numScans) {
+  if(!targets || !busy) {
+    return(RADIOLIB_ERR_NULL_POINTER);
+  }
+  if((num > 32) || (numScans == 0)) {
+    return(RADIOLIB_ERR_INVALID_NUM_SAMPLES);
+  }
+
+  *busy = 0;
+  Module* mod = this->getMod();
+
+  // the first channel always has to be set up
+  bool retune = true;
+  bool changeRate = true;
+  int16_t state = RADIOLIB_ERR_NONE;
+  for(size_t i = 0; i < num; i++) {
+    RadioLibTime_t start = mod->hal->micros();
+    if(changeRate) {
+      state = this->setDataRate(targets[i].dr, targets[i].modem);
+      RADIOLIB_ASSERT(state);
+    }
+    if(retune) {
+      state = this->setFrequency(targets[i].freq);
+      RADIOLIB_ASSERT(state);
+    }
+
+    for(uint16_t scan = 0; scan < numScans; scan++) {
+      state = this->startChannelScan();
+      RADIOLIB_ASSERT(state);
+
+      // while the first scan runs, find out what has to change for the next channel
+      int16_t nextState = RADIOLIB_ERR_NONE;
+      if((scan == 0) && (i + 1 < num)) {
+        const ChannelScanTarget_t* next = &targets[i + 1];
+        retune = (next->freq != targets[i].freq);
+        changeRate = (next->modem != targets[i].modem) || (memcmp(&next->dr, &targets[i].dr, sizeof(DataRate_t)) != 0);
+        if(changeRate) {
+          nextState = this->checkDataRate(next->dr, next->modem);
+        }
+      }
+
+      // wait for channel activity detected or timeout
+      while(!mod->hal->digitalRead(mod->getIrq())) {
+        mod->hal->yield();
+      }
+
+      state = this->getChannelScanResult();
+      if((state == RADIOLIB_LORA_DETECTED) || (state == RADIOLIB_PREAMBLE_DETECTED)) {
+        *busy |= (1UL << i);
+      } else if(state != RADIOLIB_CHANNEL_FREE) {
+        return(state);
+      }
+      RADIOLIB_ASSERT(nextState);
+
+      // no need to keep scanning a busy channel
+      if(*busy & (1UL << i)) {
+        break;
+      }
+    }
+
+    if(durations) {
+      durations[i] = mod->hal->micros() - start;
+    }
+  }
+
+  return(this->standby());
+}
+
 int32_t PhysicalLayer::random(int32_t max) {
   if(max == 0) {
     return(0);
@@ -443,13 +668,43 @@ int16_t PhysicalLayer::startDirect() {
 
 #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
 int16_t PhysicalLayer::available() {
-  return(this->bufferWritePos);
+  return((int16_t)((this->bufferWritePos - this->bufferReadPos) & RADIOLIB_DIRECT_BUFFER_MASK));
+}
+
+size_t PhysicalLayer::peekDirect(const uint8_t** data) {
+  RadioLibDirectIndex_t readPos = this->bufferReadPos;
+  RadioLibDirectIndex_t writePos = this->bufferWritePos;
+  RADIOLIB_MEMORY_FENCE();
+  if(data) {
+    *data = &this->buffer[readPos];
+  }
+
+  // stop at the end of the buffer, the rest is at its start
+  if(writePos >= readPos) {
+    return(writePos - readPos);
+  }
+  return(RADIOLIB_DIRECT_BUFFER_SIZE - readPos);
+}
+
+void PhysicalLayer::consumeDirect(size_t len) {
+  size_t num = (size_t)this->available();
+  if(len > num) {
+    len = num;
+  }
+  RADIOLIB_MEMORY_FENCE();
+  this->bufferReadPos = (this->bufferReadPos + len) & RADIOLIB_DIRECT_BUFFER_MASK;
+}
+
+uint32_t PhysicalLayer::getDirectOverruns() {
+  return(this->bufferOverruns);
 }
 
 void PhysicalLayer::dropSync() {
   if(this->directSyncWordLen > 0) {
     this->gotSync = false;
     this->syncBuffer = 0;
+    this->syncBufferLen = 0;
+    this->directSyncMatch = -1;
   }
 }
 
@@ -457,17 +712,28 @@ uint8_t PhysicalLayer::read(bool drop) {
   if(drop) {
     dropSync();
   }
-  this->bufferWritePos--;
-  return(this->buffer[this->bufferReadPos++]);
+
+  const uint8_t* data = NULL;
+  if(this->peekDirect(&data) == 0) {
+    return(0);
+  }
+  uint8_t b = *data;
+  this->consumeDirect(1);
+  return(b);
 }
 
-int16_t PhysicalLayer::setDirectSyncWord(uint32_t syncWord, uint8_t len) {
-  if(len > 32) {
+int16_t PhysicalLayer::setDirectSyncWord(uint32_t syncWord, uint8_t len, uint8_t maxErrors) {
+  // with too many accepted errors, random data would match
+  if((len > 32) || (maxErrors*4 >= RADIOLIB_MAX(len, 1))) {
     return(RADIOLIB_ERR_INVALID_SYNC_WORD);
   }
-  this->directSyncWordMask = 0xFFFFFFFF >> (32 - len);
+  this->directSyncWordMask = (len == 0) ? 0 : (0xFFFFFFFF >> (32 - len));
   this->directSyncWordLen = len;
-  this->directSyncWord = syncWord;
+  this->directSyncMaxErrors = maxErrors;
+  this->directSyncWords[0] = syncWord & this->directSyncWordMask;
+  this->directSyncWordsNum = 1;
+  this->directSyncMatch = -1;
+  this->syncBufferLen = 0;
 
   // override sync word matching when length is set to 0
   if(this->directSyncWordLen == 0) {
@@ -477,6 +743,21 @@ int16_t PhysicalLayer::setDirectSyncWord(uint32_t syncWord, uint8_t len) {
   return(RADIOLIB_ERR_NONE);
 }
 
+int16_t PhysicalLayer::addDirectSyncWord(uint32_t syncWord) {
+  if((this->directSyncWordLen == 0) || (this->directSyncWordsNum >= RADIOLIB_DIRECT_SYNC_WORDS_NUM)) {
+    return(RADIOLIB_ERR_INVALID_SYNC_WORD);
+  }
+  this->directSyncWords[this->directSyncWordsNum++] = syncWord & this->directSyncWordMask;
+  return(RADIOLIB_ERR_NONE);
+}
+
+int8_t PhysicalLayer::getDirectSyncMatch(uint8_t* errors) {
+  if(errors) {
+    *errors = this->directSyncErrors;
+  }
+  return(this->directSyncMatch);
+}
+
 void PhysicalLayer::updateDirectBuffer(uint8_t bit) {
   // check sync word
   if(!this->gotSync) {
@@ -485,33 +766,179 @@ void PhysicalLayer::updateDirectBuffer(uint8_t bit) {
 
     RADIOLIB_DEBUG_PROTOCOL_PRINTLN("S\t%lu", (long unsigned int)this->syncBuffer);
 
-    if((this->syncBuffer & this->directSyncWordMask) == this->directSyncWord) {
+    // only a full sync word can be matched, otherwise the initial zeros could pass with errors
+    if(this->syncBufferLen < this->directSyncWordLen) {
+      this->syncBufferLen++;
+      if(this->syncBufferLen < this->directSyncWordLen) {
+        return;
+      }
+    }
+
+    // correlate with all sync words, the bit errors are the ones set in the difference
+    uint32_t rx = this->syncBuffer & this->directSyncWordMask;
+    for(uint8_t i = 0; i < this->directSyncWordsNum; i++) {
+      uint32_t diff = rx ^ this->directSyncWords[i];
+      if(diff && ((this->directSyncMaxErrors == 0) || (rlb_popcount(diff) > this->directSyncMaxErrors))) {
+        continue;
+      }
+
       this->gotSync = true;
-      this->bufferWritePos = 0;
-      this->bufferReadPos = 0;
+      this->directSyncMatch = i;
+      this->directSyncErrors = diff ? rlb_popcount(diff) : 0;
+
+      // the frame starts on a new byte, bytes of earlier frames are kept until they are read
       this->bufferBitPos = 0;
+      break;
     }
 
   } else {
-    // save the bit
-    if(bit) {
-      this->buffer[this->bufferWritePos] |= 0x01 << this->bufferBitPos;
-    } else {
-      this->buffer[this->bufferWritePos] &= ~(0x01 << this->bufferBitPos);
-    }
+    // save the bit, MSB first
+    this->bufferByte = (this->bufferByte << 1) | (bit ? 0x01 : 0x00);
     this->bufferBitPos++;
 
     // check complete byte
     if(this->bufferBitPos == 8) {
-      this->buffer[this->bufferWritePos] = rlb_reflect(this->buffer[this->bufferWritePos], 8);
-      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("R\t%X", this->buffer[this->bufferWritePos]);
-
-      this->bufferWritePos++;
+      RADIOLIB_DEBUG_PROTOCOL_PRINTLN("R\t%X", this->bufferByte);
       this->bufferBitPos = 0;
+
+      // drop the byte if the reader did not keep up
+      RadioLibDirectIndex_t writePos = this->bufferWritePos;
+      RadioLibDirectIndex_t next = (writePos + 1) & RADIOLIB_DIRECT_BUFFER_MASK;
+      if(next == this->bufferReadPos) {
+        this->bufferOverruns = this->bufferOverruns + 1;
+        return;
+      }
+      this->buffer[writePos] = this->bufferByte;
+      RADIOLIB_MEMORY_FENCE();
+      this->bufferWritePos = next;
     }
   }
 }
 
+#if RADIOLIB_RX_QUEUE_LEN
+int16_t PhysicalLayer::startReceiveQueued() {
+  rxQueueInstance = this;
+  this->setPacketReceivedAction(PhysicalLayerQueueReceived);
+  return(this->startReceive());
+}
+
+void PhysicalLayer::stopReceiveQueued() {
+  this->clearPacketReceivedAction();
+  if(rxQueueInstance == this) {
+    rxQueueInstance = NULL;
+  }
+  (void)this->standby();
+}
+
+void PhysicalLayer::queueReceived() {
+  this->captureIrqTime(RADIOLIB_IRQ_RX_DONE);
+  RadioLibTime_t timestamp = this->irqTimes[RADIOLIB_IRQ_RX_DONE];
+  size_t len = this->getPacketLength();
+
+  // drop the packet if there is no entry or not enough pool space for it, or if it could not be read
+  uint8_t writePos = this->rxQueueWrite;
+  uint8_t next = (writePos + 1) % (RADIOLIB_RX_QUEUE_LEN + 1);
+  size_t offset = 0;
+  if((next == this->rxQueueRead) || !this->rxPoolAlloc(len, &offset)) {
+    this->rxQueueDrops = this->rxQueueDrops + 1;
+    (void)this->finishReceive();
+
+  } else if(this->readData(&this->rxPool[offset], len) != RADIOLIB_ERR_NONE) {
+    this->rxQueueDrops = this->rxQueueDrops + 1;
+
+  } else {
+    RxQueueEntry_t* entry = &this->rxQueue[writePos];
+    entry->offset = offset;
+    entry->info.len = len;
+    entry->info.rssi = this->getRSSI();
+    entry->info.snr = this->getSNR();
+    entry->info.freqError = this->getFrequencyError();
+    entry->info.timestamp = timestamp;
+    this->rxPoolHead = offset + len;
+    RADIOLIB_MEMORY_FENCE();
+    this->rxQueueWrite = next;
+  }
+
+  (void)this->startReceive();
+}
+
+size_t PhysicalLayer::getNumQueued() {
+  return((this->rxQueueWrite + (RADIOLIB_RX_QUEUE_LEN + 1) - this->rxQueueRead) % (RADIOLIB_RX_QUEUE_LEN + 1));
+}
+
+int16_t PhysicalLayer::readQueued(uint8_t* data, size_t len, RadioLibPacketInfo_t* info) {
+  uint8_t readPos = this->rxQueueRead;
+  if(readPos == this->rxQueueWrite) {
+    return(RADIOLIB_ERR_QUEUE_EMPTY);
+  }
+  RADIOLIB_MEMORY_FENCE();
+
+  const RxQueueEntry_t* entry = &this->rxQueue[readPos];
+  if(data) {
+    memcpy(data, &this->rxPool[entry->offset], RADIOLIB_MIN(len, entry->info.len));
+  }
+  if(info) {
+    memcpy(info, &entry->info, sizeof(RadioLibPacketInfo_t));
+  }
+
+  // only now the entry and its pool space can be reused
+  RADIOLIB_MEMORY_FENCE();
+  this->rxQueueRead = (readPos + 1) % (RADIOLIB_RX_QUEUE_LEN + 1);
+  return(RADIOLIB_ERR_NONE);
+}
+
+uint32_t PhysicalLayer::getQueueDrops() {
+  return(this->rxQueueDrops);
+}
+
+bool PhysicalLayer::rxPoolAlloc(size_t len, size_t* offset) {
+  if(len > RADIOLIB_RX_QUEUE_POOL_SIZE) {
+    return(false);
+  }
+
+  // an empty queue leaves the whole pool free
+  uint8_t readPos = this->rxQueueRead;
+  if(readPos == this->rxQueueWrite) {
+    *offset = 0;
+    return(true);
+  }
+
+  // the pool is used from the oldest packet (tail) to the end of the newest one (head)
+  size_t tail = this->rxQueue[readPos].offset;
+  size_t head = this->rxPoolHead;
+  if(len == 0) {
+    *offset = head;
+    return(true);
+  }
+  if(head > tail) {
+    if(RADIOLIB_RX_QUEUE_POOL_SIZE - head >= len) {
+      *offset = head;
+      return(true);
+    }
+    if(tail >= len) {
+      *offset = 0;
+      return(true);
+    }
+  } else if((head < tail) && (tail - head >= len)) {
+    *offset = head;
+    return(true);
+  }
+  return(false);
+}
+#endif
+
+bool PhysicalLayer::waitForIrq(RadioLibTime_t timeout) {
+  Module* mod = this->getMod();
+  RadioLibTime_t start = mod->hal->micros();
+  while(!mod->hal->digitalRead(mod->getIrq())) {
+    mod->hal->yield();
+    if(mod->hal->micros() - start > timeout) {
+      return(false);
+    }
+  }
+  return(true);
+}
+
 void PhysicalLayer::setDirectAction(void (*func)(void)) {
   (void)func;
 }
@@ -557,6 +984,74 @@ void PhysicalLayer::clearChannelScanAction() {
   
 }
 
+void PhysicalLayer::captureIrqTime(RadioLibIrqType_t irq) {
+  if(irq > RADIOLIB_IRQ_TIMEOUT) {
+    return;
+  }
+  this->irqTimes[irq] = this->getMod()->hal->irqMicros();
+}
+
+RadioLibTime_t PhysicalLayer::getIrqTime(RadioLibIrqType_t irq) {
+  if(irq > RADIOLIB_IRQ_TIMEOUT) {
+    return(0);
+  }
+  return(this->irqTimes[irq]);
+}
+
+void PhysicalLayer::setTimestampedAction(RadioLibIrqType_t irq, void (*func)(void)) {
+  // a radio keeps its slot until the action is cleared
+  if(this->irqTimeSlot < 0) {
+    for(int8_t i = 0; i < RADIOLIB_IRQ_TIME_NUM_RADIOS; i++) {
+      if(!irqTimeSlots[i].radio) {
+        this->irqTimeSlot = i;
+        break;
+      }
+    }
+  }
+
+  // without a free slot, the time can not be captured, but the action is still called
+  void (*action)(void) = func;
+  if(this->irqTimeSlot >= 0) {
+    IrqTimeSlot_t* entry = &irqTimeSlots[this->irqTimeSlot];
+    entry->radio = NULL;
+    entry->event = irq;
+    entry->action = func;
+    entry->radio = this;
+    action = irqTimeSlotActions[this->irqTimeSlot];
+  } else {
+    RADIOLIB_DEBUG_BASIC_PRINTLN("No free timestamped action slot");
+  }
+
+  this->irqTimeEvent = irq;
+  if(!action) {
+    this->clearTimestampedAction();
+    return;
+  }
+  if(irq == RADIOLIB_IRQ_TX_DONE) {
+    this->setPacketSentAction(action);
+  } else if((irq == RADIOLIB_IRQ_CAD_DONE) || (irq == RADIOLIB_IRQ_CAD_DETECTED)) {
+    this->setChannelScanAction(action);
+  } else {
+    this->setPacketReceivedAction(action);
+  }
+}
+
+void PhysicalLayer::clearTimestampedAction() {
+  if(this->irqTimeEvent == RADIOLIB_IRQ_TX_DONE) {
+    this->clearPacketSentAction();
+  } else if((this->irqTimeEvent == RADIOLIB_IRQ_CAD_DONE) || (this->irqTimeEvent == RADIOLIB_IRQ_CAD_DETECTED)) {
+    this->clearChannelScanAction();
+  } else {
+    this->clearPacketReceivedAction();
+  }
+
+  // free the slot for other radios
+  if(this->irqTimeSlot >= 0) {
+    irqTimeSlots[this->irqTimeSlot].radio = NULL;
+    this->irqTimeSlot = -1;
+  }
+}
+
 int16_t PhysicalLayer::setModem(ModemType_t modem) {
   (void)modem;
   return(RADIOLIB_ERR_UNSUPPORTED);
@@ -577,6 +1072,94 @@ int16_t PhysicalLayer::launchMode() {
   return(RADIOLIB_ERR_UNSUPPORTED);
 }
 
+int16_t PhysicalLayer::setFastTurnaround(bool enable) {
+  (void)enable;
+  return(RADIOLIB_ERR_UNSUPPORTED);
+}
+
+int16_t PhysicalLayer::scheduleTransmit(const uint8_t* data, size_t len, RadioLibTime_t start, uint8_t addr) {
+  RadioModeConfig_t cfg = {
+    .transmit = {
+      .data = data,
+      .len = len,
+      .addr = addr,
+    }
+  };
+
+  this->txScheduled = false;
+  int16_t state = this->stageMode(RADIOLIB_RADIO_MODE_TX, &cfg);
+  RADIOLIB_ASSERT(state);
+  this->txScheduleStart = start;
+  this->txScheduled = true;
+  return(state);
+}
+
+RadioLibTime_t PhysicalLayer::getTimeUntilScheduled() {
+  if(!this->isTxScheduled()) {
+    return(0);
+  }
+
+  // the launch command itself takes time, so it has to be sent early
+  // the difference wraps around together with micros(), so more than half of the range ahead means the deadline passed
+  RadioLibTime_t launch = this->txScheduleStart - this->txJitter.latency;
+  RadioLibTime_t remaining = launch - this->getMod()->hal->micros();
+  if(remaining > ((RadioLibTime_t)-1) / 2) {
+    return(0);
+  }
+  return(remaining);
+}
+
+bool PhysicalLayer::isTxScheduled() {
+  // staging another mode replaces the scheduled transmission
+  if(this->stagedMode != RADIOLIB_RADIO_MODE_TX) {
+    this->txScheduled = false;
+  }
+  return(this->txScheduled);
+}
+
+int16_t PhysicalLayer::launchScheduled(bool wait) {
+  if(!this->isTxScheduled()) {
+    return(RADIOLIB_ERR_TX_NOT_SCHEDULED);
+  }
+
+  if(wait) {
+    Module* mod = this->getMod();
+    while(this->getTimeUntilScheduled() > 0) {
+      mod->hal->yield();
+    }
+  }
+
+  // the transmission starts once the launch command was sent
+  Module* mod = this->getMod();
+  this->txScheduled = false;
+  RadioLibTime_t launchStart = mod->hal->micros();
+  int16_t state = this->launchMode();
+  RadioLibTime_t launchEnd = mod->hal->micros();
+  RADIOLIB_ASSERT(state);
+
+  int32_t jitter = (int32_t)(launchEnd - this->txScheduleStart);
+  this->txJitter.latency = launchEnd - launchStart;
+  this->txJitter.last = jitter;
+  if((this->txJitter.count == 0) || (jitter < this->txJitter.min)) {
+    this->txJitter.min = jitter;
+  }
+  if((this->txJitter.count == 0) || (jitter > this->txJitter.max)) {
+    this->txJitter.max = jitter;
+  }
+  this->txJitter.count++;
+  return(state);
+}
+
+RadioLibTxJitter_t PhysicalLayer::getTxJitter() {
+  return(this->txJitter);
+}
+
+void PhysicalLayer::resetTxJitter() {
+  RadioLibTime_t latency = this->txJitter.latency;
+  memset(&this->txJitter, 0, sizeof(RadioLibTxJitter_t));
+  this->txJitter.latency = latency;
+}
+
 #if RADIOLIB_INTERRUPT_TIMING
 void PhysicalLayer::setInterruptSetup(void (*func)(uint32_t)) {
   Module* mod = getMod();
@@ -25,6 +25,24 @@ enum RadioLibIrqType_t {
 #define RADIOLIB_IRQ_CAD_DEFAULT_FLAGS      ((1UL << RADIOLIB_IRQ_CAD_DETECTED) | (1UL << RADIOLIB_IRQ_CAD_DONE))
 #define RADIOLIB_IRQ_CAD_DEFAULT_MASK       ((1UL << RADIOLIB_IRQ_CAD_DETECTED) | (1UL << RADIOLIB_IRQ_CAD_DONE))
 
+// number of radios that can have a timestamped action attached at the same time
+#define RADIOLIB_IRQ_TIME_NUM_RADIOS        (4)
+
+#if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
+#if (RADIOLIB_DIRECT_BUFFER_SIZE < 2) || ((RADIOLIB_DIRECT_BUFFER_SIZE & (RADIOLIB_DIRECT_BUFFER_SIZE - 1)) != 0)
+  #error "RADIOLIB_DIRECT_BUFFER_SIZE must be a power of 2"
+#endif
+
+// positions in the direct mode buffer are kept in the smallest type, so that they can be read in a single access
+#if RADIOLIB_DIRECT_BUFFER_SIZE <= 256
+typedef uint8_t RadioLibDirectIndex_t;
+#elif RADIOLIB_DIRECT_BUFFER_SIZE <= 65536
+typedef uint16_t RadioLibDirectIndex_t;
+#else
+typedef uint32_t RadioLibDirectIndex_t;
+#endif
+#endif
+
 /*!
   \struct LoRaRate_t
   \brief Data rate structure interpretation in case LoRa is used
@@ -170,6 +188,50 @@ union ChannelScanConfig_t {
   RSSIScanConfig_t rssi;
 };
 
+#if RADIOLIB_RX_QUEUE_LEN
+/*!
+  \struct RadioLibPacketInfo_t
+  \brief Details of a packet taken from the receive queue.
+*/
+struct RadioLibPacketInfo_t {
+  /*! \brief Packet length in bytes */
+  size_t len;
+
+  /*! \brief RSSI in dBm */
+  float rssi;
+
+  /*! \brief SNR in dB */
+  float snr;
+
+  /*! \brief Frequency error in Hz */
+  float freqError;
+
+  /*! \brief Time of the packet received interrupt, in microseconds */
+  RadioLibTime_t timestamp;
+};
+#endif
+
+/*!
+  \struct RadioLibTxJitter_t
+  \brief Timing of scheduled transmissions, as the difference between achieved and requested start.
+*/
+struct RadioLibTxJitter_t {
+  /*! \brief Jitter of the last scheduled transmission in microseconds, negative if it started early */
+  int32_t last;
+
+  /*! \brief Smallest jitter in microseconds */
+  int32_t min;
+
+  /*! \brief Largest jitter in microseconds */
+  int32_t max;
+
+  /*! \brief Number of scheduled transmissions */
+  uint32_t count;
+
+  /*! \brief Duration of the last launch command in microseconds, used to start the next one early */
+  RadioLibTime_t latency;
+};
+
 struct StandbyConfig_t {
   /*! \brief Module-specific standby mode configuration. */
   uint8_t mode;
@@ -246,6 +308,21 @@ enum RadioModeType_t {
   RADIOLIB_RADIO_MODE_SLEEP,
 };
 
+/*!
+  \struct ChannelScanTarget_t
+  \brief One channel of a batched channel scan, used by scanChannels.
+*/
+struct ChannelScanTarget_t {
+  /*! \brief Carrier frequency in MHz */
+  float freq;
+
+  /*! \brief Data rate to scan for */
+  DataRate_t dr;
+
+  /*! \brief Modem of the data rate, RADIOLIB_MODEM_NONE to use the active modem */
+  ModemType_t modem;
+};
+
 #define RADIOLIB_LORA_SYNC_WORD_PRIVATE                         (0x12UL << 0)   //  7     0     LoRa sync word: private network
 #define RADIOLIB_LORA_SYNC_WORD_PUBLIC                          (0x34UL << 0)   //  7     0                     public network (LoRaWAN)
 
@@ -413,7 +490,7 @@ class PhysicalLayer {
     /*!
       \brief Default destructor.
     */
-    virtual ~PhysicalLayer() = default;
+    virtual ~PhysicalLayer();
 
     // basic methods
 
@@ -510,6 +587,21 @@ class PhysicalLayer {
     */
     virtual int16_t receive(uint8_t* data, size_t len, RadioLibTime_t timeout = 0);
 
+    /*!
+      \brief Transmit a packet and start receiving as soon as it was sent, e.g. to catch an acknowledgement.
+      The reception is configured before transmitting. Radios that support it keep the frequency synthesizer
+      running after transmission (see setFastTurnaround), the others switch through standby. The radio is left in standby.
+      \param txData Binary data to transmit.
+      \param txLen Length of binary data to transmit (in bytes).
+      \param rxData Pointer to array to save the received binary data.
+      \param rxLen Number of bytes to read, 0 to read the complete packet.
+      \param timeout Reception timeout in microseconds, counted from the end of the transmission.
+      \param turnaround Optional pointer to save the time from the end of the transmission until the receiver
+      was started into, in microseconds.
+      \returns \ref status_codes, RADIOLIB_ERR_RX_TIMEOUT if nothing was received.
+    */
+    int16_t transmitReceive(const uint8_t* txData, size_t txLen, uint8_t* rxData, size_t rxLen, RadioLibTime_t timeout, RadioLibTime_t* turnaround = NULL);
+
     #if defined(RADIOLIB_BUILD_ARDUINO)
     /*!
       \brief Interrupt-driven Arduino String transmit method. Unlike the standard transmit method, this one is non-blocking.
@@ -571,6 +663,16 @@ class PhysicalLayer {
     */
     virtual int16_t readData(uint8_t* data, size_t len);
 
+    /*!
+      \brief Reads the start of a received packet without finishing the reception, readData can still be called
+      afterwards. Useful to check packet headers before reading the full packet. Must be implemented in module class.
+      \param data Pointer to array to save the received binary data.
+      \param len Number of bytes that will be read. When more bytes than received are requested,
+      only the received bytes will be read.
+      \returns \ref status_codes
+    */
+    virtual int16_t peekData(uint8_t* data, size_t len);
+
     /*!
       \brief Enables direct transmission mode on pins DIO1 (clock) and DIO2 (data). Must be implemented in module class.
       While in direct mode, the module will not be able to transmit or receive packets. Can only be activated in FSK mode.
@@ -660,6 +762,15 @@ class PhysicalLayer {
       \returns \ref status_codes
     */
     virtual int16_t setPreambleLength(size_t len);
+
+    /*!
+      \brief Set LoRa header mode and payload CRC, e.g. to receive LoRaWAN Class B beacons.
+      Must be implemented in module class if the module supports it.
+      \param len Payload length for implicit header mode, 0 to use explicit header mode.
+      \param crc Whether the payload CRC is enabled.
+      \returns \ref status_codes
+    */
+    virtual int16_t setLoRaHeader(size_t len, bool crc);
     
     /*!
       \brief Set data rate. Must be implemented in module class if the module supports it.
@@ -697,6 +808,12 @@ class PhysicalLayer {
       \returns SNR of the last received packet in dB.
     */
     virtual float getSNR();
+
+    /*!
+      \brief Gets frequency error of the last received packet.
+      \returns Frequency error in Hz.
+    */
+    virtual float getFrequencyError();
     
     /*!
       \brief Calculate the expected time-on-air for a given modem, data rate, packet configuration and payload size.
@@ -816,6 +933,19 @@ class PhysicalLayer {
     */
     virtual int16_t scanChannel(const ChannelScanConfig_t &config);
 
+    /*!
+      \brief Check a list of channels for activity. Frequency and data rate are only set when they differ
+      from the previous channel, and the next channel is prepared while the current scan runs.
+      Uses the default scan configuration of the module, the radio is left in standby.
+      \param targets Channels to scan, up to 32.
+      \param num Number of channels to scan.
+      \param busy Pointer to a bitmap to save the result into, bit N is set if activity was detected on channel N.
+      \param durations Optional array of num values to save the time spent on each channel into, in microseconds.
+      \param numScans Number of scans per channel, a channel is busy if any of them detects activity.
+      \returns \ref status_codes
+    */
+    int16_t scanChannels(const ChannelScanTarget_t* targets, size_t num, uint32_t* busy, RadioLibTime_t* durations = NULL, uint16_t numScans = 1);
+
     /*!
       \brief Get truly random number in range 0 - max.
       \param max The maximum value of the random number (non-inclusive).
@@ -847,11 +977,29 @@ class PhysicalLayer {
     #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
     /*!
       \brief Set sync word to be used to determine start of packet in direct reception mode.
+      Replaces all previously set sync words.
       \param syncWord Sync word bits.
       \param len Sync word length in bits. Set to zero to disable sync word matching.
+      \param maxErrors Number of bit errors that are still accepted as a match, must be less than a quarter of len.
+      Defaults to 0 (exact match).
+      \returns \ref status_codes
+    */
+    int16_t setDirectSyncWord(uint32_t syncWord, uint8_t len, uint8_t maxErrors = 0);
+
+    /*!
+      \brief Add another sync word to be searched for at the same time, e.g. the inverted sync word.
+      Length and number of accepted bit errors are the same as set by setDirectSyncWord.
+      \param syncWord Sync word bits.
       \returns \ref status_codes
     */
-    int16_t setDirectSyncWord(uint32_t syncWord, uint8_t len);
+    int16_t addDirectSyncWord(uint32_t syncWord);
+
+    /*!
+      \brief Get the sync word that was matched in direct reception mode.
+      \param errors Pointer to variable to save the number of bit errors in the matched sync word into, may be NULL.
+      \returns Index of the sync word in the order it was set, -1 if no sync word was matched.
+    */
+    int8_t getDirectSyncMatch(uint8_t* errors = NULL);
 
     /*!
       \brief Set interrupt service routine function to call when data bit is received in direct mode.
@@ -872,6 +1020,27 @@ class PhysicalLayer {
     */
     int16_t available();
 
+    /*!
+      \brief Get the received direct mode bytes without removing them from the buffer.
+      As the buffer wraps around, this may be only a part of the available bytes;
+      the rest follows once the returned bytes were released by consumeDirect.
+      \param data Will be set to point to the first received byte.
+      \returns Number of contiguous bytes at data.
+    */
+    size_t peekDirect(const uint8_t** data);
+
+    /*!
+      \brief Remove bytes from the direct mode buffer, after they were processed in place.
+      \param len Number of bytes to remove, at most the number returned by peekDirect.
+    */
+    void consumeDirect(size_t len);
+
+    /*!
+      \brief Get the number of direct mode bytes lost because the buffer was full.
+      \returns Number of lost bytes since the start.
+    */
+    uint32_t getDirectOverruns();
+
     /*!
       \brief Forcefully drop synchronization.
     */
@@ -909,6 +1078,50 @@ class PhysicalLayer {
     */
     virtual void clearPacketReceivedAction();
 
+    #if RADIOLIB_RX_QUEUE_LEN
+    /*!
+      \brief Start receiving into the receive queue. Each received packet is read from the radio in the packet received
+      interrupt, and reception is restarted with startReceive(). Only one radio can use the receive queue this way;
+      others can call queueReceived from their own packet received interrupt.
+      The platform must allow SPI transfers in interrupts.
+      \returns \ref status_codes
+    */
+    int16_t startReceiveQueued();
+
+    /*!
+      \brief Stop receiving into the receive queue. Packets that were already queued can still be read.
+    */
+    void stopReceiveQueued();
+
+    /*!
+      \brief Read the received packet from the radio into the receive queue and restart reception.
+      Must be called from the packet received interrupt.
+    */
+    void queueReceived();
+
+    /*!
+      \brief Get the number of packets in the receive queue.
+      \returns Number of packets.
+    */
+    size_t getNumQueued();
+
+    /*!
+      \brief Take the oldest packet from the receive queue.
+      \param data Buffer to save the packet into.
+      \param len Size of the buffer. Longer packets are truncated, info contains the full length.
+      \param info Optional packet details.
+      \returns \ref status_codes, RADIOLIB_ERR_QUEUE_EMPTY if there is no packet.
+    */
+    int16_t readQueued(uint8_t* data, size_t len, RadioLibPacketInfo_t* info = NULL);
+
+    /*!
+      \brief Get the number of packets that were dropped because the receive queue was full,
+      or because they could not be read from the radio (e.g. CRC mismatch).
+      \returns Number of dropped packets since the start.
+    */
+    uint32_t getQueueDrops();
+    #endif
+
     /*!
       \brief Sets interrupt service routine to call when a packet is sent.
       \param func ISR to call.
@@ -931,6 +1144,37 @@ class PhysicalLayer {
     */
     virtual void clearChannelScanAction();
 
+    /*!
+      \brief Capture the time of a radio interrupt using RadioLibHal::irqMicros.
+      Intended to be called first thing in the interrupt service routine.
+      \param irq Event that the interrupt signals, up to RADIOLIB_IRQ_TIMEOUT.
+    */
+    void captureIrqTime(RadioLibIrqType_t irq);
+
+    /*!
+      \brief Get the captured time of a radio interrupt.
+      \param irq Event to get the time of, up to RADIOLIB_IRQ_TIMEOUT.
+      \returns Time in microseconds, 0 if the event was not captured yet.
+    */
+    RadioLibTime_t getIrqTime(RadioLibIrqType_t irq);
+
+    /*!
+      \brief Set interrupt service routine that is called after the time of the interrupt was captured.
+      Replaces the packet sent, packet received or channel scan action, depending on the event.
+      Up to RADIOLIB_IRQ_TIME_NUM_RADIOS radios can use this at the same time, each one until it calls clearTimestampedAction.
+      If all are in use, the ISR is attached without capturing the time.
+      \param irq Event that the interrupt signals in the next operation, e.g. RADIOLIB_IRQ_RX_DONE,
+      or RADIOLIB_IRQ_PREAMBLE_DETECTED if that is the IRQ mask passed to startReceive.
+      \param func ISR to call after the time was captured, may be NULL.
+    */
+    void setTimestampedAction(RadioLibIrqType_t irq, void (*func)(void));
+
+    /*!
+      \brief Clear the interrupt service routine set by setTimestampedAction,
+      so that other radios can use timestamped actions.
+    */
+    void clearTimestampedAction();
+
     /*!
       \brief Set modem for the radio to use. Will perform full reset and reconfigure the radio
       using its default parameters.
@@ -960,6 +1204,54 @@ class PhysicalLayer {
     */
     virtual int16_t launchMode();
 
+    /*!
+      \brief Keep the frequency synthesizer running after transmission or reception, instead of falling back
+      to standby. Used by transmitReceive, while enabled the receiver is started without going through standby.
+      \param enable Whether to keep the synthesizer running.
+      \returns \ref status_codes, RADIOLIB_ERR_UNSUPPORTED if the radio has no such option.
+    */
+    virtual int16_t setFastTurnaround(bool enable);
+
+    /*!
+      \brief Prepare a transmission to start at a given time. The payload and configuration are written
+      to the radio now using stageMode, so that only the launch command remains at the deadline.
+      A newly scheduled transmission replaces the previous one.
+      \param data Binary data that will be transmitted, only needs to be valid until this method returns.
+      \param len Length of binary data to transmit (in bytes).
+      Staging another mode with stageMode cancels the scheduled transmission.
+      \param start Requested start of the transmission, in microseconds of RadioLibHal::micros.
+      Must be less than half the range of RadioLibTime_t ahead (about 35 minutes where it is 32 bits wide),
+      deadlines further ahead are taken as already passed.
+      \param addr Node address to transmit the packet to. Only used in FSK mode.
+      \returns \ref status_codes
+    */
+    int16_t scheduleTransmit(const uint8_t* data, size_t len, RadioLibTime_t start, uint8_t addr = 0);
+
+    /*!
+      \brief Get the time left until the scheduled transmission has to be launched.
+      Can be used to set up a timer which then calls launchScheduled.
+      \returns Time in microseconds, 0 if the launch is due or nothing is scheduled.
+    */
+    RadioLibTime_t getTimeUntilScheduled();
+
+    /*!
+      \brief Launch the scheduled transmission.
+      \param wait Whether to busy-wait until the launch is due. If false, it is launched immediately.
+      \returns \ref status_codes, RADIOLIB_ERR_TX_NOT_SCHEDULED if no transmission is scheduled.
+    */
+    int16_t launchScheduled(bool wait = true);
+
+    /*!
+      \brief Get the timing of scheduled transmissions.
+      \returns Start time jitter since the last reset.
+    */
+    RadioLibTxJitter_t getTxJitter();
+
+    /*!
+      \brief Reset the statistics of scheduled transmissions. The measured launch latency is kept.
+    */
+    void resetTxJitter();
+
     #if RADIOLIB_INTERRUPT_TIMING
 
     /*!
@@ -1011,19 +1303,64 @@ class PhysicalLayer {
 #endif
 
     #if !RADIOLIB_EXCLUDE_DIRECT_RECEIVE
+    // the buffer is a single-producer, single-consumer ring: the write position
+    // is only changed by updateDirectBuffer (in interrupt), the read position only by the reader
     uint8_t bufferBitPos = 0;
-    uint8_t bufferWritePos = 0;
-    uint8_t bufferReadPos = 0;
-    uint8_t buffer[RADIOLIB_STATIC_ARRAY_SIZE] = { 0 };
+    uint8_t bufferByte = 0;
+    volatile RadioLibDirectIndex_t bufferWritePos = 0;
+    volatile RadioLibDirectIndex_t bufferReadPos = 0;
+    volatile uint32_t bufferOverruns = 0;
+    uint8_t buffer[RADIOLIB_DIRECT_BUFFER_SIZE] = { 0 };
     uint32_t syncBuffer = 0;
-    uint32_t directSyncWord = 0;
+    uint8_t syncBufferLen = 0;
+    uint32_t directSyncWords[RADIOLIB_DIRECT_SYNC_WORDS_NUM] = { 0 };
+    uint8_t directSyncWordsNum = 0;
     uint8_t directSyncWordLen = 0;
     uint32_t directSyncWordMask = 0;
+    uint8_t directSyncMaxErrors = 0;
+    int8_t directSyncMatch = -1;
+    uint8_t directSyncErrors = 0;
     bool gotSync = false;
     #endif
 
+    // captured interrupt times
+    volatile RadioLibTime_t irqTimes[RADIOLIB_IRQ_TIMEOUT + 1] = { 0 };
+
+    // event of the timestamped action, and the global ISR slot it is dispatched from (-1 if none)
+    RadioLibIrqType_t irqTimeEvent = RADIOLIB_IRQ_RX_DONE;
+    int8_t irqTimeSlot = -1;
+
+    // scheduled transmission, only valid while the staged mode is still the transmission
+    bool txScheduled = false;
+    RadioLibTime_t txScheduleStart = 0;
+    RadioLibTxJitter_t txJitter = { 0, 0, 0, 0, 0 };
+
+    #if RADIOLIB_RX_QUEUE_LEN
+    // the receive queue is filled in interrupt and read by the application: the write position
+    // and the pool are only changed by queueReceived, the read position only by readQueued
+    struct RxQueueEntry_t {
+      RadioLibPacketInfo_t info;
+      size_t offset;
+    };
+    RxQueueEntry_t rxQueue[RADIOLIB_RX_QUEUE_LEN + 1];
+    volatile uint8_t rxQueueWrite = 0;
+    volatile uint8_t rxQueueRead = 0;
+    volatile uint32_t rxQueueDrops = 0;
+    size_t rxPoolHead = 0;
+    uint8_t rxPool[RADIOLIB_RX_QUEUE_POOL_SIZE];
+
+    // find a contiguous free area of the payload pool, which is used in queue order
+    bool rxPoolAlloc(size_t len, size_t* offset);
+    #endif
+
     virtual Module* getMod() = 0;
 
+    // poll the interrupt pin, false on timeout
+    bool waitForIrq(RadioLibTime_t timeout);
+
+    // check whether the scheduled transmission is still staged
+    bool isTxScheduled();
+
     // allow specific classes access the private getMod method
     friend class AFSKClient;
     friend class RTTYClient;
@@ -1036,7 +1373,9 @@ class PhysicalLayer {
     friend class BellClient;
     friend class FT8Client;
     friend class LoRaWANNode;
+    friend class LoRaWANPackageTS005;
     friend class M17Client;
+    friend class SX126xSpectrumSweep;
 };
 
 #endif
@@ -113,6 +113,18 @@ bool RadioLibAES128::verifyCMAC(const uint8_t* in, size_t len, const uint8_t* cm
   return(true);
 }
 
+void RadioLibAES128::generateMIC(const uint8_t* in, size_t len, uint8_t* mic) {
+  uint8_t cmac[RADIOLIB_AES128_BLOCK_SIZE];
+  this->generateCMAC(in, len, cmac);
+  memcpy(mic, cmac, sizeof(uint32_t));
+}
+
+bool RadioLibAES128::bindKey(const uint8_t* key, uint8_t keyId) {
+  (void)key;
+  (void)keyId;
+  return(false);
+}
+
 void RadioLibAES128::blockXor(uint8_t* dst, const uint8_t* a, const uint8_t* b) {
   for(uint8_t j = 0; j < RADIOLIB_AES128_BLOCK_SIZE; j++) {
     dst[j] = a[j] ^ b[j];
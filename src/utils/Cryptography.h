@@ -105,6 +105,29 @@ class RadioLibAES128 {
       \returns True if valid, false otherwise.
     */
     bool verifyCMAC(const uint8_t* in, size_t len, const uint8_t* cmac);
+
+    /*!
+      \brief Calculate the first 4 bytes of the CMAC, as used for LoRaWAN message integrity codes.
+      By default the full CMAC is calculated. AES engines that calculate the MIC directly can override this.
+      \param in Input data (unpadded).
+      \param len Length of the input data.
+      \param mic Buffer to save the 4-byte MIC into.
+    */
+    virtual void generateMIC(const uint8_t* in, size_t len, uint8_t* mic);
+
+    /*!
+      \brief Store a key in a key slot of the AES engine. Subsequent calls to init with the same key buffer
+      then select the slot, instead of transferring the key again. Engines without key storage ignore this.
+      \param key Key buffer to bind. If its contents change, the key must be bound again.
+      \param keyId Key slot in the AES engine.
+      \returns True if the key was stored in the engine, false otherwise.
+    */
+    virtual bool bindKey(const uint8_t* key, uint8_t keyId);
+
+    /*!
+      \brief Default destructor.
+    */
+    virtual ~RadioLibAES128() = default;
   
   private:
     void blockXor(uint8_t* dst, const uint8_t* a, const uint8_t* b);
@@ -18,7 +18,7 @@ uint32_t rlb_reflect(uint32_t in, uint8_t bits) {
 // fast-ish popcount function for use in calculating LFSR feedback value
 // without relying on __builtin_popcount() which may or may not be available
 // from https://stackoverflow.com/a/51388846
-static uint8_t rlb_popcount(uint32_t in) {
+uint8_t rlb_popcount(uint32_t in) {
   in = (in & 0x55555555UL) + ((in >> 1) & 0x55555555UL);
   in = (in & 0x33333333UL) + ((in >> 2) & 0x33333333UL);
   in = (in & 0x0F0F0F0FUL) + ((in >> 4) & 0x0F0F0F0FUL);
@@ -27,6 +27,29 @@ static uint8_t rlb_popcount(uint32_t in) {
   return(in);
 }
 
+int8_t rlb_select_bit(uint32_t in, uint8_t n) {
+  // skip whole bytes first, then walk the remaining bits
+  int8_t base = 0;
+  while(in) {
+    uint8_t cnt = rlb_popcount(in & 0xFFUL);
+    if(n >= cnt) {
+      n -= cnt;
+      in >>= 8;
+      base += 8;
+      continue;
+    }
+    for(int8_t i = 0; i < 8; i++) {
+      if(in & (1UL << i)) {
+        if(n == 0) {
+          return(base + i);
+        }
+        n--;
+      }
+    }
+  }
+  return(-1);
+}
+
 void rlb_scrambler(uint8_t* data, size_t len, const uint32_t poly, const uint32_t init, bool scramble) {
   if(!poly) {
     return;
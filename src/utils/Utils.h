@@ -29,6 +29,21 @@
 */
 uint32_t rlb_reflect(uint32_t in, uint8_t bits);
 
+/*!
+  \brief Function to count the number of set bits.
+  \param in The input to count bits in.
+  \return Number of bits set to 1.
+*/
+uint8_t rlb_popcount(uint32_t in);
+
+/*!
+  \brief Function to find the position of the n-th set bit, counting from the LSB.
+  \param in The input to search.
+  \param n Zero-based index of the set bit to find.
+  \return Position of the bit (0 - 31), or -1 if the input has fewer than n + 1 bits set.
+*/
+int8_t rlb_select_bit(uint32_t in, uint8_t n);
+
 /*!
   \brief Function to scramble or descramble input using a linear feedback shift register (LFSR).
   \param data The input data to (de)scramble.